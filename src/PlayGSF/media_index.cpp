@@ -0,0 +1,430 @@
+#include "media_index.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+
+extern "C" {
+#include "VBA/psftag.h"
+}
+
+// Formato del índice, una línea por elemento con campos separados por tabs:
+//
+// gsf_index <versión>
+// <directorio>
+// <mtime del directorio>
+// D <nombre>
+// F <nombre> <mtime> <tamaño> <escaneado> <title> <artist> <game> <year>
+//   <copyright> <gsfby> <length> <fade>
+
+static const int index_version = 1;
+
+// While scanning, index of directory is written at most this often
+static const int save_interval_ms = 2000;
+
+struct IndexEntry {
+    MediaEntry e;
+    long mtime, size;
+    int scanned;        // 0 = not yet, 1 = tags valid, -1 = no tags
+    TrackMetadata meta;
+};
+
+struct IndexDir {
+    long mtime;
+    bool modified;      // needs writing to index file
+    std::vector<IndexEntry> entries;
+};
+
+static std::map<std::string, IndexDir> dirs;
+static std::vector<std::string> pending;   // directories to scan, most urgent last
+static std::string index_dir;
+static std::mutex index_mutex;
+static std::condition_variable index_cond;
+static std::thread scan_thread;
+static bool scan_quit;
+
+bool media_is_gsf(const std::string& fname) {
+    auto pos = fname.find_last_of('.');
+    if (pos == std::string::npos) return false;
+    std::string ext = fname.substr(pos);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return (ext == ".minigsf" || ext == ".gsf");
+}
+
+bool media_read_tags(const std::string& file, TrackMetadata& out) {
+    out = TrackMetadata{};
+    // psftag needs room for the largest tag, too much for the stack of a thread
+    char *tag = (char *)calloc(1, 50001);
+    if (!tag) return false;
+    if (psftag_readfromfile((void*)tag, file.c_str())) {
+        free(tag);
+        return false;
+    }
+
+    char buf[512] = {0};
+    out.filename = file;
+    if (psftag_getvar(tag, "title", buf, sizeof(buf)) == 0) out.title = buf;
+    if (psftag_getvar(tag, "artist", buf, sizeof(buf)) == 0) out.artist = buf;
+    if (psftag_getvar(tag, "game", buf, sizeof(buf)) == 0) out.game = buf;
+    if (psftag_getvar(tag, "year", buf, sizeof(buf)) == 0) out.year = buf;
+    if (psftag_getvar(tag, "copyright", buf, sizeof(buf)) == 0) out.copyright = buf;
+    if (psftag_getvar(tag, "gsfby", buf, sizeof(buf)) == 0) out.gsf_by = buf;
+
+    if (psftag_getvar(tag, "length", buf, sizeof(buf)) == 0) {
+        out.length = buf;
+    } else {
+        out.length = "150";
+    }
+
+    if (psftag_getvar(tag, "fade", buf, sizeof(buf)) == 0) {
+        out.fade = buf;
+    } else {
+        out.fade = "10";
+    }
+
+    free(tag);
+    return true;
+}
+
+// ----- Index files -----
+
+static std::string index_path(const std::string& dir) {
+    // FNV-1a hash of directory
+    unsigned long h = 2166136261UL;
+    for (size_t i = 0; i < dir.size(); i++)
+        h = ((h ^ (unsigned char)dir[i]) * 16777619UL) & 0xFFFFFFFF;
+    char name[16];
+    snprintf(name, sizeof(name), "/%08lx.idx", h);
+    return index_dir + name;
+}
+
+// Split line at tabs
+static void split(char* line, std::vector<char*>& out) {
+    out.clear();
+    line[strcspn(line, "\r\n")] = 0;
+    for (char* p = line; ; ) {
+        out.push_back(p);
+        p = strchr(p, '\t');
+        if (!p) break;
+        *p++ = 0;
+    }
+}
+
+// Replace characters which would break index format
+static std::string clean(const std::string& s) {
+    std::string out = s;
+    for (size_t i = 0; i < out.size(); i++)
+        if (out[i] == '\t' || out[i] == '\n' || out[i] == '\r') out[i] = ' ';
+    return out;
+}
+
+static bool load_index(const std::string& dir, IndexDir& out) {
+    out.mtime = 0;
+    out.modified = false;
+    out.entries.clear();
+    if (index_dir.empty()) return false;
+
+    FILE* in = fopen(index_path(dir).c_str(), "r");
+    if (!in) return false;
+
+    bool ok = false;
+    std::vector<char> buf(8192);
+    std::vector<char*> f;
+    int version;
+    if (fscanf(in, "gsf_index %d\n", &version) == 1 && version == index_version &&
+            fgets(&buf[0], (int)buf.size(), in)) {
+        split(&buf[0], f);
+        ok = (f[0] == dir) && fscanf(in, "%ld\n", &out.mtime) == 1;
+    }
+
+    while (ok && fgets(&buf[0], (int)buf.size(), in)) {
+        split(&buf[0], f);
+        IndexEntry x = IndexEntry();
+        if (f[0][0] == 'D' && f.size() == 2) {
+            x.e.name = f[1];
+            x.e.is_dir = true;
+        } else if (f[0][0] == 'F' && f.size() == 13) {
+            x.e.name = f[1];
+            x.e.is_dir = false;
+            x.mtime = atol(f[2]);
+            x.size = atol(f[3]);
+            x.scanned = atoi(f[4]);
+            x.meta.title = f[5];
+            x.meta.artist = f[6];
+            x.meta.game = f[7];
+            x.meta.year = f[8];
+            x.meta.copyright = f[9];
+            x.meta.gsf_by = f[10];
+            x.meta.length = f[11];
+            x.meta.fade = f[12];
+        } else {
+            ok = false;
+            break;
+        }
+        out.entries.push_back(x);
+    }
+    fclose(in);
+    if (!ok) {
+        out.mtime = 0;
+        out.entries.clear();
+    }
+    return ok;
+}
+
+static void save_index(const std::string& dir, const IndexDir& d) {
+    // Escribir a un temporal primero, para no dejar nunca el índice a medias
+    std::string path = index_path(dir);
+    std::string temp = path + ".tmp";
+    FILE* out = fopen(temp.c_str(), "w");
+    if (!out) return;
+
+    fprintf(out, "gsf_index %d\n%s\n%ld\n", index_version, dir.c_str(), d.mtime);
+    for (const IndexEntry& x : d.entries) {
+        if (x.e.is_dir) {
+            fprintf(out, "D\t%s\n", x.e.name.c_str());
+            continue;
+        }
+        const TrackMetadata& m = x.meta;
+        fprintf(out, "F\t%s\t%ld\t%ld\t%d\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\n",
+                x.e.name.c_str(), x.mtime, x.size, x.scanned,
+                m.title.c_str(), m.artist.c_str(), m.game.c_str(), m.year.c_str(),
+                m.copyright.c_str(), m.gsf_by.c_str(), m.length.c_str(), m.fade.c_str());
+    }
+
+    if (fclose(out) != 0 || rename(temp.c_str(), path.c_str()) != 0)
+        remove(temp.c_str());
+}
+
+// Write index files of modified directories. Called with lock held, which is
+// released while writing so listing never waits on the card. False if there
+// was nothing to write.
+static bool save_modified(std::unique_lock<std::mutex>& lock) {
+    if (index_dir.empty()) return false;
+
+    std::vector<std::pair<std::string, IndexDir>> copies;
+    for (auto& d : dirs) {
+        if (d.second.modified) {
+            d.second.modified = false;
+            copies.push_back(d);
+        }
+    }
+    if (copies.empty()) return false;
+
+    lock.unlock();
+    for (const auto& d : copies) save_index(d.first, d.second);
+    lock.lock();
+    return true;
+}
+
+// ----- Listing -----
+
+static bool entry_less(const IndexEntry& a, const IndexEntry& b) {
+    if (a.e.is_dir != b.e.is_dir) return a.e.is_dir > b.e.is_dir;
+    return a.e.name < b.e.name;
+}
+
+// Read directory itself, keeping tags from old listing of files which haven't
+// changed
+static void read_dir(const std::string& dir, const IndexDir& old, IndexDir& out) {
+    out.entries.clear();
+    DIR* d = opendir(dir.c_str());
+    if (!d) return;
+    struct dirent* de;
+    while ((de = readdir(d)) != nullptr) {
+        std::string name = de->d_name;
+        if (name == "." || name == "..") continue;
+
+        // Solo stat cuando el sistema de archivos no da el tipo, o para pistas
+        IndexEntry x = IndexEntry();
+        x.e.name = name;
+        struct stat st{};
+        bool have_stat = false;
+        if (de->d_type == DT_DIR || de->d_type == DT_REG) {
+            x.e.is_dir = (de->d_type == DT_DIR);
+        } else {
+            if (stat((dir + "/" + name).c_str(), &st) != 0) continue;
+            have_stat = true;
+            x.e.is_dir = S_ISDIR(st.st_mode);
+        }
+        if (!x.e.is_dir) {
+            if (!media_is_gsf(name)) continue;
+            if (!have_stat && stat((dir + "/" + name).c_str(), &st) != 0) continue;
+            x.mtime = (long)st.st_mtime;
+            x.size = (long)st.st_size;
+        }
+        out.entries.push_back(x);
+    }
+    closedir(d);
+    std::sort(out.entries.begin(), out.entries.end(), entry_less);
+
+    for (IndexEntry& x : out.entries) {
+        if (x.e.is_dir) continue;
+        auto it = std::lower_bound(old.entries.begin(), old.entries.end(), x, entry_less);
+        if (it != old.entries.end() && it->e.name == x.e.name && !it->e.is_dir &&
+                it->mtime == x.mtime && it->size == x.size)
+            x = *it;
+    }
+}
+
+void media_index_list(const std::string& dir, std::vector<MediaEntry>& out) {
+    out.clear();
+    struct stat st{};
+    if (stat(dir.c_str(), &st) != 0) return;
+    long mtime = (long)st.st_mtime;
+
+    std::lock_guard<std::mutex> lock(index_mutex);
+    auto it = dirs.find(dir);
+    if (it == dirs.end()) {
+        it = dirs.insert(std::make_pair(dir, IndexDir())).first;
+        load_index(dir, it->second);
+    }
+
+    IndexDir& d = it->second;
+    if (d.mtime != mtime) {
+        // El directorio cambió desde que se indexó
+        IndexDir fresh;
+        read_dir(dir, d, fresh);
+        d.entries.swap(fresh.entries);
+        d.mtime = mtime;
+        d.modified = true;
+    }
+
+    bool unscanned = false;
+    for (const IndexEntry& x : d.entries) {
+        out.push_back(x.e);
+        if (!x.e.is_dir && x.scanned == 0) unscanned = true;
+    }
+
+    // Escanear este directorio a continuación
+    pending.erase(std::remove(pending.begin(), pending.end(), dir), pending.end());
+    if (unscanned) pending.push_back(dir);
+
+    // El hilo de escaneo escribe el índice
+    if (unscanned || d.modified) index_cond.notify_one();
+}
+
+bool media_index_find(const std::string& path, TrackMetadata& out) {
+    size_t slash = path.find_last_of('/');
+    if (slash == std::string::npos) return false;
+    IndexEntry key = IndexEntry();
+    key.e.name = path.substr(slash + 1);
+
+    std::lock_guard<std::mutex> lock(index_mutex);
+    auto it = dirs.find(path.substr(0, slash));
+    if (it == dirs.end()) return false;
+    const std::vector<IndexEntry>& v = it->second.entries;
+    auto x = std::lower_bound(v.begin(), v.end(), key, entry_less);
+    if (x == v.end() || x->e.name != key.e.name || x->scanned <= 0) return false;
+    out = x->meta;
+    out.filename = path;
+    return true;
+}
+
+// ----- Background scanning -----
+
+static void scan_loop() {
+    // Baja prioridad, para no quitar CPU al motor ni a la interfaz
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 19);
+
+    auto last_save = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(index_mutex);
+    while (!scan_quit) {
+        // Next file needing tags in most recently listed directory
+        std::string dir, name;
+        while (!pending.empty() && name.empty()) {
+            auto it = dirs.find(pending.back());
+            if (it != dirs.end()) {
+                for (const IndexEntry& x : it->second.entries) {
+                    if (!x.e.is_dir && x.scanned == 0) {
+                        dir = it->first;
+                        name = x.e.name;
+                        break;
+                    }
+                }
+            }
+            if (name.empty()) pending.pop_back();
+        }
+
+        if (name.empty()) {
+            // Nothing to do; write out what has been scanned, then look again
+            // since directories may have been listed meanwhile
+            if (!save_modified(lock)) index_cond.wait(lock);
+            continue;
+        }
+
+        lock.unlock();
+        TrackMetadata meta;
+        bool ok = media_read_tags(dir + "/" + name, meta);
+        lock.lock();
+
+        // Directory might have been read again meanwhile
+        auto it = dirs.find(dir);
+        if (it == dirs.end()) continue;
+        IndexDir& d = it->second;
+        for (IndexEntry& x : d.entries) {
+            if (!x.e.is_dir && x.e.name == name && x.scanned == 0) {
+                x.scanned = ok ? 1 : -1;
+                for (std::string* s : {&meta.title, &meta.artist, &meta.game, &meta.year,
+                        &meta.copyright, &meta.gsf_by, &meta.length, &meta.fade})
+                    *s = clean(*s);
+                meta.filename.clear();
+                x.meta = meta;
+                d.modified = true;
+                break;
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_save >= std::chrono::milliseconds(save_interval_ms)) {
+            last_save = now;
+            save_modified(lock);
+        }
+    }
+}
+
+int media_index_open(const char *dir) {
+    index_dir.clear();
+    if (dir && *dir) {
+        // Crear también los directorios padre
+        std::string path = dir;
+        for (size_t i = 1; i <= path.size(); i++) {
+            if (i == path.size() || path[i] == '/') {
+                if (mkdir(path.substr(0, i).c_str(), 0755) != 0 && errno != EEXIST)
+                    return -1;
+            }
+        }
+        index_dir = path;
+    }
+
+    if (!scan_thread.joinable()) {
+        scan_quit = false;
+        scan_thread = std::thread(scan_loop);
+    }
+    return 0;
+}
+
+void media_index_close(void) {
+    if (scan_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(index_mutex);
+            scan_quit = true;
+            index_cond.notify_one();
+        }
+        scan_thread.join();
+    }
+
+    std::unique_lock<std::mutex> lock(index_mutex);
+    save_modified(lock);
+}
@@ -0,0 +1,44 @@
+// Index of GSF music directories. Listing and tags of each directory are kept
+// in an index file, so a directory is only read again when its modification
+// time changes. Tags are read by a low-priority background thread, most
+// recently listed directory first. Functions may be called from any thread.
+
+#ifndef MEDIA_INDEX_H
+#define MEDIA_INDEX_H
+
+#include <string>
+#include <vector>
+
+// Estructura de metadatos de pista
+struct TrackMetadata {
+    std::string filename, title, artist, game, year, copyright, gsf_by, length, fade;
+};
+
+struct MediaEntry {
+    std::string name;
+    bool is_dir;
+};
+
+// Keep index files in directory, creating it if necessary, and start
+// background thread. NULL or "" keeps index in memory only. Returns 0 on
+// success.
+int media_index_open(const char *index_dir);
+
+// Write out index and stop background thread
+void media_index_close(void);
+
+// List directories, then GSF files, each sorted by name. "." and ".." aren't
+// included.
+void media_index_list(const std::string& dir, std::vector<MediaEntry>& out);
+
+// Get tags of file from index. False if it hasn't been scanned yet.
+bool media_index_find(const std::string& path, TrackMetadata& out);
+
+// Read tags from file itself. Missing length and fade are filled in with
+// defaults. False if file has no tags.
+bool media_read_tags(const std::string& path, TrackMetadata& out);
+
+// True if file name has a GSF extension
+bool media_is_gsf(const std::string& name);
+
+#endif
@@ -0,0 +1,1499 @@
+// -*- C++ -*-
+// Cached CPU core, see CpuCache.h. Every handler here is a copy of the
+// matching case in arm-new.h or thumb.h (C_CORE version) with the decoding
+// taken out, so keep the two in step.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "GBA.h"
+#include "GBAinline.h"
+#include "Globals.h"
+#include "CpuCache.h"
+
+extern int memoryWait[16];
+extern int memoryWait32[16];
+extern int memoryWaitSeq32[16];
+extern int memoryWaitFetch[16];
+extern int memoryWaitFetch32[16];
+extern u8 cpuBitsSet[256];
+extern bool holdState;
+
+static inline int CPUUpdateTicksAccess32(u32 address)
+{
+  return memoryWait32[(address>>24)&15];
+}
+
+static inline int CPUUpdateTicksAccess16(u32 address)
+{
+  return memoryWait[(address>>24)&15];
+}
+
+static inline int CPUUpdateTicksAccessSeq32(u32 address)
+{
+  return memoryWaitSeq32[(address>>24)&15];
+}
+
+u8 cpuCacheWorkRAMPages[0x40000 >> 10];
+u8 cpuCacheInternalRAMPages[0x8000 >> 10];
+
+struct CpuCacheEntry;
+typedef void (*CpuCacheHandler)(const CpuCacheEntry *, int &clockTicks);
+
+struct CpuCacheEntry {
+  CpuCacheHandler handler; // NULL until decoded
+  u32 value;               // immediate operand, offset or register list
+  u8 rd;
+  u8 rn;
+  u8 rm;
+  u8 rs;
+  u8 shift;                // shift amount, or carry out + 1 of an immediate
+  u8 cond;                 // ARM condition
+  u8 cycles;               // THUMB cycles from thumbCycles
+};
+
+struct CpuCachePages {
+  CpuCacheEntry *bios[0x4000 >> 10];
+  CpuCacheEntry *workRAM[0x40000 >> 10];
+  CpuCacheEntry *internalRAM[0x8000 >> 10];
+  CpuCacheEntry *rom[0x2000000 >> 10];
+};
+
+static CpuCachePages armPages;
+static CpuCachePages thumbPages;
+
+#define ARM_PAGE_ENTRIES   (1024 / 4)
+#define THUMB_PAGE_ENTRIES (1024 / 2)
+
+// Handler of instructions left to the interpreter
+static void interpret(const CpuCacheEntry *, int &)
+{
+}
+
+static CpuCacheEntry **cpuCacheSlot(CpuCachePages &pages, u32 address)
+{
+  switch(address >> 24) {
+  case 0:
+    return &pages.bios[(address & 0x3FFF) >> 10];
+  case 2:
+    return &pages.workRAM[(address & 0x3FFFF) >> 10];
+  case 3:
+    return &pages.internalRAM[(address & 0x7FFF) >> 10];
+  case 8:
+  case 9:
+  case 10:
+  case 12:
+    return &pages.rom[(address & 0x1FFFFFF) >> 10];
+  }
+  return NULL;
+}
+
+static CpuCacheEntry *cpuCachePage(CpuCachePages &pages, u32 address,
+                                   int entries)
+{
+  CpuCacheEntry **slot = cpuCacheSlot(pages, address);
+  if(slot == NULL)
+    return NULL;
+  if(*slot == NULL) {
+    *slot = (CpuCacheEntry *)calloc(entries, sizeof(CpuCacheEntry));
+    if(*slot == NULL)
+      return NULL;
+    if((address >> 24) == 2)
+      cpuCacheWorkRAMPages[(address & 0x3FFFF) >> 10] = 1;
+    else if((address >> 24) == 3)
+      cpuCacheInternalRAMPages[(address & 0x7FFF) >> 10] = 1;
+  }
+  return *slot;
+}
+
+static void cpuCacheFreePages(CpuCacheEntry **slot, int count)
+{
+  for(int i = 0; i < count; i++) {
+    if(slot[i] != NULL) {
+      free(slot[i]);
+      slot[i] = NULL;
+    }
+  }
+}
+
+void cpuCacheFlush()
+{
+  CpuCachePages *pages[2] = { &armPages, &thumbPages };
+  for(int i = 0; i < 2; i++) {
+    cpuCacheFreePages(pages[i]->bios, 0x4000 >> 10);
+    cpuCacheFreePages(pages[i]->workRAM, 0x40000 >> 10);
+    cpuCacheFreePages(pages[i]->internalRAM, 0x8000 >> 10);
+    cpuCacheFreePages(pages[i]->rom, 0x2000000 >> 10);
+  }
+  memset(cpuCacheWorkRAMPages, 0, sizeof(cpuCacheWorkRAMPages));
+  memset(cpuCacheInternalRAMPages, 0, sizeof(cpuCacheInternalRAMPages));
+}
+
+void cpuCacheInvalidate(u32 address)
+{
+  CpuCacheEntry **slot = cpuCacheSlot(armPages, address);
+  if(slot != NULL && *slot != NULL)
+    (*slot)[(address & 0x3FF) >> 2].handler = NULL;
+  slot = cpuCacheSlot(thumbPages, address);
+  if(slot != NULL && *slot != NULL) {
+    CpuCacheEntry *e = &(*slot)[(address & 0x3FC) >> 1];
+    e[0].handler = NULL;
+    e[1].handler = NULL;
+  }
+}
+
+// Flags, as set by arm-new.h and thumb.h
+
+#define NEG(i) ((i) >> 31)
+#define POS(i) ((~(i)) >> 31)
+
+static inline void setNZ(u32 res)
+{
+  N_FLAG = (res & 0x80000000) ? true : false;
+  Z_FLAG = (res) ? false : true;
+}
+
+static inline void setAddFlags(u32 a, u32 b, u32 c)
+{
+  Z_FLAG = (c == 0) ? true : false;
+  N_FLAG = NEG(c) ? true : false;
+  C_FLAG = ((NEG(a) & NEG(b)) |
+            (NEG(a) & POS(c)) |
+            (NEG(b) & POS(c))) ? true : false;
+  V_FLAG = ((NEG(a) & NEG(b) & POS(c)) |
+            (POS(a) & POS(b) & NEG(c))) ? true : false;
+}
+
+static inline void setSubFlags(u32 a, u32 b, u32 c)
+{
+  Z_FLAG = (c == 0) ? true : false;
+  N_FLAG = NEG(c) ? true : false;
+  C_FLAG = ((NEG(a) & POS(b)) |
+            (NEG(a) & POS(c)) |
+            (POS(b) & POS(c))) ? true : false;
+  V_FLAG = ((NEG(a) & POS(b) & POS(c)) |
+            (POS(a) & NEG(b) & NEG(c))) ? true : false;
+}
+
+static inline bool cpuCacheCondition(int cond)
+{
+  switch(cond) {
+  case 0x00: // EQ
+    return Z_FLAG;
+  case 0x01: // NE
+    return !Z_FLAG;
+  case 0x02: // CS
+    return C_FLAG;
+  case 0x03: // CC
+    return !C_FLAG;
+  case 0x04: // MI
+    return N_FLAG;
+  case 0x05: // PL
+    return !N_FLAG;
+  case 0x06: // VS
+    return V_FLAG;
+  case 0x07: // VC
+    return !V_FLAG;
+  case 0x08: // HI
+    return C_FLAG && !Z_FLAG;
+  case 0x09: // LS
+    return !C_FLAG || Z_FLAG;
+  case 0x0A: // GE
+    return N_FLAG == V_FLAG;
+  case 0x0B: // LT
+    return N_FLAG != V_FLAG;
+  case 0x0C: // GT
+    return !Z_FLAG && (N_FLAG == V_FLAG);
+  case 0x0D: // LE
+    return Z_FLAG || (N_FLAG != V_FLAG);
+  case 0x0E: // AL
+    return true;
+  }
+  return false;
+}
+
+// ARM data processing
+
+enum {
+  OPERAND_IMM,     // value, carry out in shift
+  OPERAND_REG,     // Rm
+  OPERAND_LSL,     // Rm, LSL #shift
+  OPERAND_LSR,     // Rm, LSR #shift
+  OPERAND_LSR32,   // Rm, LSR #32
+  OPERAND_ASR,     // Rm, ASR #shift
+  OPERAND_ASR32,   // Rm, ASR #32
+  OPERAND_ROR,     // Rm, ROR #shift
+  OPERAND_RRX,     // Rm, RRX
+  OPERAND_LSL_REG, // Rm, LSL Rs
+  OPERAND_LSR_REG, // Rm, LSR Rs
+  OPERAND_ASR_REG, // Rm, ASR Rs
+  OPERAND_ROR_REG, // Rm, ROR Rs
+  OPERAND_COUNT
+};
+
+template<int OPERAND>
+static inline u32 armOperand(const CpuCacheEntry *e, bool &C_OUT,
+                             int &clockTicks)
+{
+  u32 v = reg[e->rm].I;
+  int shift = e->shift;
+  switch(OPERAND) {
+  case OPERAND_IMM:
+    if(shift)
+      C_OUT = shift - 1 ? true : false;
+    return e->value;
+  case OPERAND_REG:
+    return v;
+  case OPERAND_LSL:
+    C_OUT = (v >> (32 - shift)) & 1 ? true : false;
+    return v << shift;
+  case OPERAND_LSR:
+    C_OUT = (v >> (shift - 1)) & 1 ? true : false;
+    return v >> shift;
+  case OPERAND_LSR32:
+    C_OUT = (v & 0x80000000) ? true : false;
+    return 0;
+  case OPERAND_ASR:
+    C_OUT = ((s32)v >> (int)(shift - 1)) & 1 ? true : false;
+    return (s32)v >> (int)shift;
+  case OPERAND_ASR32:
+    if(v & 0x80000000) {
+      C_OUT = true;
+      return 0xFFFFFFFF;
+    }
+    C_OUT = false;
+    return 0;
+  case OPERAND_ROR:
+    C_OUT = (v >> (shift - 1)) & 1 ? true : false;
+    return (v << (32 - shift)) | (v >> shift);
+  case OPERAND_RRX:
+    {
+      u32 c = C_FLAG ? 1 : 0;
+      C_OUT = (v & 1) ? true : false;
+      return (v >> 1) | (c << 31);
+    }
+  case OPERAND_LSL_REG:
+    clockTicks++;
+    shift = reg[e->rs].B.B0;
+    if(shift) {
+      if(shift == 32) {
+        C_OUT = (v & 1 ? true : false);
+        return 0;
+      } else if(shift < 32) {
+        C_OUT = (v >> (32 - shift)) & 1 ? true : false;
+        return v << shift;
+      }
+      C_OUT = false;
+      return 0;
+    }
+    return v;
+  case OPERAND_LSR_REG:
+    clockTicks++;
+    shift = reg[e->rs].B.B0;
+    if(shift) {
+      if(shift == 32) {
+        C_OUT = (v & 0x80000000 ? true : false);
+        return 0;
+      } else if(shift < 32) {
+        C_OUT = (v >> (shift - 1)) & 1 ? true : false;
+        return v >> shift;
+      }
+      C_OUT = false;
+      return 0;
+    }
+    return v;
+  case OPERAND_ASR_REG:
+    clockTicks++;
+    shift = reg[e->rs].B.B0;
+    if(shift < 32) {
+      if(shift) {
+        C_OUT = ((s32)v >> (int)(shift - 1)) & 1 ? true : false;
+        return (s32)v >> (int)shift;
+      }
+      return v;
+    }
+    if(v & 0x80000000) {
+      C_OUT = true;
+      return 0xFFFFFFFF;
+    }
+    C_OUT = false;
+    return 0;
+  case OPERAND_ROR_REG:
+    clockTicks++;
+    shift = reg[e->rs].B.B0 & 0x1f;
+    if(shift) {
+      C_OUT = (v >> (shift - 1)) & 1 ? true : false;
+      return (v << (32 - shift)) | (v >> shift);
+    }
+    C_OUT = (v & 0x80000000 ? true : false);
+    return v;
+  }
+  return 0;
+}
+
+template<int OP, int OPERAND, bool S>
+static void armDataProcessing(const CpuCacheEntry *e, int &clockTicks)
+{
+  bool C_OUT = C_FLAG;
+  u32 value = armOperand<OPERAND>(e, C_OUT, clockTicks);
+  u32 lhs = reg[e->rn].I;
+  u32 res;
+
+  switch(OP) {
+  case 0x0: // AND
+    res = lhs & value;
+    break;
+  case 0x1: // EOR
+    res = lhs ^ value;
+    break;
+  case 0x2: // SUB
+    res = lhs - value;
+    if(S)
+      setSubFlags(lhs, value, res);
+    break;
+  case 0x3: // RSB
+    res = value - lhs;
+    if(S)
+      setSubFlags(value, lhs, res);
+    break;
+  case 0x4: // ADD
+    res = lhs + value;
+    if(S)
+      setAddFlags(lhs, value, res);
+    break;
+  case 0x5: // ADC
+    res = lhs + value + (u32)C_FLAG;
+    if(S)
+      setAddFlags(lhs, value, res);
+    break;
+  case 0x6: // SBC
+    res = lhs - value - !((u32)C_FLAG);
+    if(S)
+      setSubFlags(lhs, value, res);
+    break;
+  case 0x7: // RSC
+    res = value - lhs - !((u32)C_FLAG);
+    if(S)
+      setSubFlags(value, lhs, res);
+    break;
+  case 0x8: // TST
+    res = lhs & value;
+    break;
+  case 0x9: // TEQ
+    res = lhs ^ value;
+    break;
+  case 0xA: // CMP
+    res = lhs - value;
+    setSubFlags(lhs, value, res);
+    break;
+  case 0xB: // CMN
+    res = lhs + value;
+    setAddFlags(lhs, value, res);
+    break;
+  case 0xC: // ORR
+    res = lhs | value;
+    break;
+  case 0xD: // MOV
+    res = value;
+    break;
+  case 0xE: // BIC
+    res = lhs & (~value);
+    break;
+  default: // MVN
+    res = ~value;
+    break;
+  }
+
+  bool logical = (OP < 2) || (OP >= 8 && OP != 0xA && OP != 0xB);
+  if(S && logical) {
+    setNZ(res);
+    C_FLAG = C_OUT;
+  }
+  if(OP < 8 || OP >= 0xC)
+    reg[e->rd].I = res;
+}
+
+#define DATA_OPERANDS(OP, S) \
+  { armDataProcessing<OP, OPERAND_IMM, S>,\
+    armDataProcessing<OP, OPERAND_REG, S>,\
+    armDataProcessing<OP, OPERAND_LSL, S>,\
+    armDataProcessing<OP, OPERAND_LSR, S>,\
+    armDataProcessing<OP, OPERAND_LSR32, S>,\
+    armDataProcessing<OP, OPERAND_ASR, S>,\
+    armDataProcessing<OP, OPERAND_ASR32, S>,\
+    armDataProcessing<OP, OPERAND_ROR, S>,\
+    armDataProcessing<OP, OPERAND_RRX, S>,\
+    armDataProcessing<OP, OPERAND_LSL_REG, S>,\
+    armDataProcessing<OP, OPERAND_LSR_REG, S>,\
+    armDataProcessing<OP, OPERAND_ASR_REG, S>,\
+    armDataProcessing<OP, OPERAND_ROR_REG, S> }
+
+#define DATA_OP(OP) { DATA_OPERANDS(OP, false), DATA_OPERANDS(OP, true) }
+
+// TST, TEQ, CMP and CMN always set flags, without S they are other
+// instructions and never get here
+static const CpuCacheHandler armDataHandlers[16][2][OPERAND_COUNT] = {
+  DATA_OP(0x0), DATA_OP(0x1), DATA_OP(0x2), DATA_OP(0x3),
+  DATA_OP(0x4), DATA_OP(0x5), DATA_OP(0x6), DATA_OP(0x7),
+  DATA_OP(0x8), DATA_OP(0x9), DATA_OP(0xA), DATA_OP(0xB),
+  DATA_OP(0xC), DATA_OP(0xD), DATA_OP(0xE), DATA_OP(0xF)
+};
+
+// ARM multiply
+
+template<bool ACCUMULATE, bool S>
+static void armMultiply(const CpuCacheEntry *e, int &clockTicks)
+{
+  u32 rs = reg[e->rs].I;
+  if(ACCUMULATE)
+    reg[e->rd].I = reg[e->rm].I * rs + reg[e->rn].I;
+  else
+    reg[e->rd].I = reg[e->rm].I * rs;
+  if(S)
+    setNZ(reg[e->rd].I);
+  if(((s32)rs)<0)
+    rs = ~rs;
+  if((rs & 0xFFFFFF00) == 0)
+    clockTicks += ACCUMULATE ? 3 : 2;
+  else if ((rs & 0xFFFF0000) == 0)
+    clockTicks += ACCUMULATE ? 4 : 3;
+  else if ((rs & 0xFF000000) == 0)
+    clockTicks += ACCUMULATE ? 5 : 4;
+  else
+    clockTicks += ACCUMULATE ? 6 : 5;
+}
+
+// ARM LDR, STR, LDRB and STRB
+
+enum {
+  OFFSET_IMM,
+  OFFSET_LSL,
+  OFFSET_LSR,
+  OFFSET_ASR,
+  OFFSET_ROR
+};
+
+template<int OFFSET>
+static inline u32 armOffset(const CpuCacheEntry *e)
+{
+  int shift = e->shift;
+  u32 v = reg[e->rm].I;
+  switch(OFFSET) {
+  case OFFSET_IMM:
+    return e->value;
+  case OFFSET_LSL:
+    return v << shift;
+  case OFFSET_LSR:
+    return shift ? v >> shift : 0;
+  case OFFSET_ASR:
+    if(shift)
+      return (s32)v >> shift;
+    return (v & 0x80000000) ? 0xFFFFFFFF : 0;
+  case OFFSET_ROR:
+    if(shift)
+      return (v << (32 - shift)) | (v >> shift);
+    return (v >> 1) | ((u32)C_FLAG << 31);
+  }
+  return 0;
+}
+
+template<bool LOAD, bool BYTE, bool PRE, bool UP, bool WRITEBACK, int OFFSET>
+static void armTransfer(const CpuCacheEntry *e, int &clockTicks)
+{
+  u32 offset = armOffset<OFFSET>(e);
+  u32 base = reg[e->rn].I;
+  u32 next = UP ? base + offset : base - offset;
+  u32 address = PRE ? next : base;
+
+  if(LOAD) {
+    if(BYTE)
+      reg[e->rd].I = CPUReadByte(address);
+    else
+      reg[e->rd].I = CPUReadMemory(address);
+    if((!PRE || WRITEBACK) && e->rd != e->rn)
+      reg[e->rn].I = next;
+    clockTicks += 3 + (BYTE ? CPUUpdateTicksAccess16(address) :
+                       CPUUpdateTicksAccess32(address));
+  } else {
+    if(PRE && WRITEBACK)
+      reg[e->rn].I = address;
+    if(BYTE)
+      CPUWriteByte(address, reg[e->rd].B.B0);
+    else
+      CPUWriteMemory(address, reg[e->rd].I);
+    if(!PRE)
+      reg[e->rn].I = next;
+    clockTicks += 2 + (BYTE ? CPUUpdateTicksAccess16(address) :
+                       CPUUpdateTicksAccess32(address));
+  }
+}
+
+#define TRANSFER_OFFSETS(L, B, P, U, W) \
+  { armTransfer<L, B, P, U, W, OFFSET_IMM>,\
+    armTransfer<L, B, P, U, W, OFFSET_LSL>,\
+    armTransfer<L, B, P, U, W, OFFSET_LSR>,\
+    armTransfer<L, B, P, U, W, OFFSET_ASR>,\
+    armTransfer<L, B, P, U, W, OFFSET_ROR> }
+
+#define TRANSFER_W(L, B, P, U) \
+  { TRANSFER_OFFSETS(L, B, P, U, false), TRANSFER_OFFSETS(L, B, P, U, true) }
+
+#define TRANSFER_U(L, B, P) { TRANSFER_W(L, B, P, false), TRANSFER_W(L, B, P, true) }
+#define TRANSFER_P(L, B) { TRANSFER_U(L, B, false), TRANSFER_U(L, B, true) }
+#define TRANSFER_B(L) { TRANSFER_P(L, false), TRANSFER_P(L, true) }
+
+// Indexed by L, B, P, U, W and offset
+static const CpuCacheHandler armTransferHandlers[2][2][2][2][2][5] = {
+  TRANSFER_B(false), TRANSFER_B(true)
+};
+
+// ARM STRH, LDRH, LDRSB and LDRSH
+
+enum {
+  HALF_STRH,
+  HALF_LDRH,
+  HALF_LDRSB,
+  HALF_LDRSH
+};
+
+template<int TYPE, bool PRE, bool UP, bool WRITEBACK, bool IMMEDIATE>
+static void armHalfTransfer(const CpuCacheEntry *e, int &clockTicks)
+{
+  u32 offset = IMMEDIATE ? e->value : reg[e->rm].I;
+  u32 base = reg[e->rn].I;
+  u32 next = UP ? base + offset : base - offset;
+  u32 address = PRE ? next : base;
+
+  if(TYPE == HALF_STRH) {
+    clockTicks += 4 + CPUUpdateTicksAccess16(address);
+    CPUWriteHalfWord(address, reg[e->rd].W.W0);
+    if(!PRE || WRITEBACK)
+      reg[e->rn].I = next;
+  } else {
+    clockTicks += 3 + CPUUpdateTicksAccess16(address);
+    if(TYPE == HALF_LDRH)
+      reg[e->rd].I = CPUReadHalfWord(address);
+    else if(TYPE == HALF_LDRSB)
+      reg[e->rd].I = (s8)CPUReadByte(address);
+    else
+      reg[e->rd].I = (s16)CPUReadHalfWordSigned(address);
+    if((!PRE || WRITEBACK) && e->rd != e->rn)
+      reg[e->rn].I = next;
+  }
+}
+
+#define HALF_I(T, P, U, W) \
+  { armHalfTransfer<T, P, U, W, false>, armHalfTransfer<T, P, U, W, true> }
+#define HALF_W(T, P, U) { HALF_I(T, P, U, false), HALF_I(T, P, U, true) }
+#define HALF_U(T, P) { HALF_W(T, P, false), HALF_W(T, P, true) }
+#define HALF_P(T) { HALF_U(T, false), HALF_U(T, true) }
+
+// Indexed by type, P, U, W and I
+static const CpuCacheHandler armHalfHandlers[4][2][2][2][2] = {
+  HALF_P(HALF_STRH), HALF_P(HALF_LDRH), HALF_P(HALF_LDRSB), HALF_P(HALF_LDRSH)
+};
+
+// ARM B and BL
+
+template<bool LINK>
+static void armBranch(const CpuCacheEntry *e, int &clockTicks)
+{
+  clockTicks += 3;
+  if(LINK)
+    reg[14].I = reg[15].I - 4;
+  reg[15].I += e->value;
+  armNextPC = reg[15].I;
+  reg[15].I += 4;
+}
+
+static void armDecode(CpuCacheEntry *e, u32 opcode)
+{
+  bool load = (opcode & 0x00100000) ? true : false;
+
+  e->value = 0;
+  e->rd = (opcode >> 12) & 15;
+  e->rn = (opcode >> 16) & 15;
+  e->rm = opcode & 15;
+  e->rs = (opcode >> 8) & 15;
+  e->shift = (opcode >> 7) & 31;
+  e->cond = opcode >> 28;
+  e->cycles = 0;
+  e->handler = interpret;
+
+  switch((opcode >> 25) & 7) {
+  case 0:
+    if((opcode & 0x90) == 0x90) {
+      if((opcode & 0x60) == 0) {
+        // MUL and MLA, but not long multiplies or SWP
+        if((opcode & 0x0FC00000) == 0 && ((opcode >> 16) & 15) != 15) {
+          e->rd = (opcode >> 16) & 15;
+          e->rn = (opcode >> 12) & 15;
+          bool s = (opcode & 0x00100000) ? true : false;
+          if(opcode & 0x00200000)
+            e->handler = s ? armMultiply<true, true> : armMultiply<true, false>;
+          else
+            e->handler = s ? armMultiply<false, true> : armMultiply<false, false>;
+        }
+        break;
+      }
+      // STRH, LDRH, LDRSB and LDRSH, but not PC loads or STRD/LDRD
+      int type = (opcode >> 5) & 3;
+      if(load) {
+        if(e->rd == 15)
+          break;
+      } else if(type != 1)
+        break;
+      e->value = (opcode & 0x0F) | ((opcode >> 4) & 0xF0);
+      e->handler = armHalfHandlers[load ? type : HALF_STRH]
+        [(opcode >> 24) & 1][(opcode >> 23) & 1][(opcode >> 21) & 1]
+        [(opcode >> 22) & 1];
+      break;
+    }
+    // fall through, data processing with register operand
+  case 1:
+    {
+      int op = (opcode >> 21) & 15;
+      int s = (opcode >> 20) & 1;
+      int operand;
+      if(e->rd == 15 || (op >= 8 && op <= 11 && !s))
+        break;
+      if(opcode & 0x02000000) {
+        u32 v = opcode & 0xFF;
+        int shift = (opcode & 0xF00) >> 7;
+        operand = OPERAND_IMM;
+        e->shift = 0;
+        e->value = v;
+        if(shift) {
+          e->shift = 1 + ((v >> (shift - 1)) & 1);
+          e->value = (v << (32 - shift)) | (v >> shift);
+        }
+      } else if(opcode & 0x10) {
+        operand = OPERAND_LSL_REG + ((opcode >> 5) & 3);
+      } else {
+        static const int immOperands[4][2] = {
+          { OPERAND_REG, OPERAND_LSL },
+          { OPERAND_LSR32, OPERAND_LSR },
+          { OPERAND_ASR32, OPERAND_ASR },
+          { OPERAND_RRX, OPERAND_ROR }
+        };
+        operand = immOperands[(opcode >> 5) & 3][e->shift ? 1 : 0];
+      }
+      e->handler = armDataHandlers[op][s][operand];
+    }
+    break;
+  case 3:
+    if(opcode & 0x10)
+      break;
+    // fall through
+  case 2:
+    {
+      int offset = OFFSET_IMM;
+      if(load && e->rd == 15)
+        break;
+      if(opcode & 0x02000000)
+        offset = OFFSET_LSL + ((opcode >> 5) & 3);
+      else
+        e->value = opcode & 0xFFF;
+      e->handler = armTransferHandlers[load][(opcode >> 22) & 1]
+        [(opcode >> 24) & 1][(opcode >> 23) & 1][(opcode >> 21) & 1][offset];
+    }
+    break;
+  case 5:
+    {
+      int offset = opcode & 0x00FFFFFF;
+      if(offset & 0x00800000)
+        offset |= 0xFF000000;
+      e->value = offset << 2;
+      if(opcode & 0x01000000)
+        e->handler = armBranch<true>;
+      else
+        e->handler = armBranch<false>;
+    }
+    break;
+  }
+}
+
+// THUMB shifts by immediate
+
+template<int TYPE>
+static void thumbShift(const CpuCacheEntry *e, int &)
+{
+  u32 v = reg[e->rn].I;
+  int shift = e->shift;
+  u32 value;
+
+  if(TYPE == 0) {
+    // LSL Rd, Rm, #Imm 5
+    if(shift) {
+      C_FLAG = (v >> (32 - shift)) & 1 ? true : false;
+      value = v << shift;
+    } else {
+      value = v;
+    }
+  } else if(TYPE == 1) {
+    // LSR Rd, Rm, #Imm 5
+    if(shift) {
+      C_FLAG = (v >> (shift - 1)) & 1 ? true : false;
+      value = v >> shift;
+    } else {
+      C_FLAG = v & 0x80000000 ? true : false;
+      value = 0;
+    }
+  } else {
+    // ASR Rd, Rm, #Imm 5
+    if(shift) {
+      C_FLAG = ((s32)v >> (int)(shift - 1)) & 1 ? true : false;
+      value = (s32)v >> (int)shift;
+    } else if(v & 0x80000000) {
+      value = 0xFFFFFFFF;
+      C_FLAG = true;
+    } else {
+      value = 0;
+      C_FLAG = false;
+    }
+  }
+  reg[e->rd].I = value;
+  setNZ(value);
+}
+
+// THUMB ADD and SUB Rd, Rs, Rn or #Offset3
+
+template<bool SUB, bool IMMEDIATE>
+static void thumbAddSub(const CpuCacheEntry *e, int &)
+{
+  u32 lhs = reg[e->rn].I;
+  u32 rhs = IMMEDIATE ? e->value : reg[e->rm].I;
+  u32 res = SUB ? lhs - rhs : lhs + rhs;
+  reg[e->rd].I = res;
+  if(SUB)
+    setSubFlags(lhs, rhs, res);
+  else
+    setAddFlags(lhs, rhs, res);
+}
+
+// THUMB MOV, CMP, ADD and SUB Rd, #Offset8
+
+template<int OP>
+static void thumbImmediate(const CpuCacheEntry *e, int &)
+{
+  u32 lhs = reg[e->rd].I;
+  u32 rhs = e->value;
+  u32 res;
+
+  switch(OP) {
+  case 0: // MOV
+    reg[e->rd].I = rhs;
+    N_FLAG = false;
+    Z_FLAG = (rhs ? false : true);
+    break;
+  case 1: // CMP
+    res = lhs - rhs;
+    setSubFlags(lhs, rhs, res);
+    break;
+  case 2: // ADD
+    res = lhs + rhs;
+    reg[e->rd].I = res;
+    setAddFlags(lhs, rhs, res);
+    break;
+  default: // SUB
+    res = lhs - rhs;
+    reg[e->rd].I = res;
+    setSubFlags(lhs, rhs, res);
+    break;
+  }
+}
+
+// THUMB ALU operations
+
+template<int OP>
+static void thumbAlu(const CpuCacheEntry *e, int &clockTicks)
+{
+  int dest = e->rd;
+  u32 lhs = reg[dest].I;
+  u32 rhs = reg[e->rn].I;
+  u32 value;
+  u32 res;
+
+  switch(OP) {
+  case 0x0: // AND
+    reg[dest].I = lhs & rhs;
+    setNZ(reg[dest].I);
+    break;
+  case 0x1: // EOR
+    reg[dest].I = lhs ^ rhs;
+    setNZ(reg[dest].I);
+    break;
+  case 0x2: // LSL
+    value = rhs & 0xFF;
+    if(value) {
+      if(value == 32) {
+        value = 0;
+        C_FLAG = (lhs & 1 ? true : false);
+      } else if(value < 32) {
+        C_FLAG = (lhs >> (32 - value)) & 1 ? true : false;
+        value = lhs << value;
+      } else {
+        value = 0;
+        C_FLAG = false;
+      }
+      reg[dest].I = value;
+    }
+    setNZ(reg[dest].I);
+    clockTicks++;
+    break;
+  case 0x3: // LSR
+    value = rhs & 0xFF;
+    if(value) {
+      if(value == 32) {
+        value = 0;
+        C_FLAG = (lhs & 0x80000000 ? true : false);
+      } else if(value < 32) {
+        C_FLAG = (lhs >> (value - 1)) & 1 ? true : false;
+        value = lhs >> value;
+      } else {
+        value = 0;
+        C_FLAG = false;
+      }
+      reg[dest].I = value;
+    }
+    setNZ(reg[dest].I);
+    clockTicks++;
+    break;
+  case 0x4: // ASR
+    value = rhs & 0xFF;
+    if(value) {
+      if(value < 32) {
+        C_FLAG = ((s32)lhs >> (int)(value - 1)) & 1 ? true : false;
+        reg[dest].I = (s32)lhs >> (int)value;
+      } else if(lhs & 0x80000000) {
+        reg[dest].I = 0xFFFFFFFF;
+        C_FLAG = true;
+      } else {
+        reg[dest].I = 0x00000000;
+        C_FLAG = false;
+      }
+    }
+    setNZ(reg[dest].I);
+    clockTicks++;
+    break;
+  case 0x5: // ADC
+    res = lhs + rhs + (u32)C_FLAG;
+    reg[dest].I = res;
+    setAddFlags(lhs, rhs, res);
+    break;
+  case 0x6: // SBC
+    res = lhs - rhs - !((u32)C_FLAG);
+    reg[dest].I = res;
+    setSubFlags(lhs, rhs, res);
+    break;
+  case 0x7: // ROR
+    value = rhs & 0xFF;
+    if(value) {
+      value = value & 0x1f;
+      if(value == 0) {
+        C_FLAG = (lhs & 0x80000000 ? true : false);
+      } else {
+        C_FLAG = (lhs >> (value - 1)) & 1 ? true : false;
+        reg[dest].I = (lhs << (32 - value)) | (lhs >> value);
+      }
+    }
+    clockTicks++;
+    setNZ(reg[dest].I);
+    break;
+  case 0x8: // TST
+    setNZ(lhs & rhs);
+    break;
+  case 0x9: // NEG
+    res = 0 - rhs;
+    reg[dest].I = res;
+    setSubFlags(0, rhs, res);
+    break;
+  case 0xA: // CMP
+    setSubFlags(lhs, rhs, lhs - rhs);
+    break;
+  case 0xB: // CMN
+    setAddFlags(lhs, rhs, lhs + rhs);
+    break;
+  case 0xC: // ORR
+    reg[dest].I = lhs | rhs;
+    setNZ(reg[dest].I);
+    break;
+  case 0xD: // MUL
+    reg[dest].I = lhs * rhs;
+    if (((s32)rhs) < 0)
+      rhs = ~rhs;
+    if ((rhs & 0xFFFFFF00) == 0)
+      clockTicks += 1;
+    else if ((rhs & 0xFFFF0000) == 0)
+      clockTicks += 2;
+    else if ((rhs & 0xFF000000) == 0)
+      clockTicks += 3;
+    else
+      clockTicks += 4;
+    setNZ(reg[dest].I);
+    break;
+  case 0xE: // BIC
+    reg[dest].I = lhs & (~rhs);
+    setNZ(reg[dest].I);
+    break;
+  default: // MVN
+    reg[dest].I = ~rhs;
+    setNZ(reg[dest].I);
+    break;
+  }
+}
+
+static const CpuCacheHandler thumbAluHandlers[16] = {
+  thumbAlu<0x0>, thumbAlu<0x1>, thumbAlu<0x2>, thumbAlu<0x3>,
+  thumbAlu<0x4>, thumbAlu<0x5>, thumbAlu<0x6>, thumbAlu<0x7>,
+  thumbAlu<0x8>, thumbAlu<0x9>, thumbAlu<0xA>, thumbAlu<0xB>,
+  thumbAlu<0xC>, thumbAlu<0xD>, thumbAlu<0xE>, thumbAlu<0xF>
+};
+
+// THUMB ADD, CMP and MOV with high registers, never to PC
+
+static void thumbAddHigh(const CpuCacheEntry *e, int &)
+{
+  reg[e->rd].I += reg[e->rn].I;
+}
+
+static void thumbCmpHigh(const CpuCacheEntry *e, int &)
+{
+  u32 lhs = reg[e->rd].I;
+  u32 rhs = reg[e->rn].I;
+  setSubFlags(lhs, rhs, lhs - rhs);
+}
+
+static void thumbMovHigh(const CpuCacheEntry *e, int &)
+{
+  reg[e->rd].I = reg[e->rn].I;
+}
+
+// THUMB loads and stores
+
+enum {
+  THUMB_STR,
+  THUMB_STRH,
+  THUMB_STRB,
+  THUMB_LDSB,
+  THUMB_LDR,
+  THUMB_LDRH,
+  THUMB_LDRB,
+  THUMB_LDSH,
+  THUMB_LDR_QUICK // LDR Rd, [SP, #Imm]
+};
+
+template<int TYPE, bool IMMEDIATE>
+static void thumbTransfer(const CpuCacheEntry *e, int &clockTicks)
+{
+  u32 address = reg[e->rn].I + (IMMEDIATE ? e->value : reg[e->rm].I);
+
+  switch(TYPE) {
+  case THUMB_STR:
+    CPUWriteMemory(address, reg[e->rd].I);
+    clockTicks += CPUUpdateTicksAccess32(address);
+    break;
+  case THUMB_STRH:
+    CPUWriteHalfWord(address, reg[e->rd].W.W0);
+    clockTicks += CPUUpdateTicksAccess16(address);
+    break;
+  case THUMB_STRB:
+    CPUWriteByte(address, reg[e->rd].B.B0);
+    clockTicks += CPUUpdateTicksAccess16(address);
+    break;
+  case THUMB_LDSB:
+    reg[e->rd].I = (s8)CPUReadByte(address);
+    clockTicks += CPUUpdateTicksAccess16(address);
+    break;
+  case THUMB_LDR:
+    reg[e->rd].I = CPUReadMemory(address);
+    clockTicks += CPUUpdateTicksAccess32(address);
+    break;
+  case THUMB_LDRH:
+    reg[e->rd].I = CPUReadHalfWord(address);
+    clockTicks += CPUUpdateTicksAccess16(address);
+    break;
+  case THUMB_LDRB:
+    reg[e->rd].I = CPUReadByte(address);
+    clockTicks += CPUUpdateTicksAccess16(address);
+    break;
+  case THUMB_LDSH:
+    reg[e->rd].I = (s16)CPUReadHalfWordSigned(address);
+    clockTicks += CPUUpdateTicksAccess16(address);
+    break;
+  default:
+    reg[e->rd].I = CPUReadMemoryQuick(address);
+    clockTicks += CPUUpdateTicksAccess32(address);
+    break;
+  }
+}
+
+static const CpuCacheHandler thumbRegisterTransfers[8] = {
+  thumbTransfer<THUMB_STR, false>, thumbTransfer<THUMB_STRH, false>,
+  thumbTransfer<THUMB_STRB, false>, thumbTransfer<THUMB_LDSB, false>,
+  thumbTransfer<THUMB_LDR, false>, thumbTransfer<THUMB_LDRH, false>,
+  thumbTransfer<THUMB_LDRB, false>, thumbTransfer<THUMB_LDSH, false>
+};
+
+static void thumbLoadPC(const CpuCacheEntry *e, int &clockTicks)
+{
+  // LDR Rd, [PC, #Imm]
+  u32 address = (reg[15].I & 0xFFFFFFFC) + e->value;
+  reg[e->rd].I = CPUReadMemoryQuick(address);
+  clockTicks += CPUUpdateTicksAccess32(address);
+}
+
+static void thumbAddPC(const CpuCacheEntry *e, int &)
+{
+  // ADD Rd, PC, Imm
+  reg[e->rd].I = (reg[15].I & 0xFFFFFFFC) + e->value;
+}
+
+static void thumbAddSP(const CpuCacheEntry *e, int &)
+{
+  // ADD Rd, SP, Imm
+  reg[e->rd].I = reg[13].I + e->value;
+}
+
+static void thumbAdjustSP(const CpuCacheEntry *e, int &)
+{
+  // ADD SP, Imm
+  reg[13].I += e->value;
+}
+
+// THUMB PUSH, POP, STMIA and LDMIA
+
+template<bool LR>
+static void thumbPush(const CpuCacheEntry *e, int &clockTicks)
+{
+  int offset = 0;
+  u32 list = e->value;
+  u32 temp = reg[13].I - (LR ? 4 : 0) - 4 * cpuBitsSet[list & 0xff];
+  u32 address = temp & 0xFFFFFFFC;
+  for(int r = 0; r < 9; r++) {
+    if(list & (1 << r)) {
+      CPUWriteMemory(address, reg[r == 8 ? 14 : r].I);
+      if(offset)
+        clockTicks += 1 + CPUUpdateTicksAccessSeq32(address);
+      else
+        clockTicks += 1 + CPUUpdateTicksAccess32(address);
+      offset = 1;
+      address += 4;
+    }
+  }
+  reg[13].I = temp;
+}
+
+template<bool PC>
+static void thumbPop(const CpuCacheEntry *e, int &clockTicks)
+{
+  int offset = 0;
+  u32 list = e->value;
+  u32 address = reg[13].I & 0xFFFFFFFC;
+  u32 temp = reg[13].I + (PC ? 4 : 0) + 4*cpuBitsSet[list & 0xFF];
+  for(int r = 0; r < 8; r++) {
+    if(list & (1 << r)) {
+      reg[r].I = CPUReadMemory(address);
+      if(offset)
+        clockTicks += 2 + CPUUpdateTicksAccessSeq32(address);
+      else
+        clockTicks += 2 + CPUUpdateTicksAccess32(address);
+      offset = 1;
+      address += 4;
+    }
+  }
+  if(PC) {
+    reg[15].I = (CPUReadMemory(address) & 0xFFFFFFFE);
+    if(offset)
+      clockTicks += CPUUpdateTicksAccessSeq32(address);
+    else
+      clockTicks += CPUUpdateTicksAccess32(address);
+    armNextPC = reg[15].I;
+    reg[15].I += 2;
+  }
+  reg[13].I = temp;
+}
+
+static void thumbStm(const CpuCacheEntry *e, int &clockTicks)
+{
+  int base = e->rn;
+  u32 list = e->value;
+  u32 address = reg[base].I & 0xFFFFFFFC;
+  u32 temp = reg[base].I + 4*cpuBitsSet[list];
+  int offset = 0;
+  for(int r = 0; r < 8; r++) {
+    if(list & (1 << r)) {
+      CPUWriteMemory(address, reg[r].I);
+      if(!offset) {
+        reg[base].I = temp;
+        clockTicks += 1 + CPUUpdateTicksAccess32(address);
+      } else
+        clockTicks += 1 + CPUUpdateTicksAccessSeq32(address);
+      offset = 1;
+      address += 4;
+    }
+  }
+}
+
+static void thumbLdm(const CpuCacheEntry *e, int &clockTicks)
+{
+  int base = e->rn;
+  u32 list = e->value;
+  u32 address = reg[base].I & 0xFFFFFFFC;
+  u32 temp = reg[base].I + 4*cpuBitsSet[list];
+  int offset = 0;
+  for(int r = 0; r < 8; r++) {
+    if(list & (1 << r)) {
+      reg[r].I = CPUReadMemory(address);
+      if(offset)
+        clockTicks += 2 + CPUUpdateTicksAccessSeq32(address);
+      else
+        clockTicks += 2 + CPUUpdateTicksAccess32(address);
+      offset = 1;
+      address += 4;
+    }
+  }
+  if(!(list & (1 << base)))
+    reg[base].I = temp;
+}
+
+// THUMB branches
+
+template<int COND>
+static void thumbBranchCond(const CpuCacheEntry *e, int &clockTicks)
+{
+  if(cpuCacheCondition(COND)) {
+    reg[15].I += e->value;
+    armNextPC = reg[15].I;
+    reg[15].I += 2;
+    clockTicks = 3;
+  }
+}
+
+static const CpuCacheHandler thumbBranchHandlers[14] = {
+  thumbBranchCond<0x0>, thumbBranchCond<0x1>, thumbBranchCond<0x2>,
+  thumbBranchCond<0x3>, thumbBranchCond<0x4>, thumbBranchCond<0x5>,
+  thumbBranchCond<0x6>, thumbBranchCond<0x7>, thumbBranchCond<0x8>,
+  thumbBranchCond<0x9>, thumbBranchCond<0xA>, thumbBranchCond<0xB>,
+  thumbBranchCond<0xC>, thumbBranchCond<0xD>
+};
+
+static void thumbBranch(const CpuCacheEntry *e, int &)
+{
+  // B offset
+  reg[15].I += e->value;
+  armNextPC = reg[15].I;
+  reg[15].I += 2;
+}
+
+static void thumbBranchLinkHigh(const CpuCacheEntry *e, int &)
+{
+  // BLL #offset
+  reg[14].I = reg[15].I + e->value;
+}
+
+static void thumbBranchLinkLow(const CpuCacheEntry *e, int &)
+{
+  // BLH #offset
+  u32 temp = reg[15].I-2;
+  reg[15].I = (reg[14].I + e->value)&0xFFFFFFFE;
+  armNextPC = reg[15].I;
+  reg[15].I += 2;
+  reg[14].I = temp|1;
+}
+
+static void thumbDecode(CpuCacheEntry *e, u32 opcode)
+{
+  int op = opcode >> 8;
+
+  e->value = 0;
+  e->rd = opcode & 7;
+  e->rn = (opcode >> 3) & 7;
+  e->rm = (opcode >> 6) & 7;
+  e->rs = 0;
+  e->shift = (opcode >> 6) & 0x1f;
+  e->cond = 0;
+  e->cycles = thumbCycles[op];
+  e->handler = interpret;
+
+  switch(op >> 3) {
+  case 0x00:
+    e->handler = thumbShift<0>;
+    break;
+  case 0x01:
+    e->handler = thumbShift<1>;
+    break;
+  case 0x02:
+    e->handler = thumbShift<2>;
+    break;
+  case 0x03:
+    e->value = e->rm;
+    switch((op >> 1) & 3) {
+    case 0:
+      e->handler = thumbAddSub<false, false>;
+      break;
+    case 1:
+      e->handler = thumbAddSub<true, false>;
+      break;
+    case 2:
+      e->handler = thumbAddSub<false, true>;
+      break;
+    default:
+      e->handler = thumbAddSub<true, true>;
+      break;
+    }
+    break;
+  case 0x04:
+  case 0x05:
+  case 0x06:
+  case 0x07:
+    e->rd = op & 7;
+    e->value = opcode & 255;
+    switch((op >> 3) & 3) {
+    case 0:
+      e->handler = thumbImmediate<0>;
+      break;
+    case 1:
+      e->handler = thumbImmediate<1>;
+      break;
+    case 2:
+      e->handler = thumbImmediate<2>;
+      break;
+    default:
+      e->handler = thumbImmediate<3>;
+      break;
+    }
+    break;
+  case 0x08:
+    if(op < 0x44) {
+      e->handler = thumbAluHandlers[(opcode >> 6) & 15];
+    } else if(op < 0x47) {
+      int h = (opcode >> 6) & 3;
+      if(h & 1)
+        e->rn += 8;
+      if(h & 2)
+        e->rd += 8;
+      if(op == 0x44) {
+        if(h != 0 && e->rd != 15)
+          e->handler = thumbAddHigh;
+      } else if(op == 0x45) {
+        e->handler = thumbCmpHigh;
+      } else if(e->rd != 15) {
+        e->handler = thumbMovHigh;
+      }
+    }
+    break;
+  case 0x09:
+    e->rd = op & 7;
+    e->value = (opcode & 0xFF) << 2;
+    e->handler = thumbLoadPC;
+    break;
+  case 0x0a:
+  case 0x0b:
+    e->handler = thumbRegisterTransfers[(opcode >> 9) & 7];
+    break;
+  case 0x0c:
+    e->value = ((opcode >> 6) & 31) << 2;
+    e->handler = thumbTransfer<THUMB_STR, true>;
+    break;
+  case 0x0d:
+    e->value = ((opcode >> 6) & 31) << 2;
+    e->handler = thumbTransfer<THUMB_LDR, true>;
+    break;
+  case 0x0e:
+    e->value = (opcode >> 6) & 31;
+    e->handler = thumbTransfer<THUMB_STRB, true>;
+    break;
+  case 0x0f:
+    e->value = (opcode >> 6) & 31;
+    e->handler = thumbTransfer<THUMB_LDRB, true>;
+    break;
+  case 0x10:
+    e->value = ((opcode >> 6) & 31) << 1;
+    e->handler = thumbTransfer<THUMB_STRH, true>;
+    break;
+  case 0x11:
+    e->value = ((opcode >> 6) & 31) << 1;
+    e->handler = thumbTransfer<THUMB_LDRH, true>;
+    break;
+  case 0x12:
+    e->rd = op & 7;
+    e->rn = 13;
+    e->value = (opcode & 255) << 2;
+    e->handler = thumbTransfer<THUMB_STR, true>;
+    break;
+  case 0x13:
+    e->rd = op & 7;
+    e->rn = 13;
+    e->value = (opcode & 255) << 2;
+    e->handler = thumbTransfer<THUMB_LDR_QUICK, true>;
+    break;
+  case 0x14:
+    e->rd = op & 7;
+    e->value = (opcode & 255) << 2;
+    e->handler = thumbAddPC;
+    break;
+  case 0x15:
+    e->rd = op & 7;
+    e->value = (opcode & 255) << 2;
+    e->handler = thumbAddSP;
+    break;
+  case 0x16:
+  case 0x17:
+    e->value = opcode & 0x1FF;
+    switch(op) {
+    case 0xb0:
+      {
+        int offset = (opcode & 127) << 2;
+        if(opcode & 0x80)
+          offset = -offset;
+        e->value = offset;
+        e->handler = thumbAdjustSP;
+      }
+      break;
+    case 0xb4:
+      e->handler = thumbPush<false>;
+      break;
+    case 0xb5:
+      e->handler = thumbPush<true>;
+      break;
+    case 0xbc:
+      e->value &= 0xFF;
+      e->handler = thumbPop<false>;
+      break;
+    case 0xbd:
+      e->value &= 0xFF;
+      e->handler = thumbPop<true>;
+      break;
+    }
+    break;
+  case 0x18:
+    e->rn = op & 7;
+    e->value = opcode & 0xFF;
+    e->handler = thumbStm;
+    break;
+  case 0x19:
+    e->rn = op & 7;
+    e->value = opcode & 0xFF;
+    e->handler = thumbLdm;
+    break;
+  case 0x1a:
+  case 0x1b:
+    if(op < 0xde) {
+      e->value = ((s8)(opcode & 0xFF)) << 1;
+      e->handler = thumbBranchHandlers[op & 15];
+    }
+    break;
+  case 0x1c:
+    {
+      int offset = (opcode & 0x3FF) << 1;
+      if(opcode & 0x0400)
+        offset |= 0xFFFFF800;
+      e->value = offset;
+      e->handler = thumbBranch;
+    }
+    break;
+  case 0x1e:
+    {
+      int offset = (opcode & 0x7FF);
+      if(op < 0xf4)
+        e->value = offset << 12;
+      else
+        e->value = (offset << 12) | 0xFF800000;
+      e->handler = thumbBranchLinkHigh;
+    }
+    break;
+  case 0x1f:
+    e->value = (opcode & 0x7FF) << 1;
+    e->handler = thumbBranchLinkLow;
+    break;
+  }
+}
+
+static bool armRun(int &cpuLoopTicks, int &clockTicks, int &executedticks)
+{
+  bool ran = false;
+  u32 pageAddress = 1; // never a page address, so first one is looked up
+  CpuCacheEntry *page = NULL;
+
+  for(;;) {
+    u32 pc = armNextPC;
+    if((pc & ~0x3FF) != pageAddress) {
+      if(pc & 3)
+        return ran;
+      page = cpuCachePage(armPages, pc, ARM_PAGE_ENTRIES);
+      if(page == NULL)
+        return ran;
+      pageAddress = pc & ~0x3FF;
+    }
+    CpuCacheEntry *e = &page[(pc & 0x3FF) >> 2];
+    if(e->handler == NULL)
+      armDecode(e, CPUReadMemoryQuick(pc));
+    if(e->handler == interpret)
+      return ran;
+
+    // the last instruction didn't end the run, so count it now
+    if(ran) {
+      executedticks += clockTicks;
+      cpuLoopTicks -= clockTicks;
+    }
+
+    clockTicks = memoryWaitFetch32[(pc >> 24) & 15];
+    armNextPC = reg[15].I;
+    reg[15].I += 4;
+    if(e->cond == 0x0E || cpuCacheCondition(e->cond))
+      e->handler(e, clockTicks);
+    CPUCheckIdleJump(pc, clockTicks);
+    ran = true;
+
+    if(cpuLoopTicks - clockTicks <= 0 || holdState)
+      return true;
+  }
+}
+
+static bool thumbRun(int &cpuLoopTicks, int &clockTicks, int &executedticks)
+{
+  bool ran = false;
+  u32 pageAddress = 1;
+  CpuCacheEntry *page = NULL;
+
+  for(;;) {
+    u32 pc = armNextPC;
+    if((pc & ~0x3FF) != pageAddress) {
+      if(pc & 1)
+        return ran;
+      page = cpuCachePage(thumbPages, pc, THUMB_PAGE_ENTRIES);
+      if(page == NULL)
+        return ran;
+      pageAddress = pc & ~0x3FF;
+    }
+    CpuCacheEntry *e = &page[(pc & 0x3FF) >> 1];
+    if(e->handler == NULL)
+      thumbDecode(e, CPUReadHalfWordQuick(pc));
+    if(e->handler == interpret)
+      return ran;
+
+    // the last instruction didn't end the run, so count it now
+    if(ran) {
+      executedticks += clockTicks;
+      cpuLoopTicks -= clockTicks;
+    }
+
+    clockTicks = e->cycles + memoryWaitFetch[(pc >> 24) & 15];
+    armNextPC = reg[15].I;
+    reg[15].I += 2;
+    e->handler(e, clockTicks);
+    CPUCheckIdleJump(pc, clockTicks);
+    ran = true;
+
+    if(cpuLoopTicks - clockTicks <= 0 || holdState)
+      return true;
+  }
+}
+
+bool cpuCacheRun(int &cpuLoopTicks, int &clockTicks, int &executedticks)
+{
+  if(armState)
+    return armRun(cpuLoopTicks, clockTicks, executedticks);
+  return thumbRun(cpuLoopTicks, clockTicks, executedticks);
+}
@@ -0,0 +1,46 @@
+// -*- C++ -*-
+// Cached CPU core. Instructions are decoded once into entries holding a
+// handler and its operands, kept in 1KB pages of the memory they came from,
+// and then run from there until that memory is written. Anything not
+// handled here (mode switches, SWI, LDM/STM, coprocessor...) is left to the
+// interpreter in arm-new.h and thumb.h, which stays the reference: a handler
+// has to do exactly what the interpreter would, down to clockTicks.
+
+#ifndef VBA_CPUCACHE_H
+#define VBA_CPUCACHE_H
+
+#include "System.h"
+
+// Non-zero for each 1KB page of RAM holding decoded instructions
+extern u8 cpuCacheWorkRAMPages[0x40000 >> 10];
+extern u8 cpuCacheInternalRAMPages[0x8000 >> 10];
+
+// From GBA.cpp
+extern const int thumbCycles[];
+
+// Run cached instructions from armNextPC until cpuLoopTicks would run out,
+// the CPU halts or an instruction isn't cached. Returns false if none were
+// run, otherwise true with clockTicks of the last one not yet counted in
+// cpuLoopTicks and executedticks, same as after the interpreter.
+extern bool cpuCacheRun(int &cpuLoopTicks, int &clockTicks, int &executedticks);
+
+// Forget all decoded instructions. Call when memory is changed other than
+// through CPUWriteMemory(), CPUWriteHalfWord() or CPUWriteByte().
+extern void cpuCacheFlush();
+
+// Forget decoded instructions in the word at address
+extern void cpuCacheInvalidate(u32 address);
+
+inline void cpuCacheWriteWorkRAM(u32 address)
+{
+  if(cpuCacheWorkRAMPages[(address & 0x3FFFF) >> 10])
+    cpuCacheInvalidate(address);
+}
+
+inline void cpuCacheWriteInternalRAM(u32 address)
+{
+  if(cpuCacheInternalRAMPages[(address & 0x7FFF) >> 10])
+    cpuCacheInvalidate(address);
+}
+
+#endif // VBA_CPUCACHE_H
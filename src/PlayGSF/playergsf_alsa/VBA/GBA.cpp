@@ -75,6 +75,15 @@ int gbaSaveType = 0; // used to remember the save type on reset
 bool intState = false;
 bool stopState = false;
 bool holdState = false;
+int cpuCore = CORE_CACHED;
+bool cpuIdleDetect = true;
+u32 cpuIdleLoop = IDLE_LOOP_AUTO;
+u64 cpuIdleTicks = 0;
+u32 cpuIdleSkips = 0;
+// Loop CPUIdleJump() last saw jumped back to, and state at that point
+u32 cpuIdleLoopPC = IDLE_LOOP_NONE;
+static u32 idleLoopRegs[15];
+static bool idleLoopFlags[4];
 int holdType = 0;
 //bool cpuSramEnabled = true;
 //bool cpuFlashEnabled = true;
@@ -89,8 +98,10 @@ static int profilSize = 0;
 static u32 profilLowPC = 0;
 static int profilScale = 0;
 #endif
+#ifdef SDL
 bool freezeWorkRAM[0x40000];
 bool freezeInternalRAM[0x8000];
+#endif
 int lcdTicks = 960;
 bool timer0On = false;
 int timer0Ticks = 0;
@@ -118,9 +129,11 @@ u32 dma3Source = 0;
 u32 dma3Dest = 0;
 //void (*cpuSaveGameFunc)(u32,u8) = flashSaveDecide;
 //void (*renderLine)() = mode0RenderLine;
+#ifndef SOUND_ONLY
 bool fxOn = false;
 bool windowOn = false;
 int frameCount = 0;
+#endif
 char buffer[1024];
 FILE *out = NULL;
 u32 lastTime = 0;
@@ -949,6 +962,8 @@ void CPUCleanUp()
     profCleanup();
   }
 #endif
+
+  cpuCacheFlush();
   
   if(rom != NULL) {
     free(rom);
@@ -1093,6 +1108,7 @@ int CPULoadRom(const char *szFile)
     CPUCleanUp();
     return 0;
   }    
+#ifndef SOUND_ONLY
   paletteRAM = (u8 *)calloc(1,0x400);
   if(paletteRAM == NULL) {
     //systemMessage(MSG_OUT_OF_MEMORY, N_("Failed to allocate memory for %s"),
@@ -1114,6 +1130,7 @@ int CPULoadRom(const char *szFile)
     CPUCleanUp();
     return 0;
   }      
+#endif
   //pix = (u8 *)calloc(1, 4 * 241 * 162);
   //if(pix == NULL) {
   //  systemMessage(MSG_OUT_OF_MEMORY, N_("Failed to allocate memory for %s"),
@@ -1937,6 +1954,9 @@ void CPUCheckDMA(int reason, int dmamask)
 
 void CPUUpdateRegister(u32 address, u16 value)
 {
+  // a loop writing I/O isn't idle
+  cpuIdleLoopPC = IDLE_LOOP_NONE;
+
   switch(address) {
   case 0x00:
     {
@@ -1944,8 +1964,10 @@ void CPUUpdateRegister(u32 address, u16 value)
       bool changeBG = ((DISPCNT ^ value) & 0x0F00) ? true : false;
       DISPCNT = (value & 0xFFF7);
       UPDATE_REG(0x00, DISPCNT);
+#ifndef SOUND_ONLY
       layerEnable = layerSettings & value;
       windowOn = (layerEnable & 0x6000) ? true : false;
+#endif
       if(change && !((value & 0x80))) {
         if(!(DISPSTAT & 1)) {
           lcdTicks = 960;
@@ -2101,6 +2123,7 @@ void CPUUpdateRegister(u32 address, u16 value)
     //UPDATE_REG(0x42, WIN1H);
 //    CPUUpdateWindow1();    
   //  break;      
+#ifndef SOUND_ONLY
   case 0x44:
     WIN0V = value;
     UPDATE_REG(0x44, WIN0V);
@@ -2134,6 +2157,7 @@ void CPUUpdateRegister(u32 address, u16 value)
   case 0x54:
     COLY = value & 0x1F;
     UPDATE_REG(0x54, COLY);
+#endif
     break;
   case 0x60:
   case 0x62:
@@ -2310,9 +2334,12 @@ void CPUUpdateRegister(u32 address, u16 value)
     }
     break;
   case 0x100:
+    // Direct Sound resamples at the rate of timers 0 and 1
+    soundRender();
     timer0Reload = value;
     break;
   case 0x102:
+    soundRender();
     timer0Ticks = timer0ClockReload = TIMER_TICKS[value & 3];        
     if(!timer0On && (value & 0x80)) {
       // reload the counter
@@ -2327,9 +2354,11 @@ void CPUUpdateRegister(u32 address, u16 value)
     //    CPUUpdateTicks();
     break;
   case 0x104:
+    soundRender();
     timer1Reload = value;
     break;
   case 0x106:
+    soundRender();
     timer1Ticks = timer1ClockReload = TIMER_TICKS[value & 3];        
     if(!timer1On && (value & 0x80)) {
       // reload the counter
@@ -2478,6 +2507,18 @@ void CPUWriteHalfWord(u32 address, u16 value)
     }
   }
 #endif
+
+  // a loop storing to memory isn't idle
+  cpuIdleLoopPC = IDLE_LOOP_NONE;
+
+  const memoryPage *page = &cpuWritePages[address >> 24];
+  u32 offset = address & page->mask;
+  if(offset < page->size) {
+    WRITE16LE(((u16 *)&page->address[offset & ~1]), value);
+    if(page->code[offset >> 10])
+      cpuCacheInvalidate(address);
+    return;
+  }
   
   switch(address >> 24) {
   case 2:
@@ -2489,6 +2530,7 @@ void CPUWriteHalfWord(u32 address, u16 value)
     else
 #endif
       WRITE16LE(((u16 *)&workRAM[address & 0x3FFFE]),value);
+    cpuCacheWriteWorkRAM(address);
     break;
   case 3:
 #ifdef SDL
@@ -2499,10 +2541,12 @@ void CPUWriteHalfWord(u32 address, u16 value)
     else
 #endif
       WRITE16LE(((u16 *)&internalRAM[address & 0x7ffe]), value);
+    cpuCacheWriteInternalRAM(address);
     break;    
   case 4:
     CPUUpdateRegister(address & 0x3fe, value);
     break;
+#ifndef SOUND_ONLY
   case 5:
     WRITE16LE(((u16 *)&paletteRAM[address & 0x3fe]), value);
     break;
@@ -2515,6 +2559,7 @@ void CPUWriteHalfWord(u32 address, u16 value)
   case 7:
     WRITE16LE(((u16 *)&oam[address & 0x3fe]), value);
     break;
+#endif
   case 8:
   case 9:
     //if(address == 0x80000c4 || address == 0x80000c6 || address == 0x80000c8) {
@@ -2550,6 +2595,18 @@ void CPUWriteHalfWord(u32 address, u16 value)
 
 void CPUWriteByte(u32 address, u8 b)
 {
+  // a loop storing to memory isn't idle
+  cpuIdleLoopPC = IDLE_LOOP_NONE;
+
+  const memoryPage *page = &cpuWritePages[address >> 24];
+  u32 offset = address & page->mask;
+  if(offset < page->size) {
+    page->address[offset] = b;
+    if(page->code[offset >> 10])
+      cpuCacheInvalidate(address);
+    return;
+  }
+
   switch(address >> 24) {
   case 2:
 #ifdef SDL
@@ -2558,6 +2615,7 @@ void CPUWriteByte(u32 address, u8 b)
       else
 #endif  
         workRAM[address & 0x3FFFF] = b;
+    cpuCacheWriteWorkRAM(address);
     break;
   case 3:
 #ifdef SDL
@@ -2566,12 +2624,15 @@ void CPUWriteByte(u32 address, u8 b)
     else
 #endif
       internalRAM[address & 0x7fff] = b;
+    cpuCacheWriteInternalRAM(address);
     break;
   case 4:
     switch(address & 0x3FF) {
     case 0x301:
-      if(b == 0x80)
+      if(b == 0x80) {
+        soundRender();
         stopState = true;
+      }
       holdState = 1;
       holdType = -1;
       break;
@@ -2631,6 +2692,7 @@ void CPUWriteByte(u32 address, u8 b)
                           ((READ16LE(((u16 *)&ioMem[address & 0x3fe])) & 0xFF00) | b));
     }
     break;
+#ifndef SOUND_ONLY
   case 5:
     // no need to switch
     *((u16 *)&paletteRAM[address & 0x3FE]) = (b << 8) | b;
@@ -2646,6 +2708,7 @@ void CPUWriteByte(u32 address, u8 b)
     // no need to switch
     *((u16 *)&oam[address & 0x3FE]) = (b << 8) | b;
     break;    
+#endif
   case 13:
    // if(cpuEEPROMEnabled) {
    //   eepromWrite(address, b);
@@ -2767,6 +2830,15 @@ void CPUInit(const char *biosFileName, bool useBiosFile)
  // *((u16 *)&rom[0x1fe209e]) = 0x4770; // BX LR
 }
 
+// Games whose idle loop isn't found by CPUIdleJump(), or is wrongly, keyed
+// by game code from the ROM header. Ends with an empty code.
+static const struct {
+  char code[5];
+  u32 idleLoop;
+} idleLoopOverrides[] = {
+  { "", IDLE_LOOP_AUTO }
+};
+
 void CPUReset()
 {
 /*  if(gbaSaveType == 0) {
@@ -2786,6 +2858,7 @@ void CPUReset()
   //rtcReset();
   // clen registers
   memset(&reg[0], 0, sizeof(reg));
+#ifndef SOUND_ONLY
   // clean OAM
   memset(oam, 0, 0x400);
   // clean palette
@@ -2794,12 +2867,25 @@ void CPUReset()
   //memset(pix, 0, 4*160*240);
   // clean vram
   memset(vram, 0, 0x20000);
+#endif
   // clean io memory
   memset(ioMem, 0, 0x400);
+  // forget code decoded from the last ROM
+  cpuCacheFlush();
+
+  u8 *header = cpuIsMultiBoot ? workRAM : rom;
+  cpuIdleLoop = IDLE_LOOP_AUTO;
+  for(int i = 0; idleLoopOverrides[i].code[0]; i++)
+    if(!memcmp(&header[0xac], idleLoopOverrides[i].code, 4))
+      cpuIdleLoop = idleLoopOverrides[i].idleLoop;
+  cpuIdleLoopPC = IDLE_LOOP_NONE;
+  cpuIdleTicks = 0;
+  cpuIdleSkips = 0;
 
   DISPCNT  = 0x0080;
   DISPSTAT = 0x0000;
   VCOUNT   = 0x0000;
+#ifndef SOUND_ONLY
   BG0CNT   = 0x0000;
   BG1CNT   = 0x0000;
   BG2CNT   = 0x0000;
@@ -2838,6 +2924,7 @@ void CPUReset()
   BLDMOD   = 0x0000;
   COLEV    = 0x0000;
   COLY     = 0x0000;
+#endif
   DM0SAD_L = 0x0000;
   DM0SAD_H = 0x0000;
   DM0DAD_L = 0x0000;
@@ -2901,10 +2988,12 @@ void CPUReset()
   armState = true;
   C_FLAG = V_FLAG = N_FLAG = Z_FLAG = false;
   UPDATE_REG(0x00, DISPCNT);
+#ifndef SOUND_ONLY
   UPDATE_REG(0x20, BG2PA);
   UPDATE_REG(0x26, BG2PD);
   UPDATE_REG(0x30, BG3PA);
   UPDATE_REG(0x36, BG3PD);
+#endif
   UPDATE_REG(0x130, P1);
   UPDATE_REG(0x88, 0x200);
 
@@ -2952,11 +3041,15 @@ void CPUReset()
   dma3Dest = 0;
 //  cpuSaveGameFunc = flashSaveDecide;
 //  renderLine = mode0RenderLine;
+#ifndef SOUND_ONLY
   fxOn = false;
   windowOn = false;
   frameCount = 0;
+#endif
   saveType = 0;
+#ifndef SOUND_ONLY
   layerEnable = DISPCNT & layerSettings;
+#endif
 
 //  CPUUpdateRenderBuffers(true);
   
@@ -2973,12 +3066,14 @@ void CPUReset()
   map[3].mask = 0x7FFF;
   map[4].address = ioMem;
   map[4].mask = 0x3FF;
+#ifndef SOUND_ONLY
   map[5].address = paletteRAM;
   map[5].mask = 0x3FF;
   map[6].address = vram;
   map[6].mask = 0x1FFFF;
   map[7].address = oam;
   map[7].mask = 0x3FF;
+#endif
   map[8].address = rom;
   map[8].mask = 0x1FFFFFF;
   map[9].address = rom;
@@ -2990,6 +3085,28 @@ void CPUReset()
   //map[14].address = flashSaveMemory;
   //map[14].mask = 0xFFFF;
 
+  memset(cpuReadPages, 0, sizeof(cpuReadPages));
+  memset(cpuWritePages, 0, sizeof(cpuWritePages));
+  cpuReadPages[2].address = workRAM;
+  cpuReadPages[2].mask = 0x3FFFF;
+  cpuReadPages[2].size = 0x40000;
+  cpuReadPages[3].address = internalRAM;
+  cpuReadPages[3].mask = 0x7FFF;
+  cpuReadPages[3].size = 0x8000;
+  // a multiboot image is in work RAM, rom is only a small dummy buffer
+  for(int i = 8; i <= 12; i++) {
+    cpuReadPages[i].address = rom;
+    cpuReadPages[i].mask = 0x1FFFFFF;
+    cpuReadPages[i].size = cpuIsMultiBoot ? 0 : loadedsize;
+  }
+#ifndef SDL
+  // frozen cheat addresses have to go through cheatsWriteMemory()
+  cpuWritePages[2] = cpuReadPages[2];
+  cpuWritePages[2].code = cpuCacheWorkRAMPages;
+  cpuWritePages[3] = cpuReadPages[3];
+  cpuWritePages[3].code = cpuCacheInternalRAMPages;
+#endif
+
   //eepromReset();
   //flashReset();
   
@@ -3097,6 +3214,40 @@ void log(const char *defaultMsg, ...)
 #else
 extern void winlog(const char *, ...);
 #endif
+
+void CPUIdleJump(int &clockTicks)
+{
+  if(cpuIdleLoop != IDLE_LOOP_AUTO) {
+    if(armNextPC != cpuIdleLoop)
+      return;
+  } else {
+    bool same = armNextPC == cpuIdleLoopPC &&
+      idleLoopFlags[0] == N_FLAG && idleLoopFlags[1] == Z_FLAG &&
+      idleLoopFlags[2] == C_FLAG && idleLoopFlags[3] == V_FLAG;
+    for(int i = 0; same && i < 15; i++)
+      same = idleLoopRegs[i] == reg[i].I;
+    if(!same) {
+      // may be the first time round a loop, see if the next one matches
+      cpuIdleLoopPC = armNextPC;
+      for(int i = 0; i < 15; i++)
+        idleLoopRegs[i] = reg[i].I;
+      idleLoopFlags[0] = N_FLAG;
+      idleLoopFlags[1] = Z_FLAG;
+      idleLoopFlags[2] = C_FLAG;
+      idleLoopFlags[3] = V_FLAG;
+      return;
+    }
+  }
+
+  // nothing can change until the next event, so go straight to it
+  int idle = *extCpuLoopTicks - clockTicks;
+  if(idle > 0) {
+    clockTicks += idle;
+    cpuIdleTicks += idle;
+    cpuIdleSkips++;
+  }
+}
+
 extern "C" int cpupercent;
 unsigned char cpupercentaverage[10];
 int cpuaveragepointer=0;
@@ -3152,10 +3303,17 @@ void CPULoop(int ticks)
 #endif*/
 
     if(!holdState) {
-      if(armState) {
-#include "arm-new.h"
+      if(cpuCore == CORE_CACHED &&
+         cpuCacheRun(cpuLoopTicks, clockTicks, executedticks)) {
+        // ran one or more cached instructions
       } else {
+        u32 jumpFrom = armNextPC;
+        if(armState) {
+#include "arm-new.h"
+        } else {
 #include "thumb.h"
+        }
+        CPUCheckIdleJump(jumpFrom, clockTicks);
       }
 	  executedticks += clockTicks;
     } else {
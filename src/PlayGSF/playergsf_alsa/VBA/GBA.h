@@ -37,6 +37,18 @@ typedef struct {
   u32 mask;
 } memoryMap;
 
+// Memory that loads and stores can reach directly. An access to region
+// address >> 24 whose offset (address & mask) is below size goes straight
+// to address, anything else to the switch in CPURead*() and CPUWrite*(),
+// which handles BIOS protection, I/O, open bus and the end of the ROM.
+// code holds the cpuCache*Pages flags of writable memory.
+typedef struct {
+  u8 *address;
+  u32 mask;
+  u32 size;
+  u8 *code;
+} memoryPage;
+
 typedef union {
   struct {
 #ifdef WORDS_BIGENDIAN
@@ -69,6 +81,8 @@ typedef union {
 
 #ifndef NO_GBA_MAP
 extern memoryMap map[256];
+extern memoryPage cpuReadPages[256];
+extern memoryPage cpuWritePages[256];
 #endif
 
 extern reg_pair reg[45];
@@ -81,10 +95,33 @@ extern bool V_FLAG;
 extern bool armIrqEnable;
 extern bool armState;
 extern int armMode;
+
+// CPU core run by CPULoop(). The interpreter is the reference, the cached
+// core (CpuCache.cpp) runs instructions it has already decoded.
+enum { CORE_INTERPRETER, CORE_CACHED };
+extern int cpuCore;
+
+// Idle loop detection. A short jump back to where the CPU already was, with
+// the same registers and nothing stored to memory or I/O in between, is a
+// loop waiting for an event, so the CPU goes straight to the next one.
+// cpuIdleLoop is set by CPUReset() from a table of games where that doesn't
+// work: IDLE_LOOP_AUTO to detect, IDLE_LOOP_NONE to never skip, or the
+// address of the loop.
+#define IDLE_LOOP_AUTO 0
+#define IDLE_LOOP_NONE 1
+#define IDLE_LOOP_SIZE 64 // longest loop detected, in bytes
+extern bool cpuIdleDetect;
+extern u32 cpuIdleLoop;
+extern u64 cpuIdleTicks; // ticks skipped since CPUReset()
+extern u32 cpuIdleSkips;
+extern u32 cpuIdleLoopPC; // loop being checked, IDLE_LOOP_NONE after any store
+extern void CPUIdleJump(int &clockTicks);
 //extern void (*cpuSaveGameFunc)(u32,u8);
 
+#ifdef SDL
 extern bool freezeWorkRAM[0x40000];
 extern bool freezeInternalRAM[0x8000];
+#endif
 //extern bool CPUReadGSASnapshot(const char *);
 //extern bool CPUWriteGSASnapshot(const char *, const char *, const char *, const char *);
 //extern bool CPUWriteBatteryFile(const char *);
@@ -24,6 +24,9 @@ extern int loadedsize;
 
 #include "System.h"
 #include "Port.h"
+#include "Globals.h"
+#include "Sound.h"
+#include "CpuCache.h"
 //#include "RTC.h"
 
 //extern bool cpuSramEnabled;
@@ -53,7 +56,11 @@ inline u32 CPUReadMemory(u32 address)
 #endif
   
   u32 value;
-  switch(address >> 24) {
+  const memoryPage *page = &cpuReadPages[address >> 24];
+  u32 offset = address & page->mask;
+  if(offset < page->size)
+    value = READ32LE(((u32 *)&page->address[offset & ~3]));
+  else switch(address >> 24) {
   case 0:
     if(reg[15].I >> 24) {
       if(address < 0x4000) {
@@ -77,6 +84,7 @@ inline u32 CPUReadMemory(u32 address)
     value = READ32LE(((u32 *)&internalRAM[address & 0x7ffC]));
     break;
   case 4:
+    soundReadEvent(address);
     if((address < 0x4000400) && ioReadable[address & 0x3fc]) {
       if(ioReadable[(address & 0x3fc) + 2])
         value = READ32LE(((u32 *)&ioMem[address & 0x3fC]));
@@ -84,6 +92,7 @@ inline u32 CPUReadMemory(u32 address)
         value = READ16LE(((u16 *)&ioMem[address & 0x3fc]));
     } else goto unreadable;
     break;
+#ifndef SOUND_ONLY
   case 5:
     value = READ32LE(((u32 *)&paletteRAM[address & 0x3fC]));
     break;
@@ -93,6 +102,7 @@ inline u32 CPUReadMemory(u32 address)
   case 7:
     value = READ32LE(((u32 *)&oam[address & 0x3FC]));
     break;
+#endif
   case 8:
   case 9:
   case 10:
@@ -173,8 +183,11 @@ inline u32 CPUReadHalfWord(u32 address)
 #endif
   
   u32 value;
-  
-  switch(address >> 24) {
+  const memoryPage *page = &cpuReadPages[address >> 24];
+  u32 offset = address & page->mask;
+  if(offset < page->size)
+    value = READ16LE(((u16 *)&page->address[offset & ~1]));
+  else switch(address >> 24) {
   case 0:
     if (reg[15].I >> 24) {
       if(address < 0x4000) {
@@ -196,10 +209,12 @@ inline u32 CPUReadHalfWord(u32 address)
     value = READ16LE(((u16 *)&internalRAM[address & 0x7ffe]));
     break;
   case 4:
+    soundReadEvent(address);
     if((address < 0x4000400) && ioReadable[address & 0x3fe])
       value =  READ16LE(((u16 *)&ioMem[address & 0x3fe]));
     else goto unreadable;
     break;
+#ifndef SOUND_ONLY
   case 5:
     value = READ16LE(((u16 *)&paletteRAM[address & 0x3fe]));
     break;
@@ -209,6 +224,7 @@ inline u32 CPUReadHalfWord(u32 address)
   case 7:
     value = READ16LE(((u16 *)&oam[address & 0x3fe]));
     break;
+#endif
   case 8:
   case 9:
   case 10:
@@ -276,6 +292,11 @@ inline u16 CPUReadHalfWordSigned(u32 address)
 
 inline u8 CPUReadByte(u32 address)
 {
+  const memoryPage *page = &cpuReadPages[address >> 24];
+  u32 offset = address & page->mask;
+  if(offset < page->size)
+    return page->address[offset];
+
   switch(address >> 24) {
   case 0:
     if (reg[15].I >> 24) {
@@ -295,15 +316,18 @@ inline u8 CPUReadByte(u32 address)
   case 3:
     return internalRAM[address & 0x7fff];
   case 4:
+    soundReadEvent(address);
     if((address < 0x4000400) && ioReadable[address & 0x3ff])
       return ioMem[address & 0x3ff];
     else goto unreadable;
+#ifndef SOUND_ONLY
   case 5:
     return paletteRAM[address & 0x3ff];
   case 6:
     return vram[address & 0x1ffff];
   case 7:
     return oam[address & 0x3ff];
+#endif
   case 8:
   case 9:
   case 10:
@@ -364,6 +388,18 @@ inline void CPUWriteMemory(u32 address, u32 value)
     }
   }
 #endif
+
+  // a loop storing to memory isn't idle
+  cpuIdleLoopPC = IDLE_LOOP_NONE;
+
+  const memoryPage *page = &cpuWritePages[address >> 24];
+  u32 offset = address & page->mask;
+  if(offset < page->size) {
+    WRITE32LE(((u32 *)&page->address[offset & ~3]), value);
+    if(page->code[offset >> 10])
+      cpuCacheInvalidate(address);
+    return;
+  }
   
   switch(address >> 24) {
   case 0x02:
@@ -375,6 +411,7 @@ inline void CPUWriteMemory(u32 address, u32 value)
     else
 #endif
       WRITE32LE(((u32 *)&workRAM[address & 0x3FFFC]), value);
+    cpuCacheWriteWorkRAM(address);
     break;
   case 0x03:
 #ifdef SDL
@@ -385,11 +422,13 @@ inline void CPUWriteMemory(u32 address, u32 value)
     else
 #endif
       WRITE32LE(((u32 *)&internalRAM[address & 0x7ffC]), value);
+    cpuCacheWriteInternalRAM(address);
     break;
   case 0x04:
     CPUUpdateRegister((address & 0x3FC), value & 0xFFFF);
     CPUUpdateRegister((address & 0x3FC) + 2, (value >> 16));
     break;
+#ifndef SOUND_ONLY
   case 0x05:
     WRITE32LE(((u32 *)&paletteRAM[address & 0x3FC]), value);
     break;
@@ -402,6 +441,7 @@ inline void CPUWriteMemory(u32 address, u32 value)
   case 0x07:
     WRITE32LE(((u32 *)&oam[address & 0x3fc]), value);
     break;
+#endif
   case 0x0D:
 //    if(cpuEEPROMEnabled) {
 //      eepromWrite(address, value);
@@ -428,4 +468,11 @@ inline void CPUWriteMemory(u32 address, u32 value)
   }
 }
 
+// Call after each instruction, with pc it was fetched from
+inline void CPUCheckIdleJump(u32 pc, int &clockTicks)
+{
+  if((u32)(pc - armNextPC) <= IDLE_LOOP_SIZE && cpuIdleDetect)
+    CPUIdleJump(clockTicks);
+}
+
 #endif //VBA_GBAinline_H
@@ -20,6 +20,8 @@
 
 reg_pair reg[45];
 memoryMap map[256];
+memoryPage cpuReadPages[256];
+memoryPage cpuWritePages[256];
 bool ioReadable[0x400];
 bool N_FLAG = 0;
 bool C_FLAG = 0;
@@ -39,8 +41,10 @@ bool synchronize = true;
 bool cpuDisableSfx = false;
 bool cpuIsMultiBoot = false;
 bool parseDebug = true;
+#ifndef SOUND_ONLY
 int layerSettings = 0xff00;
 int layerEnable = 0xff00;
+#endif
 bool speedHack = false;
 int cpuSaveType = 0;
 bool cpuEnhancedDetection = true;
@@ -59,6 +63,8 @@ u8 *ioMem = NULL;
 u16 DISPCNT  = 0x0080;
 u16 DISPSTAT = 0x0000;
 u16 VCOUNT   = 0x0000;
+// Display registers, only kept to be drawn
+#ifndef SOUND_ONLY
 u16 BG0CNT   = 0x0000;
 u16 BG1CNT   = 0x0000;
 u16 BG2CNT   = 0x0000;
@@ -97,6 +103,7 @@ u16 MOSAIC   = 0x0000;
 u16 BLDMOD   = 0x0000;
 u16 COLEV    = 0x0000;
 u16 COLY     = 0x0000;
+#endif
 u16 DM0SAD_L = 0x0000;
 u16 DM0SAD_H = 0x0000;
 u16 DM0DAD_L = 0x0000;
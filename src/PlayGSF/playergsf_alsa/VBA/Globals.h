@@ -51,8 +51,10 @@ extern bool synchronize;
 extern bool cpuDisableSfx;
 extern bool cpuIsMultiBoot;
 extern bool parseDebug;
+#ifndef SOUND_ONLY
 extern int layerSettings;
 extern int layerEnable;
+#endif
 extern bool speedHack;
 extern int cpuSaveType;
 extern bool cpuEnhancedDetection;
@@ -71,6 +73,7 @@ extern u8 *ioMem;
 extern u16 DISPCNT;
 extern u16 DISPSTAT;
 extern u16 VCOUNT;
+#ifndef SOUND_ONLY
 extern u16 BG0CNT;
 extern u16 BG1CNT;
 extern u16 BG2CNT;
@@ -109,6 +112,7 @@ extern u16 MOSAIC;
 extern u16 BLDMOD;
 extern u16 COLEV;
 extern u16 COLY;
+#endif
 extern u16 DM0SAD_L;
 extern u16 DM0SAD_H;
 extern u16 DM0DAD_L;
@@ -144,6 +144,7 @@ int soundIndex = 0;
 int soundBufferIndex = 0;
 int soundDebug = 0;
 bool soundOffFlag = false;
+int soundPending = 0;
 
 int sound1On = 0;
 int sound1ATL = 0;
@@ -230,6 +231,21 @@ char soundReverse = false;
 
 }
 
+// Direct Sound samples leave the FIFOs when their timer overflows, but are
+// only resampled when the block they fall in is rendered. Until then they
+// wait here, stamped with the number of output samples pending before them.
+#define SOUND_DS_QUEUE 256
+
+static struct {
+  int time;
+  u8 value;
+} soundDSQueue[2][SOUND_DS_QUEUE];
+static int soundDSQueueCount[2] = { 0, 0 };
+static int soundDSQueueIndex[2] = { 0, 0 };
+#ifdef NO_INTERPOLATION
+static u8 soundDSOutput[2] = { 0, 0 };
+#endif
+
 variable_desc soundSaveStruct[] = {
   { &soundPaused, sizeof(int) },
   { &soundPlay, sizeof(int) },
@@ -322,6 +338,8 @@ void soundEvent(u32 address, u8 data)
 {
   int freq = 0;
 
+  soundRender();
+
   switch(address) {
   case NR10:
     data &= 0x7f;
@@ -572,6 +590,10 @@ void soundEvent(u32 address, u8 data)
 
 void soundEvent(u32 address, u16 data)
 {
+  // the FIFOs are only read when a timer overflows
+  if(address < FIFOA_L)
+    soundRender();
+
   switch(address) {
   case SGCNT0_H:
     data &= 0xFF0F;
@@ -583,6 +605,9 @@ void soundEvent(u32 address, u16 data)
 	}*/
     if(data & 0x0800) {
       interp_reset(0);
+#ifdef NO_INTERPOLATION
+      soundDSOutput[0] = 0;
+#endif
       soundDSFifoAWriteIndex = 0;
       soundDSFifoAIndex = 0;
       soundDSFifoACount = 0;
@@ -593,6 +618,9 @@ void soundEvent(u32 address, u16 data)
     soundDSATimer = (data & 0x0400) ? 1 : 0;    
     if(data & 0x8000) {
       interp_reset(1);
+#ifdef NO_INTERPOLATION
+      soundDSOutput[1] = 0;
+#endif
       soundDSFifoBWriteIndex = 0;
       soundDSFifoBIndex = 0;
       soundDSFifoBCount = 0;
@@ -637,258 +665,349 @@ void soundEvent(u32 address, u16 data)
   }
 }
 
-void soundChannel1()
+void soundChannel1(int count)
 {
-  int vol = sound1EnvelopeVolume;
+  u8 *out = &soundBuffer[0][soundIndex];
 
-  int freq = 0;
-  int value = 0;
+  if(!sound1On) {
+    memset(out, 0, count);
+    return;
+  }
+
+  for(int i = 0; i < count; i++) {
+    int vol = sound1EnvelopeVolume;
+
+    int freq = 0;
+    int value = 0;
   
-  if(sound1On && (sound1ATL || !sound1Continue)) {
-    sound1Index += soundQuality*sound1Skip;
-    sound1Index &= 0x1fffffff;
+    if(sound1On && (sound1ATL || !sound1Continue)) {
+      sound1Index += soundQuality*sound1Skip;
+      sound1Index &= 0x1fffffff;
 
-    value = ((s8)sound1Wave[sound1Index>>24]) * vol;
-  }
+      value = ((s8)sound1Wave[sound1Index>>24]) * vol;
+    }
 
-  soundBuffer[0][soundIndex] = value;
+    out[i] = value;
 
   
-  if(sound1On) {
-    if(sound1ATL) {
-      sound1ATL-=soundQuality;
+    if(sound1On) {
+      if(sound1ATL) {
+        sound1ATL-=soundQuality;
       
-      if(sound1ATL <=0 && sound1Continue) {
-        ioMem[NR52] &= 0xfe;
-        sound1On = 0;
+        if(sound1ATL <=0 && sound1Continue) {
+          ioMem[NR52] &= 0xfe;
+          sound1On = 0;
+        }
       }
-    }
     
-    if(sound1EnvelopeATL) {
-      sound1EnvelopeATL-=soundQuality;
+      if(sound1EnvelopeATL) {
+        sound1EnvelopeATL-=soundQuality;
       
-      if(sound1EnvelopeATL<=0) {
-        if(sound1EnvelopeUpDown) {
-          if(sound1EnvelopeVolume < 15)
-            sound1EnvelopeVolume++;
-        } else {
-          if(sound1EnvelopeVolume)
-            sound1EnvelopeVolume--;
-        }
+        if(sound1EnvelopeATL<=0) {
+          if(sound1EnvelopeUpDown) {
+            if(sound1EnvelopeVolume < 15)
+              sound1EnvelopeVolume++;
+          } else {
+            if(sound1EnvelopeVolume)
+              sound1EnvelopeVolume--;
+          }
         
-        sound1EnvelopeATL += sound1EnvelopeATLReload;
+          sound1EnvelopeATL += sound1EnvelopeATLReload;
+        }
       }
-    }
     
-    if(sound1SweepATL) {
-      sound1SweepATL-=soundQuality;
+      if(sound1SweepATL) {
+        sound1SweepATL-=soundQuality;
       
-      if(sound1SweepATL<=0) {
-        freq = (((int)(ioMem[NR14]&7) << 8) | ioMem[NR13]);
+        if(sound1SweepATL<=0) {
+          freq = (((int)(ioMem[NR14]&7) << 8) | ioMem[NR13]);
           
-        int updown = 1;
+          int updown = 1;
         
-        if(sound1SweepUpDown)
-          updown = -1;
+          if(sound1SweepUpDown)
+            updown = -1;
         
-        int newfreq = 0;
-        if(sound1SweepSteps) {
-          newfreq = freq + updown * freq / (1 << sound1SweepSteps);
-          if(newfreq == freq)
-            newfreq = 0;
-        } else
-          newfreq = freq;
+          int newfreq = 0;
+          if(sound1SweepSteps) {
+            newfreq = freq + updown * freq / (1 << sound1SweepSteps);
+            if(newfreq == freq)
+              newfreq = 0;
+          } else
+            newfreq = freq;
         
-        if(newfreq < 0) {
-          sound1SweepATL += sound1SweepATLReload;
-        } else if(newfreq > 2047) {
-          sound1SweepATL = 0;
-          sound1On = 0;
-          ioMem[NR52] &= 0xfe;
-        } else {
-          sound1SweepATL += sound1SweepATLReload;
-          sound1Skip = SOUND_MAGIC/(2048 - newfreq);
+          if(newfreq < 0) {
+            sound1SweepATL += sound1SweepATLReload;
+          } else if(newfreq > 2047) {
+            sound1SweepATL = 0;
+            sound1On = 0;
+            ioMem[NR52] &= 0xfe;
+          } else {
+            sound1SweepATL += sound1SweepATLReload;
+            sound1Skip = SOUND_MAGIC/(2048 - newfreq);
           
-          ioMem[NR13] = newfreq & 0xff;
-          ioMem[NR14] = (ioMem[NR14] & 0xf8) |((newfreq >> 8) & 7);
+            ioMem[NR13] = newfreq & 0xff;
+            ioMem[NR14] = (ioMem[NR14] & 0xf8) |((newfreq >> 8) & 7);
+          }
         }
       }
     }
   }
 }
 
-void soundChannel2()
+void soundChannel2(int count)
 {
-  //  int freq = 0;
-  int vol = sound2EnvelopeVolume;
+  u8 *out = &soundBuffer[1][soundIndex];
+
+  if(!sound2On) {
+    memset(out, 0, count);
+    return;
+  }
+
+  for(int i = 0; i < count; i++) {
+    //  int freq = 0;
+    int vol = sound2EnvelopeVolume;
 
-  int value = 0;
+    int value = 0;
   
-  if(sound2On && (sound2ATL || !sound2Continue)) {
-    sound2Index += soundQuality*sound2Skip;
-    sound2Index &= 0x1fffffff;
+    if(sound2On && (sound2ATL || !sound2Continue)) {
+      sound2Index += soundQuality*sound2Skip;
+      sound2Index &= 0x1fffffff;
 
-    value = ((s8)sound2Wave[sound2Index>>24]) * vol;
-  }
+      value = ((s8)sound2Wave[sound2Index>>24]) * vol;
+    }
   
-  soundBuffer[1][soundIndex] = value;
+    out[i] = value;
     
-  if(sound2On) {
-    if(sound2ATL) {
-      sound2ATL-=soundQuality;
+    if(sound2On) {
+      if(sound2ATL) {
+        sound2ATL-=soundQuality;
       
-      if(sound2ATL <= 0 && sound2Continue) {
-        ioMem[NR52] &= 0xfd;
-        sound2On = 0;
+        if(sound2ATL <= 0 && sound2Continue) {
+          ioMem[NR52] &= 0xfd;
+          sound2On = 0;
+        }
       }
-    }
     
-    if(sound2EnvelopeATL) {
-      sound2EnvelopeATL-=soundQuality;
+      if(sound2EnvelopeATL) {
+        sound2EnvelopeATL-=soundQuality;
       
-      if(sound2EnvelopeATL <= 0) {
-        if(sound2EnvelopeUpDown) {
-          if(sound2EnvelopeVolume < 15)
-            sound2EnvelopeVolume++;
-        } else {
-          if(sound2EnvelopeVolume)
-            sound2EnvelopeVolume--;
+        if(sound2EnvelopeATL <= 0) {
+          if(sound2EnvelopeUpDown) {
+            if(sound2EnvelopeVolume < 15)
+              sound2EnvelopeVolume++;
+          } else {
+            if(sound2EnvelopeVolume)
+              sound2EnvelopeVolume--;
+          }
+          sound2EnvelopeATL += sound2EnvelopeATLReload;
         }
-        sound2EnvelopeATL += sound2EnvelopeATLReload;
       }
     }
   }
 }  
 
-void soundChannel3()
+void soundChannel3(int count)
 {
-  int value = sound3Last;
+  u8 *out = &soundBuffer[2][soundIndex];
+
+  if(!sound3On) {
+    memset(out, sound3Last, count);
+    return;
+  }
+
+  for(int i = 0; i < count; i++) {
+    int value = sound3Last;
   
-  if(sound3On && (sound3ATL || !sound3Continue)) {
-    sound3Index += soundQuality*sound3Skip;
-    if(sound3DataSize) {
-      sound3Index &= 0x3fffffff;
-      value = sound3WaveRam[sound3Index>>25];
-    } else {
-      sound3Index &= 0x1fffffff;
-      value = sound3WaveRam[sound3Bank*0x10 + (sound3Index>>25)];
-    }
+    if(sound3On && (sound3ATL || !sound3Continue)) {
+      sound3Index += soundQuality*sound3Skip;
+      if(sound3DataSize) {
+        sound3Index &= 0x3fffffff;
+        value = sound3WaveRam[sound3Index>>25];
+      } else {
+        sound3Index &= 0x1fffffff;
+        value = sound3WaveRam[sound3Bank*0x10 + (sound3Index>>25)];
+      }
     
-    if( (sound3Index & 0x01000000)) {
-      value &= 0x0f;
-    } else {
-      value >>= 4;
-    }
+      if( (sound3Index & 0x01000000)) {
+        value &= 0x0f;
+      } else {
+        value >>= 4;
+      }
 
-    value -= 8;
-    value *= 2;
+      value -= 8;
+      value *= 2;
     
-    if(sound3ForcedOutput) {
-      value = ((value >> 1) + value) >> 1;
-    } else {
-      switch(sound3OutputLevel) {
-      case 0:
-        value = 0;
-        break;
-      case 1:
-        break;
-      case 2:
-        value = (value >> 1);
-        break;
-      case 3:
-        value = (value >> 2);
-        break;
+      if(sound3ForcedOutput) {
+        value = ((value >> 1) + value) >> 1;
+      } else {
+        switch(sound3OutputLevel) {
+        case 0:
+          value = 0;
+          break;
+        case 1:
+          break;
+        case 2:
+          value = (value >> 1);
+          break;
+        case 3:
+          value = (value >> 2);
+          break;
+        }
       }
+      sound3Last = value;
     }
-    sound3Last = value;
-  }
   
-  soundBuffer[2][soundIndex] = value;
+    out[i] = value;
   
-  if(sound3On) {
-    if(sound3ATL) {
-      sound3ATL-=soundQuality;
+    if(sound3On) {
+      if(sound3ATL) {
+        sound3ATL-=soundQuality;
       
-      if(sound3ATL <= 0 && sound3Continue) {
-        ioMem[NR52] &= 0xfb;
-        sound3On = 0;
+        if(sound3ATL <= 0 && sound3Continue) {
+          ioMem[NR52] &= 0xfb;
+          sound3On = 0;
+        }
       }
     }
   }
 }
 
-void soundChannel4()
+void soundChannel4(int count)
 {
-  int vol = sound4EnvelopeVolume;
+  u8 *out = &soundBuffer[3][soundIndex];
 
-  int value = 0;
+  if(!sound4On) {
+    memset(out, 0, count);
+    return;
+  }
 
-  if(sound4Clock <= 0x0c) {
-    if(sound4On && (sound4ATL || !sound4Continue)) {
-      sound4Index += soundQuality*sound4Skip;
-      sound4ShiftIndex += soundQuality*sound4ShiftSkip;
+  for(int i = 0; i < count; i++) {
+    int vol = sound4EnvelopeVolume;
 
-      if(sound4NSteps) {
-        while(sound4ShiftIndex > 0x1fffff) {
-          sound4ShiftRight = (((sound4ShiftRight << 6) ^
-                               (sound4ShiftRight << 5)) & 0x40) |
-            (sound4ShiftRight >> 1);
-          sound4ShiftIndex -= 0x200000;
-        }
-      } else {
-        while(sound4ShiftIndex > 0x1fffff) {
-          sound4ShiftRight = (((sound4ShiftRight << 14) ^
-                              (sound4ShiftRight << 13)) & 0x4000) |
-            (sound4ShiftRight >> 1);
+    int value = 0;
 
-          sound4ShiftIndex -= 0x200000;   
+    if(sound4Clock <= 0x0c) {
+      if(sound4On && (sound4ATL || !sound4Continue)) {
+        sound4Index += soundQuality*sound4Skip;
+        sound4ShiftIndex += soundQuality*sound4ShiftSkip;
+
+        if(sound4NSteps) {
+          while(sound4ShiftIndex > 0x1fffff) {
+            sound4ShiftRight = (((sound4ShiftRight << 6) ^
+                                 (sound4ShiftRight << 5)) & 0x40) |
+              (sound4ShiftRight >> 1);
+            sound4ShiftIndex -= 0x200000;
+          }
+        } else {
+          while(sound4ShiftIndex > 0x1fffff) {
+            sound4ShiftRight = (((sound4ShiftRight << 14) ^
+                                (sound4ShiftRight << 13)) & 0x4000) |
+              (sound4ShiftRight >> 1);
+
+            sound4ShiftIndex -= 0x200000;   
+          }
         }
-      }
 
-      sound4Index &= 0x1fffff;    
-      sound4ShiftIndex &= 0x1fffff;        
+        sound4Index &= 0x1fffff;    
+        sound4ShiftIndex &= 0x1fffff;        
     
-      value = ((sound4ShiftRight & 1)*2-1) * vol;
-    } else {
-      value = 0;
+        value = ((sound4ShiftRight & 1)*2-1) * vol;
+      } else {
+        value = 0;
+      }
     }
-  }
   
-  soundBuffer[3][soundIndex] = value;
+    out[i] = value;
 
-  if(sound4On) {
-    if(sound4ATL) {
-      sound4ATL-=soundQuality;
+    if(sound4On) {
+      if(sound4ATL) {
+        sound4ATL-=soundQuality;
       
-      if(sound4ATL <= 0 && sound4Continue) {
-        ioMem[NR52] &= 0xfd;
-        sound4On = 0;
+        if(sound4ATL <= 0 && sound4Continue) {
+          ioMem[NR52] &= 0xfd;
+          sound4On = 0;
+        }
       }
-    }
     
-    if(sound4EnvelopeATL) {
-      sound4EnvelopeATL-=soundQuality;
+      if(sound4EnvelopeATL) {
+        sound4EnvelopeATL-=soundQuality;
       
-      if(sound4EnvelopeATL <= 0) {
-        if(sound4EnvelopeUpDown) {
-          if(sound4EnvelopeVolume < 15)
-            sound4EnvelopeVolume++;
-        } else {
-          if(sound4EnvelopeVolume)
-            sound4EnvelopeVolume--;
+        if(sound4EnvelopeATL <= 0) {
+          if(sound4EnvelopeUpDown) {
+            if(sound4EnvelopeVolume < 15)
+              sound4EnvelopeVolume++;
+          } else {
+            if(sound4EnvelopeVolume)
+              sound4EnvelopeVolume--;
+          }
+          sound4EnvelopeATL += sound4EnvelopeATLReload;
         }
-        sound4EnvelopeATL += sound4EnvelopeATLReload;
       }
     }
   }
 }
 
-void soundDirectSoundA()
+static void soundDirectSoundPush(int ch, u8 value)
+{
+#ifndef NO_INTERPOLATION
+  interp_push(ch, (s8)value << 8);
+#else
+  soundDSOutput[ch] = value;
+#endif
+}
+
+// Feeds the resampler the samples taken before output sample 'time' of the
+// block being rendered
+static void soundDirectSoundReplay(int ch, int time)
+{
+  while(soundDSQueueIndex[ch] < soundDSQueueCount[ch] &&
+        soundDSQueue[ch][soundDSQueueIndex[ch]].time <= time) {
+    soundDirectSoundPush(ch, soundDSQueue[ch][soundDSQueueIndex[ch]].value);
+    soundDSQueueIndex[ch]++;
+  }
+}
+
+// Called on timer overflow. Queues the sample if there are output samples
+// still to render before it.
+static void soundDirectSoundQueue(int ch, u8 value)
+{
+  if(soundPending && soundDSQueueCount[ch] == SOUND_DS_QUEUE)
+    soundRender();
+
+  if(soundPending) {
+    soundDSQueue[ch][soundDSQueueCount[ch]].time = soundPending;
+    soundDSQueue[ch][soundDSQueueCount[ch]].value = value;
+    soundDSQueueCount[ch]++;
+  } else
+    soundDirectSoundPush(ch, value);
+}
+
+// 'done' is the number of pending samples rendered before this block
+void soundDirectSound(int ch, int timer, int done, int count)
 {
 #ifndef NO_INTERPOLATION
-  directBuffer[0][soundIndex] = interp_pop(0, calc_rate(soundDSATimer)); //soundDSAValue;
+  u16 *out = &directBuffer[ch][soundIndex];
+  double rate = calc_rate(timer);
+
+  for(int i = 0; i < count;) {
+    soundDirectSoundReplay(ch, done + i);
+
+    // resample up to the next queued sample in one go
+    int n = count - i;
+    if(soundDSQueueIndex[ch] < soundDSQueueCount[ch] &&
+       soundDSQueue[ch][soundDSQueueIndex[ch]].time - done - i < n)
+      n = soundDSQueue[ch][soundDSQueueIndex[ch]].time - done - i;
+
+    interp_render(ch, &out[i], n, rate);
+    i += n;
+  }
 #else
-  soundBuffer[4][soundIndex] = soundDSAValue;
+  u8 *out = &soundBuffer[4 + ch][soundIndex];
+
+  for(int i = 0; i < count; i++) {
+    soundDirectSoundReplay(ch, done + i);
+    out[i] = soundDSOutput[ch];
+  }
 #endif
 }
 
@@ -910,22 +1029,13 @@ void soundDirectSoundATimer()
     }
     
     soundDSAValue = (soundDSFifoA[soundDSFifoAIndex]);
-    interp_push(0, (s8)soundDSAValue << 8);
+    soundDirectSoundQueue(0, soundDSAValue);
     soundDSFifoAIndex = (++soundDSFifoAIndex) & 31;
     soundDSFifoACount--;
   } else
     soundDSAValue = 0;
 }
 
-void soundDirectSoundB()
-{
-#ifndef NO_INTERPOLATION
-  directBuffer[1][soundIndex] = interp_pop(1, calc_rate(soundDSBTimer)); //soundDSBValue;
-#else
-  soundBuffer[5][soundIndex] = soundDSBValue;
-#endif
-}
-
 void soundDirectSoundBTimer()
 {
   if(soundDSBEnabled) {
@@ -944,7 +1054,7 @@ void soundDirectSoundBTimer()
     }
     
     soundDSBValue = (soundDSFifoB[soundDSFifoBIndex]);
-    interp_push(1, (s8)soundDSBValue << 8);
+    soundDirectSoundQueue(1, soundDSBValue);
     soundDSFifoBIndex = (++soundDSFifoBIndex) & 31;
     soundDSFifoBCount--;
   } else {
@@ -969,386 +1079,371 @@ void soundTimerOverflow(int timer)
 extern "C" int relvolume;
 
 #ifndef NO_INTERPOLATION
-void soundMix()
+void soundMix(int count)
 {
-  int res = 0;
-  int cgbRes = 0;
   int ratio = ioMem[0x82] & 3;
   int dsaRatio = ioMem[0x82] & 4;
   int dsbRatio = ioMem[0x82] & 8;
-  
-  if(soundBalance & 16) {
-    cgbRes = ((s8)soundBuffer[0][soundIndex]);
-  }
-  if(soundBalance & 32) {
-    cgbRes += ((s8)soundBuffer[1][soundIndex]);
-  }
-  if(soundBalance & 64) {
-    cgbRes += ((s8)soundBuffer[2][soundIndex]);
-  }
-  if(soundBalance & 128) {
-    cgbRes += ((s8)soundBuffer[3][soundIndex]);
-  }
-
-  if((soundControl & 0x0200) && (soundEnableFlag & 0x100)){
-    if(!dsaRatio)
-      res = ((s16)directBuffer[0][soundIndex])>>1;
-    else
-      res = ((s16)directBuffer[0][soundIndex]);
-  }
-  
-  if((soundControl & 0x2000) && (soundEnableFlag & 0x200)){
-    if(!dsbRatio)
-      res += ((s16)directBuffer[1][soundIndex])>>1;
-    else
-      res += ((s16)directBuffer[1][soundIndex]);
-  }
-  
-  res = (res * 170) >> 8;
-  cgbRes = (cgbRes * 52 * soundLevel1);
+  int balance = soundBalance;
+  bool dsaLeft = (soundControl & 0x0200) && (soundEnableFlag & 0x100);
+  bool dsbLeft = (soundControl & 0x2000) && (soundEnableFlag & 0x200);
+  bool dsaRight = (soundControl & 0x0100) && (soundEnableFlag & 0x100);
+  bool dsbRight = (soundControl & 0x1000) && (soundEnableFlag & 0x200);
+  int dsaShift = dsaRatio ? 0 : 1;
+  int dsbShift = dsbRatio ? 0 : 1;
+  int cgbLevel = 52 * soundLevel1;
+  int cgbShift;
+  double volume = (float)relvolume / 1000.0;
+  int index = soundBufferIndex;
 
   switch(ratio) {
   case 0:
   case 3: // prohibited, but 25%    
-    cgbRes >>= 2;
+    cgbShift = 2;
     break;
   case 1:
-    cgbRes >>= 1;
+    cgbShift = 1;
     break;
   case 2:
+    cgbShift = 0;
     break;
   }
 
-  res += cgbRes;
+  for(int i = soundIndex; i < soundIndex + count; i++) {
+    int res = 0;
+    int cgbRes = 0;
 
-  if(soundEcho) {
-    res *= 2;
-    res += soundFilter[soundEchoIndex];
-    res /= 2;
-    soundFilter[soundEchoIndex++] = res;
-  }
+    if(balance & 16) {
+      cgbRes = ((s8)soundBuffer[0][i]);
+    }
+    if(balance & 32) {
+      cgbRes += ((s8)soundBuffer[1][i]);
+    }
+    if(balance & 64) {
+      cgbRes += ((s8)soundBuffer[2][i]);
+    }
+    if(balance & 128) {
+      cgbRes += ((s8)soundBuffer[3][i]);
+    }
 
-  if(soundLowPass) {
-    soundLeft[4] = soundLeft[3];
-    soundLeft[3] = soundLeft[2];
-    soundLeft[2] = soundLeft[1];
-    soundLeft[1] = soundLeft[0];
-    soundLeft[0] = res;
-    res = (soundLeft[4] + 2*soundLeft[3] + 8*soundLeft[2] + 2*soundLeft[1] +
-           soundLeft[0])/14;
-  }
+    if(dsaLeft)
+      res = ((s16)directBuffer[0][i]) >> dsaShift;
+    if(dsbLeft)
+      res += ((s16)directBuffer[1][i]) >> dsbShift;
 
-  switch(soundVolume) {
-  case 0:
-  case 1:
-  case 2:
-  case 3:
-    res *= (soundVolume+1);
-    break;
-  case 4:
-    res >>= 2;
-    break;
-  case 5:
-    res >>= 1;
-    break;
-  }
+    res = (res * 170) >> 8;
+    res += (cgbRes * cgbLevel) >> cgbShift;
 
-  res = (int)((float) res * ((float)relvolume / 1000.0));
-  
-  if(res > 32767)
-    res = 32767;
-  if(res < -32768)
-    res = -32768;
-
-  if(soundReverse)
-    soundFinalWave[++soundBufferIndex] = res;
-  else
-    soundFinalWave[soundBufferIndex++] = res;
-  
-  res = 0;
-  cgbRes = 0;
+    if(soundEcho) {
+      res *= 2;
+      res += soundFilter[soundEchoIndex];
+      res /= 2;
+      soundFilter[soundEchoIndex++] = res;
+    }
+
+    if(soundLowPass) {
+      soundLeft[4] = soundLeft[3];
+      soundLeft[3] = soundLeft[2];
+      soundLeft[2] = soundLeft[1];
+      soundLeft[1] = soundLeft[0];
+      soundLeft[0] = res;
+      res = (soundLeft[4] + 2*soundLeft[3] + 8*soundLeft[2] + 2*soundLeft[1] +
+             soundLeft[0])/14;
+    }
+
+    switch(soundVolume) {
+    case 0:
+    case 1:
+    case 2:
+    case 3:
+      res *= (soundVolume+1);
+      break;
+    case 4:
+      res >>= 2;
+      break;
+    case 5:
+      res >>= 1;
+      break;
+    }
+
+    res = (int)((float) res * volume);
   
-  if(soundBalance & 1) {
-    cgbRes = ((s8)soundBuffer[0][soundIndex]);
-  }
-  if(soundBalance & 2) {
-    cgbRes += ((s8)soundBuffer[1][soundIndex]);
-  }
-  if(soundBalance & 4) {
-    cgbRes += ((s8)soundBuffer[2][soundIndex]);
-  }
-  if(soundBalance & 8) {
-    cgbRes += ((s8)soundBuffer[3][soundIndex]);
-  }
+    if(res > 32767)
+      res = 32767;
+    if(res < -32768)
+      res = -32768;
 
-  if((soundControl & 0x0100) && (soundEnableFlag & 0x100)){
-    if(!dsaRatio)
-      res = ((s16)directBuffer[0][soundIndex])>>1;
+    if(soundReverse)
+      soundFinalWave[++index] = res;
     else
-      res = ((s16)directBuffer[0][soundIndex]);
-  }
+      soundFinalWave[index++] = res;
   
-  if((soundControl & 0x1000) && (soundEnableFlag & 0x200)){
-    if(!dsbRatio)
-      res += ((s16)directBuffer[1][soundIndex])>>1;
-    else
-      res += ((s16)directBuffer[1][soundIndex]);
-  }
-
-  res = (res * 170) >> 8;
-  cgbRes = (cgbRes * 52 * soundLevel1);
+    res = 0;
+    cgbRes = 0;
   
-  switch(ratio) {
-  case 0:
-  case 3: // prohibited, but 25%
-    cgbRes >>= 2;
-    break;
-  case 1:
-    cgbRes >>= 1;
-    break;
-  case 2:
-    break;
-  }
+    if(balance & 1) {
+      cgbRes = ((s8)soundBuffer[0][i]);
+    }
+    if(balance & 2) {
+      cgbRes += ((s8)soundBuffer[1][i]);
+    }
+    if(balance & 4) {
+      cgbRes += ((s8)soundBuffer[2][i]);
+    }
+    if(balance & 8) {
+      cgbRes += ((s8)soundBuffer[3][i]);
+    }
 
-  res += cgbRes;
+    if(dsaRight)
+      res = ((s16)directBuffer[0][i]) >> dsaShift;
+    if(dsbRight)
+      res += ((s16)directBuffer[1][i]) >> dsbShift;
+
+    res = (res * 170) >> 8;
+    res += (cgbRes * cgbLevel) >> cgbShift;
   
-  if(soundEcho) {
-    res *= 2;
-    res += soundFilter[soundEchoIndex];
-    res /= 2;
-    soundFilter[soundEchoIndex++] = res;
-
-    if(soundEchoIndex >= 4000)
-      soundEchoIndex = 0;
-  }
+    if(soundEcho) {
+      res *= 2;
+      res += soundFilter[soundEchoIndex];
+      res /= 2;
+      soundFilter[soundEchoIndex++] = res;
+
+      if(soundEchoIndex >= 4000)
+        soundEchoIndex = 0;
+    }
 
-  if(soundLowPass) {
-    soundRight[4] = soundRight[3];
-    soundRight[3] = soundRight[2];
-    soundRight[2] = soundRight[1];
-    soundRight[1] = soundRight[0];
-    soundRight[0] = res;
-    res = (soundRight[4] + 2*soundRight[3] + 8*soundRight[2] + 2*soundRight[1] +
-           soundRight[0])/14;
-  }
+    if(soundLowPass) {
+      soundRight[4] = soundRight[3];
+      soundRight[3] = soundRight[2];
+      soundRight[2] = soundRight[1];
+      soundRight[1] = soundRight[0];
+      soundRight[0] = res;
+      res = (soundRight[4] + 2*soundRight[3] + 8*soundRight[2] + 2*soundRight[1] +
+             soundRight[0])/14;
+    }
 
-  switch(soundVolume) {
-  case 0:
-  case 1:
-  case 2:
-  case 3:
-    res *= (soundVolume+1);
-    break;
-  case 4:
-    res >>= 2;
-    break;
-  case 5:
-    res >>= 1;
-    break;
-  }
+    switch(soundVolume) {
+    case 0:
+    case 1:
+    case 2:
+    case 3:
+      res *= (soundVolume+1);
+      break;
+    case 4:
+      res >>= 2;
+      break;
+    case 5:
+      res >>= 1;
+      break;
+    }
   
-  res = (int)((float) res * ((float)relvolume / 1000.));
+    res = (int)((float) res * volume);
 
-  if(res > 32767)
-    res = 32767;
-  if(res < -32768)
-    res = -32768;
+    if(res > 32767)
+      res = 32767;
+    if(res < -32768)
+      res = -32768;
   
-  if(soundReverse)
-    soundFinalWave[-1+soundBufferIndex++] = res;
-  else
-    soundFinalWave[soundBufferIndex++] = res;
+    if(soundReverse)
+      soundFinalWave[-1+index++] = res;
+    else
+      soundFinalWave[index++] = res;
+  }
+
+  soundBufferIndex = index;
 }
 #else
 
-void soundMix()
+void soundMix(int count)
 {
-  int res = 0;
-  int cgbRes = 0;
-  int ratio = ioMem[0x82] & 3;
-  int dsaRatio = ioMem[0x82] & 4;
-  int dsbRatio = ioMem[0x82] & 8;
+  for(int i = soundIndex; i < soundIndex + count; i++) {
+    int res = 0;
+    int cgbRes = 0;
+    int ratio = ioMem[0x82] & 3;
+    int dsaRatio = ioMem[0x82] & 4;
+    int dsbRatio = ioMem[0x82] & 8;
  
  
-  if((soundBalance & 16)) {
-    cgbRes = ((s8)soundBuffer[0][soundIndex]);
-  }
-  if((soundBalance & 32)) {
-    cgbRes += ((s8)soundBuffer[1][soundIndex]);
-  }
-  if((soundBalance & 64)) {
-    cgbRes += ((s8)soundBuffer[2][soundIndex]);
-  }
-  if((soundBalance & 128)) {
-    cgbRes += ((s8)soundBuffer[3][soundIndex]);
-  }
+    if((soundBalance & 16)) {
+      cgbRes = ((s8)soundBuffer[0][i]);
+    }
+    if((soundBalance & 32)) {
+      cgbRes += ((s8)soundBuffer[1][i]);
+    }
+    if((soundBalance & 64)) {
+      cgbRes += ((s8)soundBuffer[2][i]);
+    }
+    if((soundBalance & 128)) {
+      cgbRes += ((s8)soundBuffer[3][i]);
+    }
 
-  if((soundControl & 0x0200) && (soundEnableFlag & 0x100)){
-    if(!dsaRatio)
-      res = ((s8)soundBuffer[4][soundIndex])>>1;
-    else
-      res = ((s8)soundBuffer[4][soundIndex]);
-  }
+    if((soundControl & 0x0200) && (soundEnableFlag & 0x100)){
+      if(!dsaRatio)
+        res = ((s8)soundBuffer[4][i])>>1;
+      else
+        res = ((s8)soundBuffer[4][i]);
+    }
   
-  if((soundControl & 0x2000) && (soundEnableFlag & 0x200)){
-    if(!dsbRatio)
-      res += ((s8)soundBuffer[5][soundIndex])>>1;
-    else
-      res += ((s8)soundBuffer[5][soundIndex]);
-  }
+    if((soundControl & 0x2000) && (soundEnableFlag & 0x200)){
+      if(!dsbRatio)
+        res += ((s8)soundBuffer[5][i])>>1;
+      else
+        res += ((s8)soundBuffer[5][i]);
+    }
   
-  res = (res * 170);
-  cgbRes = (cgbRes * 52 * soundLevel1);
-
-  switch(ratio) {
-  case 0:
-  case 3: // prohibited, but 25%    
-    cgbRes >>= 2;
-    break;
-  case 1:
-    cgbRes >>= 1;
-    break;
-  case 2:
-    break;
-  }
+    res = (res * 170);
+    cgbRes = (cgbRes * 52 * soundLevel1);
+
+    switch(ratio) {
+    case 0:
+    case 3: // prohibited, but 25%    
+      cgbRes >>= 2;
+      break;
+    case 1:
+      cgbRes >>= 1;
+      break;
+    case 2:
+      break;
+    }
 
-  res += cgbRes;
+    res += cgbRes;
 
-  if(soundEcho) {
-    res *= 2;
-    res += soundFilter[soundEchoIndex];
-    res /= 2;
-    soundFilter[soundEchoIndex++] = res;
-  }
+    if(soundEcho) {
+      res *= 2;
+      res += soundFilter[soundEchoIndex];
+      res /= 2;
+      soundFilter[soundEchoIndex++] = res;
+    }
 
-  if(soundLowPass) {
-    soundLeft[4] = soundLeft[3];
-    soundLeft[3] = soundLeft[2];
-    soundLeft[2] = soundLeft[1];
-    soundLeft[1] = soundLeft[0];
-    soundLeft[0] = res;
-    res = (soundLeft[4] + 2*soundLeft[3] + 8*soundLeft[2] + 2*soundLeft[1] + soundLeft[0])/14;
-  }
+    if(soundLowPass) {
+      soundLeft[4] = soundLeft[3];
+      soundLeft[3] = soundLeft[2];
+      soundLeft[2] = soundLeft[1];
+      soundLeft[1] = soundLeft[0];
+      soundLeft[0] = res;
+      res = (soundLeft[4] + 2*soundLeft[3] + 8*soundLeft[2] + 2*soundLeft[1] + soundLeft[0])/14;
+    }
 
-  switch(soundVolume) {
-  case 0:
-  case 1:
-  case 2:
-  case 3:
-    res *= (soundVolume+1);
-    break;
-  case 4:
-    res >>= 2;
-    break;
-  case 5:
-    res >>= 1;
-    break;
-  }
+    switch(soundVolume) {
+    case 0:
+    case 1:
+    case 2:
+    case 3:
+      res *= (soundVolume+1);
+      break;
+    case 4:
+      res >>= 2;
+      break;
+    case 5:
+      res >>= 1;
+      break;
+    }
 
-  res = (int)((float) res * ((float)relvolume / 1000.0));
+    res = (int)((float) res * ((float)relvolume / 1000.0));
   
-  if(res > 32767)
-    res = 32767;
-  if(res < -32768)
-    res = -32768;
-
-  if(soundReverse)
-    soundFinalWave[++soundBufferIndex] = res;
-  else
-    soundFinalWave[soundBufferIndex++] = res;
+    if(res > 32767)
+      res = 32767;
+    if(res < -32768)
+      res = -32768;
+
+    if(soundReverse)
+      soundFinalWave[++soundBufferIndex] = res;
+    else
+      soundFinalWave[soundBufferIndex++] = res;
   
-  res = 0;
-  cgbRes = 0;
+    res = 0;
+    cgbRes = 0;
   
-  if((soundBalance & 1)) {
-    cgbRes = ((s8)soundBuffer[0][soundIndex]);
-  }
-  if((soundBalance & 2)) {
-    cgbRes += ((s8)soundBuffer[1][soundIndex]);
-  }
-  if((soundBalance & 4)) {
-    cgbRes += ((s8)soundBuffer[2][soundIndex]);
-  }
-  if((soundBalance & 8)) {
-    cgbRes += ((s8)soundBuffer[3][soundIndex]);
-  }
+    if((soundBalance & 1)) {
+      cgbRes = ((s8)soundBuffer[0][i]);
+    }
+    if((soundBalance & 2)) {
+      cgbRes += ((s8)soundBuffer[1][i]);
+    }
+    if((soundBalance & 4)) {
+      cgbRes += ((s8)soundBuffer[2][i]);
+    }
+    if((soundBalance & 8)) {
+      cgbRes += ((s8)soundBuffer[3][i]);
+    }
 
-  if((soundControl & 0x0100) && (soundEnableFlag & 0x100)){
-    if(!dsaRatio)
-      res = ((s8)soundBuffer[4][soundIndex])>>1;
-    else
-      res = ((s8)soundBuffer[4][soundIndex]);
-  }
+    if((soundControl & 0x0100) && (soundEnableFlag & 0x100)){
+      if(!dsaRatio)
+        res = ((s8)soundBuffer[4][i])>>1;
+      else
+        res = ((s8)soundBuffer[4][i]);
+    }
   
-  if((soundControl & 0x1000) && (soundEnableFlag & 0x200)){
-    if(!dsbRatio)
-      res += ((s8)soundBuffer[5][soundIndex])>>1;
-    else
-      res += ((s8)soundBuffer[5][soundIndex]);
-  }
+    if((soundControl & 0x1000) && (soundEnableFlag & 0x200)){
+      if(!dsbRatio)
+        res += ((s8)soundBuffer[5][i])>>1;
+      else
+        res += ((s8)soundBuffer[5][i]);
+    }
 
-  res = (res * 170);
-  cgbRes = (cgbRes * 52 * soundLevel1);
+    res = (res * 170);
+    cgbRes = (cgbRes * 52 * soundLevel1);
   
-  switch(ratio) {
-  case 0:
-  case 3: // prohibited, but 25%
-    cgbRes >>= 2;
-    break;
-  case 1:
-    cgbRes >>= 1;
-    break;
-  case 2:
-    break;
-  }
+    switch(ratio) {
+    case 0:
+    case 3: // prohibited, but 25%
+      cgbRes >>= 2;
+      break;
+    case 1:
+      cgbRes >>= 1;
+      break;
+    case 2:
+      break;
+    }
 
-  res += cgbRes;
+    res += cgbRes;
   
-  if(soundEcho) {
-    res *= 2;
-    res += soundFilter[soundEchoIndex];
-    res /= 2;
-    soundFilter[soundEchoIndex++] = res;
-
-    if(soundEchoIndex >= 4000)
-      soundEchoIndex = 0;
-  }
+    if(soundEcho) {
+      res *= 2;
+      res += soundFilter[soundEchoIndex];
+      res /= 2;
+      soundFilter[soundEchoIndex++] = res;
+
+      if(soundEchoIndex >= 4000)
+        soundEchoIndex = 0;
+    }
 
-  if(soundLowPass) {
-    soundRight[4] = soundRight[3];
-    soundRight[3] = soundRight[2];
-    soundRight[2] = soundRight[1];
-    soundRight[1] = soundRight[0];
-    soundRight[0] = res;
-    res = (soundRight[4] + 2*soundRight[3] + 8*soundRight[2] + 2*soundRight[1] + soundRight[0])/14;
-  }
+    if(soundLowPass) {
+      soundRight[4] = soundRight[3];
+      soundRight[3] = soundRight[2];
+      soundRight[2] = soundRight[1];
+      soundRight[1] = soundRight[0];
+      soundRight[0] = res;
+      res = (soundRight[4] + 2*soundRight[3] + 8*soundRight[2] + 2*soundRight[1] + soundRight[0])/14;
+    }
 
-  switch(soundVolume) {
-  case 0:
-  case 1:
-  case 2:
-  case 3:
-    res *= (soundVolume+1);
-    break;
-  case 4:
-    res >>= 2;
-    break;
-  case 5:
-    res >>= 1;
-    break;
-  }
+    switch(soundVolume) {
+    case 0:
+    case 1:
+    case 2:
+    case 3:
+      res *= (soundVolume+1);
+      break;
+    case 4:
+      res >>= 2;
+      break;
+    case 5:
+      res >>= 1;
+      break;
+    }
 
-  res = (float) res * ((float)relvolume / 1000.);
+    res = (float) res * ((float)relvolume / 1000.);
   
-  if(res > 32767)
-    res = 32767;
-  if(res < -32768)
-    res = -32768;
+    if(res > 32767)
+      res = 32767;
+    if(res < -32768)
+      res = -32768;
   
-  if(soundReverse)
-    soundFinalWave[-1+soundBufferIndex++] = res;
-  else
-    soundFinalWave[soundBufferIndex++] = res;
+    if(soundReverse)
+      soundFinalWave[-1+soundBufferIndex++] = res;
+    else
+      soundFinalWave[soundBufferIndex++] = res;
+  }
 }
 #endif
 
@@ -1424,164 +1519,212 @@ void soundTick()
 
 //#ifndef LINUX
 #if 1
-void soundTick()
+// Silence detection and fade out, once the sample ending just before
+// soundFinalWave[index] has been mixed
+static void soundTrackTick(int index)
 {
-	//if (seek_needed == -1)		//if no seek is needed
-	if (1)
+	//check for silence...
+//#if 0
+	decodeposmod=(int)decode_pos_ms%500;
+	if(((decodeposmod>=0)&&(decodeposmod<=10))||didseek)
 	{
-		//if(systemSoundOn) {						//needed?  I don't think so
-		if(soundMasterOn && !stopState) 
+		if((!outputtimeread)||didseek)
 		{
-			soundChannel1();
-			soundChannel2();
-			soundChannel3();
-			soundChannel4();
-			soundDirectSoundA();
-			soundDirectSoundB();
-			if ((decode_pos_ms  < TrackLength) || IgnoreTrackLength || playforever)
-				soundMix();
-			else
-			{
-				soundFinalWave[soundBufferIndex++] = 0;
-				soundFinalWave[soundBufferIndex++] = 0;
-			}
-			//check for silence...
-//#if 0
-			decodeposmod=(int)decode_pos_ms%500;
-			if(((decodeposmod>=0)&&(decodeposmod<=10))||didseek)
-			{
-				if((!outputtimeread)||didseek)
-				{
 //					mod.SetInfo(cpupercent,sndSamplesPerSec/1000,sndNumChannels,1);
 //					int outputtime=mod.outMod->GetOutputTime();
 //					int writtentime=mod.outMod->GetWrittenTime();
-					int outputtime, writtentime;
-					outputtime = writtentime = (int)decode_pos_ms;
-					if(outputtime<0)
-						outputtime=0;
-					if(writtentime<0)
-						writtentime=0;
-					buffertime = writtentime-outputtime;
-					if(buffertime<0)
-						buffertime=0;
-					playtime = (decode_pos_ms - (buffertime));
-					outputtimeread=1;
-				}
-				else
-					playtime += (1./44100.)*1000.;
-			}
-			else
+			int outputtime, writtentime;
+			outputtime = writtentime = (int)decode_pos_ms;
+			if(outputtime<0)
+				outputtime=0;
+			if(writtentime<0)
+				writtentime=0;
+			buffertime = writtentime-outputtime;
+			if(buffertime<0)
+				buffertime=0;
+			playtime = (decode_pos_ms - (buffertime));
+			outputtimeread=1;
+		}
+		else
+			playtime += (1./44100.)*1000.;
+	}
+	else
+	{
+		playtime += (1./44100.)*1000.;
+		outputtimeread=0;
+	}
+//#endif			
+	
+	if(DetectSilence)
+	{
+		if(!silencedetected||decode_pos_ms<100||didseek)
+		{
+			/*if(decode_pos_ms<100)
 			{
-				playtime += (1./44100.)*1000.;
-				outputtimeread=0;
+				//prevtime=(int)(decode_pos_ms - (mod.outMod->GetWrittenTime()-mod.outMod->GetOutputTime()));
+				//playtime=prevtime;
 			}
-//#endif			
+			else*/
+				prevtime=(int)playtime;
+			didseek=false;
+		}
+		//if((soundFinalWave[index-2] <=  0x200 || soundFinalWave[index-2] >=  0xFE00) || 
+		  if ((soundFinalWave[index-2] - prevsound[0]) <= 0x8 )
+			  //|| (prevsound[0] - soundFinalWave[index-2]) <= 0x8)
+		{
+			silencedetected++;
+		//	if((silencedetected%0x100)==81)
+		//	DisplayError("Silence Detected count = %d",silencedetected);
+		}
+		else
+			silencedetected=0;
+		prevsound[0]=soundFinalWave[index-2];
+		//if((soundFinalWave[index-1] <=  0x200 || soundFinalWave[index-1] >=  0xFE00) || 
+		  if ((soundFinalWave[index-1] - prevsound[1]) <= 0x8 )
+//		   (prevsound[1] - soundFinalWave[index-1]) <= 0x8)
+			silencedetected++;
+		else
+			silencedetected=0;
+		prevsound[1]=soundFinalWave[index-1];
+		//if(silencedetected>(silencelength*2*sndSamplesPerSec))
+		//if((silencedetected>0)&&((decode_pos_ms - (mod.outMod->GetWrittenTime()-mod.outMod->GetOutputTime())-prevtime) > (silencelength*1000)))
+		if((silencedetected>0)&&((playtime-prevtime) > ((silencelength*1000)+buffertime)))
+		{
+		//	DisplayError("%d %d %d", silencedetected,silencelength*2*sndSamplesPerSec,sndSamplesPerSec);
+			outputtimeread=0;
+			silencedetected=0;
+			end_of_track();
 			
-			if(DetectSilence)
-			{
-				if(!silencedetected||decode_pos_ms<100||didseek)
-				{
-					/*if(decode_pos_ms<100)
-					{
-						//prevtime=(int)(decode_pos_ms - (mod.outMod->GetWrittenTime()-mod.outMod->GetOutputTime()));
-						//playtime=prevtime;
-					}
-					else*/
-						prevtime=(int)playtime;
-					didseek=false;
-				}
-				//if((soundFinalWave[soundBufferIndex-2] <=  0x200 || soundFinalWave[soundBufferIndex-2] >=  0xFE00) || 
-				  if ((soundFinalWave[soundBufferIndex-2] - prevsound[0]) <= 0x8 )
-					  //|| (prevsound[0] - soundFinalWave[soundBufferIndex-2]) <= 0x8)
-				{
-					silencedetected++;
-				//	if((silencedetected%0x100)==81)
-				//	DisplayError("Silence Detected count = %d",silencedetected);
-				}
-				else
-					silencedetected=0;
-				prevsound[0]=soundFinalWave[soundBufferIndex-2];
-				//if((soundFinalWave[soundBufferIndex-1] <=  0x200 || soundFinalWave[soundBufferIndex-1] >=  0xFE00) || 
-				  if ((soundFinalWave[soundBufferIndex-1] - prevsound[1]) <= 0x8 )
-		//		   (prevsound[1] - soundFinalWave[soundBufferIndex-1]) <= 0x8)
-					silencedetected++;
-				else
-					silencedetected=0;
-				prevsound[1]=soundFinalWave[soundBufferIndex-1];
-				//if(silencedetected>(silencelength*2*sndSamplesPerSec))
-				//if((silencedetected>0)&&((decode_pos_ms - (mod.outMod->GetWrittenTime()-mod.outMod->GetOutputTime())-prevtime) > (silencelength*1000)))
-				if((silencedetected>0)&&((playtime-prevtime) > ((silencelength*1000)+buffertime)))
-				{
-				//	DisplayError("%d %d %d", silencedetected,silencelength*2*sndSamplesPerSec,sndSamplesPerSec);
-					outputtimeread=0;
-					silencedetected=0;
-					end_of_track();
-					
-				}
+		}
+
+	}
+	//check for fade...
+	if ((decode_pos_ms  >= TrackLength-FadeLength) && !IgnoreTrackLength && !playforever)
+	{
+		//if (decode_pos_ms - (mod.outMod->GetWrittenTime()-mod.outMod->GetOutputTime()) < TrackLength)		//if we're in the fade zone
+		if(playtime < TrackLength)
+		{
+			((short *)soundFinalWave)[index-2] *= (float)(1-((decode_pos_ms-(TrackLength-FadeLength))/FadeLength));
+			((short *)soundFinalWave)[index-1] *= (float)(1-((decode_pos_ms-(TrackLength-FadeLength))/FadeLength));
+		}
+		else if(playtime < (TrackLength + TrailingSilence))
+		{
+			soundFinalWave[index-2] = 0;
+			soundFinalWave[index-1] = 0;
+		}
+		else
+		{
+			soundFinalWave[index-2] = 0;
+			soundFinalWave[index-1] = 0;
+			outputtimeread=0;
+			//DisplayError("playtime=%d, tracklength=%d, decode_pos_ms=%d\nGetOutputTime()=%d, GetWrittenTime=%d",(int)playtime,(int)TrackLength, (int)decode_pos_ms,mod.outMod->GetOutputTime(),mod.outMod->GetWrittenTime());
+			end_of_track();
+		}
+	}
 
-			}
-			//check for fade...
-			if ((decode_pos_ms  >= TrackLength-FadeLength) && !IgnoreTrackLength && !playforever)
-			{
-				//if (decode_pos_ms - (mod.outMod->GetWrittenTime()-mod.outMod->GetOutputTime()) < TrackLength)		//if we're in the fade zone
-				if(playtime < TrackLength)
-				{
-					((short *)soundFinalWave)[soundBufferIndex-2] *= (float)(1-((decode_pos_ms-(TrackLength-FadeLength))/FadeLength));
-					((short *)soundFinalWave)[soundBufferIndex-1] *= (float)(1-((decode_pos_ms-(TrackLength-FadeLength))/FadeLength));
-				}
-				else if(playtime < (TrackLength + TrailingSilence))
-				{
-					soundFinalWave[soundBufferIndex-2] = 0;
-					soundFinalWave[soundBufferIndex-1] = 0;
-				}
-				else
-				{
-					soundFinalWave[soundBufferIndex-2] = 0;
-					soundFinalWave[soundBufferIndex-1] = 0;
-					outputtimeread=0;
-					//DisplayError("playtime=%d, tracklength=%d, decode_pos_ms=%d\nGetOutputTime()=%d, GetWrittenTime=%d",(int)playtime,(int)TrackLength, (int)decode_pos_ms,mod.outMod->GetOutputTime(),mod.outMod->GetWrittenTime());
-					end_of_track();
-				}
-			}
-		
 //			printf("TS: %d\n", TrailingSilence);
 
-			
+	
 //#endif
-			} else {
-				soundFinalWave[soundBufferIndex++] = 0;
-				soundFinalWave[soundBufferIndex++] = 0;
-			}
-		  
-			soundIndex++;
-		    
-			if(2*soundBufferIndex >= soundBufferLen) 
-			{
-				if(systemSoundOn) 
-				{
-					if(soundPaused) {
-						soundResume();
-					}      
-		        
-					systemWriteDataToSoundBuffer();
-				}
-				soundIndex = 0;
-				soundBufferIndex = 0;
-			}
-		//	}
-		//}
+}
+
+// Renders count samples into the output buffer, which has at least as much
+// room left. 'done' is the number of pending samples rendered before them.
+static void soundRenderBlock(int done, int count)
+{
+	if(soundMasterOn && !stopState) 
+	{
+		int start = soundBufferIndex;
+
+		soundChannel1(count);
+		soundChannel2(count);
+		soundChannel3(count);
+		soundChannel4(count);
+		soundDirectSound(0, soundDSATimer, done, count);
+		soundDirectSound(1, soundDSBTimer, done, count);
+		if ((decode_pos_ms  < TrackLength) || IgnoreTrackLength || playforever)
+			soundMix(count);
+		else
+		{
+			memset(&soundFinalWave[soundBufferIndex], 0, count * 4);
+			soundBufferIndex += count * 2;
+		}
+
+		for(int i = 1; i <= count; i++)
+			soundTrackTick(start + i * 2);
+	} else {
+		soundDirectSoundReplay(0, done + count - 1);
+		soundDirectSoundReplay(1, done + count - 1);
+		memset(&soundFinalWave[soundBufferIndex], 0, count * 4);
+		soundBufferIndex += count * 2;
 	}
-//	/*
-	else
+
+	soundIndex += count;
+
+	if(2*soundBufferIndex >= soundBufferLen) 
 	{
-		//decode_pos_ms += (1. / 44100.) * (double)soundQuality; //0.02267276353518178520905584379325; //mathematically, i couldn't obtain this exact number.  Found it from testing.  This is an average, but really close.
-		decode_pos_ms += (1./44100.)*1000.;
-		didseek=true;
-		if (decode_pos_ms >= seek_needed)
-			seek_needed = -1;
+		if(systemSoundOn) 
+		{
+			if(soundPaused) {
+				soundResume();
+			}      
+        
+			systemWriteDataToSoundBuffer();
+		}
+		soundIndex = 0;
+		soundBufferIndex = 0;
+	}
+}
 
+void soundRender()
+{
+	int done = 0;
+
+	if(!soundPending)
+		return;
+
+	while(done < soundPending)
+	{
+		if (seek_needed == -1)		//if no seek is needed
+		{
+			// stop at the end of the output buffer
+			int count = (soundBufferLen - 2*soundBufferIndex + 3) / 4;
+			if(count > soundPending - done)
+				count = soundPending - done;
+			if(count < 1)
+				count = 1;
+			soundRenderBlock(done, count);
+			done += count;
+		}
+		else
+		{
+			soundDirectSoundReplay(0, done);
+			soundDirectSoundReplay(1, done);
+			//decode_pos_ms += (1. / 44100.) * (double)soundQuality; //0.02267276353518178520905584379325; //mathematically, i couldn't obtain this exact number.  Found it from testing.  This is an average, but really close.
+			decode_pos_ms += (1./44100.)*1000.;
+			didseek=true;
+			if (decode_pos_ms >= seek_needed)
+				seek_needed = -1;
+			done++;
+		}
 	}
-//	*/		
+
+	// what is left was taken after the last pending sample
+	for(int ch = 0; ch < 2; ch++)
+	{
+		soundDirectSoundReplay(ch, done);
+		soundDSQueueIndex[ch] = 0;
+		soundDSQueueCount[ch] = 0;
+	}
+	soundPending = 0;
+}
+
+void soundTick()
+{
+	soundPending++;
+
+	if(2*soundBufferIndex + 4*soundPending >= soundBufferLen)
+		soundRender();
 }
 #endif
 
@@ -1606,6 +1749,7 @@ void soundEnable(int channels)
 {
   int c = channels & 0x0f;
   
+  soundRender();
   soundEnableFlag |= ((channels & 0x30f) |c | (c << 4));
   if(ioMem)
     soundBalance = (ioMem[NR51] & soundEnableFlag);
@@ -1615,6 +1759,7 @@ void soundDisable(int channels)
 {
   int c = channels & 0x0f;
   
+  soundRender();
   soundEnableFlag &= (~((channels & 0x30f)|c|(c<<4)));
   if(ioMem)
     soundBalance = (ioMem[NR51] & soundEnableFlag);
@@ -1637,6 +1782,9 @@ void soundReset()
   soundMasterOn = 1;
   soundIndex = 0;
   soundBufferIndex = 0;
+  soundPending = 0;
+  soundDSQueueCount[0] = soundDSQueueCount[1] = 0;
+  soundDSQueueIndex[0] = soundDSQueueIndex[1] = 0;
   soundLevel1 = 7;
   soundLevel2 = 7;
   
@@ -1762,6 +1910,7 @@ void soundSetQuality(int quality)
 
 void soundSaveGame(gzFile gzFile)
 {
+  soundRender();
   utilWriteData(gzFile, soundSaveStruct);
   utilWriteData(gzFile, soundSaveStructV2);
   
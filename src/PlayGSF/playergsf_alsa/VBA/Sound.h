@@ -48,6 +48,7 @@
 #define FIFOB_H 0xa6
 
 extern void soundTick();
+extern void soundRender();
 extern void soundShutdown();
 extern bool soundInit();
 extern void soundPause();
@@ -69,6 +70,7 @@ extern "C"
 {
 extern int SOUND_CLOCK_TICKS;
 extern int soundTicks;
+extern int soundPending;
 extern int soundPaused;
 extern bool soundOffFlag;
 extern int soundQuality;
@@ -85,4 +87,13 @@ extern char soundReverse;
 
 }
 
+// Samples are rendered in blocks, some time after their tick. The mixer
+// updates NR52 and the channel 1 frequency, so catch up before the CPU
+// reads them.
+inline void soundReadEvent(u32 address)
+{
+  if(soundPending && (u32)((address & 0x3ff) - NR10) <= NR52 + 3 - NR10)
+    soundRender();
+}
+
 #endif // VBA_SOUND_H
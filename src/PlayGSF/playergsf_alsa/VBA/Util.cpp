@@ -20,6 +20,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <zlib.h>
+#include <sys/stat.h>
+#include <mutex>
 
 
 extern int loadedsize;
@@ -602,6 +604,7 @@ GSF_FILE decompressGSF(const char * file, int libnum=1)
     unsigned int ccrc;
     unsigned long decompsize=12;
 	unsigned int tmpval;
+	Byte *compbuf, *uncompbuf;
 	FILE *f;
 	memset(gsffile.psftag,0,sizeof(gsffile.psftag));
 	gsffile.program=NULL;
@@ -786,6 +789,293 @@ GSF_FILE decompressGSF(const char * file, int libnum=1)
 	return gsffile;
 }
 
+// Cache of decompressed GSF libraries. Every track of an album normally
+// shares one gsflib of several MB, so once it has been decompressed, starting
+// another track only decompresses that track's small program section. Entries
+// are checked against the library's size and modification time; the least
+// recently used is dropped when the cache is full. If a directory has been set
+// with utilSetGSFLibCacheDir(), decompressed images are also kept there for
+// later runs.
+#define GSFLIB_CACHE_ENTRIES 4
+#define GSFLIB_CACHE_MAX_BYTES (48*1024*1024)
+#define GSFLIB_CACHE_MAGIC 0x43465347 // "GSFC"
+#define GSFLIB_CACHE_VERSION 1
+
+struct GSFLIB_CACHE {
+	char path[260];
+	time_t mtime;
+	off_t filesize;
+	Byte *program;              // decompressed image, header included
+	unsigned int programsize;
+	char *psftag;
+	unsigned int lastused;
+};
+
+struct GSFLIB_CACHE_HEADER {
+	unsigned int magic;
+	unsigned int version;
+	long long mtime;
+	long long filesize;
+	unsigned int pathsize;
+	unsigned int tagsize;
+	unsigned int programsize;
+};
+
+static GSFLIB_CACHE gsflibCache[GSFLIB_CACHE_ENTRIES];
+static unsigned int gsflibCacheClock;
+
+// Held while loading, so libraries can be prefetched from another thread
+static std::mutex gsflibMutex;
+
+// Only read or written with gsflibMutex held
+static char gsflibCacheDir[260];
+
+// Size of decompressed program, including its 12-byte header
+static unsigned int gsfProgramSize(const Byte *program)
+{
+	unsigned int size;
+	copy_int(&size, (unsigned char *) program + 8);
+	return size + 12;
+}
+
+static void gsflibCacheFree(GSFLIB_CACHE *entry)
+{
+	free(entry->program);
+	free(entry->psftag);
+	memset(entry, 0, sizeof(*entry));
+}
+
+static void gsflibCacheStore(const char *path, const struct stat *st,
+                             const Byte *program, unsigned int programsize, const char *psftag)
+{
+	int i;
+	if(strlen(path) >= sizeof(gsflibCache[0].path) || programsize > GSFLIB_CACHE_MAX_BYTES)
+		return;
+
+	unsigned int total = programsize;
+	GSFLIB_CACHE *entry = NULL;
+	for(i = 0; i < GSFLIB_CACHE_ENTRIES; i++) {
+		if(gsflibCache[i].program && !strcmp(gsflibCache[i].path, path))
+			gsflibCacheFree(&gsflibCache[i]);
+		total += gsflibCache[i].programsize;
+	}
+
+	// Drop least recently used until new entry fits
+	for(;;) {
+		GSFLIB_CACHE *oldest = NULL;
+		entry = NULL;
+		for(i = 0; i < GSFLIB_CACHE_ENTRIES; i++) {
+			if(!gsflibCache[i].program) {
+				if(!entry)
+					entry = &gsflibCache[i];
+			} else if(!oldest || gsflibCache[i].lastused < oldest->lastused) {
+				oldest = &gsflibCache[i];
+			}
+		}
+		if(entry && total <= GSFLIB_CACHE_MAX_BYTES)
+			break;
+		total -= oldest->programsize;
+		gsflibCacheFree(oldest);
+	}
+
+	entry->program = (Byte*) malloc(programsize);
+	entry->psftag = strdup(psftag);
+	if(!entry->program || !entry->psftag) {
+		gsflibCacheFree(entry);
+		return;
+	}
+	memcpy(entry->program, program, programsize);
+	strcpy(entry->path, path);
+	entry->mtime = st->st_mtime;
+	entry->filesize = st->st_size;
+	entry->programsize = programsize;
+	entry->lastused = ++gsflibCacheClock;
+}
+
+// Fill gsffile with a copy of cached library, since caller modifies and frees it
+static bool gsflibFromCache(GSF_FILE *gsffile, const Byte *program, unsigned int programsize,
+                            const char *psftag)
+{
+	gsffile->program = (Byte*) malloc(programsize);
+	if(gsffile->program == NULL)
+		return false;
+	memcpy(gsffile->program, program, programsize);
+	gsffile->reserved = NULL;
+	memset(gsffile->psftag, 0, sizeof(gsffile->psftag));
+	strncpy(gsffile->psftag, psftag, sizeof(gsffile->psftag) - 1);
+	memset(gsffile->libname, 0, sizeof(gsffile->libname));
+	gsffile->gsfloaded = true;
+	return true;
+}
+
+#ifdef LINUX
+static void gsflibDiskCacheName(const char *path, char *buffer)
+{
+	unsigned long crc = crc32(crc32(0L, Z_NULL, 0), (const Bytef*) path, strlen(path));
+	sprintf(buffer, "%s/%08lx.gsflib", gsflibCacheDir, crc);
+}
+
+static bool gsflibDiskCacheRead(const char *path, const struct stat *st, GSF_FILE *gsffile)
+{
+	char name[300], cachedpath[260];
+	GSFLIB_CACHE_HEADER header;
+	bool ok = false;
+	char *psftag = NULL;
+	Byte *program = NULL;
+
+	gsflibDiskCacheName(path, name);
+	FILE *f = fopen(name, "rb");
+	if(f == NULL)
+		return false;
+
+	if(fread(&header, sizeof(header), 1, f) == 1 &&
+	   header.magic == GSFLIB_CACHE_MAGIC && header.version == GSFLIB_CACHE_VERSION &&
+	   header.mtime == (long long) st->st_mtime && header.filesize == (long long) st->st_size &&
+	   header.pathsize < sizeof(cachedpath) && header.tagsize < sizeof(gsffile->psftag) &&
+	   header.programsize >= 12 && header.programsize <= 0x2000000 + 12 &&
+	   fread(cachedpath, 1, header.pathsize, f) == header.pathsize) {
+		cachedpath[header.pathsize] = 0;
+		psftag = (char*) malloc(header.tagsize + 1);
+		program = (Byte*) malloc(header.programsize);
+		if(!strcmp(cachedpath, path) && psftag && program &&
+		   fread(psftag, 1, header.tagsize, f) == header.tagsize &&
+		   fread(program, 1, header.programsize, f) == header.programsize &&
+		   gsfProgramSize(program) == header.programsize) {
+			psftag[header.tagsize] = 0;
+			gsflibCacheStore(path, st, program, header.programsize, psftag);
+			gsffile->program = program;
+			program = NULL;
+			gsffile->reserved = NULL;
+			memset(gsffile->psftag, 0, sizeof(gsffile->psftag));
+			memcpy(gsffile->psftag, psftag, header.tagsize);
+			memset(gsffile->libname, 0, sizeof(gsffile->libname));
+			gsffile->gsfloaded = true;
+			ok = true;
+		}
+	}
+	fclose(f);
+	free(psftag);
+	free(program);
+	return ok;
+}
+
+static void gsflibDiskCacheWrite(const char *path, const struct stat *st, const GSF_FILE *gsffile)
+{
+	char name[300], tempname[310];
+	GSFLIB_CACHE_HEADER header;
+
+	mkdir(gsflibCacheDir, 0755);
+	gsflibDiskCacheName(path, name);
+	sprintf(tempname, "%s.tmp", name);
+
+	header.magic = GSFLIB_CACHE_MAGIC;
+	header.version = GSFLIB_CACHE_VERSION;
+	header.mtime = st->st_mtime;
+	header.filesize = st->st_size;
+	header.pathsize = strlen(path);
+	header.tagsize = strlen(gsffile->psftag);
+	header.programsize = gsfProgramSize(gsffile->program);
+
+	FILE *f = fopen(tempname, "wb");
+	if(f == NULL)
+		return;
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+	          fwrite(path, 1, header.pathsize, f) == header.pathsize &&
+	          fwrite(gsffile->psftag, 1, header.tagsize, f) == header.tagsize &&
+	          fwrite(gsffile->program, 1, header.programsize, f) == header.programsize;
+	if(fclose(f) != 0)
+		ok = false;
+	if(!ok || rename(tempname, name) != 0)
+		remove(tempname);
+}
+#endif
+
+static GSFLIB_CACHE *gsflibCacheFind(const char *file, const struct stat *st)
+{
+	for(int i = 0; i < GSFLIB_CACHE_ENTRIES; i++) {
+		GSFLIB_CACHE *entry = &gsflibCache[i];
+		if(entry->program && !strcmp(entry->path, file) &&
+		   entry->mtime == st->st_mtime && entry->filesize == st->st_size) {
+			entry->lastused = ++gsflibCacheClock;
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+// Same as decompressGSF(), for libraries, using cache
+static GSF_FILE decompressGSFLib(const char * file, int libnum)
+{
+	GSF_FILE gsffile;
+	struct stat st;
+
+	if(stat(file, &st) != 0)
+		return decompressGSF(file, libnum);
+
+	GSFLIB_CACHE *entry = gsflibCacheFind(file, &st);
+	if(entry && gsflibFromCache(&gsffile, entry->program, entry->programsize, entry->psftag))
+		return gsffile;
+
+#ifdef LINUX
+	if(gsflibCacheDir[0] && gsflibDiskCacheRead(file, &st, &gsffile))
+		return gsffile;
+#endif
+
+	gsffile = decompressGSF(file, libnum);
+	if(gsffile.gsfloaded && gsffile.program) {
+		gsflibCacheStore(file, &st, gsffile.program, gsfProgramSize(gsffile.program), gsffile.psftag);
+#ifdef LINUX
+		if(gsflibCacheDir[0])
+			gsflibDiskCacheWrite(file, &st, &gsffile);
+#endif
+	}
+	return gsffile;
+}
+
+void utilSetGSFLibCacheDir(const char *dir)
+{
+	std::lock_guard<std::mutex> lock(gsflibMutex);
+	snprintf(gsflibCacheDir, sizeof(gsflibCacheDir), "%s", dir ? dir : "");
+}
+
+void utilClearGSFLibCache()
+{
+	std::lock_guard<std::mutex> lock(gsflibMutex);
+	for(int i = 0; i < GSFLIB_CACHE_ENTRIES; i++)
+		gsflibCacheFree(&gsflibCache[i]);
+}
+
+void utilPrefetchGSFLib(const char *file)
+{
+	char libtag[0x40], tempname[260], filename[260 + 0x40];
+	struct stat st;
+
+	char *tag = (char*) malloc(50001);
+	if(tag == NULL)
+		return;
+	int found = !psftag_readfromfile(tag, file) &&
+	            !psftag_getvar(tag, "_lib", libtag, sizeof(libtag) - 1) && strlen(libtag);
+	free(tag);
+	if(!found)
+		return;
+
+	utilGetBasePath(file, tempname);
+#ifdef LINUX
+	sprintf(filename, "%s/%s", tempname, libtag);
+#else
+	sprintf(filename, "%s\\%s", tempname, libtag);
+#endif
+	if(stat(filename, &st) != 0)
+		return;
+
+	std::lock_guard<std::mutex> lock(gsflibMutex);
+	if(gsflibCacheFind(filename, &st))
+		return;
+	GSF_FILE lib = decompressGSFLib(filename, 2);
+	free(lib.program);
+	free(lib.reserved);
+}
+
 #define MAX_GSFLIB 11
 
 bool utildecompGSF(const char * file)
@@ -797,6 +1087,7 @@ bool utildecompGSF(const char * file)
 
     int i;
     GSF_FILE gsffile, gsflib[MAX_GSFLIB];
+    std::lock_guard<std::mutex> lock(gsflibMutex);
 
     TrackLength = 0;
     FadeLength = 0;
@@ -823,14 +1114,14 @@ bool utildecompGSF(const char * file)
 
         if (access(filename, R_OK) != 0) {
             fprintf(stderr, "Library file not found: %s\n", filename);
-            free(uncompbuf);
+            free(gsffile.program);
             return false;
         }
 
-        gsflib[1] = decompressGSF(filename, 2);
+        gsflib[1] = decompressGSFLib(filename, 2);
         if (!gsflib[1].gsfloaded) {
             printf("Failed to load library: %s\n", filename);
-            free(uncompbuf);
+            free(gsffile.program);
             return false;
         }
 
@@ -865,7 +1156,7 @@ bool utildecompGSF(const char * file)
                         return false;
                     }
 
-                    gsflib[i] = decompressGSF(filename, i + 1);
+                    gsflib[i] = decompressGSFLib(filename, i + 1);
                     if (!gsflib[i].gsfloaded) {
                         free(uncompbuf);
                         return false;
@@ -63,4 +63,12 @@ extern int utilGzRead(gzFile file, voidp buffer, unsigned int len);
 extern int utilGzClose(gzFile file);
 extern long utilGzMemTell(gzFile file);
 extern void utilGBAFindSave(const u8 *, const int);
+
+// Set directory for on-disk cache of decompressed GSF libraries, empty or NULL
+// for none. Can be called from any thread.
+extern void utilSetGSFLibCacheDir(const char *dir);
+extern void utilClearGSFLibCache();
+// Decompress library used by GSF file into cache, so it starts quickly later.
+// Can be called from any thread.
+extern void utilPrefetchGSFLib(const char *file);
 #endif
@@ -871,11 +871,14 @@ void BIOS_RegisterRamReset(u32 flags)
     if(flags & 0x01) {
       // clear work RAM
       memset(workRAM, 0, 0x40000);
+      cpuCacheFlush();
     }
     if(flags & 0x02) {
       // clear internal RAM
       memset(internalRAM, 0, 0x7e00); // don't clear 0x7e00-0x7fff
+      cpuCacheFlush();
     }
+#ifndef SOUND_ONLY
     if(flags & 0x04) {
       // clear palette RAM
       memset(paletteRAM, 0, 0x400);
@@ -888,6 +891,7 @@ void BIOS_RegisterRamReset(u32 flags)
       // clean OAM
       memset(oam, 0, 0x400);
     }
+#endif
 
     if(flags & 0x80) {
       int i;
@@ -1091,6 +1095,7 @@ void BIOS_SoftReset()
   u8 b = internalRAM[0x7ffa];
 
   memset(&internalRAM[0x7e00], 0, 0x200);
+  cpuCacheFlush();
 
   if(b) {
     armNextPC = 0x02000000;
@@ -1,4 +1,11 @@
 #include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
 
 #include "libresample.h"
 
@@ -135,26 +142,20 @@ void init_fir_table()
 	}
 }
 
+// Keeps a second copy of every sample buffer_size further on, so that the
+// buffered samples are always contiguous from data()
+
 template <class T, unsigned buffer_size>
 class sample_buffer
 {
 	unsigned ptr, filled;
-	T * buffer;
+	T buffer[buffer_size * 2];
 
 public:
-	sample_buffer() : ptr(0), filled(0), buffer(0) {}
-	~sample_buffer()
-	{
-		if (buffer) delete [] buffer;
-	}
+	sample_buffer() : ptr(0), filled(0) {}
 
 	void clear()
 	{
-		if (buffer)
-		{
-			delete [] buffer;
-			buffer = 0;
-		}
 		ptr = filled = 0;
 	}
 
@@ -163,51 +164,75 @@ public:
 		return filled;
 	}
 
-	void push_back(T sample)
+	inline void push_back(T sample)
 	{
-		if (!buffer) buffer = new T[buffer_size];
 		buffer[ptr] = sample;
+		buffer[ptr + buffer_size] = sample;
 		if (++ptr >= buffer_size) ptr = 0;
 		if (filled < buffer_size) filled++;
 	}
 
-	void erase(unsigned count)
+	inline void erase(unsigned count)
 	{
 		if (count > filled) filled = 0;
 		else filled -= count;
 	}
 
-	T operator[] (int index) const
+	// oldest sample first
+	inline const T * data() const
 	{
-		index += (int)(ptr - filled);
+		int index = (int)(ptr - filled);
 		if (index < 0) index += (int)buffer_size;
-		else if (index >= (int)buffer_size) index -= (int)buffer_size;
-		return buffer[index];
+		return &buffer[index];
+	}
+
+	inline T operator[] (int index) const
+	{
+		return data()[index];
+	}
+};
+
+// Filters that work out one output sample at a time share this loop, which
+// calls their pop() directly
+
+template <class T>
+class foo_block
+{
+public:
+	void render(u16 * out, int count, double rate)
+	{
+		T * filter = static_cast<T *>(this);
+		for (int i = 0; i < count; i++)
+		{
+			out[i] = filter->pop(rate);
+		}
 	}
 };
 
-class foo_null : public foo_interpolate
+class foo_null : public foo_block<foo_null>
 {
 	int sample;
 
 public:
 	foo_null() : sample(0) {}
-	~foo_null() {}
 
-	void reset() {}
+	void reset()
+	{
+		sample = 0;
+	}
 
 	void push(int psample)
 	{
 		sample = psample;
 	}
 
-	int pop(double rate)
+	inline int pop(double rate)
 	{
 		return sample;
 	}
 };
 
-class foo_linear : public foo_interpolate
+class foo_linear : public foo_block<foo_linear>
 {
 	sample_buffer<int,4> samples;
 
@@ -224,8 +249,6 @@ public:
 		position = 0;
 	}
 
-	~foo_linear() {}
-
 	void reset()
 	{
 		position = 0;
@@ -237,7 +260,7 @@ public:
 		samples.push_back(sample);
 	}
 
-	int pop(double rate)
+	inline int pop(double rate)
 	{
 		int ret;
 		unsigned lrate;
@@ -271,7 +294,7 @@ public:
 // and this integer cubic interpolation implementation was kind of borrowed from either TiMidity
 // or the P.E.Op.S. SPU project, or is in use in both, or something...
 
-class foo_cubic : public foo_interpolate
+class foo_cubic : public foo_block<foo_cubic>
 {
 	sample_buffer<int,12> samples;
 
@@ -288,8 +311,6 @@ public:
 		position = 0;
 	}
 
-	~foo_cubic() {}
-
 	void reset()
 	{
 		position = 0;
@@ -301,7 +322,7 @@ public:
 		samples.push_back(sample);
 	}
 
-	int pop(double rate)
+	inline int pop(double rate)
 	{
 		int ret;
 		unsigned lrate;
@@ -342,16 +363,38 @@ public:
 	}
 };
 
-class foo_fir : public foo_interpolate
+// 8 tap dot product of samples and a row of fir_lut. Direct Sound samples
+// are 8 bit shifted up, so they fit the 16 bit multiplies.
+static inline int fir_dot(const short * s, const short * k)
 {
-	sample_buffer<int,24> samples;
-
-	unsigned position;
-
-	inline int smp(int index)
+#if defined(__SSE2__)
+	__m128i sum = _mm_madd_epi16(_mm_loadu_si128((const __m128i *)s),
+	                             _mm_loadu_si128((const __m128i *)k));
+	sum = _mm_add_epi32(sum, _mm_unpackhi_epi64(sum, sum));
+	sum = _mm_add_epi32(sum, _mm_srli_si128(sum, 4));
+	return _mm_cvtsi128_si32(sum);
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	int16x8_t a = vld1q_s16(s);
+	int16x8_t b = vld1q_s16(k);
+	int32x4_t sum = vmull_s16(vget_low_s16(a), vget_low_s16(b));
+	sum = vmlal_s16(sum, vget_high_s16(a), vget_high_s16(b));
+	int32x2_t half = vadd_s32(vget_low_s32(sum), vget_high_s32(sum));
+	return vget_lane_s32(vpadd_s32(half, half), 0);
+#else
+	int ret = 0;
+	for (int i = 0; i < 8; i++)
 	{
-		return samples[index];
+		ret += s[i] * k[i];
 	}
+	return ret;
+#endif
+}
+
+class foo_fir : public foo_block<foo_fir>
+{
+	sample_buffer<short,24> samples;
+
+	unsigned position;
 
 public:
 	foo_fir()
@@ -359,8 +402,6 @@ public:
 		position = 0;
 	}
 
-	~foo_fir() {}
-
 	void reset()
 	{
 		position = 0;
@@ -372,7 +413,7 @@ public:
 		samples.push_back(sample);
 	}
 
-	int pop(double rate)
+	inline int pop(double rate)
 	{
 		int ret;
 		unsigned lrate;
@@ -386,14 +427,7 @@ public:
 
 		if (samples.size() < 8) return 0;
 
-		ret  = smp(0) * fir_lut[(position & ~7)    ];
-		ret += smp(1) * fir_lut[(position & ~7) + 1];
-		ret += smp(2) * fir_lut[(position & ~7) + 2];
-		ret += smp(3) * fir_lut[(position & ~7) + 3];
-		ret += smp(4) * fir_lut[(position & ~7) + 4];
-		ret += smp(5) * fir_lut[(position & ~7) + 5];
-		ret += smp(6) * fir_lut[(position & ~7) + 6];
-		ret += smp(7) * fir_lut[(position & ~7) + 7];
+		ret = fir_dot(samples.data(), &fir_lut[position & ~7]);
 		ret >>= WFIR_QUANTBITS;
 
 		if (ret > 32767) ret = 32767;
@@ -412,7 +446,10 @@ public:
 	}
 };
 
-class foo_libresample : public foo_interpolate
+// libresample keeps its own input and output buffers, so a whole block is
+// asked for in one call instead of one sample at a time
+
+class foo_libresample
 {
 	sample_buffer<float,32> samples;
 
@@ -444,63 +481,67 @@ public:
 		samples.push_back(float(sample));
 	}
 
-	int pop(double rate)
+	void render(u16 * out, int count, double rate)
 	{
-		int ret;
+		float buffer[256];
+		int done = 0;
 
 		if (!resampler)
 		{
 			resampler = resample_open(0, .25, 44100. / 4000.);
 		}
 
+		while (done < count)
 		{
-			int count = samples.size();
-			float in[32];
-			float out;
+			int wanted = count - done;
 			int used, returned;
 
-			for (used = 0; used < count; used++)
-			{
-				in[used] = samples[used];
-			}
+			if (wanted > 256) wanted = 256;
 
-			returned = resample_process(resampler, 1. / rate, in, count, 0, &used, &out, 1);
+			returned = resample_process(resampler, 1. / rate, (float *)samples.data(), samples.size(), 0, &used, buffer, wanted);
 
 			if (used)
 			{
 				samples.erase(used);
 			}
 
-			if (returned < 1) return 0;
+			// short only once the input has run out
+			for (int i = 0; i < returned; i++)
+			{
+				int ret = (int)buffer[i];
 
-			ret = (int)out;
-		}
+				if (ret > 32767) ret = 32767;
+				else if (ret < -32768) ret = -32768;
 
-		if (ret > 32767) ret = 32767;
-		else if (ret < -32768) ret = -32768;
+				out[done++] = ret;
+			}
 
-		return ret;
+			if (returned < wanted) break;
+		}
+
+		for (; done < count; done++)
+		{
+			out[done] = 0;
+		}
 	}
 };
 
-foo_interpolate * get_filter(int which)
+// and here is the implementation specific code, in a messier state than the stuff above
+
+struct interp_channel
 {
-	switch (which)
-	{
-	default:
-		return new foo_null;
-	case 1:
-		return new foo_linear;
-	case 2:
-		return new foo_cubic;
-	case 3:
-		return new foo_fir;
-	case 4:
-		return new foo_libresample;
-	}
-}
+	foo_null null;
+	foo_linear linear;
+	foo_cubic cubic;
+	foo_fir fir;
+	foo_libresample libresample;
+};
 
-// and here is the implementation specific code, in a messier state than the stuff above
+static interp_channel interp[2];
+
+static int interpolation = 0;
+
+static bool fir_ready = false;
 
 #endif
 
@@ -525,23 +566,10 @@ double calc_rate(int timer)
 	}
 }
 
-#ifndef NO_INTERPOLATION
-
-static foo_interpolate * interp[2];
-
-static int interpolation = 0;
-
-#endif
-
 void interp_setup(int which)
 {
 #ifndef NO_INTERPOLATION
-	init_fir_table();
-	for (int i = 0; i < 2; i++)
-	{
-		interp[i] = get_filter(which);
-	}
-	interpolation = which;
+	interp_switch(which);
 #endif
 }
 
@@ -550,7 +578,7 @@ void interp_cleanup()
 #ifndef NO_INTERPOLATION
 	for (int i = 0; i < 2; i++)
 	{
-		delete interp[i];
+		interp[i].libresample.reset();
 	}
 #endif
 }
@@ -558,10 +586,19 @@ void interp_cleanup()
 void interp_switch(int which)
 {
 #ifndef NO_INTERPOLATION
+	if (which == 3 && !fir_ready)
+	{
+		init_fir_table();
+		fir_ready = true;
+	}
+
 	for (int i = 0; i < 2; i++)
 	{
-		delete interp[i];
-		interp[i] = get_filter(which);
+		interp[i].null.reset();
+		interp[i].linear.reset();
+		interp[i].cubic.reset();
+		interp[i].fir.reset();
+		interp[i].libresample.reset();
 	}
 
 	interpolation = which;
@@ -573,7 +610,24 @@ void interp_reset(int ch)
 #ifndef NO_INTERPOLATION
 	if (soundInterpolation != interpolation) interp_switch(soundInterpolation);
 
-	interp[ch]->reset();
+	switch (interpolation)
+	{
+	default:
+		interp[ch].null.reset();
+		break;
+	case 1:
+		interp[ch].linear.reset();
+		break;
+	case 2:
+		interp[ch].cubic.reset();
+		break;
+	case 3:
+		interp[ch].fir.reset();
+		break;
+	case 4:
+		interp[ch].libresample.reset();
+		break;
+	}
 #endif
 }
 
@@ -582,15 +636,49 @@ void interp_push(int ch, int sample)
 #ifndef NO_INTERPOLATION
 	if (soundInterpolation != interpolation) interp_switch(soundInterpolation);
 
-	interp[ch]->push(sample);
+	switch (interpolation)
+	{
+	default:
+		interp[ch].null.push(sample);
+		break;
+	case 1:
+		interp[ch].linear.push(sample);
+		break;
+	case 2:
+		interp[ch].cubic.push(sample);
+		break;
+	case 3:
+		interp[ch].fir.push(sample);
+		break;
+	case 4:
+		interp[ch].libresample.push(sample);
+		break;
+	}
 #endif
 }
 
-int interp_pop(int ch, double rate)
+void interp_render(int ch, u16 * out, int count, double rate)
 {
 #ifndef NO_INTERPOLATION
-	return interp[ch]->pop(rate);
+	switch (interpolation)
+	{
+	default:
+		interp[ch].null.render(out, count, rate);
+		break;
+	case 1:
+		interp[ch].linear.render(out, count, rate);
+		break;
+	case 2:
+		interp[ch].cubic.render(out, count, rate);
+		break;
+	case 3:
+		interp[ch].fir.render(out, count, rate);
+		break;
+	case 4:
+		interp[ch].libresample.render(out, count, rate);
+		break;
+	}
 #else
-	return 0;
+	memset(out, 0, count * sizeof(u16));
 #endif
 }
@@ -1,24 +1,11 @@
 #ifndef __SND_INTERP_H__
 #define __SND_INTERP_H__
 
-// simple interface that could easily be recycled
-
-class foo_interpolate
-{
-public:
-	foo_interpolate() {}
-	virtual ~foo_interpolate() {};
-
-	virtual void reset() = 0;
-
-	virtual void push(int sample) = 0;
-	virtual int pop(double rate) = 0;
-};
-
-foo_interpolate * get_filter(int which);
-
-
-// complicated, synced interface, specific to this implementation
+// Direct Sound resampling. The interpolation is picked once per block, so
+// each filter runs its samples in a loop of its own rather than through a
+// virtual call per output sample.
+//
+// 0: none, 1: linear, 2: cubic, 3: 8 tap FIR, 4: libresample
 
 double calc_rate(int timer);
 
@@ -31,7 +18,9 @@ void interp_switch(int which);
 
 void interp_reset(int ch);
 void interp_push(int ch, int sample);
-int interp_pop(int ch, double rate);
 
-#endif
+// Renders count output samples of channel ch, with no samples pushed in
+// between, rate being input samples per output sample
+void interp_render(int ch, u16 *out, int count, double rate);
 
+#endif
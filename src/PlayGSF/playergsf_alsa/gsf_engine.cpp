@@ -0,0 +1,796 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include <algorithm>
+#include <alsa/asoundlib.h>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <string>
+#include <math.h>
+
+#include "types.h"
+#include "gsf_engine.h"
+#include "Output_Filter.h"
+
+extern "C" {
+#include "VBA/psftag.h"
+#include "gsf.h"
+}
+
+extern "C" {
+int defvolume=1000;
+int relvolume=1000;
+int TrackLength=0;
+int FadeLength=0;
+int IgnoreTrackLength, DefaultLength=150000;
+int playforever=0;
+int TrailingSilence=1000;
+int DetectSilence=1, silencedetected=0, silencelength=5;
+}
+int cpupercent=0, sndSamplesPerSec, sndNumChannels;
+int sndBitsPerSample=16;
+int bass_boost_enabled = 0;
+
+int deflen=120,deffade=10;
+#define W GSF_SCOPE_WIDTH
+int draw_buf[2][6][2*W];
+int n_old[2][6];
+// Draw buf starts full, all samples are 0
+int last[2][6] = {
+	{2*W, 2*W, 2*W, 2*W, 2*W, 2*W},
+	{2*W, 2*W, 2*W, 2*W, 2*W, 2*W},
+};
+
+// Fade and bass boost, applied as sound is gathered into a period
+static Output_Filter output_filter;
+
+int curr_buf;
+std::mutex bufmtx;
+
+// Oscilloscope tap: every how many samples one is drawn, 0 when nobody is
+// watching and writeSound() skips the draw buffers altogether
+static int scope_step;
+
+extern unsigned short soundFinalWave[1470];
+extern int soundBufferLen;
+extern int soundIndex;
+extern int8_t soundBuffer[4][735];
+extern uint8_t *ioMem;
+#ifdef NO_INTERPOLATION
+int16_t directBuffer[2][735];
+#else
+extern int16_t directBuffer[2][735];
+#endif
+extern int soundLevel1;
+extern int enableDS;
+
+// Sound.cpp state used to time silence detection and fades
+extern int didseek;
+extern double playtime;
+
+double decode_pos_ms; // current decoding position, in milliseconds
+int seek_needed = -1; // if != -1, it is the point that the decode thread should seek to, in ms.
+
+static int g_playing = 0;
+
+static snd_pcm_t *pcm_handle;
+static snd_pcm_uframes_t frames;        // period size
+static snd_pcm_uframes_t pcm_buffer_frames;
+static int pcm_rate;
+static int pcm_can_pause;
+static int pcm_mmap;                    // written through mmap, not writei
+
+// Sound waiting to go to device, which is written a whole period at a time
+static short *period_buf;
+static snd_pcm_uframes_t period_fill;
+
+// Times device ran dry or was suspended, and had to be restarted
+static unsigned pcm_xruns;
+
+// Position of sound now coming out of device, updated by writeSound()
+static int heard_pos_ms;
+
+// Engine thread and the commands posted to it. Everything below is protected
+// by cmd_mutex.
+static std::thread engine_thread;
+static std::mutex cmd_mutex;
+static std::condition_variable cmd_cond;
+static bool cmd_quit;
+static bool cmd_load;
+static bool cmd_stop;
+static int cmd_pause = -1;
+static int cmd_seek = -1;
+static int cmd_bass = -1;
+static int cmd_scope = -1;
+static bool cmd_next;
+static std::string cmd_path;
+static std::string cmd_queue;   // track to follow current one, or empty
+static struct gsf_engine_status status;
+
+// Queued track started after the previous one without emptying device, and
+// isn't heard yet. Its status is reported once it is.
+static bool switch_pending;
+static struct gsf_engine_status pending_status;
+
+// Decompresses library of queued track while current one plays
+static std::thread prefetch_thread;
+
+extern "C" int LengthFromString(const char * timestring);
+extern void utilSetGSFLibCacheDir(const char *dir);
+extern void utilClearGSFLibCache();
+extern void utilPrefetchGSFLib(const char *file);
+
+extern "C" void end_of_track()
+{
+	g_playing = 0;
+}
+
+// Declaración global para conservar el estado del filtro
+static float prev_filtered[2][6][2*W] = {{{0}}}; // Buffer para almacenar muestras filtradas previas
+
+// Append every step-th sample of data to draw buffer c of channel, starting
+// it at a rising zero crossing so the waveform holds still on screen
+template<typename T>
+void updateBuf(int c, int ch, float m, T *data, int datalen, int step) {
+    int zeroCrossing = -1;
+    int min = *std::min_element(draw_buf[c][ch], draw_buf[c][ch] + W);
+    int max = *std::max_element(draw_buf[c][ch], draw_buf[c][ch] + W);
+    int th = (max + min) / 2;
+
+    datalen = (datalen + step - 1) / step;
+    int min_need = W - datalen;
+    int search_head = last[c][ch] - min_need;
+
+    // Buscar cruce por cero para sincronizar el buffer
+    for (int i = search_head; i >= 1; i--) {
+        if (draw_buf[c][ch][i - 1] >= th && draw_buf[c][ch][i] < th) {
+            zeroCrossing = i;
+            break;
+        }
+    }
+
+    if (zeroCrossing < n_old[c][ch])
+        zeroCrossing = search_head;
+
+    n_old[!c][ch] = last[c][ch] - zeroCrossing;
+    memcpy(draw_buf[!c][ch], draw_buf[c][ch] + zeroCrossing, sizeof(int) * n_old[!c][ch]);
+
+    const float alpha = 0.1f; // Factor de suavizado para el filtro paso bajo
+
+    // Aplicar filtro paso bajo exponencial (media móvil ponderada)
+    for (int i = 0; i < datalen; i++) {
+        float raw_sample = data[i * step] * m;
+        float filtered_sample;
+        if (i == 0)
+            filtered_sample = alpha * raw_sample + (1.0f - alpha) * prev_filtered[c][ch][n_old[!c][ch] - 1];
+        else
+            filtered_sample = alpha * raw_sample + (1.0f - alpha) * prev_filtered[c][ch][n_old[!c][ch] + i - 1];
+
+        prev_filtered[c][ch][n_old[!c][ch] + i] = filtered_sample;
+        draw_buf[!c][ch][n_old[!c][ch] + i] = static_cast<int>(filtered_sample);
+    }
+
+    last[!c][ch] = n_old[!c][ch] + datalen;
+    assert(last[!c][ch] >= W);
+}
+
+// Clear draw buffers and start drawing every step-th sample, or stop if 0
+static void scope_setup(int step)
+{
+    std::lock_guard<std::mutex> lock(bufmtx);
+    memset(draw_buf, 0, sizeof(draw_buf));
+    memset(prev_filtered, 0, sizeof(prev_filtered));
+    memset(n_old, 0, sizeof(n_old));
+    for (int c = 0; c < 2; c++)
+        for (int ch = 0; ch < 6; ch++)
+            last[c][ch] = 2*W;
+    scope_step = step;
+}
+
+// Feed oscilloscope from sound just rendered, if it is on
+static void scope_update(void)
+{
+    if (!scope_step)
+        return;
+
+    int ratio = ioMem[0x82] & 3;
+    int dsaRatio = ioMem[0x82] & 4;
+    int dsbRatio = ioMem[0x82] & 8;
+    float m = soundLevel1;
+
+    switch(ratio) {
+        case 0:
+        case 3:
+            m /= 4.0;
+            break;
+        case 1:
+            m /= 2.0;
+            break;
+        case 2:
+            break;
+    }
+
+    for (int i = 0; i < 4; i++)
+        updateBuf(curr_buf, i, m, soundBuffer[i], soundIndex, scope_step);
+
+    if (!dsaRatio) m = 0.5; else m = 1;
+    m = m / float(soundLevel1) / 52.0;
+    updateBuf(curr_buf, 4, m, directBuffer[0], soundIndex, scope_step);
+
+    if (!dsbRatio) m = 0.5; else m = 1;
+    m = m / float(soundLevel1) / 52.0;
+    updateBuf(curr_buf, 5, m, directBuffer[1], soundIndex, scope_step);
+
+    bufmtx.lock();
+    curr_buf = !curr_buf;
+    bufmtx.unlock();
+}
+// Set up bass boost for current sample rate, as a low shelf that clips
+// like the float one it replaced
+static void output_filter_setup(void)
+{
+    output_filter.clear_eq();
+    if (bass_boost_enabled && sndSamplesPerSec)
+        output_filter.add_low_shelf(sndSamplesPerSec, 250.0, 5.0, 0.707);
+}
+
+// Get device going again after an underrun or suspend. Returns 0 once it can
+// take more sound.
+static int recover_device(int err)
+{
+	if (err == -EPIPE || err == -ESTRPIPE)
+		pcm_xruns++;
+	err = snd_pcm_recover(pcm_handle, err, 1);
+	if (err < 0)
+		fprintf(stderr, "Error recovering PCM device: %s\n", snd_strerror(err));
+	return err;
+}
+
+// Write frames to device, waiting for room. Through mmap, sound is copied
+// straight into device buffer, which is started once it is full.
+static void write_frames(const short *buf, snd_pcm_uframes_t n)
+{
+	while (n > 0) {
+		if (!pcm_mmap) {
+			snd_pcm_sframes_t written = snd_pcm_writei(pcm_handle, buf, n);
+			if (written < 0) {
+				if (recover_device(written) < 0)
+					return;
+				continue;
+			}
+			buf += written * sndNumChannels;
+			n -= written;
+			continue;
+		}
+
+		snd_pcm_sframes_t avail = snd_pcm_avail_update(pcm_handle);
+		if (avail < 0) {
+			if (recover_device(avail) < 0)
+				return;
+			continue;
+		}
+		if ((snd_pcm_uframes_t)avail < std::min(n, frames)) {
+			if (snd_pcm_state(pcm_handle) == SND_PCM_STATE_PREPARED)
+				snd_pcm_start(pcm_handle);
+			int err = snd_pcm_wait(pcm_handle, 1000);
+			if (err < 0 && recover_device(err) < 0)
+				return;
+			continue;
+		}
+
+		const snd_pcm_channel_area_t *areas;
+		snd_pcm_uframes_t offset, count = n;
+		int err = snd_pcm_mmap_begin(pcm_handle, &areas, &offset, &count);
+		if (err < 0) {
+			if (recover_device(err) < 0)
+				return;
+			continue;
+		}
+		char *dst = (char *)areas[0].addr + (areas[0].first + offset * areas[0].step) / 8;
+		memcpy(dst, buf, count * sndNumChannels * sizeof(short));
+		snd_pcm_sframes_t committed = snd_pcm_mmap_commit(pcm_handle, offset, count);
+		if (committed < 0 || (snd_pcm_uframes_t)committed != count) {
+			if (recover_device(committed < 0 ? committed : -EPIPE) < 0)
+				return;
+			continue;
+		}
+		buf += count * sndNumChannels;
+		n -= count;
+	}
+}
+
+extern "C" void writeSound(void)
+{
+    int ret = soundBufferLen;
+
+    scope_update();
+
+    int time_to_end_ms = TrackLength - FadeLength;
+    if (time_to_end_ms < 0) time_to_end_ms = 0;
+
+    int fade = Output_Filter::gain_unit;
+    if (time_to_end_ms <= FadeLength)
+        fade = FadeLength <= 0 ? 0 : (int)((int64_t)time_to_end_ms * Output_Filter::gain_unit / FadeLength);
+    output_filter.set_fade(fade);
+
+    // Fade and bass boost are done in place as sound is gathered into a period
+    const short *in = (const short *)soundFinalWave;
+    int frames_left = ret / (2 * sndNumChannels);
+    while (frames_left > 0) {
+        int n = std::min<int>(frames_left, frames - period_fill);
+        int samplesCount = n * sndNumChannels;
+        short *out = period_buf + period_fill * sndNumChannels;
+        memcpy(out, in, samplesCount * sizeof(short));
+        output_filter.run(out, samplesCount);
+
+        in += samplesCount;
+        frames_left -= n;
+        period_fill += n;
+        if (period_fill == frames) {
+            write_frames(period_buf, period_fill);
+            period_fill = 0;
+        }
+    }
+
+    decode_pos_ms += (ret / (2 * sndNumChannels)) * 1000.0 / sndSamplesPerSec;
+
+    // What hasn't been heard yet is what device holds, plus the part period
+    snd_pcm_sframes_t avail = snd_pcm_avail_update(pcm_handle);
+    snd_pcm_sframes_t delay_frames = period_fill;
+    if (avail >= 0 && (snd_pcm_uframes_t)avail < pcm_buffer_frames)
+        delay_frames += pcm_buffer_frames - avail;
+    heard_pos_ms = (int)(decode_pos_ms - delay_frames * 1000.0 / sndSamplesPerSec);
+}
+
+// Open sound device for current sample rate, unless already open for it
+static int open_device(void)
+{
+	if (pcm_handle && pcm_rate == sndSamplesPerSec)
+		return 1;
+
+	if (pcm_handle) {
+		snd_pcm_close(pcm_handle);
+		pcm_handle = NULL;
+	}
+
+	int err;
+	if ((err = snd_pcm_open(&pcm_handle, "default",
+	                        SND_PCM_STREAM_PLAYBACK, 0)) < 0) {
+	    fprintf(stderr, "Error opening PCM device: %s\n", snd_strerror(err));
+	    pcm_handle = NULL;
+	    return 0;
+	}
+
+	snd_pcm_hw_params_t *hw_params;
+	snd_pcm_hw_params_alloca(&hw_params);
+	snd_pcm_hw_params_any(pcm_handle, hw_params);
+	pcm_mmap = snd_pcm_hw_params_set_access(pcm_handle, hw_params, SND_PCM_ACCESS_MMAP_INTERLEAVED) >= 0;
+	if (!pcm_mmap)
+		snd_pcm_hw_params_set_access(pcm_handle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED);
+	snd_pcm_hw_params_set_format(pcm_handle, hw_params, SND_PCM_FORMAT_S16_LE);
+	snd_pcm_hw_params_set_channels(pcm_handle, hw_params, sndNumChannels);
+	snd_pcm_hw_params_set_rate(pcm_handle, hw_params, sndSamplesPerSec, 0);
+
+	snd_pcm_uframes_t buffer_size = 4096;
+	snd_pcm_uframes_t period_size = 1024;
+
+	snd_pcm_hw_params_set_buffer_size_near(pcm_handle, hw_params, &buffer_size);
+	snd_pcm_hw_params_set_period_size_near(pcm_handle, hw_params, &period_size, NULL);
+
+	if ((err = snd_pcm_hw_params(pcm_handle, hw_params)) < 0) {
+	    fprintf(stderr, "Error setting HW parameters: %s\n", snd_strerror(err));
+	    snd_pcm_close(pcm_handle);
+	    pcm_handle = NULL;
+	    return 0;
+	}
+
+	snd_pcm_hw_params_get_period_size(hw_params, &frames, NULL);
+	snd_pcm_hw_params_get_buffer_size(hw_params, &pcm_buffer_frames);
+	pcm_can_pause = snd_pcm_hw_params_can_pause(hw_params);
+
+	// Wake writer once a whole period fits
+	snd_pcm_sw_params_t *sw_params;
+	snd_pcm_sw_params_alloca(&sw_params);
+	snd_pcm_sw_params_current(pcm_handle, sw_params);
+	snd_pcm_sw_params_set_avail_min(pcm_handle, sw_params, frames);
+	snd_pcm_sw_params(pcm_handle, sw_params);
+
+	period_buf = (short *)realloc(period_buf, frames * sndNumChannels * sizeof(short));
+	period_fill = 0;
+	if (!period_buf) {
+		snd_pcm_close(pcm_handle);
+		pcm_handle = NULL;
+		return 0;
+	}
+	pcm_rate = sndSamplesPerSec;
+	return 1;
+}
+
+// Throw away sound queued in device, so what follows is heard at once
+static void flush_device(void)
+{
+	period_fill = 0;
+	if (pcm_handle) {
+		snd_pcm_drop(pcm_handle);
+		snd_pcm_prepare(pcm_handle);
+	}
+}
+
+// Load track and set length from its tags. Sound still queued in device is
+// thrown away unless keep_queued is set. Returns 0 on failure.
+static int start_track(const char *path, int keep_queued = 0)
+{
+	static char tag[50001];
+	char length_str[256], fade_str[256];
+
+	if (!keep_queued)
+		flush_device();
+
+	decode_pos_ms = 0;
+	heard_pos_ms = 0;
+	seek_needed = -1;
+	TrailingSilence = 1000;
+	silencedetected = 0;
+	playtime = 0;
+	didseek = true;
+
+	if (!GSFRun((char *)path))
+		return 0;
+
+	psftag_readfromfile((void*)tag, path);
+
+	if (psftag_getvar(tag, "fade", fade_str, sizeof(fade_str)-1))
+	    strcpy(fade_str, "10");
+	FadeLength = LengthFromString(fade_str);
+
+	if (!IgnoreTrackLength && !psftag_raw_getvar(tag, "length", length_str, sizeof(length_str)-1))
+		TrackLength = LengthFromString(length_str) + FadeLength;
+	else
+		TrackLength = DefaultLength;
+
+	/* Must be done after GSFrun so sndNumchannels and
+	 * sndSamplesPerSec are set to valid values */
+	if (!open_device()) {
+		GSFClose();
+		return 0;
+	}
+	output_filter_setup();
+
+	g_playing = 1;
+	return 1;
+}
+
+// Let device play out what remains of track
+static void finish_track(void)
+{
+	if (pcm_handle) {
+		write_frames(period_buf, period_fill);
+		period_fill = 0;
+		snd_pcm_drain(pcm_handle);
+		snd_pcm_prepare(pcm_handle);
+	}
+}
+
+static void pause_device(int pause)
+{
+	if (!pcm_handle)
+		return;
+	if (pause) {
+		if (!pcm_can_pause || snd_pcm_pause(pcm_handle, 1) < 0)
+			snd_pcm_drop(pcm_handle);
+	} else {
+		if (!pcm_can_pause || snd_pcm_pause(pcm_handle, 0) < 0)
+			snd_pcm_prepare(pcm_handle);
+	}
+}
+
+static void prefetch(std::string path)
+{
+	utilPrefetchGSFLib(path.c_str());
+}
+
+static void join_prefetch(void)
+{
+	if (prefetch_thread.joinable())
+		prefetch_thread.join();
+}
+
+// Report queued track once its first sound is coming out of device
+static void update_pending(int force)
+{
+	if (switch_pending && (force || heard_pos_ms >= 0)) {
+		switch_pending = false;
+		status.length_ms = pending_status.length_ms;
+		status.fade_ms = pending_status.fade_ms;
+		status.position_ms = 0;
+		status.serial++;
+	}
+}
+
+// Current track has ended. Go straight on to queued track so device never
+// runs dry, otherwise let device play out what remains.
+static void end_track(std::unique_lock<std::mutex>& lock, std::string& path)
+{
+	if (cmd_queue.empty() || cmd_load || cmd_stop) {
+		lock.unlock();
+		finish_track();
+		lock.lock();
+		if (!cmd_load && !cmd_stop) {
+			status.playing = 0;
+			status.ended = 1;
+		}
+		return;
+	}
+
+	update_pending(1);
+	path = cmd_queue;
+	cmd_queue.clear();
+	lock.unlock();
+	join_prefetch();
+	int ok = start_track(path.c_str(), 1);
+	lock.lock();
+	if (!ok) {
+		status.playing = 0;
+		status.ended = 1;
+		return;
+	}
+	pending_status.length_ms = TrackLength;
+	pending_status.fade_ms = FadeLength;
+	switch_pending = true;
+}
+
+static void engine_loop(void)
+{
+	std::string path;
+	std::string prefetched;
+	std::unique_lock<std::mutex> lock(cmd_mutex);
+	while (!cmd_quit) {
+		if (cmd_bass >= 0) {
+			bass_boost_enabled = cmd_bass;
+			output_filter_setup();
+			cmd_bass = -1;
+		}
+
+		if (cmd_scope >= 0) {
+			scope_setup(cmd_scope);
+			cmd_scope = -1;
+		}
+
+		if (cmd_load) {
+			cmd_load = false;
+			cmd_stop = false;
+			path = cmd_path;
+			switch_pending = false;
+			lock.unlock();
+			int ok = start_track(path.c_str());
+			lock.lock();
+			status.playing = ok;
+			status.length_ms = TrackLength;
+			status.fade_ms = FadeLength;
+			continue;
+		}
+
+		if (cmd_stop) {
+			cmd_stop = false;
+			cmd_next = false;
+			cmd_seek = -1;
+			switch_pending = false;
+			g_playing = 0;
+			status.playing = 0;
+			flush_device();
+			continue;
+		}
+
+		if (cmd_pause >= 0) {
+			pause_device(cmd_pause);
+			cmd_pause = -1;
+		}
+
+		if (cmd_seek >= 0 && status.playing) {
+			int ms = cmd_seek;
+			cmd_seek = -1;
+			update_pending(1);
+			lock.unlock();
+			// Emulation can only go forward, so an earlier position is
+			// reached by starting over
+			int ok = 1;
+			if (ms < decode_pos_ms)
+				ok = start_track(path.c_str());
+			else
+				flush_device();
+			if (ok && ms > decode_pos_ms)
+				seek_needed = ms;
+			heard_pos_ms = ms;
+			lock.lock();
+			status.playing = ok;
+			status.position_ms = ms;
+			continue;
+		}
+		cmd_seek = -1;
+
+		if (cmd_next) {
+			cmd_next = false;
+			if (status.playing)
+				end_track(lock, path);
+			continue;
+		}
+
+		if (!status.playing || status.paused) {
+			cmd_cond.wait(lock);
+			continue;
+		}
+
+		if (cmd_queue != prefetched) {
+			prefetched = cmd_queue;
+			lock.unlock();
+			join_prefetch();
+			if (!prefetched.empty())
+				prefetch_thread = std::thread(prefetch, prefetched);
+			lock.lock();
+			continue;
+		}
+
+		// Queued track follows straight on, without the usual silence
+		TrailingSilence = cmd_queue.empty() ? 1000 : 0;
+
+		// writeSound() waits for room in device, which sets the pace
+		lock.unlock();
+		EmulationLoop();
+		lock.lock();
+
+		status.xruns = pcm_xruns;
+		if (!g_playing)
+			end_track(lock, path);
+		update_pending(0);
+		if (!switch_pending)
+			status.position_ms = heard_pos_ms < 0 ? 0 : heard_pos_ms;
+	}
+	lock.unlock();
+	join_prefetch();
+}
+
+int gsf_engine_open(void)
+{
+	if (engine_thread.joinable())
+		return 0;
+	cmd_quit = false;
+	try {
+		engine_thread = std::thread(engine_loop);
+	} catch (...) {
+		return -1;
+	}
+	return 0;
+}
+
+void gsf_engine_close(void)
+{
+	if (!engine_thread.joinable())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(cmd_mutex);
+		cmd_quit = true;
+	}
+	cmd_cond.notify_one();
+	engine_thread.join();
+
+	GSFClose();
+	utilClearGSFLibCache();
+	if (pcm_handle) {
+		snd_pcm_drop(pcm_handle);
+		snd_pcm_close(pcm_handle);
+		pcm_handle = NULL;
+	}
+	free(period_buf);
+	period_buf = NULL;
+}
+
+void gsf_engine_set_lib_cache_dir(const char *dir)
+{
+	utilSetGSFLibCacheDir(dir);
+}
+
+void gsf_engine_load(const char *path)
+{
+	{
+		std::lock_guard<std::mutex> lock(cmd_mutex);
+		cmd_path = path;
+		cmd_load = true;
+		cmd_seek = -1;
+		cmd_pause = -1;
+		status.playing = 1;
+		status.paused = 0;
+		status.ended = 0;
+		status.position_ms = 0;
+		status.serial++;
+		cmd_queue.clear();
+		cmd_next = false;
+	}
+	cmd_cond.notify_one();
+}
+
+void gsf_engine_queue(const char *path)
+{
+	{
+		std::lock_guard<std::mutex> lock(cmd_mutex);
+		cmd_queue = path ? path : "";
+	}
+	cmd_cond.notify_one();
+}
+
+void gsf_engine_next(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(cmd_mutex);
+		cmd_next = true;
+	}
+	cmd_cond.notify_one();
+}
+
+void gsf_engine_stop(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(cmd_mutex);
+		cmd_load = false;
+		cmd_stop = true;
+		cmd_queue.clear();
+	}
+	cmd_cond.notify_one();
+}
+
+void gsf_engine_pause(int pause)
+{
+	{
+		std::lock_guard<std::mutex> lock(cmd_mutex);
+		if (status.paused == !!pause)
+			return;
+		status.paused = !!pause;
+		cmd_pause = !!pause;
+	}
+	cmd_cond.notify_one();
+}
+
+void gsf_engine_seek(int ms)
+{
+	{
+		std::lock_guard<std::mutex> lock(cmd_mutex);
+		cmd_seek = ms < 0 ? 0 : ms;
+	}
+	cmd_cond.notify_one();
+}
+
+void gsf_engine_set_bass(int enable)
+{
+	{
+		std::lock_guard<std::mutex> lock(cmd_mutex);
+		cmd_bass = !!enable;
+	}
+	cmd_cond.notify_one();
+}
+
+void gsf_engine_set_scope(int step)
+{
+	{
+		std::lock_guard<std::mutex> lock(cmd_mutex);
+		cmd_scope = step < 0 ? 0 : step;
+	}
+	cmd_cond.notify_one();
+}
+
+int gsf_engine_get_scope(int out[GSF_SCOPE_CHANNELS][GSF_SCOPE_WIDTH])
+{
+	std::lock_guard<std::mutex> lock(bufmtx);
+	if (!scope_step)
+		return 0;
+	for (int ch = 0; ch < GSF_SCOPE_CHANNELS; ch++)
+		memcpy(out[ch], draw_buf[curr_buf][ch], sizeof(out[ch]));
+	return 1;
+}
+
+void gsf_engine_get_status(struct gsf_engine_status *out)
+{
+	std::lock_guard<std::mutex> lock(cmd_mutex);
+	*out = status;
+}
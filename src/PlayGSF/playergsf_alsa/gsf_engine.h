@@ -0,0 +1,72 @@
+// GSF player engine. The emulator runs on its own thread, feeding an ALSA
+// device which stays open from one track to the next. All functions are
+// called from the controlling thread and return without waiting for the
+// engine, except gsf_engine_close().
+
+#ifndef GSF_ENGINE_H
+#define GSF_ENGINE_H
+
+struct gsf_engine_status {
+	int playing;      // track is loaded and hasn't ended
+	int paused;
+	int ended;        // track reached its end, or silence was detected
+	int position_ms;  // position of sound now being heard
+	int length_ms;    // length including fade
+	int fade_ms;
+	unsigned serial;  // incremented by each gsf_engine_load(), and when a
+	                  // queued track starts being heard
+	unsigned xruns;   // times sound device ran dry and was restarted
+};
+
+// Start engine thread. Returns 0 on success.
+int gsf_engine_open(void);
+
+// Stop playback and engine thread, and close sound device
+void gsf_engine_close(void);
+
+// Keep decompressed GSF libraries in directory, so they don't need to be
+// decompressed again by later runs. NULL or "" disables this. Libraries are
+// always cached in memory while the engine runs. Call before loading a track.
+void gsf_engine_set_lib_cache_dir(const char *dir);
+
+// Start playing file from the beginning, replacing any current track
+void gsf_engine_load(const char *path);
+
+// Play file as soon as current track ends, continuing the same sound stream
+// so there is no gap between them. NULL or "" cancels. gsf_engine_load() and
+// gsf_engine_stop() also cancel it.
+void gsf_engine_queue(const char *path);
+
+// End current track now and go on to queued track without a gap, or stop
+// once device has played out if none is queued
+void gsf_engine_next(void);
+
+// Stop current track
+void gsf_engine_stop(void);
+
+// Pause or resume playback
+void gsf_engine_pause(int pause);
+
+// Move to position in current track, in milliseconds
+void gsf_engine_seek(int ms);
+
+// Enable low-shelf bass boost
+void gsf_engine_set_bass(int enable);
+
+// Oscilloscope of the four PSG and two Direct Sound channels. It is off
+// unless a host that draws it turns it on, so headless playback doesn't pay
+// for it.
+#define GSF_SCOPE_CHANNELS 6
+#define GSF_SCOPE_WIDTH 800
+
+// Start drawing every step-th sample of each channel, GSF_SCOPE_WIDTH of them
+// at a time, or stop if step is 0
+void gsf_engine_set_scope(int step);
+
+// Copy latest waveforms into out. Returns 0 if oscilloscope is off.
+int gsf_engine_get_scope(int out[GSF_SCOPE_CHANNELS][GSF_SCOPE_WIDTH]);
+
+// Get state of engine
+void gsf_engine_get_status(struct gsf_engine_status *out);
+
+#endif
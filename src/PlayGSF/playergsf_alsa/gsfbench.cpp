@@ -0,0 +1,152 @@
+// Benchmark for the GBA core. Plays a GSF for a number of emulated seconds
+// without a sound device and reports how long it took on the host, once with
+// each CPU core, and whether they made identical sound. -n turns off idle loop
+// detection, otherwise how much of the time the CPU was found idle is shown.
+// -i picks the Direct Sound interpolation (0-4); -i all times each of them,
+// best first, to find the cheapest one that still sounds right.
+//
+// Usage: ./gsfbench [-s seconds] [-c interp|cached] [-i mode|all] [-n] file.minigsf
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <chrono>
+
+#include "types.h"
+
+extern "C" {
+#include "gsf.h"
+}
+#include "VBA/GBA.h"
+#include "VBA/Sound.h"
+
+extern "C" {
+int defvolume=1000;
+int relvolume=1000;
+int TrackLength=0;
+int FadeLength=0;
+int IgnoreTrackLength=1, DefaultLength=150000;
+int playforever=1;
+int TrailingSilence=1000;
+int DetectSilence=0, silencedetected=0, silencelength=5;
+}
+int cpupercent=0, sndSamplesPerSec, sndNumChannels;
+int sndBitsPerSample=16;
+int deflen=120,deffade=10;
+double decode_pos_ms;
+int seek_needed = -1;
+
+static uint32_t wave_hash;
+static long samples_written;
+static double idle_percent;
+
+extern "C" void end_of_track() { }
+
+extern "C" void writeSound(void)
+{
+	const unsigned short *p = soundFinalWave;
+	for (int i = 0; i < soundBufferLen / 2; i++)
+		wave_hash = wave_hash * 31 + p[i];
+	samples_written += soundBufferLen / (2 * sndNumChannels);
+	decode_pos_ms += (soundBufferLen / (2 * sndNumChannels)) * 1000.0 / sndSamplesPerSec;
+}
+
+// Play seconds of file with core. Returns host time taken, or -1 on error.
+static double run(const char *path, int core, double seconds)
+{
+	cpuCore = core;
+	wave_hash = 0;
+	samples_written = 0;
+	decode_pos_ms = 0;
+	if (!GSFRun((char *)path))
+		return -1;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	while (samples_written < seconds * sndSamplesPerSec)
+		EmulationLoop();
+	double host = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	idle_percent = 100.0 * cpuIdleTicks / (seconds * 16777216);
+
+	GSFClose();
+	return host;
+}
+
+int main(int argc, char **argv)
+{
+	static const char *modes[] = { "none", "linear", "cubic", "fir", "libresample" };
+	double seconds = 60;
+	int first = CORE_INTERPRETER, last = CORE_CACHED;
+	int mode_first = -1, mode_last = -1;
+	int r;
+
+	while ((r = getopt(argc, argv, "s:c:i:n")) >= 0) {
+		switch (r) {
+			case 's':
+				seconds = atof(optarg);
+				break;
+			case 'c':
+				if (!strcmp(optarg, "interp"))
+					first = last = CORE_INTERPRETER;
+				else if (!strcmp(optarg, "cached"))
+					first = last = CORE_CACHED;
+				else {
+					fprintf(stderr, "Unknown core %s\n", optarg);
+					return 1;
+				}
+				break;
+			case 'i':
+				if (!strcmp(optarg, "all")) {
+					mode_first = 4;
+					mode_last = 0;
+				} else if (optarg[0] >= '0' && optarg[0] <= '4' && !optarg[1])
+					mode_first = mode_last = optarg[0] - '0';
+				else {
+					fprintf(stderr, "Unknown interpolation %s\n", optarg);
+					return 1;
+				}
+				break;
+			case 'n':
+				cpuIdleDetect = false;
+				break;
+			default:
+				return 1;
+		}
+	}
+	if (optind >= argc || seconds <= 0) {
+		fprintf(stderr, "Usage: %s [-s seconds] [-c interp|cached] [-i mode|all] [-n] file\n", argv[0]);
+		return 1;
+	}
+
+	static const char *names[] = { "interp", "cached" };
+	for (int mode = mode_first; ; mode--) {
+		uint32_t hash[2] = { 0, 0 };
+		if (mode >= 0) {
+			soundInterpolation = mode;
+			printf("%s interpolation\n", modes[mode]);
+		}
+		for (int core = first; core <= last; core++) {
+			double host = run(argv[optind], core, seconds);
+			if (host < 0) {
+				fprintf(stderr, "Error loading %s\n", argv[optind]);
+				return 1;
+			}
+			hash[core] = wave_hash;
+			printf("%-7s %6.2f s for %.0f s emulated (%.1fx realtime), sound %08x",
+					names[core], host, seconds, seconds / (host > 0 ? host : 1e-9),
+					(unsigned) wave_hash);
+			if (cpuIdleDetect)
+				printf(", %.1f%% idle in %u loops", idle_percent, (unsigned) cpuIdleSkips);
+			printf("\n");
+		}
+
+		if (first != last && hash[0] != hash[1]) {
+			printf("Cores made different sound\n");
+			return 1;
+		}
+		if (mode <= mode_last)
+			break;
+	}
+	return 0;
+}
@@ -4,23 +4,19 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/ioctl.h>
-#include <signal.h>
 #include <unistd.h>
-#include <sys/wait.h>
 #include <string>
 #include <vector>
 #include <algorithm>
 #include <iostream>
-#include <chrono>
 #include <cstdio>
 #include <cstring>
 #include <fstream>
 #include <pthread.h>
 #include <fcntl.h>
 
-extern "C" {
-#include "VBA/psftag.h"
-}
+#include "playergsf_alsa/gsf_engine.h"
+#include "media_index.h"
 
 #define SCREEN_WIDTH 720
 #define SCREEN_HEIGHT 480
@@ -29,10 +25,7 @@ extern "C" {
 #define DISP_LCD_SET_BRIGHTNESS 0x102
 #define DISP_LCD_GET_BRIGHTNESS 0x103
 
-struct Entry {
-    std::string name;
-    bool is_dir;
-};
+typedef MediaEntry Entry;
 
 enum Mode { MODE_LIST, MODE_PLAYBACK };
 enum LoopMode { LOOP_OFF, LOOP_ONE, LOOP_ALL };
@@ -53,7 +46,16 @@ const int scroll_delay = 4000;
 
 bool bass_enabled_local = false;
 
-pid_t playgsf_pid = -1;
+// Track is loaded in player engine
+bool playing = false;
+// Track was stopped, for main loop to decide what plays next
+bool track_finished = false;
+// Entry queued in engine to follow current track without a gap, or -1
+int queued_index = -1;
+// Engine serial of current track; changes when engine starts queued track
+unsigned track_serial = 0;
+// Current track was cut short for queued track to start
+bool skip_requested = false;
 bool paused = false;
 bool screen_off = false;
 
@@ -68,11 +70,6 @@ bool l2_prev = false, r2_prev = false;
 bool manual_switch = false;
 bool manual_forward = true;
 
-// Estructura de metadatos de pista
-struct TrackMetadata {
-    std::string filename, title, artist, game, year, copyright, gsf_by, length, fade;
-};
-
 // Clamp manual (C++14)
 static void clamp_index(int& idx, int low, int high) {
     if (idx < low) idx = low;
@@ -179,32 +176,12 @@ bool is_directory(const std::string& path) {
 }
 
 bool is_valid_music(const std::string& fname) {
-    auto pos = fname.find_last_of('.');
-    if (pos == std::string::npos) return false;
-    std::string ext = fname.substr(pos);
-    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-    return (ext == ".minigsf" || ext == ".gsf");
+    return media_is_gsf(fname);
 }
 
+// Listado desde el índice, salvo que el directorio haya cambiado
 void list_directory(const std::string& path, bool reset_selection = true) {
-    entries.clear();
-    DIR* dir = opendir(path.c_str());
-    if (!dir) return;
-    struct dirent* entry = nullptr;
-    while ((entry = readdir(dir)) != nullptr) {
-        std::string name = entry->d_name;
-        if (name == "." || name == "..") continue;
-        std::string full_path = path + "/" + name;
-        bool dir_flag = is_directory(full_path);
-        if (dir_flag || is_valid_music(name)) {
-            entries.emplace_back(Entry{name, dir_flag});
-        }
-    }
-    closedir(dir);
-    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b){
-        if (a.is_dir != b.is_dir) return a.is_dir > b.is_dir;
-        return a.name < b.name;
-    });
+    media_index_list(path, entries);
     if (reset_selection) {
         selected_index = 0;
         scroll_offset = 0;
@@ -212,30 +189,27 @@ void list_directory(const std::string& path, bool reset_selection = true) {
     clamp_index(selected_index, 0, (int)entries.size() - 1);
 }
 
-void kill_playgsf() {
-    if (playgsf_pid > 0) {
-        kill(playgsf_pid, SIGTERM);
+void stop_track() {
+    if (playing) {
+        gsf_engine_stop();
+        track_finished = true;
         paused = false;
     }
 }
 
-bool launch_playgsf(const std::string& filepath) {
-    if (playgsf_pid != -1) return false;
-    pid_t pid = fork();
-    if (pid == 0) {
-        
-        if (bass_enabled_local)
-            execl("/usr/bin/playgsf", "playgsf", "-s", "-q", "-b", filepath.c_str(), nullptr);
-        else
-            execl("/usr/bin/playgsf", "playgsf", "-s", "-q", filepath.c_str(), nullptr);
-
-        _exit(127);
-    } else if (pid > 0) {
-        playgsf_pid = pid;
-        paused = false;
-        return true;
-    }
-    return false;
+void queue_next_track();
+
+// Start track in player engine, replacing any track playing
+void play_track(const std::string& filepath) {
+    gsf_engine_load(filepath.c_str());
+    gsf_engine_status engine;
+    gsf_engine_get_status(&engine);
+    track_serial = engine.serial;
+    skip_requested = false;
+    playing = true;
+    track_finished = false;
+    paused = false;
+    queue_next_track();
 }
 
 int find_next_track(int current, bool forward = true) {
@@ -250,6 +224,19 @@ int find_next_track(int current, bool forward = true) {
     return current;
 }
 
+// Tell engine what plays after current track, so it follows without a gap
+void queue_next_track() {
+    queued_index = -1;
+    if (loop_mode == LOOP_ONE)
+        queued_index = selected_index;
+    else if (loop_mode == LOOP_ALL)
+        queued_index = find_next_track(selected_index, true);
+    if (queued_index >= 0)
+        gsf_engine_queue((current_path + "/" + entries[queued_index].name).c_str());
+    else
+        gsf_engine_queue(NULL);
+}
+
 // Parse de etiquetas length en formato "m:ss", "ss" o "ss.xxx"
 int parse_length(const std::string& str) {
     if (str.empty()) return 0;
@@ -270,33 +257,10 @@ int parse_length(const std::string& str) {
     }
 }
 
+// Etiquetas desde el índice si ya se escanearon, si no desde el archivo
 bool read_metadata(const std::string& file, TrackMetadata& out) {
-    out = TrackMetadata{};
-    char tag[50001] = {0};
-    if (psftag_readfromfile((void*)tag, file.c_str())) return false;
-
-    char buf[512] = {0};
-    out.filename = file;
-    if (psftag_getvar(tag, "title", buf, sizeof(buf)) == 0) out.title = buf;
-    if (psftag_getvar(tag, "artist", buf, sizeof(buf)) == 0) out.artist = buf;
-    if (psftag_getvar(tag, "game", buf, sizeof(buf)) == 0) out.game = buf;
-    if (psftag_getvar(tag, "year", buf, sizeof(buf)) == 0) out.year = buf;
-    if (psftag_getvar(tag, "copyright", buf, sizeof(buf)) == 0) out.copyright = buf;
-    if (psftag_getvar(tag, "gsfby", buf, sizeof(buf)) == 0) out.gsf_by = buf;
-
-	if (psftag_getvar(tag, "length", buf, sizeof(buf)) == 0) {
-        out.length = buf;
-    } else {
-        out.length = "150";
-    }
-
-    if (psftag_getvar(tag, "fade", buf, sizeof(buf)) == 0) {
-        out.fade = buf;
-    } else {
-        out.fade = "10";
-    }
-
-    return true;
+    if (media_index_find(file, out)) return true;
+    return media_read_tags(file, out);
 }
 
 int total_track_seconds(const TrackMetadata& m) {
@@ -627,12 +591,13 @@ int main() {
         if (!controller) fprintf(stderr, "Error al abrir gamecontroller: %s\n", SDL_GetError());
     }
 
+    if (media_index_open("/.config/playgsf/index") != 0)
+        media_index_open(NULL);
+
+    if (gsf_engine_open() != 0) { fprintf(stderr, "Error al iniciar el motor GSF\n"); TTF_CloseFont(font); SDL_DestroyRenderer(renderer); SDL_DestroyWindow(window); TTF_Quit(); SDL_Quit(); return 1; }
+
     TrackMetadata current_meta;
     int track_seconds = 0;
-    using clock_type = std::chrono::steady_clock;
-    auto playback_start = clock_type::now();
-    clock_type::time_point paused_at;
-    int paused_seconds_total = 0;
     int elapsed_seconds = 0;
 	
 	last_battery_update = SDL_GetTicks();
@@ -650,6 +615,7 @@ int main() {
             
             if (!last_bass.empty())
                 bass_enabled_local = (last_bass == "1");
+            gsf_engine_set_bass(bass_enabled_local);
     
             if (!last_path.empty() && is_directory(last_path)) {
                 current_path = last_path;
@@ -686,11 +652,36 @@ int main() {
 		}
         
         // ---- CONTROL DEL FIN DE PISTA y CAMBIO CENTRALIZADO ----
-        if (playgsf_pid > 0 && !paused) {
-            int status;
-            pid_t ret = waitpid(playgsf_pid, &status, WNOHANG);
-            if (ret == playgsf_pid) {
-                playgsf_pid = -1;
+        gsf_engine_status engine;
+        gsf_engine_get_status(&engine);
+        if (playing && engine.playing && engine.serial != track_serial && queued_index >= 0) {
+            // El motor ya pasó a la pista en cola, sin pausa
+            track_serial = engine.serial;
+            skip_requested = false;
+            selected_index = queued_index;
+            std::string filepath = current_path + "/" + entries[selected_index].name;
+            if (read_metadata(filepath, current_meta)) {
+                if (loop_mode == LOOP_ONE) {
+                    track_seconds = parse_length(current_meta.length);
+                } else {
+                    track_seconds = total_track_seconds(current_meta);
+                }
+                scroll_start_time_game = 0;
+                scroll_start_time_title = 0;
+                scroll_start_time_artist = 0;
+            }
+            queue_next_track();
+            elapsed_seconds = 0;
+            if (!screen_off) {
+            draw_playback(current_meta, 0);
+            }
+        }
+        if (playing) {
+            if (!engine.playing)
+                track_finished = true;
+            if (track_finished) {
+                playing = false;
+                track_finished = false;
                 if (mode == MODE_PLAYBACK) {
                     if (manual_switch) {
                         int next_track = find_next_track(selected_index, manual_forward);
@@ -703,13 +694,11 @@ int main() {
                             } else {
                                 track_seconds = total_track_seconds(current_meta);
                             }
-                            playback_start = clock_type::now();
-                            paused_seconds_total = 0;
                             scroll_start_time_game = 0;
                             scroll_start_time_title = 0;
                             scroll_start_time_artist = 0;
                         }
-                        launch_playgsf(filepath);
+                        play_track(filepath);
 						if (!screen_off) {
                         draw_playback(current_meta, 0);
 						}
@@ -724,13 +713,11 @@ int main() {
                                 std::string filepath = current_path + "/" + entries[selected_index].name;
                                 if (read_metadata(filepath, current_meta)) {
                                     track_seconds = parse_length(current_meta.length);
-                                    playback_start = clock_type::now();
-                                    paused_seconds_total = 0;
                                     scroll_start_time_game = 0;
                                     scroll_start_time_title = 0;
                                     scroll_start_time_artist = 0;
                                 }
-                                launch_playgsf(filepath);
+                                play_track(filepath);
                                 if (!screen_off) {
                                 draw_playback(current_meta, 0);
                                 }
@@ -741,13 +728,11 @@ int main() {
                                 std::string filepath = current_path + "/" + entries[selected_index].name;
                                 if (read_metadata(filepath, current_meta)) {
                                     track_seconds = total_track_seconds(current_meta);
-                                    playback_start = clock_type::now();
-                                    paused_seconds_total = 0;
                                     scroll_start_time_game = 0;
                                     scroll_start_time_title = 0;
                                     scroll_start_time_artist = 0;
                                 }
-                                launch_playgsf(filepath);
+                                play_track(filepath);
                                 if (!screen_off) {
                                 draw_playback(current_meta, 0);
                                 }
@@ -759,26 +744,27 @@ int main() {
             }
         }
 
-        // ------ CONTROL DE TIEMPO: MATAR PROCESO si termina -----
-        if (mode == MODE_PLAYBACK && playgsf_pid > 0 && !paused) {
-            auto now = clock_type::now();
-            elapsed_seconds = (int)std::chrono::duration_cast<std::chrono::seconds>(now - playback_start).count() - paused_seconds_total;
+        // ------ CONTROL DE TIEMPO: PARAR PISTA si termina -----
+        if (mode == MODE_PLAYBACK && playing && !paused) {
+            gsf_engine_get_status(&engine);
+            elapsed_seconds = engine.position_ms / 1000;
             int fade_sec = parse_length(current_meta.fade);
             if (fade_sec == 0) fade_sec = 10;
             if (loop_mode == LOOP_OFF) {
             if (track_seconds > 0 && elapsed_seconds >= track_seconds + 1) {
                 manual_switch = false; // Fin natural
-                kill_playgsf(); // Solo matar proceso, waitpid central decide siguiente acción
+                stop_track(); // Solo parar pista, el control central decide siguiente acción
                 }
             } else if (loop_mode == LOOP_ONE) {
-            if (track_seconds > 0 && elapsed_seconds >= track_seconds + 1) {
+            if (track_seconds > 0 && elapsed_seconds >= track_seconds + 1 && !skip_requested) {
                 manual_switch = false; // Fin natural
-                kill_playgsf(); // Solo matar proceso, waitpid central decide siguiente acción
+                skip_requested = true;
+                gsf_engine_next(); // El motor repite la pista en cola sin pausa
                 }
             } else {
             if (track_seconds > 0 && elapsed_seconds >= track_seconds + fade_sec) {
                 manual_switch = false; // Fin natural
-                kill_playgsf(); // Solo matar proceso, waitpid central decide siguiente acción
+                stop_track(); // Solo parar pista, el control central decide siguiente acción
                 }
             }
             if (!screen_off) {
@@ -805,12 +791,12 @@ int main() {
                         break;
                     case SDL_CONTROLLER_BUTTON_DPAD_LEFT: // 13 dpleft
                         if (mode == MODE_PLAYBACK && !screen_off) {
-                            manual_switch = true; manual_forward = false; kill_playgsf();
+                            manual_switch = true; manual_forward = false; stop_track();
                         }
                         break;
                     case SDL_CONTROLLER_BUTTON_DPAD_RIGHT: // 14 dpright
                         if (mode == MODE_PLAYBACK && !screen_off) {
-                            manual_switch = true; manual_forward = true; kill_playgsf();
+                            manual_switch = true; manual_forward = true; stop_track();
                         }
                         break;
                     default:
@@ -835,9 +821,8 @@ int main() {
                                         scroll_start_time_title = 0;
                                         scroll_start_time_artist = 0;
                                         track_seconds = parse_length(current_meta.length);
-                                        playback_start = clock_type::now();
                                         draw_playback(current_meta, 0);
-                                        launch_playgsf(filepath);
+                                        play_track(filepath);
                                         mode = MODE_PLAYBACK;
                                         paused = false;
                                     }
@@ -848,7 +833,7 @@ int main() {
                     case 1: // Botón B físico
                         if (mode == MODE_PLAYBACK) {
                             if (!screen_off) {
-                            kill_playgsf();
+                            stop_track();
                             mode = MODE_LIST;
                             draw_list();
                             }
@@ -872,6 +857,7 @@ int main() {
                         if (mode == MODE_PLAYBACK) {
                             if (!screen_off) {
                             loop_mode = static_cast<LoopMode>((loop_mode + 1) % 3);
+                            if (playing) queue_next_track();
                             draw_playback(current_meta, elapsed_seconds);
                             }
                         }
@@ -879,7 +865,7 @@ int main() {
                     case 3: // Botón X físico
                         if (mode == MODE_PLAYBACK) {
                             bass_enabled_local = !bass_enabled_local;
-                            if (playgsf_pid > 0) kill(playgsf_pid, SIGUSR2);
+                            gsf_engine_set_bass(bass_enabled_local);
                             if (!screen_off) {
                             draw_playback(current_meta, elapsed_seconds);
                             }
@@ -905,18 +891,10 @@ int main() {
                         }
                         break;
                     case 7: // START físico
-                        if (playgsf_pid > 0) {
+                        if (playing) {
                             if (!screen_off) {
-                            if (!paused) {
-                                kill(playgsf_pid, SIGSTOP);
-                                paused = true;
-                                paused_at = clock_type::now();
-                            } else {
-                                kill(playgsf_pid, SIGCONT);
-                                paused = false;
-                                auto now_chrono = clock_type::now();
-                                paused_seconds_total += std::chrono::duration_cast<std::chrono::seconds>(now_chrono - paused_at).count();
-                            }
+                            paused = !paused;
+                            gsf_engine_pause(paused);
                             draw_playback(current_meta, elapsed_seconds);
                             }
                         }
@@ -925,17 +903,17 @@ int main() {
                         //nothing
                         break;
                     case 9: // L2 físico
-                        if (playgsf_pid > 0 && mode == MODE_PLAYBACK) {
+                        if (playing && mode == MODE_PLAYBACK) {
                             manual_switch = true;
                             manual_forward = false;
-                            kill_playgsf();
+                            stop_track();
                         }
                         break;
                     case 10: // R2 físico
-                        if (playgsf_pid > 0 && mode == MODE_PLAYBACK) {
+                        if (playing && mode == MODE_PLAYBACK) {
                             manual_switch = true;
                             manual_forward = true;
-                            kill_playgsf();
+                            stop_track();
                         }
                         break;
                     case 11: // Botón extra menú o guía físico
@@ -964,7 +942,9 @@ int main() {
         }
     }
 
-    kill_playgsf();
+    stop_track();
+    gsf_engine_close();
+    media_index_close();
     
     {
         std::ofstream ofs(state_file_path());
@@ -12,11 +12,14 @@ LOCAL_MODULE := libgme
 
 LOCAL_C_INCLUDES := $(LOCAL_PATH)/gme
 
-# YM2612 emulator to use:
+# YM2612 emulators to build in, selectable at run time:
 # VGM_YM2612_NUKED: LGPLv2.1+
-# VGM_YM2612_MAME: GPLv2+
+# VGM_YM2612_MAME: GPLv2+, makes library GPL
 # VGM_YM2612_GENS: LGPLv2.1+
-GME_YM2612_EMU=VGM_YM2612_NUKED
+GME_YM2612_EMU=VGM_YM2612_NUKED VGM_YM2612_GENS
+
+# YM2612 emulator used by default: nuked, mame or gens
+GME_YM2612_DEFAULT=nuked
 
 # For zlib compressed formats:
 GME_ZLIB=Y
@@ -26,7 +29,8 @@ LOCAL_CFLAGS := -O2 -Wall \
 	-DLIBGME_VISIBILITY \
 	-fwrapv \
 	-fvisibility=hidden \
-	-D$(GME_YM2612_EMU)
+	$(addprefix -D,$(GME_YM2612_EMU)) \
+	-DVGM_YM2612_DEFAULT=$(GME_YM2612_DEFAULT)
 
 ifeq ($(GME_ZLIB),Y)
 LOCAL_CFLAGS += -DHAVE_ZLIB_H
@@ -49,6 +53,7 @@ LOCAL_SRC_FILES := \
 	gme/Data_Reader.cpp \
 	gme/Dual_Resampler.cpp \
 	gme/Effects_Buffer.cpp \
+	gme/Emu_State.cpp \
 	gme/Fir_Resampler.cpp \
 	gme/Gb_Apu.cpp \
 	gme/Gb_Cpu.cpp \
@@ -87,6 +92,7 @@ LOCAL_SRC_FILES := \
 	gme/Vgm_Emu.cpp \
 	gme/Vgm_Emu_Impl.cpp \
 	gme/Ym2413_Emu.cpp \
+	gme/Ym2612_Emu.cpp \
 	gme/Ym2612_Nuked.cpp \
 	gme/Ym2612_GENS.cpp \
 	gme/Ym2612_MAME.cpp \
@@ -3,6 +3,7 @@
 #include "Ay_Emu.h"
 
 #include "blargg_endian.h"
+#include "Emu_State.h"
 #include <string.h>
 
 #include <algorithm> // min, max
@@ -277,6 +278,23 @@ blargg_err_t Ay_Emu::start_track_( int track )
 	return 0;
 }
 
+blargg_err_t Ay_Emu::sync_state_( Emu_State& s )
+{
+	RETURN_ERR( Classic_Emu::sync_state_( s ) );
+	s.sync( static_cast<Ay_Cpu*>( this ), sizeof (Ay_Cpu) );
+	s( play_period );
+	s( next_play );
+	s( beeper_delta );
+	s( last_beeper );
+	s( apu_addr );
+	s( cpc_latch );
+	s( spectrum_mode );
+	s( cpc_mode );
+	s( mem );
+	s( apu );
+	return 0;
+}
+
 // Emulation
 
 void Ay_Emu::cpu_out_misc( cpu_time_t time, unsigned addr, int data )
@@ -2,6 +2,7 @@
 
 #include "Blip_Buffer.h"
 
+#include "blargg_common.h"
 #include <assert.h>
 #include <limits.h>
 #include <string.h>
@@ -23,6 +24,12 @@ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA */
 	#include BLARGG_ENABLE_OPTIMIZER
 #endif
 
+#if BLARGG_SSE2
+	#include <emmintrin.h>
+#elif BLARGG_NEON
+	#include <arm_neon.h>
+#endif
+
 static int const silent_buf_size = 1; // size used for Silent_Blip_Buffer
 
 Blip_Buffer::Blip_Buffer()
@@ -186,6 +193,23 @@ void Blip_Buffer::remove_samples( long count )
 	}
 }
 
+void Blip_Buffer::skip_samples( long count )
+{
+	// Integrator is run over samples, so it ends up where reading would leave
+	// it. Once it has settled, silent samples don't change it and are passed over.
+	int const bass = BLIP_READER_BASS( *this );
+	buf_t_ const* in = buffer_;
+	blip_long accum = reader_accum_;
+	for ( long i = 0; i < count; i++ )
+	{
+		if ( in [i] || accum >> bass )
+			accum += in [i] - (accum >> bass);
+	}
+	reader_accum_ = accum;
+
+	remove_samples( count );
+}
+
 // Blip_Synth_
 
 Blip_Synth_Fast_::Blip_Synth_Fast_()
@@ -435,6 +459,308 @@ long Blip_Buffer::read_samples( blip_sample_t* BLIP_RESTRICT out, long max_sampl
 	return count;
 }
 
+// Stereo reading
+
+// The bass filter makes each sample depend on the previous one, so each
+// buffer has to be read one sample at a time. The vector versions instead
+// read center, left and right buffers in parallel, one lane each, taking four
+// samples from each buffer at a time and transposing them.
+
+#if BLARGG_SSE2
+
+static blip_long read_stereo_simd( blip_long* accum, Blip_Buffer::buf_t_ const* c_in,
+		Blip_Buffer::buf_t_ const* l_in, Blip_Buffer::buf_t_ const* r_in,
+		int bass, blip_sample_t* out, blip_long count, int stride )
+{
+	__m128i const zero = _mm_setzero_si128();
+	__m128i const bass_shift = _mm_cvtsi32_si128( bass );
+	__m128i acc = _mm_setr_epi32( accum [0], accum [1], accum [2], 0 );
+
+	blip_long n = 0;
+	for ( ; n + 4 <= count; n += 4 )
+	{
+		__m128i c = (c_in ? _mm_loadu_si128( (__m128i const*) (c_in + n) ) : zero);
+		__m128i l = _mm_loadu_si128( (__m128i const*) (l_in + n) );
+		__m128i r = _mm_loadu_si128( (__m128i const*) (r_in + n) );
+
+		// t0 = c0 l0 r0 0, t1 = c1 l1 r1 0, etc.
+		__m128i cl_lo = _mm_unpacklo_epi32( c, l );
+		__m128i cl_hi = _mm_unpackhi_epi32( c, l );
+		__m128i r_lo  = _mm_unpacklo_epi32( r, zero );
+		__m128i r_hi  = _mm_unpackhi_epi32( r, zero );
+		__m128i t [4] = {
+			_mm_unpacklo_epi64( cl_lo, r_lo ), _mm_unpackhi_epi64( cl_lo, r_lo ),
+			_mm_unpacklo_epi64( cl_hi, r_hi ), _mm_unpackhi_epi64( cl_hi, r_hi )
+		};
+
+		// integrate each, then add center to left and right: c+l c+r c c
+		__m128i p [4];
+		for ( int i = 0; i < 4; i++ )
+		{
+			__m128i s = _mm_srai_epi32( acc, blip_sample_bits - 16 );
+			acc = _mm_add_epi32( acc, _mm_sub_epi32( t [i], _mm_sra_epi32( acc, bass_shift ) ) );
+			p [i] = _mm_add_epi32( _mm_shuffle_epi32( s, _MM_SHUFFLE( 0, 0, 0, 0 ) ),
+					_mm_shuffle_epi32( s, _MM_SHUFFLE( 3, 3, 2, 1 ) ) );
+		}
+
+		// saturating to 16 bits is the same as clamping in scalar code
+		__m128i pairs = _mm_packs_epi32( _mm_unpacklo_epi64( p [0], p [1] ),
+				_mm_unpacklo_epi64( p [2], p [3] ) );
+		if ( stride == 2 )
+		{
+			_mm_storeu_si128( (__m128i*) (out + n * 2), pairs );
+		}
+		else
+		{
+			for ( int i = 0; i < 4; i++ )
+			{
+				int32_t pair = _mm_cvtsi128_si32( pairs );
+				memcpy( out + (n + i) * stride, &pair, sizeof pair );
+				pairs = _mm_srli_si128( pairs, 4 );
+			}
+		}
+	}
+
+	blip_long a [4];
+	_mm_storeu_si128( (__m128i*) a, acc );
+	accum [0] = a [0];
+	accum [1] = a [1];
+	accum [2] = a [2];
+	return n;
+}
+
+#elif BLARGG_NEON
+
+static blip_long read_stereo_simd( blip_long* accum, Blip_Buffer::buf_t_ const* c_in,
+		Blip_Buffer::buf_t_ const* l_in, Blip_Buffer::buf_t_ const* r_in,
+		int bass, blip_sample_t* out, blip_long count, int stride )
+{
+	int32x4_t const zero = vdupq_n_s32( 0 );
+	int32x4_t const bass_shift = vdupq_n_s32( -bass );
+	int32_t const init [4] = { accum [0], accum [1], accum [2], 0 };
+	int32x4_t acc = vld1q_s32( init );
+
+	blip_long n = 0;
+	for ( ; n + 4 <= count; n += 4 )
+	{
+		int32x4_t c = (c_in ? vld1q_s32( c_in + n ) : zero);
+		int32x4_t l = vld1q_s32( l_in + n );
+		int32x4_t r = vld1q_s32( r_in + n );
+
+		// t0 = c0 l0 r0 0, t1 = c1 l1 r1 0, etc.
+		int32x4x2_t cl = vzipq_s32( c, l );
+		int32x4x2_t rz = vzipq_s32( r, zero );
+		int32x4_t t [4] = {
+			vcombine_s32( vget_low_s32 ( cl.val [0] ), vget_low_s32 ( rz.val [0] ) ),
+			vcombine_s32( vget_high_s32( cl.val [0] ), vget_high_s32( rz.val [0] ) ),
+			vcombine_s32( vget_low_s32 ( cl.val [1] ), vget_low_s32 ( rz.val [1] ) ),
+			vcombine_s32( vget_high_s32( cl.val [1] ), vget_high_s32( rz.val [1] ) )
+		};
+
+		// integrate each, then add center to left and right: c+l c+r
+		int32x2_t p [4];
+		for ( int i = 0; i < 4; i++ )
+		{
+			int32x4_t s = vshrq_n_s32( acc, blip_sample_bits - 16 );
+			acc = vaddq_s32( acc, vsubq_s32( t [i], vshlq_s32( acc, bass_shift ) ) );
+			p [i] = vadd_s32( vdup_lane_s32( vget_low_s32( s ), 0 ),
+					vget_low_s32( vextq_s32( s, s, 1 ) ) );
+		}
+
+		// saturating to 16 bits is the same as clamping in scalar code
+		int16x8_t pairs = vcombine_s16( vqmovn_s32( vcombine_s32( p [0], p [1] ) ),
+				vqmovn_s32( vcombine_s32( p [2], p [3] ) ) );
+		if ( stride == 2 )
+		{
+			vst1q_s16( out + n * 2, pairs );
+		}
+		else
+		{
+			int32x4_t w = vreinterpretq_s32_s16( pairs );
+			int32_t pair [4];
+			vst1q_s32( pair, w );
+			for ( int i = 0; i < 4; i++ )
+				memcpy( out + (n + i) * stride, &pair [i], sizeof pair [i] );
+		}
+	}
+
+	accum [0] = vgetq_lane_s32( acc, 0 );
+	accum [1] = vgetq_lane_s32( acc, 1 );
+	accum [2] = vgetq_lane_s32( acc, 2 );
+	return n;
+}
+
+#endif
+
+void blip_read_stereo( Blip_Buffer* center, Blip_Buffer& left, Blip_Buffer& right,
+		int bass, blip_sample_t* BLIP_RESTRICT out, blip_long count, int stride )
+{
+	blip_long accum [3] = { center ? center->reader_accum_ : 0,
+			left.reader_accum_, right.reader_accum_ };
+	Blip_Buffer::buf_t_ const* c_in = (center ? center->buffer_ : NULL);
+	Blip_Buffer::buf_t_ const* l_in = left.buffer_;
+	Blip_Buffer::buf_t_ const* r_in = right.buffer_;
+
+	blip_long n = 0;
+	#if BLARGG_SSE2 || BLARGG_NEON
+		n = read_stereo_simd( accum, c_in, l_in, r_in, bass, out, count, stride );
+	#endif
+
+	// rest one at a time
+	for ( ; n < count; n++ )
+	{
+		blip_long c = accum [0] >> (blip_sample_bits - 16);
+		blip_long l = c + (accum [1] >> (blip_sample_bits - 16));
+		blip_long r = c + (accum [2] >> (blip_sample_bits - 16));
+		if ( (int16_t) l != l )
+			l = 0x7FFF - (l >> 24);
+		if ( (int16_t) r != r )
+			r = 0x7FFF - (r >> 24);
+
+		if ( c_in )
+			accum [0] += c_in [n] - (accum [0] >> bass);
+		accum [1] += l_in [n] - (accum [1] >> bass);
+		accum [2] += r_in [n] - (accum [2] >> bass);
+
+		out [n * stride + 0] = (blip_sample_t) l;
+		out [n * stride + 1] = (blip_sample_t) r;
+	}
+
+	if ( center )
+		center->reader_accum_ = accum [0];
+	left.reader_accum_  = accum [1];
+	right.reader_accum_ = accum [2];
+}
+
+// Planar reading
+
+#if BLARGG_SSE2
+
+static blip_long read_planar_simd( blip_long* accum, Blip_Buffer::buf_t_ const* const* in,
+		int bass, blip_long* const* out, blip_long offset, blip_long count )
+{
+	__m128i const zero = _mm_setzero_si128();
+	__m128i const bass_shift = _mm_cvtsi32_si128( bass );
+	__m128i acc = _mm_loadu_si128( (__m128i const*) accum );
+
+	blip_long n = 0;
+	for ( ; n + 4 <= count; n += 4 )
+	{
+		// t [i] = sample i of each buffer
+		__m128i a = _mm_loadu_si128( (__m128i const*) (in [0] + offset + n) );
+		__m128i b = _mm_loadu_si128( (__m128i const*) (in [1] + offset + n) );
+		__m128i c = _mm_loadu_si128( (__m128i const*) (in [2] + offset + n) );
+		__m128i d = (in [3] ? _mm_loadu_si128( (__m128i const*) (in [3] + offset + n) ) : zero);
+		__m128i ab_lo = _mm_unpacklo_epi32( a, b );
+		__m128i cd_lo = _mm_unpacklo_epi32( c, d );
+		__m128i ab_hi = _mm_unpackhi_epi32( a, b );
+		__m128i cd_hi = _mm_unpackhi_epi32( c, d );
+		__m128i t [4] = {
+			_mm_unpacklo_epi64( ab_lo, cd_lo ), _mm_unpackhi_epi64( ab_lo, cd_lo ),
+			_mm_unpacklo_epi64( ab_hi, cd_hi ), _mm_unpackhi_epi64( ab_hi, cd_hi )
+		};
+
+		for ( int i = 0; i < 4; i++ )
+		{
+			__m128i s = _mm_srai_epi32( acc, blip_sample_bits - 16 );
+			acc = _mm_add_epi32( acc, _mm_sub_epi32( t [i], _mm_sra_epi32( acc, bass_shift ) ) );
+			t [i] = s;
+		}
+
+		// transpose back to four samples of each buffer
+		ab_lo = _mm_unpacklo_epi32( t [0], t [1] );
+		cd_lo = _mm_unpacklo_epi32( t [2], t [3] );
+		ab_hi = _mm_unpackhi_epi32( t [0], t [1] );
+		cd_hi = _mm_unpackhi_epi32( t [2], t [3] );
+		_mm_storeu_si128( (__m128i*) (out [0] + n), _mm_unpacklo_epi64( ab_lo, cd_lo ) );
+		_mm_storeu_si128( (__m128i*) (out [1] + n), _mm_unpackhi_epi64( ab_lo, cd_lo ) );
+		_mm_storeu_si128( (__m128i*) (out [2] + n), _mm_unpacklo_epi64( ab_hi, cd_hi ) );
+		if ( out [3] )
+			_mm_storeu_si128( (__m128i*) (out [3] + n), _mm_unpackhi_epi64( ab_hi, cd_hi ) );
+	}
+
+	_mm_storeu_si128( (__m128i*) accum, acc );
+	return n;
+}
+
+#elif BLARGG_NEON
+
+static blip_long read_planar_simd( blip_long* accum, Blip_Buffer::buf_t_ const* const* in,
+		int bass, blip_long* const* out, blip_long offset, blip_long count )
+{
+	int32x4_t const bass_shift = vdupq_n_s32( -bass );
+	int32x4_t acc = vld1q_s32( accum );
+
+	blip_long n = 0;
+	for ( ; n + 4 <= count; n += 4 )
+	{
+		// t [i] = sample i of each buffer
+		int32x4x2_t ab = vtrnq_s32( vld1q_s32( in [0] + offset + n ), vld1q_s32( in [1] + offset + n ) );
+		int32x4x2_t cd = vtrnq_s32( vld1q_s32( in [2] + offset + n ),
+				(in [3] ? vld1q_s32( in [3] + offset + n ) : vdupq_n_s32( 0 )) );
+		int32x4_t t [4] = {
+			vcombine_s32( vget_low_s32 ( ab.val [0] ), vget_low_s32 ( cd.val [0] ) ),
+			vcombine_s32( vget_low_s32 ( ab.val [1] ), vget_low_s32 ( cd.val [1] ) ),
+			vcombine_s32( vget_high_s32( ab.val [0] ), vget_high_s32( cd.val [0] ) ),
+			vcombine_s32( vget_high_s32( ab.val [1] ), vget_high_s32( cd.val [1] ) )
+		};
+
+		for ( int i = 0; i < 4; i++ )
+		{
+			int32x4_t s = vshrq_n_s32( acc, blip_sample_bits - 16 );
+			acc = vaddq_s32( acc, vsubq_s32( t [i], vshlq_s32( acc, bass_shift ) ) );
+			t [i] = s;
+		}
+
+		// transpose back to four samples of each buffer
+		ab = vtrnq_s32( t [0], t [1] );
+		cd = vtrnq_s32( t [2], t [3] );
+		vst1q_s32( out [0] + n, vcombine_s32( vget_low_s32 ( ab.val [0] ), vget_low_s32 ( cd.val [0] ) ) );
+		vst1q_s32( out [1] + n, vcombine_s32( vget_low_s32 ( ab.val [1] ), vget_low_s32 ( cd.val [1] ) ) );
+		vst1q_s32( out [2] + n, vcombine_s32( vget_high_s32( ab.val [0] ), vget_high_s32( cd.val [0] ) ) );
+		if ( out [3] )
+			vst1q_s32( out [3] + n, vcombine_s32( vget_high_s32( ab.val [1] ), vget_high_s32( cd.val [1] ) ) );
+	}
+
+	vst1q_s32( accum, acc );
+	return n;
+}
+
+#endif
+
+void blip_read_planar( Blip_Buffer* const* bufs, int buf_count, int bass,
+		blip_long* const* out, blip_long offset, blip_long count )
+{
+	assert( 3 <= buf_count && buf_count <= 4 );
+
+	blip_long accum [4] = { 0, 0, 0, 0 };
+	Blip_Buffer::buf_t_ const* in [4] = { 0, 0, 0, 0 };
+	blip_long* dest [4] = { 0, 0, 0, 0 };
+	for ( int i = 0; i < buf_count; i++ )
+	{
+		accum [i] = bufs [i]->reader_accum_;
+		in    [i] = bufs [i]->buffer_;
+		dest  [i] = out [i];
+	}
+
+	blip_long n = 0;
+	#if BLARGG_SSE2 || BLARGG_NEON
+		n = read_planar_simd( accum, in, bass, dest, offset, count );
+	#endif
+
+	// rest one at a time
+	for ( int i = 0; i < buf_count; i++ )
+	{
+		blip_long a = accum [i];
+		for ( blip_long m = n; m < count; m++ )
+		{
+			dest [i] [m] = a >> (blip_sample_bits - 16);
+			a += in [i] [offset + m] - (a >> bass);
+		}
+		bufs [i]->reader_accum_ = a;
+	}
+}
+
 void Blip_Buffer::mix_samples( blip_sample_t const* in, long count )
 {
 	if ( buffer_size_ == silent_buf_size )
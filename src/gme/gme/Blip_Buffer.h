@@ -84,6 +84,10 @@ public:
 	// Mix 'count' samples from 'buf' into buffer.
 	void mix_samples( blip_sample_t const* buf, long count );
 
+	// Remove 'count' samples without reading them, leaving buffer in the same
+	// state as reading them would.
+	void skip_samples( long count );
+
 	// not documented yet
 	void set_modified() { modified_ = 1; }
 	int clear_modified() { int b = modified_; modified_ = 0; return b; }
@@ -307,6 +311,20 @@ int const blip_reader_default_bass = 9;
 #define BLIP_READER_END( name, blip_buffer ) \
 	(void) ((blip_buffer).reader_accum_ = name##_reader_accum)
 
+// Read center, left and right buffers together as stereo pairs of center + left
+// and center + right, clamped to 16 bits. Center can be NULL. Writes 'count'
+// pairs 'stride' samples apart. Like the BLIP_READER macros, the samples read
+// must then be removed from each buffer. Uses SSE2 or NEON where available,
+// which give the same result as the BLIP_READER macros.
+void blip_read_stereo( Blip_Buffer* center, Blip_Buffer& left, Blip_Buffer& right,
+		int bass, blip_sample_t* out, blip_long count, int stride = 2 );
+
+// Read 3 or 4 buffers into separate arrays, as BLIP_READER_READ() values, starting
+// 'offset' samples into each. Continues from the previous read, so a long read can
+// be done in blocks with increasing offset. Samples must then be removed as above.
+void blip_read_planar( Blip_Buffer* const* bufs, int buf_count, int bass,
+		blip_long* const* out, blip_long offset, blip_long count );
+
 
 // Compatibility with older version
 const long blip_unscaled = 65535;
@@ -3,6 +3,7 @@
 #include "Classic_Emu.h"
 
 #include "Multi_Buffer.h"
+#include "Emu_State.h"
 #include <string.h>
 
 /* Copyright (C) 2003-2006 Shay Green. This module is free software; you
@@ -101,6 +102,32 @@ blargg_err_t Classic_Emu::start_track_( int track )
 	return 0;
 }
 
+blargg_err_t Classic_Emu::skip_muted_( long count )
+{
+	// Muted voices don't add anything to the buffer, so frames are run and the
+	// resulting silence discarded without being mixed
+	long remain = count;
+	while ( remain && !emu_track_ended() )
+	{
+		remain -= buf->skip_samples( remain );
+		if ( remain )
+		{
+			int msec = buf->length();
+			blip_time_t clocks_emulated = (int32_t) msec * clock_rate_ / 1000;
+			RETURN_ERR( run_clocks( clocks_emulated, msec ) );
+			assert( clocks_emulated );
+			buf->end_frame( clocks_emulated );
+		}
+	}
+	return 0;
+}
+
+blargg_err_t Classic_Emu::sync_state_( Emu_State& s )
+{
+	buf->sync_state( s );
+	return 0;
+}
+
 blargg_err_t Classic_Emu::play_( long count, sample_t* out )
 {
 	long remain = count;
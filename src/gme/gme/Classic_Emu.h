@@ -33,6 +33,8 @@ protected:
 	void mute_voices_( int ) override;
 	void set_equalizer_( equalizer_t const& ) override;
 	blargg_err_t play_( long, sample_t* ) override;
+	blargg_err_t skip_muted_( long ) override;
+	blargg_err_t sync_state_( Emu_State& ) override;
 private:
 	Multi_Buffer* buf;
 	Multi_Buffer* stereo_buffer; // NULL if using custom buffer
@@ -2,6 +2,7 @@
 
 #include "Dual_Resampler.h"
 
+#include "Emu_State.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -110,6 +111,54 @@ void Dual_Resampler::dual_play( long count, dsample_t* out, Blip_Buffer& blip_bu
 	}
 }
 
+void Dual_Resampler::skip_frame_( Blip_Buffer& blip_buf )
+{
+	long pair_count = sample_buf_size >> 1;
+	blip_time_t blip_time = blip_buf.count_clocks( pair_count );
+	int sample_count = oversamples_per_frame - resampler.written();
+
+	int new_count = play_frame( blip_time, sample_count, resampler.buffer() );
+	assert( new_count < resampler_size );
+
+	blip_buf.end_frame( blip_time );
+	assert( blip_buf.samples_avail() == pair_count );
+
+	resampler.write( new_count );
+
+#ifdef	NDEBUG // Avoid warning when asserts are disabled
+	resampler.skip_output( sample_buf_size );
+#else
+	long count = resampler.skip_output( sample_buf_size );
+	assert( count == (long) sample_buf_size );
+#endif
+
+	blip_buf.skip_samples( pair_count );
+}
+
+void Dual_Resampler::dual_skip( long count, Blip_Buffer& blip_buf )
+{
+	// empty extra buffer
+	long remain = sample_buf_size - buf_pos;
+	if ( remain > count )
+		remain = count;
+	count -= remain;
+	buf_pos += remain;
+
+	// entire frames
+	while ( count >= (long) sample_buf_size )
+	{
+		skip_frame_( blip_buf );
+		count -= sample_buf_size;
+	}
+
+	// extra
+	if ( count )
+	{
+		play_frame_( blip_buf, sample_buf.begin() );
+		buf_pos = count;
+	}
+}
+
 void Dual_Resampler::mix_samples( Blip_Buffer& blip_buf, dsample_t* out )
 {
 	Blip_Reader sn;
@@ -137,3 +186,9 @@ void Dual_Resampler::mix_samples( Blip_Buffer& blip_buf, dsample_t* out )
 	sn.end( blip_buf );
 }
 
+void Dual_Resampler::sync_state( Emu_State& s )
+{
+	s( buf_pos );
+	s.sync( sample_buf.begin(), sample_buf_size * sizeof sample_buf [0] );
+	resampler.sync_state( s );
+}
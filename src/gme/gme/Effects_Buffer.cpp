@@ -2,6 +2,8 @@
 
 #include "Effects_Buffer.h"
 
+#include "Emu_State.h"
+
 #include <string.h>
 #include <algorithm>
 
@@ -22,6 +24,12 @@ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA */
 	#include BLARGG_ENABLE_OPTIMIZER
 #endif
 
+#if BLARGG_SSE2
+	#include <emmintrin.h>
+#elif BLARGG_NEON
+	#include <arm_neon.h>
+#endif
+
 typedef int32_t fixed_t;
 
 using std::min;
@@ -34,9 +42,10 @@ static const unsigned echo_size = 4096;
 static const unsigned echo_mask = echo_size - 1;
 static_assert( (echo_size & echo_mask) == 0, "echo_size must be a power of 2" );
 
+// left reverb in first half, right in second
 static const unsigned reverb_size = 8192 * 2;
-static const unsigned reverb_mask = reverb_size - 1;
-static_assert( (reverb_size & reverb_mask) == 0, "reverb_size must be a power of 2" );
+static const unsigned reverb_mask = reverb_size / 2 - 1;
+static_assert( (reverb_size / 2 & reverb_mask) == 0, "reverb_size must be a power of 2" );
 
 Effects_Buffer::config_t::config_t()
 {
@@ -134,6 +143,14 @@ void Effects_Buffer::clear()
 	stereo_remain = 0;
 	effect_remain = 0;
 
+	clear_echo();
+
+	for ( int i = 0; i < buf_count; i++ )
+		bufs [i].clear();
+}
+
+void Effects_Buffer::clear_echo()
+{
 	for(int i=0; i<max_voices; i++)
 	{
 		if ( echo_buf[i].size() )
@@ -142,9 +159,19 @@ void Effects_Buffer::clear()
 		if ( reverb_buf[i].size() )
 			memset( &reverb_buf[i][0], 0, reverb_size * sizeof reverb_buf[i][0] );
 	}
+}
 
+void Effects_Buffer::sync_state( Emu_State& state )
+{
+	state( stereo_remain );
+	state( effect_remain );
 	for ( int i = 0; i < buf_count; i++ )
-		bufs [i].clear();
+		state.sync( bufs [i] );
+
+	// echo and reverb history isn't saved, since its size would depend on whether
+	// effects are enabled; losing it only affects the tail of the echo
+	if ( state.loading() )
+		clear_echo();
 }
 
 inline int pin_range( int n, int max, int min = 0 )
@@ -191,9 +218,9 @@ void Effects_Buffer::config( const config_t& cfg )
 
 		int reverb_sample_delay = int (1.0 / 1000 * config_.reverb_delay * sample_rate());
 		chans.reverb_delay_l = pin_range( reverb_size -
-				(reverb_sample_delay - delay_offset) * 2, reverb_size - 2, 0 );
+				(reverb_sample_delay - delay_offset) * 2, reverb_size - 2, 0 ) / 2;
 		chans.reverb_delay_r = pin_range( reverb_size + 1 -
-				(reverb_sample_delay + delay_offset) * 2, reverb_size - 1, 1 );
+				(reverb_sample_delay + delay_offset) * 2, reverb_size - 1, 1 ) / 2;
 
 		int echo_sample_delay = int (1.0 / 1000 * config_.echo_delay * sample_rate());
 		chans.echo_delay_l = pin_range( echo_size - 1 - (echo_sample_delay - delay_offset),
@@ -291,6 +318,54 @@ long Effects_Buffer::samples_avail() const
 	return bufs [0].samples_avail() * 2;
 }
 
+long Effects_Buffer::skip_samples( long total_samples )
+{
+	const int n_channels = max_voices * 2;
+	const int buf_count_per_voice = buf_count/max_voices;
+
+	require( total_samples % n_channels == 0 ); // as many items needed to fill at least one frame
+
+	long remain = bufs [0].samples_avail();
+	total_samples = remain = min( remain, total_samples/n_channels );
+
+	while ( remain )
+	{
+		// echo and reverb are fed from the mix, so while they're still
+		// sounding it's mixed into scratch buffer as usual
+		if ( effect_remain )
+		{
+			blip_sample_t scratch [1024];
+			long count = min( remain, min( effect_remain, (long) (sizeof scratch / sizeof *scratch / n_channels) ) );
+			read_samples( scratch, count * n_channels );
+			remain -= count;
+			continue;
+		}
+
+		// otherwise the same buffers read_samples() would mix are only run
+		// through their integrators
+		long count = remain;
+		int active_bufs = (stereo_remain ? 3 : 1);
+		remain -= count;
+
+		stereo_remain -= count;
+		if ( stereo_remain < 0 )
+			stereo_remain = 0;
+
+		for ( int v = 0; v < max_voices; v++ ) // foreach voice
+		{
+			for ( int i = 0; i < buf_count_per_voice; i++) // foreach buffer of that voice
+			{
+				if ( i < active_bufs )
+					bufs [v*buf_count_per_voice + i].skip_samples( count );
+				else // keep time synchronized
+					bufs [v*buf_count_per_voice + i].remove_silence( count );
+			}
+		}
+	}
+
+	return total_samples * n_channels;
+}
+
 long Effects_Buffer::read_samples( blip_sample_t* out, long total_samples )
 {
 	const int n_channels = max_voices * 2;
@@ -403,191 +478,277 @@ void Effects_Buffer::mix_mono( blip_sample_t* out_, int32_t count )
     }
 }
 
-void Effects_Buffer::mix_stereo( blip_sample_t* out_, int32_t frames )
+void Effects_Buffer::mix_stereo( blip_sample_t* out, int32_t frames )
 {
-    for(int i=0; i<max_voices; i++)
-    {
-	blip_sample_t* BLIP_RESTRICT out = out_;
-	int const bass = BLIP_READER_BASS( bufs [i*max_buf_count+0] );
-	BLIP_READER_BEGIN( c, bufs [i*max_buf_count+0] );
-	BLIP_READER_BEGIN( l, bufs [i*max_buf_count+1] );
-	BLIP_READER_BEGIN( r, bufs [i*max_buf_count+2] );
-
-	int count = frames;
-	while ( count-- )
+	for ( int i = 0; i < max_voices; i++ )
 	{
-		int cs = BLIP_READER_READ( c );
-		BLIP_READER_NEXT( c, bass );
-		int left = cs + BLIP_READER_READ( l );
-		int right = cs + BLIP_READER_READ( r );
-		BLIP_READER_NEXT( l, bass );
-		BLIP_READER_NEXT( r, bass );
-
-		if ( (int16_t) left != left )
-			left = 0x7FFF - (left >> 24);
-
-		if ( (int16_t) right != right )
-			right = 0x7FFF - (right >> 24);
-
-		out [i*2+0] = left;
-		out [i*2+1] = right;
-
-		out += max_voices*2;
-
+		Blip_Buffer* voice = &bufs [i*max_buf_count];
+		blip_read_stereo( &voice [0], voice [1], voice [2], BLIP_READER_BASS( voice [0] ),
+				out + i*2, frames, max_voices*2 );
 	}
-
-	BLIP_READER_END( r, bufs [i*max_buf_count+2] );
-	BLIP_READER_END( l, bufs [i*max_buf_count+1] );
-	BLIP_READER_END( c, bufs [i*max_buf_count+0] );
-    }
 }
 
-void Effects_Buffer::mix_mono_enhanced( blip_sample_t* out_, int32_t frames )
+void Effects_Buffer::mix_mono_enhanced( blip_sample_t* out, int32_t frames )
 {
-	for(int i=0; i<max_voices; i++)
-	{
-	blip_sample_t* BLIP_RESTRICT out = out_;
-	int const bass = BLIP_READER_BASS( bufs [i*max_buf_count+2] );
-	BLIP_READER_BEGIN( center, bufs [i*max_buf_count+2] );
-	BLIP_READER_BEGIN( sq1, bufs [i*max_buf_count+0] );
-	BLIP_READER_BEGIN( sq2, bufs [i*max_buf_count+1] );
-
-	blip_sample_t* const reverb_buf = &this->reverb_buf[i][0];
-	blip_sample_t* const echo_buf = &this->echo_buf[i][0];
-	int echo_pos = this->echo_pos[i];
-	int reverb_pos = this->reverb_pos[i];
-
-	int count = frames;
-	while ( count-- )
-	{
-		int sum1_s = BLIP_READER_READ( sq1 );
-		int sum2_s = BLIP_READER_READ( sq2 );
-
-		BLIP_READER_NEXT( sq1, bass );
-		BLIP_READER_NEXT( sq2, bass );
-
-		int new_reverb_l = FMUL( sum1_s, chans.pan_1_levels [0] ) +
-				FMUL( sum2_s, chans.pan_2_levels [0] ) +
-				reverb_buf [(reverb_pos + chans.reverb_delay_l) & reverb_mask];
+	mix_effects( out, frames, false );
+}
 
-		int new_reverb_r = FMUL( sum1_s, chans.pan_1_levels [1] ) +
-				FMUL( sum2_s, chans.pan_2_levels [1] ) +
-				reverb_buf [(reverb_pos + chans.reverb_delay_r) & reverb_mask];
+void Effects_Buffer::mix_enhanced( blip_sample_t* out, int32_t frames )
+{
+	mix_effects( out, frames, true );
+}
 
-		fixed_t reverb_level = chans.reverb_level;
-		reverb_buf [reverb_pos] = (blip_sample_t) FMUL( new_reverb_l, reverb_level );
-		reverb_buf [reverb_pos + 1] = (blip_sample_t) FMUL( new_reverb_r, reverb_level );
-		reverb_pos = (reverb_pos + 2) & reverb_mask;
+// Effects are mixed in blocks. Each voice's buffers are read into separate
+// arrays, then pan, echo and reverb are applied to four frames at a time, and
+// finally left and right are clamped and interleaved into output. A block is
+// never longer than the shortest delay, so echo and reverb only read samples
+// written by earlier blocks.
 
-		int sum3_s = BLIP_READER_READ( center );
-		BLIP_READER_NEXT( center, bass );
+enum { effects_block = 256 };
 
-		int left = new_reverb_l + sum3_s + FMUL( chans.echo_level,
-				echo_buf [(echo_pos + chans.echo_delay_l) & echo_mask] );
-		int right = new_reverb_r + sum3_s + FMUL( chans.echo_level,
-				echo_buf [(echo_pos + chans.echo_delay_r) & echo_mask] );
+#if BLARGG_SSE2
 
-		echo_buf [echo_pos] = sum3_s;
-		echo_pos = (echo_pos + 1) & echo_mask;
+typedef __m128i fx4_t;
 
-		if ( (int16_t) left != left )
-			left = 0x7FFF - (left >> 24);
+static inline fx4_t fx4_set( fixed_t n )        { return _mm_set1_epi32( n ); }
+static inline fx4_t fx4_add( fx4_t x, fx4_t y ) { return _mm_add_epi32( x, y ); }
+static inline fx4_t fx4_load( blip_long const* p ) { return _mm_loadu_si128( (__m128i const*) p ); }
 
-		if ( (int16_t) right != right )
-			right = 0x7FFF - (right >> 24);
+static inline fx4_t fx4_load16( blip_sample_t const* p )
+{
+	__m128i v = _mm_loadl_epi64( (__m128i const*) p );
+	return _mm_srai_epi32( _mm_unpacklo_epi16( v, v ), 16 );
+}
 
-		out [i*2+0] = left;
-		out [i*2+1] = right;
-		out += max_voices*2;
-	}
-	this->reverb_pos[i] = reverb_pos;
-	this->echo_pos[i] = echo_pos;
+// Low 16 bits of each, like a cast to blip_sample_t
+static inline void fx4_store16( blip_sample_t* p, fx4_t x )
+{
+	x = _mm_srai_epi32( _mm_slli_epi32( x, 16 ), 16 );
+	_mm_storel_epi64( (__m128i*) p, _mm_packs_epi32( x, x ) );
+}
 
-	BLIP_READER_END( sq1, bufs [i*max_buf_count+0] );
-	BLIP_READER_END( sq2, bufs [i*max_buf_count+1] );
-	BLIP_READER_END( center, bufs [i*max_buf_count+2] );
-    }
+// FMUL() with full 64-bit product, as it is done on long
+static inline fx4_t fx4_fmul( fx4_t x, fx4_t y )
+{
+	__m128i even = _mm_mul_epu32( x, y );
+	__m128i odd  = _mm_mul_epu32( _mm_srli_epi64( x, 32 ), _mm_srli_epi64( y, 32 ) );
+	__m128i lo_hi_01 = _mm_unpacklo_epi32( even, odd );
+	__m128i lo_hi_23 = _mm_unpackhi_epi32( even, odd );
+	__m128i lo = _mm_unpacklo_epi64( lo_hi_01, lo_hi_23 );
+	__m128i hi = _mm_unpackhi_epi64( lo_hi_01, lo_hi_23 );
+
+	// unsigned to signed product
+	hi = _mm_sub_epi32( hi, _mm_and_si128( _mm_srai_epi32( x, 31 ), y ) );
+	hi = _mm_sub_epi32( hi, _mm_and_si128( _mm_srai_epi32( y, 31 ), x ) );
+	return _mm_or_si128( _mm_srli_epi32( lo, 15 ), _mm_slli_epi32( hi, 32 - 15 ) );
 }
 
-void Effects_Buffer::mix_enhanced( blip_sample_t* out_, int32_t frames )
+// Clamp and interleave four frames
+static inline void fx4_store_stereo( blip_sample_t* out, int stride, fx4_t l, fx4_t r )
 {
-    for(int i=0; i<max_voices; i++)
-    {
-	blip_sample_t* BLIP_RESTRICT out = out_;
-	int const bass = BLIP_READER_BASS( bufs [i*max_buf_count+2] );
-	BLIP_READER_BEGIN( center, bufs [i*max_buf_count+2] );
-	BLIP_READER_BEGIN( l1, bufs [i*max_buf_count+3] );
-	BLIP_READER_BEGIN( r1, bufs [i*max_buf_count+4] );
-	BLIP_READER_BEGIN( l2, bufs [i*max_buf_count+5] );
-	BLIP_READER_BEGIN( r2, bufs [i*max_buf_count+6] );
-	BLIP_READER_BEGIN( sq1, bufs [i*max_buf_count+0] );
-	BLIP_READER_BEGIN( sq2, bufs [i*max_buf_count+1] );
-
-	blip_sample_t* const reverb_buf = &this->reverb_buf[i][0];
-	blip_sample_t* const echo_buf = &this->echo_buf[i][0];
-	int echo_pos = this->echo_pos[i];
-	int reverb_pos = this->reverb_pos[i];
-
-	int count = frames;
-	while ( count-- )
+	__m128i pairs = _mm_packs_epi32( _mm_unpacklo_epi32( l, r ), _mm_unpackhi_epi32( l, r ) );
+	if ( stride == 2 )
 	{
-		int sum1_s = BLIP_READER_READ( sq1 );
-		int sum2_s = BLIP_READER_READ( sq2 );
+		_mm_storeu_si128( (__m128i*) out, pairs );
+		return;
+	}
+	for ( int i = 0; i < 4; i++ )
+	{
+		int32_t pair = _mm_cvtsi128_si32( pairs );
+		memcpy( out + i * stride, &pair, sizeof pair );
+		pairs = _mm_srli_si128( pairs, 4 );
+	}
+}
+
+#elif BLARGG_NEON
 
-		BLIP_READER_NEXT( sq1, bass );
-		BLIP_READER_NEXT( sq2, bass );
+typedef int32x4_t fx4_t;
 
-		int new_reverb_l = FMUL( sum1_s, chans.pan_1_levels [0] ) +
-				FMUL( sum2_s, chans.pan_2_levels [0] ) + BLIP_READER_READ( l1 ) +
-				reverb_buf [(reverb_pos + chans.reverb_delay_l) & reverb_mask];
+static inline fx4_t fx4_set( fixed_t n )        { return vdupq_n_s32( n ); }
+static inline fx4_t fx4_add( fx4_t x, fx4_t y ) { return vaddq_s32( x, y ); }
+static inline fx4_t fx4_load( blip_long const* p ) { return vld1q_s32( p ); }
+static inline fx4_t fx4_load16( blip_sample_t const* p ) { return vmovl_s16( vld1_s16( p ) ); }
 
-		int new_reverb_r = FMUL( sum1_s, chans.pan_1_levels [1] ) +
-				FMUL( sum2_s, chans.pan_2_levels [1] ) + BLIP_READER_READ( r1 ) +
-				reverb_buf [(reverb_pos + chans.reverb_delay_r) & reverb_mask];
+// Low 16 bits of each, like a cast to blip_sample_t
+static inline void fx4_store16( blip_sample_t* p, fx4_t x ) { vst1_s16( p, vmovn_s32( x ) ); }
 
-		BLIP_READER_NEXT( l1, bass );
-		BLIP_READER_NEXT( r1, bass );
+// FMUL() with full 64-bit product, as it is done on long
+static inline fx4_t fx4_fmul( fx4_t x, fx4_t y )
+{
+	return vcombine_s32(
+			vshrn_n_s64( vmull_s32( vget_low_s32 ( x ), vget_low_s32 ( y ) ), 15 ),
+			vshrn_n_s64( vmull_s32( vget_high_s32( x ), vget_high_s32( y ) ), 15 ) );
+}
+
+// Clamp and interleave four frames
+static inline void fx4_store_stereo( blip_sample_t* out, int stride, fx4_t l, fx4_t r )
+{
+	int16x4x2_t pairs = { { vqmovn_s32( l ), vqmovn_s32( r ) } };
+	if ( stride == 2 )
+	{
+		vst2_s16( out, pairs );
+		return;
+	}
+	for ( int i = 0; i < 4; i++ )
+	{
+		out [i * stride + 0] = vget_lane_s16( pairs.val [0], 0 );
+		out [i * stride + 1] = vget_lane_s16( pairs.val [1], 0 );
+		pairs.val [0] = vext_s16( pairs.val [0], pairs.val [0], 1 );
+		pairs.val [1] = vext_s16( pairs.val [1], pairs.val [1], 1 );
+	}
+}
 
-		fixed_t reverb_level = chans.reverb_level;
-		reverb_buf [reverb_pos] = (blip_sample_t) FMUL( new_reverb_l, reverb_level );
-		reverb_buf [reverb_pos + 1] = (blip_sample_t) FMUL( new_reverb_r, reverb_level );
-		reverb_pos = (reverb_pos + 2) & reverb_mask;
+#endif
 
-		int sum3_s = BLIP_READER_READ( center );
-		BLIP_READER_NEXT( center, bass );
+// Copy 'count' samples from ring buffer, starting at 'pos'
+static void ring_read( blip_sample_t const* ring, unsigned mask, unsigned pos,
+		blip_sample_t* out, int count )
+{
+	pos &= mask;
+	int first = min( count, (int) (mask + 1 - pos) );
+	memcpy( out, ring + pos, first * sizeof *out );
+	memcpy( out + first, ring, (count - first) * sizeof *out );
+}
 
-		int left = new_reverb_l + sum3_s + BLIP_READER_READ( l2 ) + FMUL( chans.echo_level,
-				echo_buf [(echo_pos + chans.echo_delay_l) & echo_mask] );
-		int right = new_reverb_r + sum3_s + BLIP_READER_READ( r2 ) + FMUL( chans.echo_level,
-				echo_buf [(echo_pos + chans.echo_delay_r) & echo_mask] );
+static void ring_write( blip_sample_t* ring, unsigned mask, unsigned pos,
+		blip_sample_t const* in, int count )
+{
+	pos &= mask;
+	int first = min( count, (int) (mask + 1 - pos) );
+	memcpy( ring + pos, in, first * sizeof *in );
+	memcpy( ring, in + first, (count - first) * sizeof *in );
+}
 
-		BLIP_READER_NEXT( l2, bass );
-		BLIP_READER_NEXT( r2, bass );
+void Effects_Buffer::mix_effects( blip_sample_t* out_, int32_t frames, bool stereo )
+{
+	// shortest delay, in frames
+	int block = effects_block;
+	block = min( block, (int) (reverb_size / 2 - chans.reverb_delay_l) );
+	block = min( block, (int) (reverb_size / 2 - chans.reverb_delay_r) );
+	block = min( block, (int) (echo_size - chans.echo_delay_l) );
+	block = min( block, (int) (echo_size - chans.echo_delay_r) );
+
+	int const stride = max_voices * 2;
+	for ( int i = 0; i < max_voices; i++ )
+	{
+		Blip_Buffer* const voice = &bufs [i*max_buf_count];
+		int const bass = BLIP_READER_BASS( voice [2] );
+		blip_sample_t* const reverb_l = &reverb_buf [i] [0];
+		blip_sample_t* const reverb_r = reverb_l + reverb_size / 2;
+		blip_sample_t* const echo = &echo_buf [i] [0];
+
+		blip_long sq1 [effects_block], sq2 [effects_block], center [effects_block];
+		blip_long l1 [effects_block], r1 [effects_block];
+		blip_long l2 [effects_block], r2 [effects_block];
+		blip_sample_t reverb_in_l [effects_block], reverb_in_r [effects_block];
+		blip_sample_t echo_in_l [effects_block], echo_in_r [effects_block];
+		blip_sample_t reverb_out_l [effects_block], reverb_out_r [effects_block];
+		blip_sample_t echo_out [effects_block];
+
+		for ( int32_t done = 0; done < frames; )
+		{
+			int const count = min( frames - done, (int32_t) block );
 
-		echo_buf [echo_pos] = sum3_s;
-		echo_pos = (echo_pos + 1) & echo_mask;
+			Blip_Buffer* in1 [4] = { &voice [0], &voice [1], &voice [2], &voice [3] };
+			blip_long* out1 [4] = { sq1, sq2, center, l1 };
+			blip_read_planar( in1, (stereo ? 4 : 3), bass, out1, done, count );
+			if ( stereo )
+			{
+				Blip_Buffer* in2 [3] = { &voice [4], &voice [5], &voice [6] };
+				blip_long* out2 [3] = { r1, l2, r2 };
+				blip_read_planar( in2, 3, bass, out2, done, count );
+			}
 
-		if ( (int16_t) left != left )
-			left = 0x7FFF - (left >> 24);
+			int const reverb_pos = this->reverb_pos [i];
+			int const echo_pos   = this->echo_pos [i];
+			ring_read( reverb_l, reverb_mask, reverb_pos + chans.reverb_delay_l, reverb_in_l, count );
+			ring_read( reverb_r, reverb_mask, reverb_pos + chans.reverb_delay_r, reverb_in_r, count );
+			ring_read( echo, echo_mask, echo_pos + chans.echo_delay_l, echo_in_l, count );
+			ring_read( echo, echo_mask, echo_pos + chans.echo_delay_r, echo_in_r, count );
+
+			blip_sample_t* BLIP_RESTRICT out = out_ + done * stride + i * 2;
+			int n = 0;
+
+		#if BLARGG_SSE2 || BLARGG_NEON
+			fx4_t const pan_1_l = fx4_set( chans.pan_1_levels [0] );
+			fx4_t const pan_1_r = fx4_set( chans.pan_1_levels [1] );
+			fx4_t const pan_2_l = fx4_set( chans.pan_2_levels [0] );
+			fx4_t const pan_2_r = fx4_set( chans.pan_2_levels [1] );
+			fx4_t const reverb_level = fx4_set( chans.reverb_level );
+			fx4_t const echo_level   = fx4_set( chans.echo_level );
+			for ( ; n + 4 <= count; n += 4 )
+			{
+				fx4_t s1 = fx4_load( sq1 + n );
+				fx4_t s2 = fx4_load( sq2 + n );
+				fx4_t new_reverb_l = fx4_add( fx4_add( fx4_fmul( s1, pan_1_l ),
+						fx4_fmul( s2, pan_2_l ) ), fx4_load16( reverb_in_l + n ) );
+				fx4_t new_reverb_r = fx4_add( fx4_add( fx4_fmul( s1, pan_1_r ),
+						fx4_fmul( s2, pan_2_r ) ), fx4_load16( reverb_in_r + n ) );
+				if ( stereo )
+				{
+					new_reverb_l = fx4_add( new_reverb_l, fx4_load( l1 + n ) );
+					new_reverb_r = fx4_add( new_reverb_r, fx4_load( r1 + n ) );
+				}
+				fx4_store16( reverb_out_l + n, fx4_fmul( new_reverb_l, reverb_level ) );
+				fx4_store16( reverb_out_r + n, fx4_fmul( new_reverb_r, reverb_level ) );
+
+				fx4_t c = fx4_load( center + n );
+				fx4_store16( echo_out + n, c );
+				fx4_t left  = fx4_add( fx4_add( new_reverb_l, c ),
+						fx4_fmul( echo_level, fx4_load16( echo_in_l + n ) ) );
+				fx4_t right = fx4_add( fx4_add( new_reverb_r, c ),
+						fx4_fmul( echo_level, fx4_load16( echo_in_r + n ) ) );
+				if ( stereo )
+				{
+					left  = fx4_add( left,  fx4_load( l2 + n ) );
+					right = fx4_add( right, fx4_load( r2 + n ) );
+				}
+
+				fx4_store_stereo( out + n * stride, stride, left, right );
+			}
+		#endif
 
-		if ( (int16_t) right != right )
-			right = 0x7FFF - (right >> 24);
+			for ( ; n < count; n++ )
+			{
+				int new_reverb_l = FMUL( sq1 [n], chans.pan_1_levels [0] ) +
+						FMUL( sq2 [n], chans.pan_2_levels [0] ) + reverb_in_l [n];
+				int new_reverb_r = FMUL( sq1 [n], chans.pan_1_levels [1] ) +
+						FMUL( sq2 [n], chans.pan_2_levels [1] ) + reverb_in_r [n];
+				if ( stereo )
+				{
+					new_reverb_l += l1 [n];
+					new_reverb_r += r1 [n];
+				}
+				reverb_out_l [n] = (blip_sample_t) FMUL( new_reverb_l, chans.reverb_level );
+				reverb_out_r [n] = (blip_sample_t) FMUL( new_reverb_r, chans.reverb_level );
+
+				int c = center [n];
+				echo_out [n] = (blip_sample_t) c;
+				int left  = new_reverb_l + c + FMUL( chans.echo_level, echo_in_l [n] );
+				int right = new_reverb_r + c + FMUL( chans.echo_level, echo_in_r [n] );
+				if ( stereo )
+				{
+					left  += l2 [n];
+					right += r2 [n];
+				}
+
+				if ( (int16_t) left != left )
+					left = 0x7FFF - (left >> 24);
+
+				if ( (int16_t) right != right )
+					right = 0x7FFF - (right >> 24);
+
+				out [n * stride + 0] = left;
+				out [n * stride + 1] = right;
+			}
 
-		out [i*2+0] = left;
-		out [i*2+1] = right;
+			ring_write( reverb_l, reverb_mask, reverb_pos, reverb_out_l, count );
+			ring_write( reverb_r, reverb_mask, reverb_pos, reverb_out_r, count );
+			ring_write( echo, echo_mask, echo_pos, echo_out, count );
+			this->reverb_pos [i] = (reverb_pos + count) & reverb_mask;
+			this->echo_pos [i] = (echo_pos + count) & echo_mask;
 
-		out += max_voices*2;
+			done += count;
+		}
 	}
-	this->reverb_pos[i] = reverb_pos;
-	this->echo_pos[i] = echo_pos;
-
-	BLIP_READER_END( l1, bufs [i*max_buf_count+3] );
-	BLIP_READER_END( r1, bufs [i*max_buf_count+4] );
-	BLIP_READER_END( l2, bufs [i*max_buf_count+5] );
-	BLIP_READER_END( r2, bufs [i*max_buf_count+6] );
-	BLIP_READER_END( sq1, bufs [i*max_buf_count+0] );
-	BLIP_READER_END( sq2, bufs [i*max_buf_count+1] );
-	BLIP_READER_END( center, bufs [i*max_buf_count+2] );
-    }
 }
-
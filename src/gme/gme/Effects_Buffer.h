@@ -51,7 +51,9 @@ public:
 	channel_t channel( int, int );
 	void end_frame( blip_time_t );
 	long read_samples( blip_sample_t*, long );
+	long skip_samples( long );
 	long samples_avail() const;
+	void sync_state( Emu_State& );
 private:
 	typedef long fixed_t;
 	int max_voices;
@@ -81,10 +83,12 @@ private:
 		fixed_t reverb_level;
 	} chans;
 
+	void clear_echo();
 	void mix_mono( blip_sample_t*, int32_t );
 	void mix_stereo( blip_sample_t*, int32_t );
 	void mix_enhanced( blip_sample_t*, int32_t );
 	void mix_mono_enhanced( blip_sample_t*, int32_t );
+	void mix_effects( blip_sample_t*, int32_t, bool stereo );
 };
 
 #endif
@@ -0,0 +1,60 @@
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+
+#include "Emu_State.h"
+
+#include "Blip_Buffer.h"
+#include <string.h>
+
+/* This module is free software; you can redistribute it and/or modify it
+under the terms of the GNU Lesser General Public License as published by the
+Free Software Foundation; either version 2.1 of the License, or (at your
+option) any later version. This module is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+Public License for more details. You should have received a copy of the GNU
+Lesser General Public License along with this module; if not, write to the
+Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+02110-1301 USA */
+
+#include "blargg_source.h"
+
+void Emu_State::sync( void* p, long size )
+{
+	switch ( mode_ )
+	{
+	case save:
+		memcpy( pos, p, size );
+		pos += size;
+		break;
+
+	case load:
+		memcpy( p, pos, size );
+		pos += size;
+		break;
+
+	case measure:
+		break;
+	}
+	size_ += size;
+}
+
+void Emu_State::sync( Blip_Buffer& buf )
+{
+	if ( !buf.buffer_size_ )
+		return;
+
+	int modified = buf.clear_modified();
+	(*this)( modified );
+	if ( modified )
+		buf.set_modified();
+	(*this)( buf.offset_ );
+	(*this)( buf.reader_accum_ );
+
+	// Only samples waiting to be read and the tail of the most recent impulses
+	// are live; the rest of the buffer is always silent between frames.
+	long live = buf.samples_avail() + blip_buffer_extra_;
+	sync( buf.buffer_, live * sizeof *buf.buffer_ );
+	if ( loading() )
+		memset( buf.buffer_ + live, 0,
+				(buf.buffer_size_ + blip_buffer_extra_ - live) * sizeof *buf.buffer_ );
+}
@@ -0,0 +1,46 @@
+// Saving and restoring of emulator state, used for seek checkpoints
+
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+#ifndef EMU_STATE_H
+#define EMU_STATE_H
+
+#include "blargg_common.h"
+class Blip_Buffer;
+
+// Copies blocks of emulator state to or from a flat block of memory. The same
+// sync code is used to measure, save and restore, so the three can't get out of
+// step. State is only ever restored into the object it was saved from, during the
+// same track, so objects holding pointers to each other can be copied as raw bytes.
+class Emu_State {
+public:
+	enum mode_t { measure, save, load };
+
+	// Begin syncing. Data must point to size() bytes when saving or loading.
+	Emu_State( mode_t, void* data = 0 );
+
+	// Copy 'size' bytes at 'p' to/from state
+	void sync( void* p, long size );
+
+	// Copy object to/from state
+	template<class T>
+	void operator () ( T& t ) { sync( &t, sizeof t ); }
+
+	// Copy samples waiting in Blip_Buffer, along with its position and integrator
+	void sync( Blip_Buffer& );
+
+	// Number of bytes synced so far
+	long size() const { return size_; }
+
+	mode_t mode() const { return mode_; }
+	bool loading() const { return mode_ == load; }
+
+private:
+	mode_t mode_;
+	unsigned char* pos;
+	long size_;
+};
+
+inline Emu_State::Emu_State( mode_t m, void* data ) :
+		mode_( m ), pos( (unsigned char*) data ), size_( 0 ) { }
+
+#endif
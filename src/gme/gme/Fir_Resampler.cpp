@@ -2,6 +2,7 @@
 
 #include "Fir_Resampler.h"
 
+#include "Emu_State.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -52,10 +53,11 @@ static void gen_sinc( double rolloff, int width, double offset, double spacing,
 	}
 }
 
-Fir_Resampler_::Fir_Resampler_( int width, sample_t* impulses_ ) :
+Fir_Resampler_::Fir_Resampler_( int width, sample_t* impulses_, sample_t* pairs ) :
 	width_( width ),
 	write_offset( width * stereo - stereo ),
-	impulses( impulses_ )
+	impulses( impulses_ ),
+	impulse_pairs( pairs )
 {
 	write_pos = 0;
 	res       = 1;
@@ -123,6 +125,18 @@ double Fir_Resampler_::time_ratio( double new_factor, double rolloff, double gai
 				double (0x7FFF * gain * filter),
 				(int) width_, impulses + i * width_ );
 
+		if ( impulse_pairs )
+		{
+			sample_t const* imp = impulses + i * width_;
+			sample_t* out = impulse_pairs + i * (width_ / 4 * 8);
+			for ( int n = 0; n < width_ / 4 * 4; n += 2 )
+			{
+				out [0] = out [2] = imp [n];
+				out [1] = out [3] = imp [n + 1];
+				out += 4;
+			}
+		}
+
 		pos += fstep;
 		input_per_cycle += step;
 		if ( pos >= 0.9999999 )
@@ -199,3 +213,64 @@ int Fir_Resampler_::skip_input( long count )
 
 	return count;
 }
+
+int Fir_Resampler_::skip_output( int32_t count )
+{
+	sample_t const* in = buf.begin();
+	sample_t const* end_pos = write_pos;
+	uint32_t skip = skip_bits >> imp_phase;
+	int remain = res - imp_phase;
+	int skipped = 0;
+
+	count >>= 1;
+
+	// must match read()
+	const double ratio1 = ratio() - 1.0;
+	const bool should_resample =
+		( ratio1 >= 0 ? ratio1 : -ratio1 ) >= 0.00001;
+
+	if ( end_pos - in >= width_ * stereo )
+	{
+		end_pos -= width_ * stereo;
+		do
+		{
+			count--;
+			if ( count < 0 )
+				break;
+
+			if ( should_resample )
+			{
+				remain--;
+				in += (skip * stereo) & stereo;
+				skip >>= 1;
+
+				if ( !remain )
+				{
+					skip = skip_bits;
+					remain = res;
+				}
+			}
+
+			in += step;
+			skipped++;
+		}
+		while ( in <= end_pos );
+	}
+
+	imp_phase = res - remain;
+
+	int left = write_pos - in;
+	write_pos = &buf [left];
+	memmove( buf.begin(), in, left * sizeof *in );
+
+	return skipped * stereo;
+}
+
+void Fir_Resampler_::sync_state( Emu_State& s )
+{
+	long written = write_pos - buf.begin();
+	s( written );
+	write_pos = buf.begin() + written;
+	s.sync( buf.begin(), written * sizeof *write_pos );
+	s( imp_phase );
+}
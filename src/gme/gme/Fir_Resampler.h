@@ -7,6 +7,12 @@
 #include "blargg_common.h"
 #include <string.h>
 
+#if BLARGG_SSE2
+	#include <emmintrin.h>
+#elif BLARGG_NEON
+	#include <arm_neon.h>
+#endif
+
 class Fir_Resampler_ {
 public:
 
@@ -45,6 +51,9 @@ public:
 	// Skip 'count' input samples. Returns number of samples actually skipped.
 	int skip_input( long count );
 
+	// Save/restore buffered input and phase (see Emu_State.h)
+	void sync_state( class Emu_State& );
+
 // Output
 
 	// Number of extra input samples needed until 'count' output samples are available
@@ -53,6 +62,10 @@ public:
 	// Number of output samples available
 	int avail() const { return avail_( write_pos - &buf [width_ * stereo] ); }
 
+	// Skip at most 'count' output samples without calculating them, advancing
+	// through input exactly as read() would. Returns number of samples skipped.
+	int skip_output( int32_t count );
+
 public:
 	~Fir_Resampler_();
 protected:
@@ -69,8 +82,9 @@ protected:
 	int input_per_cycle;
 	double ratio_;
 	sample_t* impulses;
+	sample_t* impulse_pairs; // for SSE2, each 4 taps stored as k0 k1 k0 k1 k2 k3 k2 k3
 
-	Fir_Resampler_( int width, sample_t* );
+	Fir_Resampler_( int width, sample_t* impulses, sample_t* impulse_pairs = 0 );
 	int avail_( int32_t input_count ) const;
 };
 
@@ -80,8 +94,14 @@ template<int width>
 class Fir_Resampler : public Fir_Resampler_ {
 	static_assert( width >= 4 && width % 2 == 0, "FIR width must be even and have 4 or more points" );
 	short impulses [max_res] [width];
+#if BLARGG_SSE2
+	short impulse_pairs [max_res] [width / 4 * 8];
+public:
+	Fir_Resampler() : Fir_Resampler_( width, impulses [0], impulse_pairs [0] ) { }
+#else
 public:
 	Fir_Resampler() : Fir_Resampler_( width, impulses [0] ) { }
+#endif
 
 	// Read at most 'count' samples. Returns number of samples actually read.
 	typedef short sample_t;
@@ -137,7 +157,54 @@ int Fir_Resampler<width>::read( sample_t* out_begin, int32_t count )
 
 				const sample_t* i = in;
 
+			#if BLARGG_SSE2
+				// L0 R0 L1 R1 -> L0 L1 R0 R1, so that each multiply-add gives
+				// L0*k0 + L1*k1 and R0*k0 + R1*k1
+				{
+					sample_t const* pairs = impulse_pairs [(imp - impulses [0]) / width];
+					__m128i sum = _mm_setzero_si128();
+					for ( int n = width / 4; n; --n )
+					{
+						__m128i s = _mm_loadu_si128( (__m128i const*) i );
+						s = _mm_shufflelo_epi16( s, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+						s = _mm_shufflehi_epi16( s, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+						sum = _mm_add_epi32( sum, _mm_madd_epi16( s,
+								_mm_loadu_si128( (__m128i const*) pairs ) ) );
+						pairs += 8;
+						imp += 4;
+						i += 8;
+					}
+					sum = _mm_add_epi32( sum, _mm_unpackhi_epi64( sum, sum ) );
+					l = _mm_cvtsi128_si32( sum );
+					r = _mm_cvtsi128_si32( _mm_srli_si128( sum, 4 ) );
+				}
+			#elif BLARGG_NEON
+				{
+					int32x4_t sum_l = vdupq_n_s32( 0 );
+					int32x4_t sum_r = vdupq_n_s32( 0 );
+					for ( int n = width / 4; n; --n )
+					{
+						int16x4x2_t s = vld2_s16( i ); // deinterleaves left and right
+						int16x4_t k = vld1_s16( imp );
+						sum_l = vmlal_s16( sum_l, s.val [0], k );
+						sum_r = vmlal_s16( sum_r, s.val [1], k );
+						imp += 4;
+						i += 8;
+					}
+					int32x2_t sum = vpadd_s32(
+							vadd_s32( vget_low_s32( sum_l ), vget_high_s32( sum_l ) ),
+							vadd_s32( vget_low_s32( sum_r ), vget_high_s32( sum_r ) ) );
+					l = vget_lane_s32( sum, 0 );
+					r = vget_lane_s32( sum, 1 );
+				}
+			#endif
+
+				// last pair if width isn't a multiple of 4, or all without SIMD
+			#if BLARGG_SSE2 || BLARGG_NEON
+				for ( int n = width / 2 % 2; n; --n )
+			#else
 				for ( int n = width / 2; n; --n )
+			#endif
 				{
 					int pt0 = imp [0];
 					l += pt0 * i [0];
@@ -3,6 +3,7 @@
 #include "Gbs_Emu.h"
 
 #include "blargg_endian.h"
+#include "Emu_State.h"
 #include <string.h>
 
 /* Copyright (C) 2003-2006 Shay Green. This module is free software; you
@@ -240,6 +241,18 @@ blargg_err_t Gbs_Emu::start_track_( int track )
 	return 0;
 }
 
+blargg_err_t Gbs_Emu::sync_state_( Emu_State& s )
+{
+	RETURN_ERR( Classic_Emu::sync_state_( s ) );
+	s.sync( static_cast<Gb_Cpu*>( this ), sizeof (Gb_Cpu) );
+	s( cpu_time );
+	s( play_period );
+	s( next_play );
+	s( ram );
+	s( apu );
+	return 0;
+}
+
 blargg_err_t Gbs_Emu::run_clocks( blip_time_t& duration, int )
 {
 	cpu_time = 0;
@@ -3,6 +3,7 @@
 #include "Gym_Emu.h"
 
 #include "blargg_endian.h"
+#include "Emu_State.h"
 #include <string.h>
 
 /* Copyright (C) 2003-2006 Shay Green. This module is free software; you
@@ -208,6 +209,11 @@ void Gym_Emu::mute_voices_( int mask )
 	apu.output( (mask & 0x80) ? 0 : &blip_buf );
 }
 
+blargg_err_t Gym_Emu::set_ym2612_emu_( int e )
+{
+	return fm.set_emu( e );
+}
+
 blargg_err_t Gym_Emu::load_mem_( byte const* in, long size )
 {
 	blaarg_static_assert( offsetof (header_t,packed [4]) == header_size, "GYM Header layout incorrect!" );
@@ -247,6 +253,20 @@ blargg_err_t Gym_Emu::start_track_( int track )
 	return 0;
 }
 
+blargg_err_t Gym_Emu::sync_state_( Emu_State& s )
+{
+	s( pos );
+	s( loop_remain );
+	s( dac_amp );
+	s( prev_dac_count );
+	s( dac_enabled );
+	s.sync( blip_buf );
+	fm.sync_state( s );
+	s( apu );
+	Dual_Resampler::sync_state( s );
+	return 0;
+}
+
 void Gym_Emu::run_dac( int dac_count )
 {
 	// Guess beginning and end of sample and adjust rate and buffer position accordingly.
@@ -378,3 +398,9 @@ blargg_err_t Gym_Emu::play_( long count, sample_t* out )
 	Dual_Resampler::dual_play( count, out, blip_buf );
 	return 0;
 }
+
+blargg_err_t Gym_Emu::skip_muted_( long count )
+{
+	Dual_Resampler::dual_skip( count, blip_buf );
+	return 0;
+}
@@ -48,9 +48,12 @@ protected:
 	blargg_err_t track_info_( track_info_t*, int track ) const;
 	blargg_err_t set_sample_rate_( long sample_rate );
 	blargg_err_t start_track_( int );
+	blargg_err_t sync_state_( Emu_State& );
 	blargg_err_t play_( long count, sample_t* );
+	blargg_err_t skip_muted_( long count );
 	void mute_voices_( int );
 	void set_tempo_( double );
+	blargg_err_t set_ym2612_emu_( int );
 	int play_frame( blip_time_t blip_time, int sample_count, sample_t* buf );
 private:
 	// sequence data begin, loop begin, current position, end
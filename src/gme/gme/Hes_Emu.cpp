@@ -3,6 +3,7 @@
 #include "Hes_Emu.h"
 
 #include "blargg_endian.h"
+#include "Emu_State.h"
 #include <string.h>
 #include <algorithm>
 
@@ -256,6 +257,22 @@ blargg_err_t Hes_Emu::start_track_( int track )
 	return 0;
 }
 
+blargg_err_t Hes_Emu::sync_state_( Emu_State& s )
+{
+	RETURN_ERR( Classic_Emu::sync_state_( s ) );
+	s.sync( static_cast<Hes_Cpu*>( this ), sizeof (Hes_Cpu) );
+	s( write_pages );
+	s( play_period );
+	s( last_frame_hook );
+	s( timer_base );
+	s( timer );
+	s( vdp );
+	s( irq );
+	s( apu );
+	s( sgx );
+	return 0;
+}
+
 // Hardware
 
 void Hes_Emu::cpu_write_vdp( int addr, int data )
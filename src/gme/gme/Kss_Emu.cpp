@@ -3,6 +3,7 @@
 #include "Kss_Emu.h"
 
 #include "blargg_endian.h"
+#include "Emu_State.h"
 #include <string.h>
 #include <algorithm>
 
@@ -260,6 +261,25 @@ blargg_err_t Kss_Emu::start_track_( int track )
 	return 0;
 }
 
+blargg_err_t Kss_Emu::sync_state_( Emu_State& s )
+{
+	RETURN_ERR( Classic_Emu::sync_state_( s ) );
+	s.sync( static_cast<Kss_Cpu*>( this ), sizeof (Kss_Cpu) );
+	s( scc_accessed );
+	s( gain_updated );
+	s( scc_enabled );
+	s( play_period );
+	s( next_play );
+	s( ay_latch );
+	s( ram );
+	s( ay );
+	s( scc );
+	if ( sn )
+		s( *sn );
+	s( unmapped_write );
+	return 0;
+}
+
 void Kss_Emu::set_bank( int logical, int physical )
 {
 	unsigned const bank_size = this->bank_size();
@@ -2,6 +2,8 @@
 
 #include "Multi_Buffer.h"
 
+#include "Emu_State.h"
+
 /* Copyright (C) 2003-2006 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
 General Public License as published by the Free Software Foundation; either
@@ -28,6 +30,30 @@ Multi_Buffer::Multi_Buffer( int spf ) : samples_per_frame_( spf )
 
 blargg_err_t Multi_Buffer::set_channel_count( int ) { return 0; }
 
+long Multi_Buffer::skip_samples( long count )
+{
+	blip_sample_t scratch [1024];
+	long total = 0;
+	while ( count > 0 )
+	{
+		long n = count;
+		if ( n > (long) (sizeof scratch / sizeof *scratch) )
+			n = sizeof scratch / sizeof *scratch;
+		n = read_samples( scratch, n );
+		if ( !n )
+			break;
+		count -= n;
+		total += n;
+	}
+	return total;
+}
+
+void Multi_Buffer::sync_state( Emu_State& state )
+{
+	if ( state.loading() )
+		clear();
+}
+
 // Silent_Buffer
 
 Silent_Buffer::Silent_Buffer() : Multi_Buffer( 1 ) // 0 channels would probably confuse
@@ -55,6 +81,19 @@ blargg_err_t Mono_Buffer::set_sample_rate( long rate, int msec )
 	return Multi_Buffer::set_sample_rate( buf.sample_rate(), buf.length() );
 }
 
+void Mono_Buffer::sync_state( Emu_State& state )
+{
+	state.sync( buf );
+}
+
+long Mono_Buffer::skip_samples( long count )
+{
+	if ( count > buf.samples_avail() )
+		count = buf.samples_avail();
+	buf.skip_samples( count );
+	return count;
+}
+
 // Stereo_Buffer
 
 Stereo_Buffer::Stereo_Buffer() : Multi_Buffer( 2 )
@@ -93,6 +132,14 @@ void Stereo_Buffer::clear()
 		bufs [i].clear();
 }
 
+void Stereo_Buffer::sync_state( Emu_State& state )
+{
+	state( stereo_added );
+	state( was_stereo );
+	for ( int i = 0; i < buf_count; i++ )
+		state.sync( bufs [i] );
+}
+
 void Stereo_Buffer::end_frame( blip_time_t clock_count )
 {
 	stereo_added = 0;
@@ -103,6 +150,41 @@ void Stereo_Buffer::end_frame( blip_time_t clock_count )
 	}
 }
 
+long Stereo_Buffer::skip_samples( long count )
+{
+	require( !(count & 1) ); // count must be even
+	count = (unsigned) count / 2;
+
+	long avail = bufs [0].samples_avail();
+	if ( count > avail )
+		count = avail;
+	if ( count )
+	{
+		// same buffers as read_samples() would read
+		int bufs_used = stereo_added | was_stereo;
+		if ( bufs_used <= 1 || (bufs_used & 1) )
+			bufs [0].skip_samples( count );
+		else
+			bufs [0].remove_silence( count );
+
+		for ( int i = 1; i < buf_count; i++ )
+		{
+			if ( bufs_used > 1 )
+				bufs [i].skip_samples( count );
+			else
+				bufs [i].remove_silence( count );
+		}
+
+		if ( !bufs [0].samples_avail() )
+		{
+			was_stereo   = stereo_added;
+			stereo_added = 0;
+		}
+	}
+
+	return count * 2;
+}
+
 long Stereo_Buffer::read_samples( blip_sample_t* out, long count )
 {
 	require( !(count & 1) ); // count must be even
@@ -148,66 +230,14 @@ long Stereo_Buffer::read_samples( blip_sample_t* out, long count )
 	return count * 2;
 }
 
-void Stereo_Buffer::mix_stereo( blip_sample_t* out_, int32_t count )
+void Stereo_Buffer::mix_stereo( blip_sample_t* out, int32_t count )
 {
-	blip_sample_t* BLIP_RESTRICT out = out_;
-	int const bass = BLIP_READER_BASS( bufs [1] );
-	BLIP_READER_BEGIN( left, bufs [1] );
-	BLIP_READER_BEGIN( right, bufs [2] );
-	BLIP_READER_BEGIN( center, bufs [0] );
-
-	for ( ; count; --count )
-	{
-		int c = BLIP_READER_READ( center );
-		int32_t l = c + BLIP_READER_READ( left );
-		int32_t r = c + BLIP_READER_READ( right );
-		if ( (int16_t) l != l )
-			l = 0x7FFF - (l >> 24);
-
-		BLIP_READER_NEXT( center, bass );
-		if ( (int16_t) r != r )
-			r = 0x7FFF - (r >> 24);
-
-		BLIP_READER_NEXT( left, bass );
-		BLIP_READER_NEXT( right, bass );
-
-		out [0] = l;
-		out [1] = r;
-		out += 2;
-	}
-
-	BLIP_READER_END( center, bufs [0] );
-	BLIP_READER_END( right, bufs [2] );
-	BLIP_READER_END( left, bufs [1] );
+	blip_read_stereo( &bufs [0], bufs [1], bufs [2], BLIP_READER_BASS( bufs [1] ), out, count );
 }
 
-void Stereo_Buffer::mix_stereo_no_center( blip_sample_t* out_, int32_t count )
+void Stereo_Buffer::mix_stereo_no_center( blip_sample_t* out, int32_t count )
 {
-	blip_sample_t* BLIP_RESTRICT out = out_;
-	int const bass = BLIP_READER_BASS( bufs [1] );
-	BLIP_READER_BEGIN( left, bufs [1] );
-	BLIP_READER_BEGIN( right, bufs [2] );
-
-	for ( ; count; --count )
-	{
-		int32_t l = BLIP_READER_READ( left );
-		if ( (int16_t) l != l )
-			l = 0x7FFF - (l >> 24);
-
-		int32_t r = BLIP_READER_READ( right );
-		if ( (int16_t) r != r )
-			r = 0x7FFF - (r >> 24);
-
-		BLIP_READER_NEXT( left, bass );
-		BLIP_READER_NEXT( right, bass );
-
-		out [0] = l;
-		out [1] = r;
-		out += 2;
-	}
-
-	BLIP_READER_END( right, bufs [2] );
-	BLIP_READER_END( left, bufs [1] );
+	blip_read_stereo( NULL, bufs [1], bufs [2], BLIP_READER_BASS( bufs [1] ), out, count );
 }
 
 void Stereo_Buffer::mix_mono( blip_sample_t* out_, int32_t count )
@@ -6,6 +6,7 @@
 
 #include "blargg_common.h"
 #include "Blip_Buffer.h"
+class Emu_State;
 
 // Interface to one or more Blip_Buffers mapped to one or more channels
 // consisting of left, center, and right buffers.
@@ -51,6 +52,15 @@ public:
 	virtual long read_samples( blip_sample_t*, long ) = 0;
 	virtual long samples_avail() const = 0;
 
+	// Discard at most 'count' samples without mixing them, when all voices are
+	// muted. Returns number of samples discarded. Default implementation reads
+	// them into a temporary buffer.
+	virtual long skip_samples( long count );
+
+	// Save/restore samples waiting to be read (see Emu_State.h). Default
+	// implementation just clears buffer when restoring.
+	virtual void sync_state( Emu_State& );
+
 public:
 	BLARGG_DISABLE_NOTHROW
 protected:
@@ -83,8 +93,10 @@ public:
 	void clear() { buf.clear(); }
 	long samples_avail() const { return buf.samples_avail(); }
 	long read_samples( blip_sample_t* p, long s ) { return buf.read_samples( p, s ); }
+	long skip_samples( long );
 	channel_t channel( int, int ) { return chan; }
 	void end_frame( blip_time_t t ) { buf.end_frame( t ); }
+	void sync_state( Emu_State& );
 };
 
 // Uses three buffers (one for center) and outputs stereo sample pairs.
@@ -108,6 +120,8 @@ public:
 
 	long samples_avail() const { return bufs [0].samples_avail() * 2; }
 	long read_samples( blip_sample_t*, long );
+	long skip_samples( long );
+	void sync_state( Emu_State& );
 
 private:
 	enum { buf_count = 3 };
@@ -3,6 +3,9 @@
 #include "Music_Emu.h"
 
 #include "Multi_Buffer.h"
+#include "Emu_State.h"
+#include "Output_Filter.h"
+#include <stdlib.h>
 #include <string.h>
 #include <algorithm>
 
@@ -23,6 +26,7 @@ static int const silence_max = 6; // seconds
 static int const silence_threshold = 0x10;
 static long const fade_block_size = 512;
 static int const fade_shift = 8; // fade ends with gain at 1.0 / (1 << fade_shift)
+static int32_t const future_time = INT_MAX / 2 + 1;
 
 using std::min;
 using std::max;
@@ -43,12 +47,15 @@ void Music_Emu::clear_track_vars()
 	silence_time     = 0;
 	silence_count    = 0;
 	buf_remain       = 0;
+	next_checkpoint  = future_time; // scheduled once start of track is found
 	warning(); // clear warning
 }
 
 void Music_Emu::unload()
 {
 	voice_count_ = 0;
+	clear_checkpoints();
+	checkpoints_unsupported = false;
 	clear_track_vars();
 	Gme_File::unload();
 }
@@ -71,6 +78,12 @@ Music_Emu::Music_Emu()
 
 	emu_autoload_playback_limit_ = true;
 
+	checkpoint_count     = 0;
+	checkpoint_bytes     = 0;
+	checkpoint_max_bytes = 0;
+	checkpoint_interval  = 0;
+	checkpoint_period    = 0;
+
 	static const char* const names [] = {
 		"Voice 1", "Voice 2", "Voice 3", "Voice 4",
 		"Voice 5", "Voice 6", "Voice 7", "Voice 8"
@@ -79,7 +92,11 @@ Music_Emu::Music_Emu()
 	Music_Emu::unload(); // non-virtual
 }
 
-Music_Emu::~Music_Emu() { delete effects_buffer; }
+Music_Emu::~Music_Emu()
+{
+	clear_checkpoints();
+	delete effects_buffer;
+}
 
 blargg_err_t Music_Emu::set_sample_rate( long rate )
 {
@@ -98,6 +115,7 @@ void Music_Emu::pre_load()
 
 void Music_Emu::set_equalizer( equalizer_t const& eq )
 {
+	clear_checkpoints();
 	equalizer_ = eq;
 	set_equalizer_( eq );
 }
@@ -140,9 +158,16 @@ void Music_Emu::mute_voices( int mask )
 
 void Music_Emu::disable_echo( bool disable )
 {
+	clear_checkpoints();
 	disable_echo_( disable );
 }
 
+blargg_err_t Music_Emu::set_ym2612_emu( int e )
+{
+	clear_checkpoints();
+	return set_ym2612_emu_( e );
+}
+
 void Music_Emu::set_tempo( double t )
 {
 	require( sample_rate() ); // sample rate must be set first
@@ -150,6 +175,8 @@ void Music_Emu::set_tempo( double t )
 	double const max = 4.00;
 	if ( t < min ) t = min;
 	if ( t > max ) t = max;
+	if ( t != tempo_ )
+		clear_checkpoints(); // checkpoint times assume unchanged tempo
 	tempo_ = t;
 	set_tempo_( t );
 }
@@ -161,6 +188,12 @@ void Music_Emu::post_load_()
 }
 
 blargg_err_t Music_Emu::start_track( int track )
+{
+	clear_checkpoints();
+	return restart_track( track );
+}
+
+blargg_err_t Music_Emu::restart_track( int track )
 {
 	clear_track_vars();
 
@@ -188,6 +221,13 @@ blargg_err_t Music_Emu::start_track( int track )
 		silence_time    = 0;
 		silence_count   = 0;
 	}
+
+	next_checkpoint = checkpoint_period;
+	if ( !checkpoint_period )
+		next_checkpoint = future_time;
+	else if ( checkpoint_count )
+		next_checkpoint += checkpoints [checkpoint_count - 1].time;
+
 	return track_ended() ? warning() : 0;
 }
 
@@ -238,8 +278,11 @@ long Music_Emu::tell_scaled() const
 
 blargg_err_t Music_Emu::seek_samples( long time )
 {
-	if ( time < out_time )
-		RETURN_ERR( start_track( current_track_ ) );
+	checkpoint_t const* cp = find_checkpoint( time, false );
+	if ( cp && (time < out_time || cp->time > emu_time) )
+		RETURN_ERR( load_checkpoint( *cp ) );
+	else if ( time < out_time )
+		RETURN_ERR( restart_track( current_track_ ) );
 	return skip( time - out_time );
 }
 
@@ -252,8 +295,11 @@ blargg_err_t Music_Emu::seek_scaled( long msec )
 {
 	require( tempo_ > 0 );
 	int32_t frames = (msec / 1000.0) * sample_rate();
-	if ( frames < out_time_scaled )
-		RETURN_ERR( start_track( current_track_ ) );
+	checkpoint_t const* cp = find_checkpoint( frames, true );
+	if ( cp && (frames < out_time_scaled || cp->time > emu_time) )
+		RETURN_ERR( load_checkpoint( *cp ) );
+	else if ( frames < out_time_scaled )
+		RETURN_ERR( restart_track( current_track_ ) );
 	int samples_to_skip = (frames - out_time_scaled) * out_channels() / tempo_;
 	samples_to_skip += samples_to_skip % out_channels();
 	return skip( samples_to_skip );
@@ -276,10 +322,17 @@ blargg_err_t Music_Emu::skip( long count )
 		count -= n;
 	}
 
-	if ( count && !emu_track_ended_ )
+	while ( count && !emu_track_ended_ )
 	{
-		emu_time += count;
-		end_track_if_error( skip_( count ) );
+		// skip in pieces so checkpoints are saved along the way
+		if ( emu_time >= next_checkpoint )
+			save_checkpoint();
+		long n = count;
+		if ( n > next_checkpoint - emu_time )
+			n = next_checkpoint - emu_time;
+		count -= n;
+		emu_time += n;
+		end_track_if_error( skip_( n ) );
 	}
 
 	if ( !(silence_count | buf_remain) ) // caught up to emulator, so update track ended
@@ -297,15 +350,28 @@ blargg_err_t Music_Emu::skip_( long count )
 		int saved_mute = mute_mask_;
 		mute_voices( ~0 );
 
-		while ( count > threshold / 2 && !emu_track_ended_ )
-		{
-			RETURN_ERR( play_( buf_size, buf.begin() ) );
-			count -= buf_size;
-		}
+		long n = count - threshold / 2;
+		n -= n % out_channels();
+		count -= n;
+		blargg_err_t err = skip_muted_( n );
 
 		mute_voices( saved_mute );
+		RETURN_ERR( err );
+	}
+
+	while ( count && !emu_track_ended_ )
+	{
+		long n = buf_size;
+		if ( n > count )
+			n = count;
+		count -= n;
+		RETURN_ERR( play_( n, buf.begin() ) );
 	}
+	return 0;
+}
 
+blargg_err_t Music_Emu::skip_muted_( long count )
+{
 	while ( count && !emu_track_ended_ )
 	{
 		long n = buf_size;
@@ -317,6 +383,131 @@ blargg_err_t Music_Emu::skip_( long count )
 	return 0;
 }
 
+blargg_err_t Music_Emu::sync_state_( Emu_State& )
+{
+	return "Saving emulator state not supported";
+}
+
+// Seek checkpoints
+
+void Music_Emu::set_seek_checkpoints( long interval_msec, long max_bytes )
+{
+	clear_checkpoints();
+	checkpoint_interval  = 0;
+	checkpoint_max_bytes = max_bytes;
+	if ( interval_msec > 0 && sample_rate() )
+		checkpoint_interval = msec_to_samples( interval_msec );
+	checkpoint_period = checkpoint_interval;
+
+	next_checkpoint = future_time;
+	if ( checkpoint_period && current_track_ >= 0 )
+		next_checkpoint = emu_time + checkpoint_period;
+}
+
+void Music_Emu::clear_checkpoints()
+{
+	while ( checkpoint_count )
+		free( checkpoints [--checkpoint_count].data );
+	checkpoint_bytes  = 0;
+	checkpoint_period = checkpoint_interval;
+	if ( checkpoint_period && current_track_ >= 0 && next_checkpoint != future_time )
+		next_checkpoint = emu_time + checkpoint_period;
+}
+
+void Music_Emu::drop_alternate_checkpoints()
+{
+	// keep second, fourth, etc. so spacing stays even
+	int kept = 0;
+	for ( int i = 0; i < checkpoint_count; i++ )
+	{
+		if ( i & 1 )
+		{
+			checkpoints [kept++] = checkpoints [i];
+		}
+		else
+		{
+			checkpoint_bytes -= checkpoints [i].size;
+			free( checkpoints [i].data );
+		}
+	}
+	checkpoint_count = kept;
+	checkpoint_period *= 2;
+}
+
+void Music_Emu::save_checkpoint()
+{
+	next_checkpoint = emu_time + checkpoint_period;
+	if ( checkpoints_unsupported )
+		return;
+
+	Emu_State measure( Emu_State::measure );
+	if ( sync_state_( measure ) )
+	{
+		checkpoints_unsupported = true;
+		next_checkpoint = future_time;
+		return;
+	}
+	long size = measure.size();
+
+	while ( checkpoint_count >= max_checkpoints || checkpoint_bytes + size > checkpoint_max_bytes )
+	{
+		if ( checkpoint_count < 2 )
+			return; // one checkpoint doesn't fit; try again next time
+
+		drop_alternate_checkpoints();
+		next_checkpoint = checkpoints [checkpoint_count - 1].time + checkpoint_period;
+		if ( emu_time < next_checkpoint )
+			return;
+	}
+
+	void* data = malloc( size );
+	if ( !data )
+		return;
+
+	Emu_State out( Emu_State::save, data );
+	sync_state_( out );
+	assert( out.size() == size );
+
+	checkpoint_t& cp = checkpoints [checkpoint_count++];
+	cp.time        = emu_time;
+	cp.time_scaled = out_time_scaled + int32_t ((emu_time - out_time) * tempo_ / out_channels());
+	cp.size        = size;
+	cp.data        = data;
+	checkpoint_bytes += size;
+}
+
+blargg_err_t Music_Emu::load_checkpoint( checkpoint_t const& cp )
+{
+	Emu_State in( Emu_State::load, cp.data );
+	RETURN_ERR( sync_state_( in ) );
+	assert( in.size() == cp.size );
+
+	emu_time         = cp.time;
+	out_time         = cp.time;
+	out_time_scaled  = cp.time_scaled;
+	silence_time     = cp.time;
+	silence_count    = 0;
+	buf_remain       = 0;
+	emu_track_ended_ = false;
+	track_ended_     = false;
+	remute_voices();
+
+	next_checkpoint = checkpoints [checkpoint_count - 1].time + checkpoint_period;
+	return 0;
+}
+
+Music_Emu::checkpoint_t const* Music_Emu::find_checkpoint( int32_t time, bool scaled ) const
+{
+	checkpoint_t const* found = 0;
+	for ( int i = 0; i < checkpoint_count; i++ )
+	{
+		if ( (scaled ? checkpoints [i].time_scaled : checkpoints [i].time) > time )
+			break;
+		found = &checkpoints [i];
+	}
+	return found;
+}
+
 // Fading
 
 void Music_Emu::set_fade( long start_msec, long length_msec )
@@ -337,19 +528,13 @@ void Music_Emu::handle_fade( long out_count, sample_t* out )
 {
 	for ( int i = 0; i < out_count; i += fade_block_size )
 	{
-		int const shift = 14;
-		int const unit = 1 << shift;
+		int const unit = Output_Filter::gain_unit;
 		int gain = int_log( (out_time + i - fade_start) / fade_block_size,
 				fade_step, unit );
 		if ( gain < (unit >> fade_shift) )
 			track_ended_ = emu_track_ended_ = true;
 
-		sample_t* io = &out [i];
-		for ( int count = min( fade_block_size, out_count - i ); count; --count )
-		{
-			*io = sample_t ((*io * gain) >> shift);
-			++io;
-		}
+		Output_Filter::scale( &out [i], min( fade_block_size, out_count - i ), gain );
 	}
 }
 
@@ -358,6 +543,8 @@ void Music_Emu::handle_fade( long out_count, sample_t* out )
 void Music_Emu::emu_play( long count, sample_t* out )
 {
 	check( current_track_ >= 0 );
+	if ( emu_time >= next_checkpoint && !emu_track_ended_ )
+		save_checkpoint();
 	emu_time += count;
 	if ( current_track_ >= 0 && !emu_track_ended_ )
 		end_track_if_error( play_( count, out ) );
@@ -6,6 +6,7 @@
 
 #include "Gme_File.h"
 class Multi_Buffer;
+class Emu_State;
 
 struct Music_Emu : public Gme_File {
 public:
@@ -66,6 +67,18 @@ public:
 	// Skip n samples
 	blargg_err_t skip( long n );
 
+	// Save emulator state every interval_msec of emulated time while playing, using
+	// at most max_bytes of memory, so that seeking only has to emulate from the
+	// nearest earlier checkpoint rather than from the beginning of the track. When
+	// memory runs out, every other checkpoint is dropped and the interval doubled.
+	// An interval of 0 disables checkpoints (the default). Has no effect on
+	// emulators which can't save their state.
+	void set_seek_checkpoints( long interval_msec, long max_bytes );
+
+	// Number of checkpoints currently held and total memory they use
+	int seek_checkpoint_count() const           { return checkpoint_count; }
+	long seek_checkpoint_bytes() const          { return checkpoint_bytes; }
+
 	// True if a track has reached its end
 	bool track_ended() const;
 
@@ -115,6 +128,11 @@ public:
 	// equalizer settings.
 	void enable_accuracy( bool enable = true );
 
+	// Selects YM2612 FM sound chip emulator used by VGM and GYM files, one of the
+	// gme_ym2612_* values in gme.h. Can be changed while playing. Has no effect
+	// on other emulators.
+	blargg_err_t set_ym2612_emu( int );
+
 // Sound equalization (treble/bass)
 
 	// Frequency equalizer parameters (see gme.txt)
@@ -147,6 +165,7 @@ protected:
 	void set_voice_count( int n )               { voice_count_ = n; }
 	void set_voice_names( const char* const* names );
 	void set_track_ended()                      { emu_track_ended_ = true; }
+	bool emu_track_ended() const                { return emu_track_ended_; }
 	double gain() const                         { return gain_; }
 	double tempo() const                        { return tempo_; }
 	void remute_voices();
@@ -155,12 +174,22 @@ protected:
 	virtual blargg_err_t set_sample_rate_( long sample_rate ) = 0;
 	virtual void set_equalizer_( equalizer_t const& ) { }
 	virtual void enable_accuracy_( bool /* enable */ ) { }
+	virtual blargg_err_t set_ym2612_emu_( int ) { return 0; }
 	virtual void mute_voices_( int mask );
 	virtual void disable_echo_( bool /* disable */);
 	virtual void set_tempo_( double );
 	virtual blargg_err_t start_track_( int ); // tempo is set before this
 	virtual blargg_err_t play_( long count, sample_t* out ) = 0;
 	virtual blargg_err_t skip_( long count );
+
+	// Run emulator for 'count' samples while all voices are muted. The samples
+	// needn't be generated at all. Default implementation plays into a scratch buffer.
+	virtual blargg_err_t skip_muted_( long count );
+
+	// Save or restore complete emulation state (see Emu_State.h). Called only
+	// between calls to play_() and skip_(). Sound settings such as voice muting
+	// are reapplied after restoring. Returns error if not supported.
+	virtual blargg_err_t sync_state_( Emu_State& );
 protected:
 	virtual void unload();
 	virtual void pre_load();
@@ -192,6 +221,29 @@ private:
 	volatile bool track_ended_;
 	void clear_track_vars();
 	void end_track_if_error( blargg_err_t );
+	blargg_err_t restart_track( int );
+
+	// seek checkpoints
+	struct checkpoint_t {
+		int32_t time;        // emu_time when saved
+		int32_t time_scaled; // out_time_scaled at same point
+		long size;
+		void* data;
+	};
+	enum { max_checkpoints = 128 };
+	checkpoint_t checkpoints [max_checkpoints]; // in order of time
+	int checkpoint_count;
+	long checkpoint_bytes;
+	long checkpoint_max_bytes;
+	int32_t checkpoint_interval; // in samples; 0 if disabled
+	int32_t checkpoint_period;   // current interval, increased as memory fills
+	int32_t next_checkpoint;
+	bool checkpoints_unsupported;
+	void clear_checkpoints();
+	void drop_alternate_checkpoints();
+	void save_checkpoint();
+	blargg_err_t load_checkpoint( checkpoint_t const& );
+	checkpoint_t const* find_checkpoint( int32_t time, bool scaled ) const;
 
 	// fading
 	int32_t fade_start;
@@ -240,7 +292,11 @@ inline int Music_Emu::current_track() const         { return current_track_; }
 inline bool Music_Emu::track_ended() const          { return track_ended_; }
 inline const Music_Emu::equalizer_t& Music_Emu::equalizer() const { return equalizer_; }
 
-inline void Music_Emu::enable_accuracy( bool b )    { enable_accuracy_( b ); }
+inline void Music_Emu::enable_accuracy( bool b )
+{
+	clear_checkpoints();
+	enable_accuracy_( b );
+}
 inline void Music_Emu::set_tempo_( double t )       { tempo_ = t; }
 inline void Music_Emu::remute_voices()              { mute_voices( mute_mask_ ); }
 inline void Music_Emu::ignore_silence( bool b )     { ignore_silence_ = b; }
@@ -1,9 +1,12 @@
 #include "Nes_Vrc7_Apu.h"
 
+#include "Ym2413_Emu.h"
+
 extern "C" {
 #include "ext/emu2413.h"
 }
 
+#include "Emu_State.h"
 #include <string.h>
 
 #include "blargg_source.h"
@@ -22,7 +25,7 @@ Nes_Vrc7_Apu::Nes_Vrc7_Apu()
 
 blargg_err_t Nes_Vrc7_Apu::init()
 {
-	CHECK_ALLOC( opll = OPLL_new( 3579545, 3579545 / 72 ) );
+	CHECK_ALLOC( opll = Ym2413_Emu::new_opll() );
 	OPLL_SetChipMode((OPLL *) opll, 1);
 	OPLL_setPatch((OPLL *) opll, vrc7_inst);
 
@@ -216,3 +219,9 @@ void Nes_Vrc7_Apu::run_until( blip_time_t end_time )
 	}
 	next_time = time;
 }
+
+void Nes_Vrc7_Apu::sync_state( Emu_State& s )
+{
+	s( *this );
+	s.sync( opll, sizeof (OPLL) );
+}
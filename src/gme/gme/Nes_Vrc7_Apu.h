@@ -24,6 +24,7 @@ public:
 	void end_frame( blip_time_t );
 	void save_snapshot( vrc7_snapshot_t* ) const;
 	void load_snapshot( vrc7_snapshot_t const& );
+	void sync_state( class Emu_State& );
 
 	void write_reg( int reg );
 	void write_data( blip_time_t, int data );
@@ -3,6 +3,7 @@
 #include "Nsf_Emu.h"
 
 #include "blargg_endian.h"
+#include "Emu_State.h"
 #include <string.h>
 #include <stdio.h>
 #include <algorithm>
@@ -614,6 +615,32 @@ blargg_err_t Nsf_Emu::start_track_( int track )
 	return 0;
 }
 
+blargg_err_t Nsf_Emu::sync_state_( Emu_State& s )
+{
+	RETURN_ERR( Classic_Emu::sync_state_( s ) );
+	s.sync( static_cast<Nes_Cpu*>( this ), sizeof (Nes_Cpu) );
+	s( saved_state );
+	s( next_play );
+	s( play_period );
+	s( play_extra );
+	s( play_ready );
+	s( mmc5_mul );
+	s( sram );
+	s( apu );
+
+	#if !NSF_EMU_APU_ONLY
+	{
+		if ( namco ) s( *namco );
+		if ( vrc6  ) s( *vrc6  );
+		if ( fme7  ) s( *fme7  );
+		if ( fds   ) s( *fds   );
+		if ( mmc5  ) s( *mmc5  );
+		if ( vrc7  ) vrc7->sync_state( s );
+	}
+	#endif
+	return 0;
+}
+
 blargg_err_t Nsf_Emu::run_clocks( blip_time_t& duration, int )
 {
 	set_time( 0 );
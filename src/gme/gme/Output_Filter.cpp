@@ -0,0 +1,381 @@
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+
+#include "Output_Filter.h"
+
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+/* This module is free software; you can redistribute it and/or modify it
+under the terms of the GNU Lesser General Public License as published by the
+Free Software Foundation; either version 2.1 of the License, or (at your
+option) any later version. This module is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+Public License for more details. You should have received a copy of the GNU
+Lesser General Public License along with this module; if not, write to the
+Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+02110-1301 USA */
+
+#include "blargg_source.h"
+
+#if BLARGG_SSE2
+	#include <emmintrin.h>
+#elif BLARGG_NEON
+	#include <arm_neon.h>
+#endif
+
+using std::min;
+using std::max;
+
+#define PI 3.1415926535897932384626433832795029
+
+int const gain_shift = 14; // gain_unit == 1 << gain_shift
+int const limit_unit = 1 << 13;
+int const limit_block = 64;   // samples limiter level is worked out for at a time
+int const limit_release = 6;  // limiter recovers 1/64 of the way each block
+int const max_level = 0x7FFF << 8; // highest sample inside EQ
+
+Output_Filter::Output_Filter()
+{
+	blaarg_static_assert( gain_unit == 1 << gain_shift, "gain_shift doesn't match gain_unit" );
+	blaarg_static_assert( limit_unit == 1 << limit_bits, "limit_unit doesn't match limit_bits" );
+	blaarg_static_assert( max_level == 0x7FFF << frac_bits, "max_level doesn't match frac_bits" );
+	gain       = gain_unit;
+	fade       = gain_unit;
+	band_count = 0;
+	limiter    = false;
+	clear();
+}
+
+void Output_Filter::clear()
+{
+	memset( hist, 0, sizeof hist );
+	limit = limit_unit;
+}
+
+void Output_Filter::clear_eq()
+{
+	band_count = 0;
+	clear();
+}
+
+// EQ bands, from the Audio EQ Cookbook by Robert Bristow-Johnson
+
+blargg_err_t Output_Filter::add_band( double b0, double b1, double b2,
+		double a0, double a1, double a2 )
+{
+	if ( band_count >= max_bands )
+		return "Too many EQ bands";
+
+	double const coeffs [5] = { b0 / a0, b1 / a0, b2 / a0, a1 / a0, a2 / a0 };
+	int32_t fixed [5];
+	for ( int i = 0; i < 5; i++ )
+	{
+		// keeps accumulator in range for samples up to 24 bits
+		if ( !(fabs( coeffs [i] ) < 7.0) )
+			return "EQ band out of range";
+		fixed [i] = (int32_t) floor( coeffs [i] * (1 << coeff_bits) + 0.5 );
+	}
+
+	band_t& b = bands [band_count];
+	b.b0 = fixed [0];
+	b.b1 = fixed [1];
+	b.b2 = fixed [2];
+	b.a1 = fixed [3];
+	b.a2 = fixed [4];
+	memset( &hist [band_count], 0, sizeof hist [band_count] );
+	band_count++;
+	return 0;
+}
+
+blargg_err_t Output_Filter::add_low_shelf( double sample_rate, double freq, double db, double slope )
+{
+	double const a     = pow( 10.0, db / 40.0 );
+	double const w0    = 2.0 * PI * freq / sample_rate;
+	double const cosw  = cos( w0 );
+	double const alpha = sin( w0 ) / 2.0 * sqrt( (a + 1.0 / a) * (1.0 / slope - 1.0) + 2.0 );
+	double const sa2   = 2.0 * sqrt( a ) * alpha;
+	return add_band(
+			a * ((a + 1) - (a - 1) * cosw + sa2),
+			2 * a * ((a - 1) - (a + 1) * cosw),
+			a * ((a + 1) - (a - 1) * cosw - sa2),
+			(a + 1) + (a - 1) * cosw + sa2,
+			-2 * ((a - 1) + (a + 1) * cosw),
+			(a + 1) + (a - 1) * cosw - sa2 );
+}
+
+blargg_err_t Output_Filter::add_high_shelf( double sample_rate, double freq, double db, double slope )
+{
+	double const a     = pow( 10.0, db / 40.0 );
+	double const w0    = 2.0 * PI * freq / sample_rate;
+	double const cosw  = cos( w0 );
+	double const alpha = sin( w0 ) / 2.0 * sqrt( (a + 1.0 / a) * (1.0 / slope - 1.0) + 2.0 );
+	double const sa2   = 2.0 * sqrt( a ) * alpha;
+	return add_band(
+			a * ((a + 1) + (a - 1) * cosw + sa2),
+			-2 * a * ((a - 1) + (a + 1) * cosw),
+			a * ((a + 1) + (a - 1) * cosw - sa2),
+			(a + 1) - (a - 1) * cosw + sa2,
+			2 * ((a - 1) - (a + 1) * cosw),
+			(a + 1) - (a - 1) * cosw - sa2 );
+}
+
+blargg_err_t Output_Filter::add_peak( double sample_rate, double freq, double db, double q )
+{
+	double const a     = pow( 10.0, db / 40.0 );
+	double const w0    = 2.0 * PI * freq / sample_rate;
+	double const cosw  = cos( w0 );
+	double const alpha = sin( w0 ) / (2.0 * q);
+	return add_band(
+			1 + alpha * a, -2 * cosw, 1 - alpha * a,
+			1 + alpha / a, -2 * cosw, 1 - alpha / a );
+}
+
+// Gain
+
+void Output_Filter::scale( sample_t* io, int count, int gain )
+{
+	int i = 0;
+#if BLARGG_SSE2
+	// each 32-bit lane is (gain, 0), so madd of (s, s) gives s * gain
+	__m128i const g = _mm_set1_epi32( gain & 0xFFFF );
+	for ( ; i + 8 <= count; i += 8 )
+	{
+		__m128i s  = _mm_loadu_si128( (__m128i const*) (io + i) );
+		__m128i lo = _mm_srai_epi32( _mm_madd_epi16( _mm_unpacklo_epi16( s, s ), g ), gain_shift );
+		__m128i hi = _mm_srai_epi32( _mm_madd_epi16( _mm_unpackhi_epi16( s, s ), g ), gain_shift );
+		_mm_storeu_si128( (__m128i*) (io + i), _mm_packs_epi32( lo, hi ) );
+	}
+#elif BLARGG_NEON
+	for ( ; i + 8 <= count; i += 8 )
+	{
+		int16x8_t s = vld1q_s16( io + i );
+		int16x4_t lo = vqshrn_n_s32( vmull_n_s16( vget_low_s16 ( s ), (int16_t) gain ), gain_shift );
+		int16x4_t hi = vqshrn_n_s32( vmull_n_s16( vget_high_s16( s ), (int16_t) gain ), gain_shift );
+		vst1q_s16( io + i, vcombine_s16( lo, hi ) );
+	}
+#endif
+	for ( ; i < count; i++ )
+	{
+		int s = (io [i] * gain) >> gain_shift;
+		if ( (int16_t) s != s )
+			s = (s >> 31) ^ 0x7FFF;
+		io [i] = (sample_t) s;
+	}
+}
+
+// EQ
+
+void Output_Filter::run_band( band_t const& b, hist_t& h, int32_t* io, int count )
+{
+#if BLARGG_NEON
+	// left and right together
+	int32x2_t x1 = vld1_s32( h.x1 );
+	int32x2_t x2 = vld1_s32( h.x2 );
+	int32x2_t y1 = vld1_s32( h.y1 );
+	int32x2_t y2 = vld1_s32( h.y2 );
+	for ( int i = 0; i < count; i += 2 )
+	{
+		int32x2_t x0 = vld1_s32( io + i );
+		int64x2_t acc = vmull_n_s32( x0, b.b0 );
+		acc = vmlal_n_s32( acc, x1, b.b1 );
+		acc = vmlal_n_s32( acc, x2, b.b2 );
+		acc = vmlsl_n_s32( acc, y1, b.a1 );
+		acc = vmlsl_n_s32( acc, y2, b.a2 );
+		int32x2_t y0 = vrshrn_n_s64( acc, coeff_bits );
+		vst1_s32( io + i, y0 );
+		x2 = x1;
+		x1 = x0;
+		y2 = y1;
+		y1 = y0;
+	}
+	vst1_s32( h.x1, x1 );
+	vst1_s32( h.x2, x2 );
+	vst1_s32( h.y1, y1 );
+	vst1_s32( h.y2, y2 );
+#else
+	// SSE2 has no signed 32-bit multiply, and each output depends on the
+	// last, so the two channels are just interleaved
+	int64_t const round = (int64_t) 1 << (coeff_bits - 1);
+	int32_t lx1 = h.x1 [0], lx2 = h.x2 [0], ly1 = h.y1 [0], ly2 = h.y2 [0];
+	int32_t rx1 = h.x1 [1], rx2 = h.x2 [1], ry1 = h.y1 [1], ry2 = h.y2 [1];
+	for ( int i = 0; i < count; i += 2 )
+	{
+		int32_t lx0 = io [i];
+		int32_t rx0 = io [i + 1];
+		int32_t ly0 = (int32_t) (((int64_t) b.b0 * lx0 + (int64_t) b.b1 * lx1 +
+				(int64_t) b.b2 * lx2 - (int64_t) b.a1 * ly1 - (int64_t) b.a2 * ly2 +
+				round) >> coeff_bits);
+		int32_t ry0 = (int32_t) (((int64_t) b.b0 * rx0 + (int64_t) b.b1 * rx1 +
+				(int64_t) b.b2 * rx2 - (int64_t) b.a1 * ry1 - (int64_t) b.a2 * ry2 +
+				round) >> coeff_bits);
+		io [i]     = ly0;
+		io [i + 1] = ry0;
+		lx2 = lx1; lx1 = lx0; ly2 = ly1; ly1 = ly0;
+		rx2 = rx1; rx1 = rx0; ry2 = ry1; ry1 = ry0;
+	}
+	h.x1 [0] = lx1; h.x2 [0] = lx2; h.y1 [0] = ly1; h.y2 [0] = ly2;
+	h.x1 [1] = rx1; h.x2 [1] = rx2; h.y1 [1] = ry1; h.y2 [1] = ry2;
+#endif
+}
+
+// Rounds EQ output back to 16 bits, clamping it
+static void narrow( int32_t const* in, short* out, int count )
+{
+	int i = 0;
+#if BLARGG_SSE2
+	__m128i const round = _mm_set1_epi32( 1 << 7 );
+	for ( ; i + 8 <= count; i += 8 )
+	{
+		__m128i lo = _mm_loadu_si128( (__m128i const*) (in + i) );
+		__m128i hi = _mm_loadu_si128( (__m128i const*) (in + i + 4) );
+		lo = _mm_srai_epi32( _mm_add_epi32( lo, round ), 8 );
+		hi = _mm_srai_epi32( _mm_add_epi32( hi, round ), 8 );
+		_mm_storeu_si128( (__m128i*) (out + i), _mm_packs_epi32( lo, hi ) );
+	}
+#elif BLARGG_NEON
+	for ( ; i + 8 <= count; i += 8 )
+	{
+		int16x4_t lo = vqrshrn_n_s32( vld1q_s32( in + i ), 8 );
+		int16x4_t hi = vqrshrn_n_s32( vld1q_s32( in + i + 4 ), 8 );
+		vst1q_s16( out + i, vcombine_s16( lo, hi ) );
+	}
+#endif
+	for ( ; i < count; i++ )
+	{
+		int s = (in [i] + (1 << 7)) >> 8;
+		if ( (int16_t) s != s )
+			s = (s >> 31) ^ 0x7FFF;
+		out [i] = (short) s;
+	}
+}
+
+// Largest magnitude of samples
+static int32_t peak_level( int32_t const* in, int count )
+{
+	int32_t hi = 0, lo = 0;
+	int i = 0;
+#if BLARGG_SSE2
+	__m128i vhi = _mm_setzero_si128();
+	__m128i vlo = _mm_setzero_si128();
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		__m128i s = _mm_loadu_si128( (__m128i const*) (in + i) );
+		__m128i gt = _mm_cmpgt_epi32( s, vhi );
+		__m128i lt = _mm_cmplt_epi32( s, vlo );
+		vhi = _mm_or_si128( _mm_and_si128( gt, s ), _mm_andnot_si128( gt, vhi ) );
+		vlo = _mm_or_si128( _mm_and_si128( lt, s ), _mm_andnot_si128( lt, vlo ) );
+	}
+	int32_t his [4], los [4];
+	_mm_storeu_si128( (__m128i*) his, vhi );
+	_mm_storeu_si128( (__m128i*) los, vlo );
+	for ( int j = 0; j < 4; j++ )
+	{
+		hi = max( hi, his [j] );
+		lo = min( lo, los [j] );
+	}
+#elif BLARGG_NEON
+	int32x4_t vhi = vdupq_n_s32( 0 );
+	int32x4_t vlo = vdupq_n_s32( 0 );
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		int32x4_t s = vld1q_s32( in + i );
+		vhi = vmaxq_s32( vhi, s );
+		vlo = vminq_s32( vlo, s );
+	}
+	int32x2_t h2 = vpmax_s32( vget_low_s32( vhi ), vget_high_s32( vhi ) );
+	int32x2_t l2 = vpmin_s32( vget_low_s32( vlo ), vget_high_s32( vlo ) );
+	hi = vget_lane_s32( vpmax_s32( h2, h2 ), 0 );
+	lo = vget_lane_s32( vpmin_s32( l2, l2 ), 0 );
+#endif
+	for ( ; i < count; i++ )
+	{
+		hi = max( hi, in [i] );
+		lo = min( lo, in [i] );
+	}
+	return max( hi, -lo );
+}
+
+// Limiter level is worked out for each block from its peak. It drops at once
+// to keep the block in range, and comes back up gradually over later blocks.
+void Output_Filter::run_limiter( int32_t const* in, sample_t* out, int count )
+{
+	while ( count > 0 )
+	{
+		int const n = min( count, limit_block );
+
+		int target = limit_unit;
+		int32_t const peak = peak_level( in, n );
+		if ( peak > max_level )
+			target = (int) ((int64_t) max_level * limit_unit / peak);
+
+		int next = limit + ((limit_unit - limit + (1 << limit_release) - 1) >> limit_release);
+		if ( next > target )
+			next = target;
+
+		if ( limit == limit_unit && next == limit_unit )
+		{
+			narrow( in, out, n );
+		}
+		else
+		{
+			// falling level applies to whole block, rising is ramped
+			int const from = min( limit, next );
+			int32_t const step = ((next - from) << 16) / (n >> 1);
+			int32_t level = from << 16;
+			for ( int i = 0; i < n; i += 2 )
+			{
+				int const g = level >> 16;
+				int l = (int) (((int64_t) in [i    ] * g) >> (limit_bits + frac_bits));
+				int r = (int) (((int64_t) in [i + 1] * g) >> (limit_bits + frac_bits));
+				if ( (int16_t) l != l )
+					l = (l >> 31) ^ 0x7FFF;
+				if ( (int16_t) r != r )
+					r = (r >> 31) ^ 0x7FFF;
+				out [i    ] = (sample_t) l;
+				out [i + 1] = (sample_t) r;
+				level += step;
+			}
+		}
+		limit = next;
+
+		in    += n;
+		out   += n;
+		count -= n;
+	}
+}
+
+void Output_Filter::run( sample_t* io, int count )
+{
+	require( (count & 1) == 0 ); // must be even
+
+	int g = gain;
+	if ( fade != gain_unit )
+		g = (g * fade) >> gain_shift;
+	if ( g != gain_unit )
+		scale( io, count, g );
+
+	// gain is already clamped, so limiter has nothing to do without EQ
+	if ( !band_count )
+		return;
+
+	int32_t buf [buf_size];
+	while ( count > 0 )
+	{
+		int const n = min( count, (int) buf_size );
+		for ( int i = 0; i < n; i++ )
+			buf [i] = io [i] * (1 << frac_bits);
+
+		for ( int b = 0; b < band_count; b++ )
+			run_band( bands [b], hist [b], buf, n );
+
+		if ( limiter )
+			run_limiter( buf, io, n );
+		else
+			narrow( buf, io, n );
+
+		io    += n;
+		count -= n;
+	}
+}
@@ -0,0 +1,81 @@
+// Fixed-point post-processing of 16-bit stereo output: gain and fade, a chain
+// of biquad EQ bands, and a peak limiter
+
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+#ifndef OUTPUT_FILTER_H
+#define OUTPUT_FILTER_H
+
+#include "blargg_common.h"
+
+// Shared by the players in this tree, which build it from source along with
+// their own output code, and by Music_Emu's fade.
+struct Output_Filter {
+public:
+
+	// Filters count samples of stereo sound in place. Count must be a multiple of 2.
+	// Does nothing at all at unity gain with no EQ bands and no limiter.
+	typedef short sample_t;
+	void run( sample_t* io, int count );
+
+	// Scales count samples in place by gain / gain_unit, clamping to 16 bits.
+	// The same as sample_t ((s * gain) >> 14) for gains up to gain_unit.
+	static void scale( sample_t* io, int count, int gain );
+
+// Optional features
+
+	// Clears EQ history and limiter, as at the start of a track
+	void clear();
+
+	// Sets gain (volume), where gain_unit is normal, up to 2 * gain_unit - 1.
+	// Applied before EQ.
+	static const int gain_unit = 0x4000;
+	void set_gain( int gain );
+
+	// Sets fade level, from gain_unit (none) down to 0 (silent). Multiplies gain.
+	void set_fade( int fade );
+
+	// Removes all EQ bands
+	void clear_eq();
+
+	// Adds EQ band, boosting or cutting by db below or above freq, or around it
+	// for a peak. Slope and q are as in the Audio EQ Cookbook. Bands are applied
+	// in the order they were added. Error if max_bands are already in use.
+	static const int max_bands = 4;
+	blargg_err_t add_low_shelf( double sample_rate, double freq, double db, double slope = 1.0 );
+	blargg_err_t add_high_shelf( double sample_rate, double freq, double db, double slope = 1.0 );
+	blargg_err_t add_peak( double sample_rate, double freq, double db, double q = 0.707 );
+
+	// Enables/disables limiter. When enabled, level is turned down smoothly
+	// whenever EQ would take output past 16 bits, rather than clipping it.
+	void enable_limiter( bool b );
+
+public:
+	Output_Filter();
+	BLARGG_DISABLE_NOTHROW
+private:
+	enum { coeff_bits = 28 };  // fraction bits of EQ coefficients
+	enum { frac_bits = 8 };    // extra fraction bits of samples inside EQ
+	enum { limit_bits = 13 };  // limiter gain of 1 << limit_bits is none
+	enum { buf_size = 256 };   // samples filtered at a time
+	struct band_t { int32_t b0, b1, b2, a1, a2; };
+	struct hist_t { int32_t x1 [2], x2 [2], y1 [2], y2 [2]; }; // left, right
+	band_t bands [max_bands];
+	hist_t hist [max_bands];
+	int band_count;
+	int gain;
+	int fade;
+	int limit;
+	bool limiter;
+
+	blargg_err_t add_band( double b0, double b1, double b2, double a0, double a1, double a2 );
+	void run_band( band_t const&, hist_t&, int32_t* io, int count );
+	void run_limiter( int32_t const* in, sample_t* out, int count );
+};
+
+inline void Output_Filter::set_gain( int g ) { gain = g; }
+
+inline void Output_Filter::set_fade( int f ) { fade = f; }
+
+inline void Output_Filter::enable_limiter( bool b ) { limiter = b; }
+
+#endif
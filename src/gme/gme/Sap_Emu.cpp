@@ -3,6 +3,7 @@
 #include "Sap_Emu.h"
 
 #include "blargg_endian.h"
+#include "Emu_State.h"
 #include <string.h>
 #include <algorithm>
 
@@ -371,6 +372,19 @@ blargg_err_t Sap_Emu::start_track_( int track )
 	return 0;
 }
 
+blargg_err_t Sap_Emu::sync_state_( Emu_State& s )
+{
+	RETURN_ERR( Classic_Emu::sync_state_( s ) );
+	s.sync( static_cast<Sap_Cpu*>( this ), sizeof (Sap_Cpu) );
+	s( next_play );
+	s( time_mask );
+	s( scanline_period );
+	s( apu );
+	s( apu2 );
+	s( mem );
+	return 0;
+}
+
 // Emulation
 
 // see sap_cpu_io.h for read/write functions
@@ -3,6 +3,7 @@
 #include "Spc_Emu.h"
 
 #include "blargg_endian.h"
+#include "Emu_State.h"
 #include <stdlib.h>
 #include <string.h>
 #include <algorithm>
@@ -317,6 +318,14 @@ blargg_err_t Spc_Emu::start_track_( int track )
 	return 0;
 }
 
+blargg_err_t Spc_Emu::sync_state_( Emu_State& s )
+{
+	s( apu );
+	s( filter );
+	resampler.sync_state( s );
+	return 0;
+}
+
 blargg_err_t Spc_Emu::play_and_filter( long count, sample_t out [] )
 {
 	RETURN_ERR( apu.play( count, out ) );
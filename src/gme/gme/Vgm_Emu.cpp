@@ -3,6 +3,7 @@
 #include "Vgm_Emu.h"
 
 #include "blargg_endian.h"
+#include "Emu_State.h"
 #include <string.h>
 #include <math.h>
 #include <algorithm>
@@ -324,6 +325,13 @@ void Vgm_Emu::mute_voices_( int mask )
 	}
 }
 
+blargg_err_t Vgm_Emu::set_ym2612_emu_( int e )
+{
+	for ( int i = 0; i < 2; i++ )
+		RETURN_ERR( ym2612[i].set_emu( e ) );
+	return 0;
+}
+
 blargg_err_t Vgm_Emu::load_mem_( byte const* new_data, long new_size )
 {
 	blaarg_static_assert( offsetof (header_t,unused2 [8]) == header_size, "VGM Header layout incorrect!" );
@@ -402,8 +410,7 @@ blargg_err_t Vgm_Emu::setup_fm()
 	{
 		ym2413_rate &= ~0xC0000000;
 		uses_fm = true;
-		if ( disable_oversampling_ )
-			fm_rate = ym2413_rate / 72.0;
+		fm_rate = ym2413_rate / 72.0; // emu2413 is exact only at native rate
 		Dual_Resampler::setup( fm_rate / blip_buf.sample_rate(), rolloff, fm_gain * gain() );
 		int result = ym2413[0].set_rate( fm_rate, ym2413_rate );
 		if ( result == 2 )
@@ -485,6 +492,26 @@ blargg_err_t Vgm_Emu::start_track_( int track )
 	return 0;
 }
 
+blargg_err_t Vgm_Emu::sync_state_( Emu_State& s )
+{
+	RETURN_ERR( Classic_Emu::sync_state_( s ) );
+	s( vgm_time );
+	s( pos );
+	s( pcm_pos );
+	s( dac_amp );
+	s( dac_disabled );
+	s( fm_time_offset );
+	for ( int i = 0; i < 2; i++ )
+	{
+		ym2612 [i].sync_state( s );
+		ym2413 [i].sync_state( s );
+		s( psg [i] );
+	}
+	s.sync( blip_buf );
+	Dual_Resampler::sync_state( s );
+	return 0;
+}
+
 blargg_err_t Vgm_Emu::run_clocks( blip_time_t& time_io, int msec )
 {
 	time_io = run_commands( msec * vgm_rate / 1000 );
@@ -502,3 +529,12 @@ blargg_err_t Vgm_Emu::play_( long count, sample_t* out )
 	Dual_Resampler::dual_play( count, out, blip_buf );
 	return 0;
 }
+
+blargg_err_t Vgm_Emu::skip_muted_( long count )
+{
+	if ( !uses_fm )
+		return Classic_Emu::skip_muted_( count );
+
+	Dual_Resampler::dual_skip( count, blip_buf );
+	return 0;
+}
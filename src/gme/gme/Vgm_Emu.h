@@ -66,9 +66,12 @@ protected:
 	blargg_err_t load_mem_( byte const*, long ) override;
 	blargg_err_t set_sample_rate_( long sample_rate ) override;
 	blargg_err_t start_track_( int ) override;
+	blargg_err_t sync_state_( Emu_State& ) override;
 	blargg_err_t play_( long count, sample_t* ) override;
+	blargg_err_t skip_muted_( long count ) override;
 	blargg_err_t run_clocks( blip_time_t&, int ) override;
 	void set_tempo_( double ) override;
+	blargg_err_t set_ym2612_emu_( int ) override;
 	void mute_voices_( int mask ) override;
 	void set_voice( int, Blip_Buffer*, Blip_Buffer*, Blip_Buffer* ) override;
 	void update_eq( blip_eq_t const& ) override;
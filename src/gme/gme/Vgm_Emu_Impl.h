@@ -9,6 +9,7 @@
 #include "Ym2413_Emu.h"
 #include "Ym2612_Emu.h"
 #include "Sms_Apu.h"
+#include "Emu_State.h"
 
 template<class Emu>
 class Ym_Emu : public Emu {
@@ -22,6 +23,12 @@ public:
 	bool enabled() const            { return last_time != disabled_time; }
 	void begin_frame( short* p );
 	int run_until( int time );
+	void sync_state( Emu_State& s )
+	{
+		s( last_time );
+		if ( enabled() )
+			Emu::sync_state( s );
+	}
 };
 
 class Vgm_Emu_Impl : public Classic_Emu, private Dual_Resampler {
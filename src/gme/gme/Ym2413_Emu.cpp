@@ -1,21 +1,121 @@
-
-// Use in place of Ym2413_Emu.cpp and ym2413.c to disable support for this chip
-
 // Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
 
 #include "Ym2413_Emu.h"
 
-Ym2413_Emu::Ym2413_Emu() { }
+extern "C" {
+#include "ext/emu2413.h"
+}
+
+#include "Emu_State.h"
+#include <math.h>
+
+/* Copyright (C) 2006 Shay Green. This module is free software; you
+can redistribute it and/or modify it under the terms of the GNU Lesser
+General Public License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version. This
+module is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+details. You should have received a copy of the GNU Lesser General Public
+License along with this module; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA */
+
+#include "blargg_source.h"
+
+// emu2413 slots peak at +/-255, so a lone voice would be far quieter than a
+// PSG square at the same volume
+int const gain_shift = 2;
+
+Ym2413_Emu::Ym2413_Emu()
+{
+	opll = 0;
+	mute_mask = 0;
+}
+
+Ym2413_Emu::~Ym2413_Emu()
+{
+	if ( opll )
+		OPLL_delete( (OPLL *) opll );
+}
+
+// emu2413 keeps its tables in statics shared by every OPLL in the process,
+// including Nes_Vrc7_Apu's, and rebuilds them whenever it's given a different
+// clock or rate. Everything asks for this one setting so they never change
+// once built, and the first build happens under C++11's static init lock.
+static unsigned const opll_clock = 3579545;
+
+void* Ym2413_Emu::new_opll()
+{
+	static bool const tables_built = (OPLL_delete( OPLL_new( opll_clock, opll_clock / 72 ) ), true);
+	(void) tables_built;
+	return OPLL_new( opll_clock, opll_clock / 72 );
+}
+
+int Ym2413_Emu::set_rate( double sample_rate, double clock_rate )
+{
+	if ( opll )
+	{
+		OPLL_delete( (OPLL *) opll );
+		opll = 0;
+	}
+
+	// At native rate each sample is one chip sample period whatever the clock,
+	// so other clocks only change the rate Vgm_Emu resamples from
+	if ( fabs( sample_rate * 72 - clock_rate ) > 72 )
+		return 2;
+
+	opll = new_opll();
+	if ( !opll )
+		return 1;
 
-Ym2413_Emu::~Ym2413_Emu() { }
+	reset();
+	return 0;
+}
 
-int Ym2413_Emu::set_rate( double, double ) { return 2; }
+void Ym2413_Emu::reset()
+{
+	if ( !opll )
+		return;
 
-void Ym2413_Emu::reset() { }
+	OPLL_SetChipMode( (OPLL *) opll, 0 ); // not VRC7
+	OPLL_reset_patch( (OPLL *) opll, OPLL_2413_TONE );
+	OPLL_reset( (OPLL *) opll );
+	OPLL_SetMuteMask( (OPLL *) opll, mute_mask );
+}
 
-void Ym2413_Emu::write( int, int ) { }
+void Ym2413_Emu::mute_voices( int mask )
+{
+	mute_mask = mask;
+	if ( opll )
+		OPLL_SetMuteMask( (OPLL *) opll, mask );
+}
 
-void Ym2413_Emu::mute_voices( int ) { }
+void Ym2413_Emu::write( int addr, int data )
+{
+	OPLL_writeIO( (OPLL *) opll, 0, addr );
+	OPLL_writeIO( (OPLL *) opll, 1, data );
+}
 
-void Ym2413_Emu::run( int, sample_t* ) { }
+void Ym2413_Emu::run( int pair_count, sample_t* out )
+{
+	OPLL* opll = (OPLL *) this->opll; // cache
+	while ( pair_count-- )
+	{
+		int s = OPLL_calc( opll ) << gain_shift;
+		for ( int i = 0; i < out_chan_count; i++ )
+		{
+			// Clamp to 16 bits, since second chip of a dual pair adds to first
+			int o = out [i] + s;
+			if ( (short) o != o )
+				o = (o >> 31) ^ 0x7FFF;
+			out [i] = (short) o;
+		}
+		out += out_chan_count;
+	}
+}
 
+void Ym2413_Emu::sync_state( Emu_State& s )
+{
+	if ( opll )
+		s.sync( opll, sizeof (OPLL) );
+}
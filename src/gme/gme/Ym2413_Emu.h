@@ -4,14 +4,17 @@
 #ifndef YM2413_EMU_H
 #define YM2413_EMU_H
 
+// Uses emu2413's table-driven, fixed-point OPLL core, shared with Nes_Vrc7_Apu.
+// Always runs at the chip's native rate, clock rate / 72.
 class Ym2413_Emu  {
-	struct OPLL* opll;
+	void* opll;
+	int mute_mask;
 public:
 	Ym2413_Emu();
 	~Ym2413_Emu();
 
-	// Set output sample rate and chip clock rates, in Hz. Returns non-zero
-	// if error.
+	// Set output sample rate and chip clock rates, in Hz. Sample rate must be
+	// clock rate / 72. Returns non-zero if error, 2 if rate isn't supported.
 	int set_rate( double sample_rate, double clock_rate );
 
 	// Reset to power-up state
@@ -24,10 +27,18 @@ public:
 	// Write 'data' to 'addr'
 	void write( int addr, int data );
 
-	// Run and write pair_count samples to output
+	// Run and add pair_count samples into current output buffer contents
 	typedef short sample_t;
 	enum { out_chan_count = 2 }; // stereo
 	void run( int pair_count, sample_t* out );
+
+	// Save/restore chip state (see Emu_State.h)
+	void sync_state( class Emu_State& );
+
+	// Creates emu2413 OPLL, as used by this and Nes_Vrc7_Apu. Every instance
+	// shares emu2413's tables, which this builds once, safely from any thread.
+	// Returns NULL if out of memory.
+	static void* new_opll();
 };
 
 #endif
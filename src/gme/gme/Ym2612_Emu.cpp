@@ -0,0 +1,226 @@
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+
+#include "Ym2612_Emu.h"
+
+#include "Emu_State.h"
+#include <string.h>
+
+/* Copyright (C) 2006 Shay Green. This module is free software; you
+can redistribute it and/or modify it under the terms of the GNU Lesser
+General Public License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version. This
+module is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+details. You should have received a copy of the GNU Lesser General Public
+License along with this module; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA */
+
+#include "blargg_source.h"
+
+#if defined(VGM_YM2612_DEFAULT)
+	Ym2612_Emu::emu_t const Ym2612_Emu::default_emu = Ym2612_Emu::VGM_YM2612_DEFAULT;
+#elif defined(VGM_YM2612_NUKED)
+	Ym2612_Emu::emu_t const Ym2612_Emu::default_emu = Ym2612_Emu::nuked;
+#elif defined(VGM_YM2612_MAME)
+	Ym2612_Emu::emu_t const Ym2612_Emu::default_emu = Ym2612_Emu::mame;
+#else
+	Ym2612_Emu::emu_t const Ym2612_Emu::default_emu = Ym2612_Emu::gens;
+#endif
+
+// Calls function of current emulator
+#ifdef VGM_YM2612_NUKED
+	#define CASE_NUKED( call ) case nuked: nuked_.call; break;
+#else
+	#define CASE_NUKED( call )
+#endif
+
+#ifdef VGM_YM2612_MAME
+	#define CASE_MAME( call ) case mame: mame_.call; break;
+#else
+	#define CASE_MAME( call )
+#endif
+
+#ifdef VGM_YM2612_GENS
+	#define CASE_GENS( call ) case gens: gens_.call; break;
+#else
+	#define CASE_GENS( call )
+#endif
+
+#define DISPATCH( call ) \
+	switch ( emu_ ) { CASE_NUKED( call ) CASE_MAME( call ) CASE_GENS( call ) default: break; }
+
+Ym2612_Emu::Ym2612_Emu()
+{
+	emu_        = default_emu;
+	sample_rate = 0;
+	clock_rate  = 0;
+	mute_mask   = 0;
+	clear_regs();
+}
+
+const char* Ym2612_Emu::emu_name( int e )
+{
+	switch ( e )
+	{
+	#ifdef VGM_YM2612_NUKED
+		case nuked: return "Nuked";
+	#endif
+	#ifdef VGM_YM2612_MAME
+		case mame:  return "MAME";
+	#endif
+	#ifdef VGM_YM2612_GENS
+		case gens:  return "GENS";
+	#endif
+	}
+	return 0;
+}
+
+const char* Ym2612_Emu::set_emu( int e )
+{
+	if ( !emu_name( e ) )
+		return "YM2612 emulator not supported";
+
+	if ( e == emu_ )
+		return 0;
+
+	emu_t const old_emu = emu_;
+	emu_ = (emu_t) e;
+	if ( !sample_rate )
+		return 0; // set_rate() hasn't been called yet
+
+	// bring new emulator to same state
+	const char* err = 0;
+	switch ( emu_ )
+	{
+	#ifdef VGM_YM2612_NUKED
+		case nuked: err = nuked_.set_rate( sample_rate, clock_rate ); break;
+	#endif
+	#ifdef VGM_YM2612_MAME
+		case mame:  err = mame_ .set_rate( sample_rate, clock_rate ); break;
+	#endif
+	#ifdef VGM_YM2612_GENS
+		case gens:  err = gens_ .set_rate( sample_rate, clock_rate ); break;
+	#endif
+		default: break;
+	}
+	if ( err )
+	{
+		emu_ = old_emu;
+		return err;
+	}
+
+	DISPATCH( reset() );
+	DISPATCH( mute_voices( mute_mask ) );
+	restore_regs();
+	return 0;
+}
+
+const char* Ym2612_Emu::set_rate( double sample_rate, double clock_rate )
+{
+	this->sample_rate = 0;
+	const char* err = 0;
+	switch ( emu_ )
+	{
+	#ifdef VGM_YM2612_NUKED
+		case nuked: err = nuked_.set_rate( sample_rate, clock_rate ); break;
+	#endif
+	#ifdef VGM_YM2612_MAME
+		case mame:  err = mame_ .set_rate( sample_rate, clock_rate ); break;
+	#endif
+	#ifdef VGM_YM2612_GENS
+		case gens:  err = gens_ .set_rate( sample_rate, clock_rate ); break;
+	#endif
+		default: break;
+	}
+	if ( err )
+		return err;
+
+	this->sample_rate = sample_rate;
+	this->clock_rate  = clock_rate;
+	clear_regs();
+	return 0;
+}
+
+void Ym2612_Emu::reset()
+{
+	clear_regs();
+	DISPATCH( reset() );
+}
+
+void Ym2612_Emu::mute_voices( int mask )
+{
+	mute_mask = mask;
+	DISPATCH( mute_voices( mask ) );
+}
+
+void Ym2612_Emu::write0( int addr, int data )
+{
+	addr &= 0xFF;
+	regs [0] [addr] = data;
+	if ( addr == 0x28 )
+		key_on [data & 7] = data;
+	DISPATCH( write0( addr, data ) );
+}
+
+void Ym2612_Emu::write1( int addr, int data )
+{
+	addr &= 0xFF;
+	regs [1] [addr] = data;
+	DISPATCH( write1( addr, data ) );
+}
+
+void Ym2612_Emu::run( int pair_count, sample_t* out )
+{
+	DISPATCH( run( pair_count, out ) );
+}
+
+void Ym2612_Emu::sync_state( Emu_State& s )
+{
+	s( regs );
+	s( key_on );
+	DISPATCH( sync_state( s ) );
+}
+
+// Register shadow
+
+void Ym2612_Emu::clear_regs()
+{
+	memset( regs, -1, sizeof regs );
+	memset( key_on, -1, sizeof key_on );
+}
+
+void Ym2612_Emu::restore_regs()
+{
+	// Registers are written again in an order that doesn't depend on order they
+	// were originally written: frequency high before low, since high is latched
+	// until low is written, and key on last.
+	static unsigned char const order [] = {
+		0xB0, 0xB1, 0xB2, 0xB4, 0xB5, 0xB6,
+		0xA4, 0xA5, 0xA6, 0xA0, 0xA1, 0xA2,
+		0xAC, 0xAD, 0xAE, 0xA8, 0xA9, 0xAA
+	};
+
+	for ( int addr = 0x21; addr < 0x30; addr++ )
+		if ( addr != 0x28 && regs [0] [addr] >= 0 )
+			write0( addr, regs [0] [addr] );
+
+	for ( int port = 0; port < 2; port++ )
+	{
+		for ( int i = 0x30; i < 0xA0 + (int) sizeof order; i++ )
+		{
+			int addr = (i < 0xA0 ? i : order [i - 0xA0]);
+			if ( regs [port] [addr] >= 0 )
+			{
+				if ( port )
+					write1( addr, regs [port] [addr] );
+				else
+					write0( addr, regs [port] [addr] );
+			}
+		}
+	}
+
+	for ( int i = 0; i < 8; i++ )
+		if ( key_on [i] >= 0 )
+			write0( 0x28, key_on [i] );
+}
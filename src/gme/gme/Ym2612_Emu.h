@@ -1,32 +1,98 @@
 // YM2612 FM sound chip emulator interface
 
 // Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+#ifndef YM2612_EMU_H
+#define YM2612_EMU_H
 
+// Each of VGM_YM2612_NUKED, VGM_YM2612_MAME and VGM_YM2612_GENS builds in that
+// emulator, and any that are built in can be switched between at run time.
+// VGM_YM2612_DEFAULT can be defined as nuked, mame or gens to choose the one
+// used by default, otherwise it's the most accurate one built in.
 #if !defined(VGM_YM2612_GENS) && !defined(VGM_YM2612_NUKED) && !defined(VGM_YM2612_MAME)
 #define VGM_YM2612_NUKED
 #endif
 
-#ifdef VGM_YM2612_GENS // LGPL v2.1+ license
-# if defined(VGM_YM2612_NUKED) || defined(VGM_YM2612_MAME)
-#   error Only one of VGM_YM2612_GENS, VGM_YM2612_NUKED or VGM_YM2612_MAME can be defined
-# endif
-#include "Ym2612_GENS.h"
-typedef Ym2612_GENS_Emu Ym2612_Emu;
-#endif
-
 #ifdef VGM_YM2612_NUKED // LGPL v2.1+ license
-# if defined(VGM_YM2612_GENS) || defined(VGM_YM2612_MAME)
-#   error Only one of VGM_YM2612_GENS, VGM_YM2612_NUKED or VGM_YM2612_MAME can be defined
-# endif
 #include "Ym2612_Nuked.h"
-typedef Ym2612_Nuked_Emu Ym2612_Emu;
 #endif
 
 #ifdef VGM_YM2612_MAME // GPL v2+ license
-# if defined(VGM_YM2612_GENS) || defined(VGM_YM2612_NUKED)
-#   error Only one of VGM_YM2612_GENS, VGM_YM2612_NUKED or VGM_YM2612_MAME can be defined
-# endif
 #include "Ym2612_MAME.h"
-typedef Ym2612_MAME_Emu Ym2612_Emu;
 #endif
 
+#ifdef VGM_YM2612_GENS // LGPL v2.1+ license
+#include "Ym2612_GENS.h"
+#endif
+
+class Ym2612_Emu {
+public:
+	// Emulators, from most accurate to fastest. Same values as gme_ym2612_* in gme.h.
+	enum emu_t { nuked = 0, mame = 1, gens = 2, emu_count };
+
+	// Emulator used unless set_emu() is called
+	static emu_t const default_emu;
+
+	// Name of emulator, or NULL if it isn't built in
+	static const char* emu_name( int );
+
+	// Switch to emulator, even while sound is being generated. Notes already
+	// playing restart from the current register values. Returns non-zero if
+	// error, including when emulator isn't built in.
+	const char* set_emu( int );
+
+	// Current emulator
+	emu_t emu() const { return emu_; }
+
+	// Set output sample rate and chip clock rates, in Hz. Returns non-zero
+	// if error.
+	const char* set_rate( double sample_rate, double clock_rate );
+
+	// Reset to power-up state
+	void reset();
+
+	// Mute voice n if bit n (1 << n) of mask is set
+	enum { channel_count = 6 };
+	void mute_voices( int mask );
+
+	// Write addr to register 0 then data to register 1
+	void write0( int addr, int data );
+
+	// Write addr to register 2 then data to register 3
+	void write1( int addr, int data );
+
+	// Run and add pair_count samples into current output buffer contents
+	typedef short sample_t;
+	enum { out_chan_count = 2 }; // stereo
+	void run( int pair_count, sample_t* out );
+
+	// Save/restore chip state (see Emu_State.h)
+	void sync_state( class Emu_State& );
+
+public:
+	Ym2612_Emu();
+private:
+	emu_t emu_;
+	double sample_rate;
+	double clock_rate;
+	int mute_mask;
+
+	// Last value written to each register, or -1 if not written since reset,
+	// so another emulator can be brought to the same state
+	short regs [2] [0x100];
+	short key_on [8]; // register 0x28 for each channel
+
+	void clear_regs();
+	void restore_regs();
+
+#ifdef VGM_YM2612_NUKED
+	Ym2612_Nuked_Emu nuked_;
+#endif
+#ifdef VGM_YM2612_MAME
+	Ym2612_MAME_Emu mame_;
+#endif
+#ifdef VGM_YM2612_GENS
+	Ym2612_GENS_Emu gens_;
+#endif
+};
+
+#endif
@@ -5,6 +5,7 @@
 #ifdef VGM_YM2612_GENS
 
 #include "Ym2612_GENS.h"
+#include "Emu_State.h"
 
 #include <assert.h>
 #include <stdlib.h>
@@ -887,6 +888,15 @@ void Ym2612_GENS_Emu::reset()
 	impl->reset();
 }
 
+void Ym2612_GENS_Emu::sync_state( Emu_State& s )
+{
+	if ( impl )
+	{
+		s( impl->YM2612 );
+		s( impl->g.LFOcnt );
+	}
+}
+
 void Ym2612_GENS_Impl::reset()
 {
 	g.LFOcnt = 0;
@@ -5,6 +5,7 @@
 #ifdef VGM_YM2612_MAME
 
 #include "Ym2612_MAME.h"
+#include "Emu_State.h"
 
 /*
 **
@@ -3110,4 +3111,9 @@ void Ym2612_MAME_Emu::run(int pair_count, Ym2612_MAME_Emu::sample_t *out)
 	if ( impl ) Ym2612_MameImpl::ym2612_generate( impl, out, pair_count, 1);
 }
 
+void Ym2612_MAME_Emu::sync_state(Emu_State &s)
+{
+	if ( impl ) s.sync( impl, sizeof (Ym2612_MameImpl::YM2612) );
+}
+
 #endif /* VGM_YM2612_MAME */
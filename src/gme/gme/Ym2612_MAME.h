@@ -1,8 +1,8 @@
 // YM2612 FM sound chip emulator interface
 
 // Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
-#ifndef YM2612_EMU_H
-#define YM2612_EMU_H
+#ifndef YM2612_MAME_H
+#define YM2612_MAME_H
 
 typedef void Ym2612_MAME_Impl;
 
@@ -33,6 +33,9 @@ public:
 	typedef short sample_t;
 	enum { out_chan_count = 2 }; // stereo
 	void run( int pair_count, sample_t* out );
+
+	// Save/restore chip state (see Emu_State.h)
+	void sync_state( class Emu_State& );
 };
 
 #endif
@@ -5,6 +5,7 @@
 #ifdef VGM_YM2612_NUKED
 
 #include "Ym2612_Nuked.h"
+#include "Emu_State.h"
 
 /*
  * Copyright (C) 2017 Alexey Khokholov (Nuke.YKT)
@@ -1873,4 +1874,9 @@ void Ym2612_Nuked_Emu::run(int pair_count, Ym2612_Nuked_Emu::sample_t *out)
 	Ym2612_NukedImpl::OPN2_GenerateStreamMix(chip_r, out, pair_count);
 }
 
+void Ym2612_Nuked_Emu::sync_state(Emu_State &s)
+{
+	if ( impl ) s.sync( impl, sizeof (Ym2612_NukedImpl::ym3438_t) );
+}
+
 #endif /* VGM_YM2612_NUKED */
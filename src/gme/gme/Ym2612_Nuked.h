@@ -1,8 +1,8 @@
 // YM2612 FM sound chip emulator interface
 
 // Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
-#ifndef YM2612_EMU_H
-#define YM2612_EMU_H
+#ifndef YM2612_NUKED_H
+#define YM2612_NUKED_H
 
 typedef void Ym2612_Nuked_Impl;
 
@@ -35,6 +35,9 @@ public:
 	typedef short sample_t;
 	enum { out_chan_count = 2 }; // stereo
 	void run( int pair_count, sample_t* out );
+
+	// Save/restore chip state (see Emu_State.h)
+	void sync_state( class Emu_State& );
 };
 
 #endif
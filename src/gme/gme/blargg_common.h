@@ -19,6 +19,15 @@
 	#define BLARGG_RESTRICT
 #endif
 
+// BLARGG_SSE2, BLARGG_NEON: defined to 1 when vector code for that instruction
+// set can be used. Define BLARGG_NO_SIMD to use only portable code.
+#if !defined (BLARGG_NO_SIMD) && (defined (__SSE2__) || defined (_M_X64) || \
+		(defined (_M_IX86_FP) && _M_IX86_FP >= 2))
+	#define BLARGG_SSE2 1
+#elif !defined (BLARGG_NO_SIMD) && (defined (__ARM_NEON) || defined (__ARM_NEON__))
+	#define BLARGG_NEON 1
+#endif
+
 // STATIC_CAST(T,expr): Used in place of static_cast<T> (expr)
 #ifndef STATIC_CAST
 	#define STATIC_CAST(T,expr) ((T) (expr))
@@ -29,6 +29,9 @@
 // Uncomment to use faster, lower quality sound synthesis
 //#define BLIP_BUFFER_FAST 1
 
+// Uncomment to use only portable code instead of SSE2/NEON intrinsics
+//#define BLARGG_NO_SIMD 1
+
 // Uncomment one of the following two if automatic byte-order determination doesn't work
 //#define BLARGG_BIG_ENDIAN 1
 //#define BLARGG_LITTLE_ENDIAN 1
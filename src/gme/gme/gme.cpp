@@ -10,6 +10,9 @@
 #if !GME_DISABLE_STEREO_DEPTH
 #include "Effects_Buffer.h"
 #endif
+#if defined(USE_GME_VGM) || defined(USE_GME_GYM)
+#include "Ym2612_Emu.h"
+#endif
 #include "blargg_endian.h"
 #include <string.h>
 #include <ctype.h>
@@ -399,6 +402,7 @@ int       gme_tell_scaled    ( Music_Emu const* me )                { return me-
 gme_err_t gme_seek           ( Music_Emu* me, int msec )            { return me->seek( msec ); }
 gme_err_t gme_seek_samples   ( Music_Emu* me, int n )               { return me->seek_samples( n ); }
 gme_err_t gme_seek_scaled    ( Music_Emu* me, int msec )            { return me->seek_scaled( msec ); }
+void      gme_set_seek_checkpoints( Music_Emu* me, int msec, long max_bytes ) { me->set_seek_checkpoints( msec, max_bytes ); }
 int       gme_voice_count    ( Music_Emu const* me )                { return me->voice_count(); }
 void      gme_ignore_silence ( Music_Emu* me, int disable )         { me->ignore_silence( disable != 0 ); }
 void      gme_set_tempo      ( Music_Emu* me, double t )            { me->set_tempo( t ); }
@@ -406,6 +410,7 @@ void      gme_mute_voice     ( Music_Emu* me, int index, int mute ) { me->mute_v
 void      gme_mute_voices    ( Music_Emu* me, int mask )            { me->mute_voices( mask ); }
 void      gme_disable_echo   ( Music_Emu* me, int disable )         { me->disable_echo( disable ); }
 void      gme_enable_accuracy( Music_Emu* me, int enabled )         { me->enable_accuracy( enabled ); }
+gme_err_t gme_set_ym2612_emu ( Music_Emu* me, int emu )             { return me->set_ym2612_emu( emu ); }
 void      gme_clear_playlist ( Music_Emu* me )                      { me->clear_playlist(); }
 int       gme_type_multitrack( gme_type_t t )                       { return t->track_count != 1; }
 int       gme_multi_channel  ( Music_Emu const* me )                { return me->multi_channel(); }
@@ -437,3 +442,13 @@ const char* gme_type_system( gme_type_t type )
 	assert( type );
 	return type->system;
 }
+
+const char* gme_ym2612_emu_name( int emu )
+{
+#if defined(USE_GME_VGM) || defined(USE_GME_GYM)
+	return Ym2612_Emu::emu_name( emu );
+#else
+	(void) emu;
+	return 0;
+#endif
+}
@@ -105,6 +105,15 @@ BLARGG_EXPORT gme_err_t gme_seek_samples( Music_Emu*, int n );
  * @since 0.6.5 */
 BLARGG_EXPORT gme_err_t gme_seek_scaled( Music_Emu*, int msec );
 
+/* Save emulator state every interval_msec while playing, using at most max_bytes,
+ * so that later seeks (backwards especially) resume from the nearest saved point
+ * instead of restarting the track. Spacing is doubled whenever the limit is reached.
+ * Saved points are discarded when a new track is started or tempo/equalizer/echo/
+ * accuracy are changed. Pass 0 for interval_msec to disable (the default).
+ * Has no effect for emulator types which can't save their state.
+ * @since 0.6.5 */
+BLARGG_EXPORT void gme_set_seek_checkpoints( Music_Emu*, int interval_msec, long max_bytes );
+
 
 /******** Informational ********/
 
@@ -210,6 +219,18 @@ BLARGG_EXPORT void gme_set_equalizer( Music_Emu*, gme_equalizer_t const* eq );
 /* Enables/disables most accurate sound emulation options */
 BLARGG_EXPORT void gme_enable_accuracy( Music_Emu*, int enabled );
 
+/* YM2612 FM sound chip emulators for Sega Genesis VGM and GYM music, from most
+accurate to fastest. Which are built in depends on how library was configured. */
+enum { gme_ym2612_nuked = 0, gme_ym2612_mame = 1, gme_ym2612_gens = 2 };
+
+/* Select YM2612 emulator. Can be changed while playing, in which case notes
+already playing restart. Returns error if emulator isn't built in. Has no effect
+on other music types. */
+BLARGG_EXPORT gme_err_t gme_set_ym2612_emu( Music_Emu*, int emu );
+
+/* Name of YM2612 emulator, or NULL if it isn't built in */
+BLARGG_EXPORT const char* gme_ym2612_emu_name( int emu );
+
 
 /******** Game music types ********/
 
@@ -0,0 +1,507 @@
+#include "Media_Library.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "SDL_timer.h"
+
+// Index file format, one item per line with tab-separated fields:
+//
+// gme_index <version>
+// <directory mtime>
+// D <name>
+// F <name> <mtime> <size> <scanned> <track count> <game>
+// T <length> <fade> <song>         (one per track, after its F line)
+
+static const int index_version = 1;
+
+// While scanning, index of directory is written at most this often, rather
+// than after every file
+static const Uint32 save_delay = 2000;
+
+Media_Library::Media_Library()
+{
+	is_music    = NULL;
+	scan_thread = NULL;
+	mutex       = NULL;
+	wake        = NULL;
+	quit        = false;
+	SDL_AtomicSet( &change_count, 0 );
+}
+
+Media_Library::~Media_Library()
+{
+	stop();
+	if ( wake )
+		SDL_DestroyCond( wake );
+	if ( mutex )
+		SDL_DestroyMutex( mutex );
+}
+
+gme_err_t Media_Library::init( const char* dir, bool (*f)( const std::string& ) )
+{
+	is_music = f;
+	index_dir.clear();
+	if ( dir && *dir )
+	{
+		// create parent directories too
+		std::string path = dir;
+		for ( size_t i = 1; i <= path.size(); i++ )
+		{
+			if ( i == path.size() || path [i] == '/' )
+			{
+				if ( mkdir( path.substr( 0, i ).c_str(), 0755 ) && errno != EEXIST )
+					return "Couldn't create index directory";
+			}
+		}
+		index_dir = path;
+	}
+
+	if ( !mutex && !(mutex = SDL_CreateMutex()) )
+		return "Couldn't create mutex";
+	if ( !wake && !(wake = SDL_CreateCond()) )
+		return "Couldn't create condition variable";
+
+	if ( !scan_thread )
+	{
+		quit = false;
+		scan_thread = SDL_CreateThread( scan_thread_, "library scan", this );
+		if ( !scan_thread )
+			return "Couldn't create scan thread";
+	}
+	return 0;
+}
+
+void Media_Library::stop()
+{
+	if ( scan_thread )
+	{
+		SDL_LockMutex( mutex );
+		quit = true;
+		SDL_CondSignal( wake );
+		SDL_UnlockMutex( mutex );
+		SDL_WaitThread( scan_thread, NULL );
+		scan_thread = NULL;
+	}
+
+	if ( mutex )
+	{
+		SDL_LockMutex( mutex );
+		save_modified();
+		SDL_UnlockMutex( mutex );
+	}
+}
+
+int Media_Library::changes() const
+{
+	return SDL_AtomicGet( &change_count );
+}
+
+// Index files
+
+std::string Media_Library::index_path( const std::string& dir ) const
+{
+	// FNV-1a hash of directory
+	unsigned long h = 2166136261UL;
+	for ( size_t i = 0; i < dir.size(); i++ )
+		h = ((h ^ (unsigned char) dir [i]) * 16777619UL) & 0xFFFFFFFF;
+
+	char name [16];
+	snprintf( name, sizeof name, "/%08lx.idx", h );
+	return index_dir + name;
+}
+
+// Split line at tabs
+static void split( char* line, std::vector<char*>& out )
+{
+	out.clear();
+	line [strcspn( line, "\r\n" )] = 0;
+	for ( char* p = line; ; )
+	{
+		out.push_back( p );
+		p = strchr( p, '\t' );
+		if ( !p )
+			break;
+		*p++ = 0;
+	}
+}
+
+bool Media_Library::load_index( const std::string& dir, dir_t& out ) const
+{
+	if ( index_dir.empty() )
+		return false;
+
+	FILE* in = fopen( index_path( dir ).c_str(), "r" );
+	if ( !in )
+		return false;
+
+	bool ok = false;
+	std::vector<char> buf( 4096 );
+	std::vector<char*> f;
+	int version;
+	if ( fscanf( in, "gme_index %d\n", &version ) == 1 && version == index_version &&
+			fgets( &buf [0], (int) buf.size(), in ) )
+	{
+		split( &buf [0], f );
+		ok = (f [0] == dir);
+		if ( ok )
+			ok = fscanf( in, "%ld\n", &out.mtime ) == 1;
+	}
+
+	out.entries.clear();
+	while ( ok && fgets( &buf [0], (int) buf.size(), in ) )
+	{
+		split( &buf [0], f );
+		if ( f [0][0] == 'D' && f.size() == 2 )
+		{
+			Media_Entry e = Media_Entry();
+			e.name   = f [1];
+			e.is_dir = true;
+			out.entries.push_back( e );
+		}
+		else if ( f [0][0] == 'F' && f.size() == 7 )
+		{
+			Media_Entry e = Media_Entry();
+			e.name        = f [1];
+			e.mtime       = atol( f [2] );
+			e.size        = atol( f [3] );
+			e.scanned     = atoi( f [4] );
+			e.track_count = atoi( f [5] );
+			e.game        = f [6];
+			out.entries.push_back( e );
+		}
+		else if ( f [0][0] == 'T' && f.size() == 4 && !out.entries.empty() &&
+				!out.entries.back().is_dir )
+		{
+			Media_Track t;
+			t.length = atol( f [1] );
+			t.fade   = atol( f [2] );
+			t.song   = f [3];
+			out.entries.back().tracks.push_back( t );
+		}
+		else
+		{
+			ok = false;
+		}
+	}
+	fclose( in );
+	out.modified = false;
+	return ok;
+}
+
+void Media_Library::save_index( const std::string& dir, dir_t const& d ) const
+{
+	// write to temporary file first, so index is never left half written
+	std::string path = index_path( dir );
+	std::string temp = path + ".tmp";
+	FILE* out = fopen( temp.c_str(), "w" );
+	if ( !out )
+		return;
+
+	fprintf( out, "gme_index %d\n%s\n%ld\n", index_version, dir.c_str(), d.mtime );
+	for ( size_t i = 0; i < d.entries.size(); i++ )
+	{
+		Media_Entry const& e = d.entries [i];
+		if ( e.is_dir )
+		{
+			fprintf( out, "D\t%s\n", e.name.c_str() );
+			continue;
+		}
+		fprintf( out, "F\t%s\t%ld\t%ld\t%d\t%d\t%s\n", e.name.c_str(), e.mtime,
+				e.size, e.scanned, e.track_count, e.game.c_str() );
+		for ( size_t t = 0; t < e.tracks.size(); t++ )
+			fprintf( out, "T\t%ld\t%ld\t%s\n", e.tracks [t].length,
+					e.tracks [t].fade, e.tracks [t].song.c_str() );
+	}
+
+	if ( fclose( out ) || rename( temp.c_str(), path.c_str() ) )
+		remove( temp.c_str() );
+}
+
+// Write index files of modified directories. Called with mutex locked, which is
+// released while writing so listing never waits on the card. False if there
+// was nothing to write.
+bool Media_Library::save_modified()
+{
+	if ( index_dir.empty() )
+		return false;
+
+	std::vector<dirs_t::value_type> copies;
+	for ( dirs_t::iterator it = dirs.begin(); it != dirs.end(); ++it )
+	{
+		if ( it->second.modified )
+		{
+			it->second.modified = false;
+			copies.push_back( *it );
+		}
+	}
+	if ( copies.empty() )
+		return false;
+
+	SDL_UnlockMutex( mutex );
+	for ( size_t i = 0; i < copies.size(); i++ )
+		save_index( copies [i].first, copies [i].second );
+	SDL_LockMutex( mutex );
+	return true;
+}
+
+// Listing
+
+static bool entry_less( Media_Entry const& a, Media_Entry const& b )
+{
+	if ( a.is_dir != b.is_dir )
+		return a.is_dir > b.is_dir;
+	return a.name < b.name;
+}
+
+void Media_Library::read_dir( const std::string& dir, dir_t& out, dir_t const* old ) const
+{
+	out.entries.clear();
+	out.modified = true;
+
+	DIR* d = opendir( dir.c_str() );
+	if ( !d )
+		return;
+
+	std::string prefix = dir + (dir == "/" ? "" : "/");
+	struct dirent* de;
+	while ( (de = readdir( d )) != NULL )
+	{
+		if ( !strcmp( de->d_name, "." ) || !strcmp( de->d_name, ".." ) )
+			continue;
+
+		Media_Entry e = Media_Entry();
+		e.name = de->d_name;
+
+		// only stat when file system doesn't give type, or for music files
+		struct stat st;
+		bool have_stat = false;
+		if ( de->d_type == DT_DIR || de->d_type == DT_REG )
+		{
+			e.is_dir = (de->d_type == DT_DIR);
+		}
+		else
+		{
+			if ( stat( (prefix + e.name).c_str(), &st ) )
+				continue;
+			have_stat = true;
+			e.is_dir = S_ISDIR( st.st_mode );
+		}
+
+		if ( !e.is_dir )
+		{
+			if ( !is_music( e.name ) )
+				continue;
+			if ( !have_stat && stat( (prefix + e.name).c_str(), &st ) )
+				continue;
+			e.mtime = (long) st.st_mtime;
+			e.size  = (long) st.st_size;
+		}
+		out.entries.push_back( e );
+	}
+	closedir( d );
+
+	std::sort( out.entries.begin(), out.entries.end(), entry_less );
+
+	// keep metadata of files which haven't changed
+	if ( old )
+	{
+		for ( size_t i = 0; i < out.entries.size(); i++ )
+		{
+			Media_Entry& e = out.entries [i];
+			if ( e.is_dir )
+				continue;
+			std::vector<Media_Entry>::const_iterator it = std::lower_bound(
+					old->entries.begin(), old->entries.end(), e, entry_less );
+			if ( it != old->entries.end() && !it->is_dir && it->name == e.name &&
+					it->mtime == e.mtime && it->size == e.size )
+				e = *it;
+		}
+	}
+}
+
+void Media_Library::list( const std::string& dir, std::vector<Media_Entry>& out )
+{
+	out.clear();
+	struct stat st;
+	if ( stat( dir.c_str(), &st ) )
+		return;
+	long mtime = (long) st.st_mtime;
+
+	SDL_LockMutex( mutex );
+	dirs_t::iterator it = dirs.find( dir );
+	if ( it == dirs.end() )
+	{
+		dir_t d;
+		d.mtime = 0;
+		d.modified = false;
+		if ( !load_index( dir, d ) )
+			d.entries.clear();
+		it = dirs.insert( dirs_t::value_type( dir, d ) ).first;
+	}
+
+	dir_t& d = it->second;
+	if ( d.mtime != mtime )
+	{
+		// directory changed since it was indexed
+		dir_t fresh;
+		read_dir( dir, fresh, &d );
+		fresh.mtime = mtime;
+		d.entries.swap( fresh.entries );
+		d.mtime = mtime;
+		d.modified = true;
+	}
+	out = d.entries;
+
+	// scan this directory next
+	bool unscanned = false;
+	for ( size_t i = 0; i < d.entries.size(); i++ )
+		unscanned |= (!d.entries [i].is_dir && !d.entries [i].scanned);
+	pending.erase( std::remove( pending.begin(), pending.end(), dir ), pending.end() );
+	if ( unscanned )
+		pending.push_back( dir );
+
+	// scan thread writes index file
+	if ( unscanned || d.modified )
+		SDL_CondSignal( wake );
+	SDL_UnlockMutex( mutex );
+}
+
+// Background scanning
+
+// Replace characters which would break index file format
+static std::string clean( const char* s )
+{
+	std::string out = s;
+	for ( size_t i = 0; i < out.size(); i++ )
+		if ( out [i] == '\t' || out [i] == '\n' || out [i] == '\r' )
+			out [i] = ' ';
+	return out;
+}
+
+// Read metadata of file into e. Runs without lock held.
+static void scan_file( const std::string& path, Media_Entry& e )
+{
+	e.scanned = -1;
+	e.track_count = 0;
+	e.game.clear();
+	e.tracks.clear();
+
+	// archives are left for player to open
+	if ( !gme_identify_extension( path.c_str() ) )
+		return;
+
+	Music_Emu* emu = NULL;
+	if ( gme_open_file( path.c_str(), &emu, gme_info_only ) )
+		return;
+
+	// same playlist as player uses
+	std::string m3u = path.substr( 0, path.find_last_of( '.' ) ) + ".m3u";
+	if ( gme_load_m3u( emu, m3u.c_str() ) ) { } // ignore error
+
+	e.track_count = gme_track_count( emu );
+	for ( int i = 0; i < e.track_count; i++ )
+	{
+		gme_info_t* info = NULL;
+		if ( gme_track_info( emu, &info, i ) )
+			break;
+		if ( i == 0 )
+			e.game = clean( info->game );
+
+		Media_Track t;
+		t.length = info->length;
+		if ( t.length <= 0 )
+			t.length = info->intro_length + info->loop_length * 2;
+		if ( t.length <= 0 )
+			t.length = -1;
+		t.fade = info->fade_length;
+		t.song = clean( info->song );
+		e.tracks.push_back( t );
+		gme_free_info( info );
+	}
+	gme_delete( emu );
+	e.scanned = 1;
+}
+
+int Media_Library::scan_thread_( void* data )
+{
+	SDL_SetThreadPriority( SDL_THREAD_PRIORITY_LOW );
+	((Media_Library*) data)->scan();
+	return 0;
+}
+
+void Media_Library::scan()
+{
+	Uint32 save_time = 0;
+	SDL_LockMutex( mutex );
+	while ( !quit )
+	{
+		// find next file needing scanning in most recently listed directory
+		std::string dir, name;
+		while ( !pending.empty() && name.empty() )
+		{
+			dirs_t::iterator it = dirs.find( pending.back() );
+			if ( it != dirs.end() )
+			{
+				std::vector<Media_Entry> const& v = it->second.entries;
+				for ( size_t i = 0; i < v.size(); i++ )
+				{
+					if ( !v [i].is_dir && !v [i].scanned )
+					{
+						dir  = it->first;
+						name = v [i].name;
+						break;
+					}
+				}
+			}
+			if ( name.empty() )
+				pending.pop_back();
+		}
+
+		if ( name.empty() )
+		{
+			// idle; write out what's been scanned, then look again since
+			// directories may have been listed meanwhile
+			if ( !save_modified() )
+				SDL_CondWait( wake, mutex );
+			continue;
+		}
+
+		SDL_UnlockMutex( mutex );
+		Media_Entry e = Media_Entry();
+		scan_file( dir + (dir == "/" ? "" : "/") + name, e );
+		SDL_LockMutex( mutex );
+
+		// directory might have been read again meanwhile
+		dirs_t::iterator it = dirs.find( dir );
+		if ( it == dirs.end() )
+			continue;
+		dir_t& d = it->second;
+		for ( size_t i = 0; i < d.entries.size(); i++ )
+		{
+			Media_Entry& x = d.entries [i];
+			if ( !x.is_dir && x.name == name && !x.scanned )
+			{
+				x.scanned     = e.scanned;
+				x.track_count = e.track_count;
+				x.game.swap( e.game );
+				x.tracks.swap( e.tracks );
+				d.modified = true;
+				SDL_AtomicIncRef( &change_count );
+				break;
+			}
+		}
+
+		Uint32 now = SDL_GetTicks();
+		if ( now - save_time >= save_delay )
+		{
+			save_time = now;
+			save_modified();
+		}
+	}
+	SDL_UnlockMutex( mutex );
+}
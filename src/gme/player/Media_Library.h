@@ -0,0 +1,88 @@
+// Index of music directories for file browser
+
+#ifndef MEDIA_LIBRARY_H
+#define MEDIA_LIBRARY_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include "gme/gme.h"
+#include "SDL_thread.h"
+#include "SDL_mutex.h"
+
+struct Media_Track {
+	long length;        // milliseconds, or -1 if unknown
+	long fade;          // milliseconds, or -1 if unknown
+	std::string song;
+};
+
+struct Media_Entry {
+	std::string name;
+	bool is_dir;
+
+	// Rest is only used for files
+	long mtime;
+	long size;
+	int scanned;        // 0 = not yet, 1 = metadata valid, -1 = couldn't be read
+	int track_count;
+	std::string game;
+	std::vector<Media_Track> tracks;
+};
+
+// Keeps listing and metadata of each directory in an index file, so a
+// directory only needs reading again when its modification time changes.
+// Metadata of files is read by a low-priority background thread, most
+// recently listed directory first.
+class Media_Library {
+public:
+	// Keep index files in directory, creating it if necessary. NULL or "" keeps
+	// them in memory only. Only files for which is_music() returns true are
+	// listed.
+	gme_err_t init( const char* index_dir, bool (*is_music)( const std::string& name ) );
+
+	// List directory, with directories first, then files, each sorted by name.
+	// "." and ".." aren't included. Metadata of files may not be scanned yet.
+	void list( const std::string& dir, std::vector<Media_Entry>& out );
+
+	// Incremented each time background thread fills in metadata
+	int changes() const;
+
+	// Finish writing index files and stop background thread
+	void stop();
+
+public:
+	Media_Library();
+	~Media_Library();
+private:
+	struct dir_t {
+		long mtime;
+		bool modified;      // needs writing to index file
+		std::vector<Media_Entry> entries;
+	};
+	typedef std::map<std::string, dir_t> dirs_t;
+
+	dirs_t dirs;
+	std::vector<std::string> pending;   // directories to scan, most urgent last
+	std::string index_dir;
+	bool (*is_music)( const std::string& );
+	SDL_Thread* scan_thread;
+	SDL_mutex* mutex;
+	SDL_cond* wake;
+	mutable SDL_atomic_t change_count;
+	bool quit;
+
+	std::string index_path( const std::string& dir ) const;
+	bool load_index( const std::string& dir, dir_t& out ) const;
+	void save_index( const std::string& dir, dir_t const& d ) const;
+	bool save_modified();
+	void read_dir( const std::string& dir, dir_t& out, dir_t const* old ) const;
+
+	static int scan_thread_( void* );
+	void scan();
+
+	// noncopyable
+	Media_Library( const Media_Library& );
+	Media_Library& operator = ( const Media_Library& );
+};
+
+#endif
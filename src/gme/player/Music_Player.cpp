@@ -2,6 +2,7 @@
 
 #include "Music_Player.h"
 
+#include <stdio.h>
 #include <string.h>
 #include <ctype.h>
 #include "SDL_rwops.h"
@@ -35,6 +36,18 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. */
 // scope
 static const int fill_rate = 60;
 
+// Number of sound buffers rendered ahead of playback. Enough to cover emulation
+// hiccups without making setting changes feel laggy.
+static const int buffers_ahead = 4;
+
+// Number of samples rendered at a time by emulator thread
+static const int render_size = 1024;
+
+// Emulator state is saved this often while playing so seeking backwards doesn't
+// have to replay the track from the beginning
+static const int seek_checkpoint_msec = 5000;
+static const long seek_checkpoint_bytes = 8 * 1024 * 1024L;
+
 // Simple sound driver using SDL
 typedef void (*sound_callback_t)( void* data, short* out, int count );
 static const char* sound_init( long sample_rate, int buf_size, sound_callback_t, void* data );
@@ -64,10 +77,26 @@ static const arc_type_t arcs[] = {
 
 Music_Player::Music_Player()
 {
-	emu_        = 0;
-	scope_buf   = 0;
-	paused      = false;
-	track_info_ = NULL;
+	emu_          = 0;
+	scope_buf     = 0;
+	paused        = false;
+	by_mem_       = false;
+	bass_boost    = false;
+	track_info_   = NULL;
+	render_thread = NULL;
+	render_wake   = NULL;
+	render_emu    = NULL;
+	render_info   = NULL;
+	render_start  = 0;
+	queue_thread  = NULL;
+	memset( &queued, 0, sizeof queued );
+	memset( settings_used, 0, sizeof settings_used );
+	SDL_AtomicSet( &render_quit, 0 );
+	SDL_AtomicSet( &emu_ended, 0 );
+	SDL_AtomicSet( &underruns, 0 );
+	SDL_AtomicSet( &scope_count, 0 );
+	SDL_AtomicSet( &queue_state, queue_none );
+	SDL_AtomicSet( &queue_start, 0 );
 }
 
 gme_err_t Music_Player::init( long rate )
@@ -79,14 +108,25 @@ gme_err_t Music_Player::init( long rate )
 	while ( buf_size < min_size )
 		buf_size *= 2;
 
+	RETURN_ERR( samples.resize( buf_size * 2 * buffers_ahead ) );
+	RETURN_ERR( commands.resize( 64 ) );
+
+	render_wake = SDL_CreateSemaphore( 0 );
+	if ( !render_wake )
+		return "Couldn't create semaphore";
+
 	return sound_init( sample_rate, buf_size, fill_buffer, this );
 }
 
 void Music_Player::stop()
 {
 	sound_stop();
+	stop_render();
+	cancel_queued();
 	gme_delete( emu_ );
 	emu_ = NULL;
+	render_emu = NULL;
+	render_info = NULL;
 }
 
 Music_Player::~Music_Player()
@@ -94,6 +134,8 @@ Music_Player::~Music_Player()
 	stop();
 	sound_cleanup();
 	gme_free_info( track_info_ );
+	if ( render_wake )
+		SDL_DestroySemaphore( render_wake );
 }
 
 // check if file is an archive
@@ -113,10 +155,9 @@ const arc_type_t* identify_archive( const char* path )
 	return nullptr;
 }
 
-gme_err_t Music_Player::load_file(const char* path , bool by_mem)
+// Open emulator for file, along with its m3u playlist if there is one
+static gme_err_t open_emu( const char* path, bool by_mem, long sample_rate, Music_Emu*& emu_ )
 {
-	stop();
-
 	if ( by_mem )
 	{
 		printf( "Loading file %s by memory...\n", path );
@@ -202,6 +243,38 @@ gme_err_t Music_Player::load_file(const char* path , bool by_mem)
 	strcpy( p, ".m3u" );
 	if ( gme_load_m3u( emu_, m3u_path ) ) { } // ignore error
 
+	gme_set_seek_checkpoints( emu_, seek_checkpoint_msec, seek_checkpoint_bytes );
+
+	return 0;
+}
+
+gme_err_t Music_Player::load_file(const char* path , bool by_mem)
+{
+	stop();
+	by_mem_ = by_mem;
+	RETURN_ERR( open_emu( path, by_mem, sample_rate, emu_ ) );
+	render_emu = emu_;
+	return 0;
+}
+
+// Start track and get its info, with length filled in if file doesn't give it
+static gme_err_t begin_track( Music_Emu* emu, int track, gme_info_t** out )
+{
+	RETURN_ERR( gme_start_track( emu, track ) );
+
+	gme_info_t* info = nullptr;
+	RETURN_ERR( gme_track_info( emu, &info, track ) );
+
+	// Calculate track length
+	if ( info->length <= 0 )
+		info->length = info->intro_length +
+					info->loop_length * 2;
+
+	if ( info->length <= 0 )
+		info->length = (long) (2.5 * 60 * 1000);
+	gme_set_fade_msecs( emu, info->length, 8000 );
+
+	*out = info;
 	return 0;
 }
 
@@ -214,24 +287,20 @@ gme_err_t Music_Player::start_track( int track )
 {
 	if ( emu_ )
 	{
-		// Sound must not be running when operating on emulator
+		// Neither sound nor emulator thread may be running when operating on emulator
 		sound_stop();
-		RETURN_ERR( gme_start_track( emu_, track ) );
+		stop_render();
+		cancel_queued();
+		render_emu = emu_;
 
+		gme_info_t* info = nullptr;
+		RETURN_ERR( begin_track( emu_, track, &info ) );
 		gme_free_info( track_info_ );
-		track_info_ = nullptr;
-		RETURN_ERR( gme_track_info( emu_, &track_info_, track ) );
-
-		// Calculate track length
-		if ( track_info_->length <= 0 )
-			track_info_->length = track_info_->intro_length +
-						track_info_->loop_length * 2;
-
-		if ( track_info_->length <= 0 )
-			track_info_->length = (long) (2.5 * 60 * 1000);
-		gme_set_fade_msecs( emu_, track_info_->length, 8000 );
+		track_info_ = info;
+		render_info = info;
 
 		paused = false;
+		start_render();
 		sound_start();
 	}
 	return 0;
@@ -246,91 +315,363 @@ void Music_Player::pause( int b )
 		sound_start();
 }
 
-void Music_Player::suspend()
-{
-	if ( !paused )
-		sound_stop();
-}
-
-void Music_Player::resume()
-{
-	if ( !paused )
-		sound_start();
-}
-
 bool Music_Player::track_ended() const
 {
-	return emu_ ? gme_track_ended( emu_ ) : false;
+	return emu_ ? SDL_AtomicGet( &emu_ended ) && !samples.avail() : false;
 }
 
-void Music_Player::set_stereo_depth( double tempo )
+void Music_Player::set_stereo_depth( double depth )
 {
-	suspend();
-	gme_set_stereo_depth( emu_, tempo );
-	resume();
+	post( cmd_stereo_depth, depth );
 }
 
 void Music_Player::enable_accuracy( bool b )
 {
-	suspend();
-	gme_enable_accuracy( emu_, b );
-	resume();
+	post( cmd_accuracy, b );
 }
 
 void Music_Player::set_tempo( double tempo )
 {
-	suspend();
-	gme_set_tempo( emu_, tempo );
-	resume();
+	post( cmd_tempo, tempo );
 }
 
 void Music_Player::set_echo_disable( bool d )
 {
-	suspend();
-	gme_disable_echo( emu_, d );
-	resume();
+	post( cmd_echo, d );
 }
 
 void Music_Player::mute_voices( int mask )
 {
-	suspend();
-	gme_mute_voices( emu_, mask );
-	gme_ignore_silence( emu_, mask != 0 );
-	resume();
+	post( cmd_mute, mask );
 }
 
 void Music_Player::seek_forward()
 {
-	suspend();
-	int pos = gme_tell( emu_ );
-	if ( pos > 0 )
-		gme_seek( emu_, pos + 1000 );
-	resume();
+	post( cmd_seek, 1000 );
 }
 
 void Music_Player::seek_backward()
 {
-	suspend();
-	int pos = gme_tell( emu_ );
-	if ( pos > 0 )
-		gme_seek( emu_, pos - 1000 );
-	resume();
+	post( cmd_seek, -1000 );
+}
+
+void Music_Player::set_bass_boost( bool boost )
+{
+	post( cmd_bass, boost );
 }
 
 void Music_Player::set_fadeout( bool fade )
 {
-	gme_set_fade_msecs( emu_, fade ? track_info_->length : -1, 8000 );
+	post( cmd_fade, fade );
+}
+
+// Emulator thread
+
+void Music_Player::post( int type, double value )
+{
+	if ( !emu_ )
+		return;
+
+	command_t cmd;
+	cmd.type  = type;
+	cmd.value = value;
+
+	if ( !render_thread )
+	{
+		run_command( cmd );
+		return;
+	}
+
+	while ( !commands.write( &cmd, 1 ) )
+		SDL_Delay( 1 ); // only if user is sending commands faster than they can run
+	SDL_SemPost( render_wake );
+}
+
+void Music_Player::run_command( command_t const& cmd )
+{
+	Music_Emu* emu = render_emu;
+	if ( !emu )
+		return;
+
+	if ( cmd.type != cmd_seek )
+	{
+		settings [cmd.type] = cmd.value;
+		settings_used [cmd.type] = true;
+	}
+
+	switch ( cmd.type )
+	{
+	case cmd_stereo_depth:
+		gme_set_stereo_depth( emu, cmd.value );
+		break;
+
+	case cmd_accuracy:
+		// YM2612 is where accuracy costs the most CPU
+		gme_enable_accuracy( emu, cmd.value != 0 );
+		gme_set_ym2612_emu( emu, cmd.value != 0 ? gme_ym2612_nuked : gme_ym2612_gens );
+		break;
+
+	case cmd_tempo:
+		gme_set_tempo( emu, cmd.value );
+		break;
+
+	case cmd_echo:
+		gme_disable_echo( emu, cmd.value != 0 );
+		break;
+
+	case cmd_mute: {
+		int mask = (int) cmd.value;
+		gme_mute_voices( emu, mask );
+		gme_ignore_silence( emu, mask != 0 );
+		break;
+	}
+
+	case cmd_seek: {
+		// Position being heard lags emulator by what's waiting to be played.
+		// Anything before render_start will be skipped by reader or is from
+		// previous track, so it doesn't count.
+		unsigned heard = samples.read_position();
+		if ( (int) (heard - render_start) < 0 )
+			heard = render_start;
+		int waiting = samples.write_position() - heard;
+		long pos = gme_tell( emu ) - (long) (waiting * 1000LL / (sample_rate * 2)) + (long) cmd.value;
+		gme_seek( emu, pos > 0 ? (int) pos : 0 );
+		samples.discard();
+		render_start = samples.write_position();
+		break;
+	}
+
+	case cmd_bass:
+		// also re-sent when queued track starts, which mustn't clear filter
+		if ( bass_boost != (cmd.value != 0) )
+		{
+			bass_boost = cmd.value != 0;
+			output_filter.clear_eq();
+			if ( bass_boost )
+				output_filter.add_low_shelf( sample_rate, 250.0, 5.0, 0.707 );
+		}
+		break;
+
+	case cmd_fade:
+		if ( render_info )
+			gme_set_fade_msecs( emu, cmd.value != 0 ? render_info->length : -1, 8000 );
+		break;
+	}
+}
+
+void Music_Player::start_render()
+{
+	samples.clear();
+	commands.clear();
+	output_filter.clear();
+	render_start = samples.write_position();
+	SDL_AtomicSet( &render_quit, 0 );
+	SDL_AtomicSet( &emu_ended, 0 );
+
+	render_thread = SDL_CreateThread( render_thread_, "gme render", this );
+	if ( !render_thread )
+		fprintf( stderr, "Couldn't create render thread: %s\n", SDL_GetError() );
+}
+
+void Music_Player::stop_render()
+{
+	if ( render_thread )
+	{
+		SDL_AtomicSet( &render_quit, 1 );
+		SDL_SemPost( render_wake );
+		SDL_WaitThread( render_thread, NULL );
+		render_thread = NULL;
+	}
+
+	// run anything posted after thread last checked
+	command_t cmd;
+	while ( commands.read( &cmd, 1 ) )
+		run_command( cmd );
+}
+
+int Music_Player::render_thread_( void* data )
+{
+	((Music_Player*) data)->render();
+	return 0;
+}
+
+void Music_Player::render()
+{
+	sample_t buf [render_size];
+	while ( !SDL_AtomicGet( &render_quit ) )
+	{
+		command_t cmd;
+		while ( commands.read( &cmd, 1 ) )
+			run_command( cmd );
+
+		bool ended = gme_track_ended( render_emu ) != 0;
+		if ( ended && SDL_AtomicCAS( &queue_state, queue_ready, queue_switching ) )
+		{
+			start_queued();
+			ended = false;
+		}
+
+		// Track hasn't really ended if queued track is still being opened
+		SDL_AtomicSet( &emu_ended, ended && SDL_AtomicGet( &queue_state ) != queue_loading );
+
+		if ( samples.space() < render_size || ended )
+		{
+			// woken by sound callback after it reads, when a command is posted,
+			// or when queued track is ready
+			SDL_SemWaitTimeout( render_wake, 100 );
+			continue;
+		}
+
+		if ( gme_play( render_emu, render_size, buf ) ) { } // ignore error
+		output_filter.run( buf, render_size );
+		samples.write( buf, render_size );
+	}
+}
+
+// Gapless playback
+
+gme_err_t Music_Player::queue_next( const char* path, int track )
+{
+	cancel_queued();
+	if ( !emu_ || SDL_AtomicGet( &queue_state ) != queue_none )
+		return "Queued track already started";
+
+	queued.path  = strdup( path );
+	queued.track = track;
+	if ( !queued.path )
+		return "Out of memory";
+
+	SDL_AtomicSet( &queue_state, queue_loading );
+	queue_thread = SDL_CreateThread( queue_thread_, "gme queue", this );
+	if ( !queue_thread )
+	{
+		SDL_AtomicSet( &queue_state, queue_none );
+		free( queued.path );
+		queued.path = NULL;
+		return "Couldn't create queue thread";
+	}
+	return 0;
+}
+
+int Music_Player::queue_thread_( void* data )
+{
+	((Music_Player*) data)->open_queued();
+	return 0;
+}
+
+// Runs in queue thread
+void Music_Player::open_queued()
+{
+	Music_Emu* emu = NULL;
+	gme_err_t err = open_emu( queued.path, by_mem_, sample_rate, emu );
+	if ( !err )
+		err = begin_track( emu, queued.track, &queued.info );
+
+	if ( err )
+	{
+		fprintf( stderr, "Couldn't open next track: %s\n", err );
+		gme_delete( emu );
+		SDL_AtomicSet( &queue_state, queue_failed );
+	}
+	else
+	{
+		queued.emu = emu;
+		SDL_AtomicSet( &queue_state, queue_ready );
+	}
+	SDL_SemPost( render_wake );
+}
+
+// Runs in emulator thread, once current track has ended
+void Music_Player::start_queued()
+{
+	// Previous emulator is left for advance_queued() to delete, since caller
+	// may still be using it
+	render_emu  = queued.emu;
+	render_info = queued.info;
+
+	for ( int i = 0; i <= cmd_fade; i++ )
+	{
+		if ( settings_used [i] )
+		{
+			command_t cmd;
+			cmd.type  = i;
+			cmd.value = settings [i];
+			run_command( cmd );
+		}
+	}
+
+	render_start = samples.write_position();
+	SDL_AtomicSet( &queue_start, render_start );
+	SDL_AtomicSet( &queue_state, queue_started );
+}
+
+void Music_Player::cancel_queued()
+{
+	if ( queue_thread )
+	{
+		SDL_WaitThread( queue_thread, NULL );
+		queue_thread = NULL;
+	}
+
+	// Once emulator thread takes queued track it can't be taken back, unless
+	// emulator thread is stopped
+	if ( render_thread && !SDL_AtomicCAS( &queue_state, queue_ready, queue_none ) &&
+			SDL_AtomicGet( &queue_state ) >= queue_switching )
+		return;
+
+	if ( render_emu == queued.emu )
+	{
+		render_emu  = emu_;
+		render_info = track_info_;
+	}
+	gme_delete( queued.emu );
+	gme_free_info( queued.info );
+	free( queued.path );
+	memset( &queued, 0, sizeof queued );
+	SDL_AtomicSet( &queue_state, queue_none );
+}
+
+bool Music_Player::advance_queued()
+{
+	if ( SDL_AtomicGet( &queue_state ) != queue_started )
+		return false;
+
+	// Wait until sound output reaches it
+	if ( (int) (samples.read_position() - (unsigned) SDL_AtomicGet( &queue_start )) < 0 )
+		return false;
+
+	if ( queue_thread )
+	{
+		SDL_WaitThread( queue_thread, NULL );
+		queue_thread = NULL;
+	}
+
+	gme_delete( emu_ );
+	gme_free_info( track_info_ );
+	emu_        = queued.emu;
+	track_info_ = queued.info;
+	free( queued.path );
+	memset( &queued, 0, sizeof queued );
+	SDL_AtomicSet( &queue_state, queue_none );
+	return true;
 }
 
 void Music_Player::fill_buffer( void* data, sample_t* out, int count )
 {
 	Music_Player* self = (Music_Player*) data;
-	if ( self->emu_ )
+	int n = self->samples.read( out, count );
+	if ( n < count )
 	{
-		if ( gme_play( self->emu_, count, out ) ) { } // ignore error
+		memset( out + n, 0, (count - n) * sizeof *out );
+		if ( self->render_thread && !SDL_AtomicGet( &self->emu_ended ) )
+			SDL_AtomicIncRef( &self->underruns );
+	}
+	SDL_SemPost( self->render_wake );
 
-		if ( self->scope_buf )
-			memcpy( self->scope_buf, out, self->scope_buf_size * sizeof *self->scope_buf );
+	if ( self->scope_buf )
+	{
+		memcpy( self->scope_buf, out, self->scope_buf_size * sizeof *self->scope_buf );
+		SDL_AtomicIncRef( &self->scope_count );
 	}
 }
 
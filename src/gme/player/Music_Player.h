@@ -8,6 +8,10 @@
 #include <assert.h>
 #include <stdlib.h>
 #include "gme/gme.h"
+#include "gme/Output_Filter.h"
+#include "Spsc_Queue.h"
+#include "SDL_thread.h"
+#include "SDL_mutex.h"
 
 class Music_Player {
 public:
@@ -23,6 +27,19 @@ public:
 	// Stop playing current file
 	void stop();
 
+	// Open track to follow current one, in the background. When current track
+	// ends, sound carries straight on into it, without a gap. Replaces any track
+	// already queued, unless that has already started. load_file(), start_track()
+	// and stop() cancel it.
+	gme_err_t queue_next( const char* path, int track );
+
+	// Cancel queued track, unless it has already started
+	void cancel_queued();
+
+	// If queued track has started being heard, make it current track and return
+	// true. Call regularly while playing.
+	bool advance_queued();
+
 // Optional functions
 
 	// Number of tracks in current file, or 0 if no file loaded.
@@ -43,7 +60,8 @@ public:
 	// Set stereo depth, where 0.0 = none and 1.0 = maximum
 	void set_stereo_depth( double );
 
-	// Enable accurate sound emulation
+	// Enable accurate sound emulation. When disabled, Genesis music uses the
+	// fastest YM2612 emulator.
 	void enable_accuracy( bool );
 
 	// Set tempo, where 0.5 = half speed, 1.0 = normal, 2.0 = double speed
@@ -61,6 +79,9 @@ public:
 	// Move back to 1 second
 	void seek_backward();
 
+	// Boost bass with a low shelf, as playgsf does
+	void set_bass_boost( bool );
+
 	// Toggle whether fadeout is used or not. If used, stops at track length,
 	// if not used, loop forever
 	void set_fadeout( bool do_fade );
@@ -69,6 +90,15 @@ public:
 	typedef short sample_t;
 	void set_scope_buffer( sample_t* buf, int size ) { scope_buf = buf; scope_buf_size = size; }
 
+	// Number of samples rendered but not yet played
+	int buffered_samples() const { return samples.avail(); }
+
+	// Number of times sound output ran out of rendered samples while playing
+	int underrun_count() const { return SDL_AtomicGet( &underruns ); }
+
+	// Number of times scope buffer has been updated, to tell when it changed
+	int scope_updates() const { return SDL_AtomicGet( &scope_count ); }
+
 public:
 	Music_Player();
 	~Music_Player();
@@ -78,10 +108,64 @@ private:
 	long sample_rate;
 	int scope_buf_size;
 	bool paused;
+	bool by_mem_;
+	bool bass_boost;
 	gme_info_t* track_info_;
 
-	void suspend();
-	void resume();
+	// Emulator runs in its own thread, ahead of sound output. Changes to
+	// emulator settings are posted to it rather than made directly.
+	enum { cmd_stereo_depth, cmd_accuracy, cmd_tempo, cmd_echo, cmd_mute,
+			cmd_bass, cmd_seek, cmd_fade };
+	struct command_t {
+		int type;
+		double value;
+	};
+	Spsc_Queue<command_t> commands;
+	Spsc_Queue<sample_t> samples;
+	SDL_Thread* render_thread;
+	SDL_sem* render_wake;
+	mutable SDL_atomic_t render_quit;
+	mutable SDL_atomic_t emu_ended;
+	mutable SDL_atomic_t underruns;
+	mutable SDL_atomic_t scope_count;
+
+	// Track emulator thread is rendering. Moves on to queued track before
+	// emu_ and track_info_ do, which only happens once it is heard.
+	Music_Emu* render_emu;
+	gme_info_t* render_info;
+	unsigned render_start; // samples.write_position() at last start or seek of render_emu
+
+	// Bass boost, applied by emulator thread to what it renders
+	Output_Filter output_filter;
+
+	// Last value of each setting, so queued track can be given the same
+	double settings [cmd_fade + 1];
+	bool settings_used [cmd_fade + 1];
+
+	// Queued track is opened by its own thread, then handed to emulator thread
+	// once ready. Emulator thread takes it when current track ends.
+	enum { queue_none, queue_loading, queue_ready, queue_failed, queue_switching,
+			queue_started };
+	struct queued_t {
+		char* path;
+		int track;
+		Music_Emu* emu;
+		gme_info_t* info;
+	};
+	queued_t queued;
+	SDL_Thread* queue_thread;
+	mutable SDL_atomic_t queue_state;
+	mutable SDL_atomic_t queue_start; // samples.write_position() where it starts
+
+	void post( int type, double value = 0 );
+	void run_command( command_t const& );
+	void start_render();
+	void stop_render();
+	void render();
+	void open_queued();
+	void start_queued();
+	static int render_thread_( void* );
+	static int queue_thread_( void* );
 	static void fill_buffer( void*, sample_t*, int );
 };
 
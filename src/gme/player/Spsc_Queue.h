@@ -0,0 +1,151 @@
+// Lock-free queue between one writer thread and one reader thread
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include "SDL_atomic.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Fixed-size ring of POD items. Exactly one thread may write and one other
+// thread may read; neither ever blocks or takes a lock, so it is safe to use
+// from the audio callback. Positions only ever increase (wrapping around at
+// 2^32) and are masked when accessing the buffer.
+template<class T>
+class Spsc_Queue {
+public:
+	Spsc_Queue();
+	~Spsc_Queue() { free( buf ); }
+
+	// Allocate room for at least 'count' items and clear queue. Neither reader
+	// nor writer may be active. Returns error string or NULL.
+	const char* resize( int count );
+
+	// Remove all items. Neither reader nor writer may be active.
+	void clear();
+
+	// Maximum number of items queue can hold
+	int capacity() const { return mask + 1; }
+
+	// Number of items waiting to be read
+	int avail() const;
+
+	// Total number of items written so far, wrapping around at 2^32
+	unsigned write_position() const { return SDL_AtomicGet( &write_pos ); }
+
+	// Total number of items read or skipped by reader so far, wrapping around
+	// at 2^32
+	unsigned read_position() const { return SDL_AtomicGet( &read_pos ); }
+
+// Writer
+
+	// Number of items that can currently be written
+	int space() const { return capacity() - avail(); }
+
+	// Write at most 'count' items and return number actually written
+	int write( T const* in, int count );
+
+	// Have reader drop all items written so far
+	void discard();
+
+// Reader
+
+	// Read at most 'count' items and return number actually read
+	int read( T* out, int count );
+
+private:
+	T* buf;
+	unsigned mask;
+	mutable SDL_atomic_t write_pos;
+	mutable SDL_atomic_t read_pos;
+	mutable SDL_atomic_t discard_pos;
+
+	// noncopyable
+	Spsc_Queue( const Spsc_Queue& );
+	Spsc_Queue& operator = ( const Spsc_Queue& );
+};
+
+template<class T>
+Spsc_Queue<T>::Spsc_Queue() : buf( NULL ), mask( (unsigned) -1 )
+{
+	clear();
+}
+
+template<class T>
+const char* Spsc_Queue<T>::resize( int count )
+{
+	unsigned size = 1;
+	while ( size < (unsigned) count )
+		size *= 2;
+
+	void* p = realloc( buf, size * sizeof (T) );
+	if ( !p )
+		return "Out of memory";
+	buf  = (T*) p;
+	mask = size - 1;
+	clear();
+	return NULL;
+}
+
+template<class T>
+void Spsc_Queue<T>::clear()
+{
+	SDL_AtomicSet( &write_pos, 0 );
+	SDL_AtomicSet( &read_pos, 0 );
+	SDL_AtomicSet( &discard_pos, 0 );
+}
+
+template<class T>
+inline int Spsc_Queue<T>::avail() const
+{
+	return (unsigned) SDL_AtomicGet( &write_pos ) - (unsigned) SDL_AtomicGet( &read_pos );
+}
+
+template<class T>
+int Spsc_Queue<T>::write( T const* in, int count )
+{
+	if ( count > space() )
+		count = space();
+
+	unsigned pos = SDL_AtomicGet( &write_pos );
+	int first = capacity() - (pos & mask);
+	if ( first > count )
+		first = count;
+	memcpy( &buf [pos & mask], in, first * sizeof (T) );
+	memcpy( buf, in + first, (count - first) * sizeof (T) );
+
+	// SDL_AtomicSet() is a full barrier, so items are visible before position
+	SDL_AtomicSet( &write_pos, pos + count );
+	return count;
+}
+
+template<class T>
+inline void Spsc_Queue<T>::discard()
+{
+	SDL_AtomicSet( &discard_pos, SDL_AtomicGet( &write_pos ) );
+}
+
+template<class T>
+int Spsc_Queue<T>::read( T* out, int count )
+{
+	unsigned pos = SDL_AtomicGet( &read_pos );
+	unsigned discard_to = SDL_AtomicGet( &discard_pos );
+	if ( (int) (discard_to - pos) > 0 )
+		pos = discard_to;
+
+	int n = (unsigned) SDL_AtomicGet( &write_pos ) - pos;
+	if ( count > n )
+		count = n;
+
+	int first = capacity() - (pos & mask);
+	if ( first > count )
+		first = count;
+	memcpy( out, &buf [pos & mask], first * sizeof (T) );
+	memcpy( out + first, buf, (count - first) * sizeof (T) );
+
+	SDL_AtomicSet( &read_pos, pos + count );
+	return count;
+}
+
+#endif
@@ -10,8 +10,9 @@ Button A Play file
 Button B Return to file selector
 Button Y Toggle track looping (infinite playback)
 Button X Pause/unpause Toggle echo processing
-Button L1 Enable/disable accurate emulation
+Button L1 Enable/disable accurate emulation (Nuked or GENS YM2612 for Genesis)
 Button R1 Reset tempo and turn channels back on
+Menu Toggle bass boost
 Select EXIT
 Start Pause/unpause
 GUIDE block/unblock buttons and screen
@@ -22,6 +23,7 @@ GUIDE block/unblock buttons and screen
 
 #include "Music_Player.h"
 #include "Audio_Scope.h"
+#include "Media_Library.h"
 
 #include <algorithm>
 #include <cstdio>
@@ -38,6 +40,7 @@ GUIDE block/unblock buttons and screen
 #include <linux/input.h>
 #include <unistd.h>
 #include <vector>
+#include <unordered_map>
 #include <pthread.h>
 #include <sys/ioctl.h>
 
@@ -95,11 +98,10 @@ int read_battery_percent() {
 }
 
 // File browser structures
-struct Entry {
-    std::string name;
-    bool is_dir;
-};
+typedef Media_Entry Entry;
 static std::vector<Entry> entries;  // current listing
+static Media_Library* library = nullptr;
+static int library_changes = 0;     // library->changes() when listed
 static std::string current_path = "/mnt/mmc/Music"; // initial root directory
 static int selected_index = 0;
 static bool file_selected = false;
@@ -113,6 +115,7 @@ static double tempo = 1.0;
 static double stereo_depth = 0.0;
 static bool accurate = false;
 static bool echo_disabled = false;
+static bool bass_boost = false;
 static int muting_mask = 0;
 
 // Screen off state
@@ -126,22 +129,62 @@ enum LoopMode {
 };
 static LoopMode loop_mode = LOOP_ALL;  // Default infinite loop
 
+// Gapless playback: what follows current track is opened ahead of time and
+// played straight after it. PLAYER_NO_GAPLESS in environment disables it.
+static bool gapless = true;
+static std::string queued_path;
+static int queued_track = 0;
+
 // Execution states
 enum RunMode { MODE_SELECTION, MODE_PLAYBACK };
 static RunMode run_mode = MODE_SELECTION;
 
+// Screen is drawn into a texture which keeps its contents between frames, so
+// only regions which changed need drawing again. If the renderer can't draw
+// to textures, everything is drawn whenever anything changes.
+static SDL_Texture* screen_texture = nullptr;
+
+// Screen regions needing to be drawn
+enum {
+    dirty_header  = 0x01, // title, track info and battery
+    dirty_scope   = 0x02,
+    dirty_status  = 0x04, // playback settings and help line
+    dirty_browser = 0x08, // whole screen while in file browser
+    dirty_all     = 0x0F
+};
+static unsigned dirty = dirty_all;
+
+// How long main loop sleeps waiting for input
+static const int frame_wait_ms = 1000 / 60; // while scope is moving
+static const int poll_wait_ms = 100;        // while playing with screen off
+static const int idle_wait_ms = 1000;       // while nothing is changing
+
+// Frame time counter, printed to stderr every few seconds when the
+// PLAYER_FRAME_STATS environment variable is set
+struct Frame_Stats {
+    bool enabled;
+    Uint32 start;       // SDL_GetTicks() at start of period
+    int wakeups;        // times main loop woke up
+    int frames;         // frames presented
+    Uint64 draw_start;  // SDL_GetPerformanceCounter() at begin_frame()
+    Uint64 draw_time;   // time spent drawing, in performance counter units
+};
+static Frame_Stats frame_stats;
+static const Uint32 frame_stats_period = 5000;
+
 // Forward declarations
 static void handle_error(const char*);
-static void render_text(const char* text, int x, int y, SDL_Color color);
-static void render_text_small(const char* text, int x, int y, SDL_Color color);
-static void render_text_big(const char* text, int x, int y, SDL_Color color);
-static bool is_directory(const std::string& path);
+static int render_text(const char* text, int x, int y, SDL_Color color);
+static int render_text_small(const char* text, int x, int y, SDL_Color color);
+static int render_text_big(const char* text, int x, int y, SDL_Color color);
+static void clear_text_cache();
 static bool is_valid_music(const std::string& fname);
 static void list_directory(const std::string& path, bool reset_selection = true);
 static void draw_file_browser();
 static void on_enter_pressed();
 static void start_track(int trk, const char* path);
-static void clear_text_areas(SDL_Renderer* renderer);
+static void queue_next_track();
+static void clear_rect(const SDL_Rect& r);
 void hw_display_off(void);
 void hw_display_on(void);
 
@@ -206,44 +249,110 @@ void hw_display_on(void)
     set_brightness(last_brightness);
 }
 
-// Render text using SDL_ttf
-static void render_text(const char* text, int x, int y, SDL_Color color)
+// Rendered strings are kept as textures and reused for as long as they keep
+// being drawn, so text that hasn't changed costs a texture copy per frame
+// rather than being rasterized again.
+struct Cached_Text {
+    SDL_Texture* texture;
+    int w, h;
+    Uint32 last_used; // SDL_GetTicks()
+};
+static std::unordered_map<std::string, Cached_Text> text_cache;
+static const size_t text_cache_max = 256;
+static const Uint32 text_cache_keep_ms = 1000;
+
+static void evict_text_cache(Uint32 now)
 {
-    SDL_Surface* surf = TTF_RenderText_Blended(font, text, color);
-    if (!surf) return;
-    SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surf);
-    SDL_FreeSurface(surf);
-    if (!texture) return;
-    SDL_Rect rect = { x, y, 0, 0 };
-    SDL_QueryTexture(texture, NULL, NULL, &rect.w, &rect.h);
-    SDL_RenderCopy(renderer, texture, NULL, &rect);
-    SDL_DestroyTexture(texture);
+    // Drop strings not drawn recently, or failing that the least recently drawn
+    auto oldest = text_cache.end();
+    for (auto it = text_cache.begin(); it != text_cache.end(); ) {
+        if (now - it->second.last_used > text_cache_keep_ms) {
+            SDL_DestroyTexture(it->second.texture);
+            it = text_cache.erase(it);
+            continue;
+        }
+        if (oldest == text_cache.end() || it->second.last_used < oldest->second.last_used)
+            oldest = it;
+        ++it;
+    }
+    if (text_cache.size() >= text_cache_max && oldest != text_cache.end()) {
+        SDL_DestroyTexture(oldest->second.texture);
+        text_cache.erase(oldest);
+    }
 }
 
-static void render_text_small(const char* text, int x, int y, SDL_Color color)
+static void clear_text_cache()
 {
-    SDL_Surface* surf = TTF_RenderText_Blended(small_font, text, color);
-    if (!surf) return;
-    SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surf);
-    SDL_FreeSurface(surf);
-    if (!texture) return;
-    SDL_Rect rect = { x, y, 0, 0 };
-    SDL_QueryTexture(texture, NULL, NULL, &rect.w, &rect.h);
-    SDL_RenderCopy(renderer, texture, NULL, &rect);
-    SDL_DestroyTexture(texture);
+    for (auto& t : text_cache)
+        SDL_DestroyTexture(t.second.texture);
+    text_cache.clear();
 }
 
-static void render_text_big(const char* text, int x, int y, SDL_Color color)
+// Texture for text in given font and color, rendering it if not already cached
+static const Cached_Text* get_text(TTF_Font* f, const char* text, SDL_Color color)
 {
-    SDL_Surface* surf = TTF_RenderText_Blended(big_font, text, color);
-    if (!surf) return;
-    SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surf);
+    if (!*text)
+        return nullptr;
+
+    std::string key;
+    key.append((const char*) &f, sizeof f);
+    key.append((const char*) &color, sizeof color);
+    key += text;
+
+    Uint32 now = SDL_GetTicks();
+    auto it = text_cache.find(key);
+    if (it != text_cache.end()) {
+        it->second.last_used = now;
+        return &it->second;
+    }
+
+    if (text_cache.size() >= text_cache_max)
+        evict_text_cache(now);
+
+    SDL_Surface* surf = TTF_RenderText_Blended(f, text, color);
+    if (!surf) return nullptr;
+    Cached_Text t;
+    t.texture = SDL_CreateTextureFromSurface(renderer, surf);
+    t.w = surf->w;
+    t.h = surf->h;
+    t.last_used = now;
     SDL_FreeSurface(surf);
-    if (!texture) return;
-    SDL_Rect rect = { x, y, 0, 0 };
-    SDL_QueryTexture(texture, NULL, NULL, &rect.w, &rect.h);
-    SDL_RenderCopy(renderer, texture, NULL, &rect);
-    SDL_DestroyTexture(texture);
+    if (!t.texture) return nullptr;
+
+    return &text_cache.emplace(std::move(key), t).first->second;
+}
+
+// Draw text and return its width
+static int draw_text(TTF_Font* f, const char* text, int x, int y, SDL_Color color)
+{
+    const Cached_Text* t = get_text(f, text, color);
+    if (!t) return 0;
+    SDL_Rect rect = { x, y, t->w, t->h };
+    SDL_RenderCopy(renderer, t->texture, NULL, &rect);
+    return t->w;
+}
+
+// Width of text as draw_text() would draw it
+static int text_width(TTF_Font* f, const char* text, SDL_Color color)
+{
+    const Cached_Text* t = get_text(f, text, color);
+    return t ? t->w : 0;
+}
+
+// Render text using SDL_ttf
+static int render_text(const char* text, int x, int y, SDL_Color color)
+{
+    return draw_text(font, text, x, y, color);
+}
+
+static int render_text_small(const char* text, int x, int y, SDL_Color color)
+{
+    return draw_text(small_font, text, x, y, color);
+}
+
+static int render_text_big(const char* text, int x, int y, SDL_Color color)
+{
+    return draw_text(big_font, text, x, y, color);
 }
 
 // Rendering function for battery shown top right
@@ -255,11 +364,8 @@ void render_status_monitor(int screen_width) {
     char bat_value[8];
     snprintf(bat_value, sizeof(bat_value), "%d%% ", battery);
 
-    int bat_label_w = 0, bat_value_w = 0;
-    int h = 0;
-
-    TTF_SizeText(font, bat_label, &bat_label_w, &h);
-    TTF_SizeText(font, bat_value, &bat_value_w, &h);
+    int bat_label_w = text_width(font, bat_label, green);
+    int bat_value_w = text_width(font, bat_value, orange);
 
     int pad = 0;
     int total_w = bat_label_w + bat_value_w + pad * 3;
@@ -267,19 +373,11 @@ void render_status_monitor(int screen_width) {
     int x = screen_width - 10 - total_w;
     int y = 10;
 
-    render_text(bat_label, x, y, green);
-    x += bat_label_w;
+    x += render_text(bat_label, x, y, green);
     render_text(bat_value, x, y, orange);
 }
 
 
-// Check if path is a directory
-static bool is_directory(const std::string& path) {
-    struct stat st;
-    if (stat(path.c_str(), &st) != 0) return false;
-    return (st.st_mode & S_IFDIR) != 0;
-}
-
 // Check if filename is a valid music extension or recognized by gme
 static bool is_valid_music(const std::string& fname) {
     auto pos = fname.find_last_of('.');
@@ -292,28 +390,16 @@ static bool is_valid_music(const std::string& fname) {
     return gme_identify_extension(fname.c_str());
 }
 
-// List content of directory into entries vector
+// List content of directory into entries vector, directories first, then
+// files alphabetically. Comes from library index unless directory changed.
 // CORREGIDO: reset_selection controla si resetear selected_index
 static void list_directory(const std::string& path, bool reset_selection) {
-    entries.clear();
-    DIR* dir = opendir(path.c_str());
-    if (!dir) return;
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != nullptr) {
-        std::string fname = entry->d_name;
-        if (fname == ".") continue;
-        std::string full_path = path + "/" + fname;
-        bool dir_flag = is_directory(full_path);
-        if (dir_flag || is_valid_music(fname))
-            entries.push_back({fname, dir_flag});
-    }
-    closedir(dir);
-    // Sort directories first, then files alphabetically
-    std::sort(entries.begin(), entries.end(),
-        [](const Entry& a, const Entry& b) {
-            if (a.is_dir != b.is_dir) return a.is_dir > b.is_dir;
-            return a.name < b.name;
-        });
+    library_changes = library->changes();
+    library->list(path, entries);
+    Entry up = Entry();
+    up.name = "..";
+    up.is_dir = true;
+    entries.insert(entries.begin(), up);
     
     // CORREGIDO: Solo resetear si se especifica
     if (reset_selection) {
@@ -331,8 +417,8 @@ static void list_directory(const std::string& path, bool reset_selection) {
 
 // Draw the file browser screen
 static void draw_file_browser() {
-    SDL_SetRenderDrawColor(renderer, 0,0,0,255);
-    SDL_RenderClear(renderer);
+    SDL_Rect screen = { 0, 0, scope_width, scope_height };
+    clear_rect(screen);
     SDL_Color white = {255,255,255,255};
     SDL_Color highlight = {255,255,0,255};
     SDL_Color dir_color = {0,255,255,255};
@@ -366,12 +452,23 @@ static void draw_file_browser() {
     int draw_y = y;
     for (int i = scroll_start; i < scroll_end; ++i) {
         SDL_Color color = (selected_index == i) ? highlight : (entries[i].is_dir ? dir_color : white);
-        std::string textline = entries[i].is_dir ? "[DIR] " + entries[i].name : entries[i].name;
+        const Entry& e = entries[i];
+        std::string textline = e.is_dir ? "[DIR] " + e.name : e.name;
+        // Metadata, once library has scanned file
+        if (!e.is_dir && e.scanned > 0) {
+            char info[32];
+            if (e.track_count > 1)
+                snprintf(info, sizeof(info), "  [%d tracks]", e.track_count);
+            else if (e.track_count == 1 && e.tracks[0].length > 0)
+                snprintf(info, sizeof(info), "  [%ld:%02ld]",
+                         e.tracks[0].length / 60000, e.tracks[0].length / 1000 % 60);
+            else
+                info[0] = 0;
+            textline += info;
+        }
         render_text(textline.c_str(), 10, draw_y, color);
         draw_y += line_height;
     }
-
-    SDL_RenderPresent(renderer);
 }
 
 // Handle enter key (or button A) pressed on the browser
@@ -397,12 +494,9 @@ static void on_enter_pressed() {
     }
 }
 
-// Start playing a given track
-static void start_track(int trk, const char* path)
+// Show current track in window title
+static void update_title(const char* path)
 {
-    paused = false;
-    handle_error(player->start_track(trk - 1));
-    track = trk;
     long seconds = player->track_info().length / 1000;
     const char* game = player->track_info().game;
     if (!*game) {
@@ -421,16 +515,136 @@ static void start_track(int trk, const char* path)
              seconds / 60, seconds % 60);
 
     SDL_SetWindowTitle(window, title);
+}
+
+// Start playing a given track
+static void start_track(int trk, const char* path)
+{
+    paused = false;
+    handle_error(player->start_track(trk - 1));
+    track = trk;
+    update_title(path);
     player->set_stereo_depth(stereo_depth);
+    player->enable_accuracy(accurate);
+    queue_next_track();
 }
 
-// Clear the top and bottom text areas by filling with black
-static void clear_text_areas(SDL_Renderer* renderer) {
-    SDL_Rect top_bar = { 0, 0, scope_width, margin_top };
-    SDL_Rect bottom_bar = { 0, scope_height - margin_bottom, scope_width, margin_bottom };
+// Find file and track (1-based) to play after current one in current loop
+// mode. Returns false if playback should stop instead.
+static bool next_after_current(std::string& path, int& trk)
+{
+    path = selected_file_path;
+    if (loop_mode == LOOP_ONE) {
+        trk = track;
+        return true;
+    }
+    if (player->track_count() > 1 || loop_mode == LOOP_OFF) {
+        if (track < player->track_count()) {
+            trk = track + 1;
+            return true;
+        }
+        trk = 1;
+        return loop_mode == LOOP_ALL;
+    }
+
+    // Single-track file in LOOP_ALL: next music file in directory, wrapping
+    // around
+    int curr = -1;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        std::string p = current_path + (current_path == "/" ? "" : "/") + entries[i].name;
+        if (p == selected_file_path) {
+            curr = (int)i;
+            break;
+        }
+    }
+    if (curr == -1)
+        return false;
+    int next = curr;
+    do {
+        next++;
+        if (next >= (int)entries.size())
+            next = 0; // wrap-around
+    } while (next != curr && (entries[next].is_dir || !is_valid_music(entries[next].name.c_str())));
+    path = current_path + (current_path == "/" ? "" : "/") + entries[next].name;
+    trk = 1;
+    return true;
+}
+
+// Have player open what follows current track, so it starts without a gap
+static void queue_next_track()
+{
+    if (!gapless)
+        return;
+    std::string path;
+    int trk;
+    if (!next_after_current(path, trk)) {
+        player->cancel_queued();
+        queued_path.clear();
+        return;
+    }
+    // On failure, it's opened normally once current track ends, which
+    // reports any error
+    if (player->queue_next(path.c_str(), trk - 1))
+        return;
+    queued_path = path;
+    queued_track = trk;
+}
+
+// Start drawing a frame with the given regions changed. Returns regions to
+// draw, or 0 if nothing changed and the frame should be skipped.
+static unsigned begin_frame(unsigned changed) {
+    if (!changed)
+        return 0;
+    frame_stats.draw_start = SDL_GetPerformanceCounter();
+    if (!screen_texture)
+        return dirty_all;
+    SDL_SetRenderTarget(renderer, screen_texture);
+    return changed;
+}
+
+// Show frame drawn since begin_frame()
+static void end_frame() {
+    if (screen_texture) {
+        SDL_SetRenderTarget(renderer, NULL);
+        SDL_RenderCopy(renderer, screen_texture, NULL, NULL);
+    }
+    frame_stats.draw_time += SDL_GetPerformanceCounter() - frame_stats.draw_start;
+    frame_stats.frames++;
+    SDL_RenderPresent(renderer);
+}
+
+// Fill area with black
+static void clear_rect(const SDL_Rect& r) {
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-    SDL_RenderFillRect(renderer, &top_bar);
-    SDL_RenderFillRect(renderer, &bottom_bar);
+    SDL_RenderFillRect(renderer, &r);
+}
+
+// Sleep until input arrives or timeout expires, leaving any event in queue
+static void wait_event(int timeout_ms) {
+    SDL_WaitEventTimeout(NULL, timeout_ms);
+
+    frame_stats.wakeups++;
+    if (!frame_stats.enabled)
+        return;
+    Uint32 elapsed = SDL_GetTicks() - frame_stats.start;
+    if (elapsed < frame_stats_period)
+        return;
+    double sec = elapsed / 1000.0;
+    double draw_ms = frame_stats.draw_time * 1000.0 / SDL_GetPerformanceFrequency();
+    fprintf(stderr, "frames: %.1f/s, %.2f ms each, wakeups: %.1f/s, drawing: %.1f%%\n",
+            frame_stats.frames / sec,
+            frame_stats.frames ? draw_ms / frame_stats.frames : 0.0,
+            frame_stats.wakeups / sec,
+            draw_ms / 10.0 / sec);
+    frame_stats.start += elapsed;
+    frame_stats.wakeups = 0;
+    frame_stats.frames = 0;
+    frame_stats.draw_time = 0;
+}
+
+// Regions were lost by the renderer and everything must be drawn again
+static bool lost_screen_event(const SDL_Event& e) {
+    return e.type == SDL_RENDER_TARGETS_RESET || e.type == SDL_WINDOWEVENT;
 }
 
 int main(int /*argc*/, char** /*argv*/)
@@ -451,6 +665,15 @@ int main(int /*argc*/, char** /*argv*/)
     renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
     if (!renderer) handle_error("Failed to create SDL renderer");
 
+    screen_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET,
+                                       scope_width, scope_height);
+    if (screen_texture)
+        SDL_SetTextureBlendMode(screen_texture, SDL_BLENDMODE_NONE);
+
+    frame_stats.enabled = getenv("PLAYER_FRAME_STATS") != nullptr;
+    gapless = getenv("PLAYER_NO_GAPLESS") == nullptr;
+    frame_stats.start = SDL_GetTicks();
+
     font = TTF_OpenFont("/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf", 24);
     if (!font) {
         font = TTF_OpenFont("DejaVuSans.ttf", 24);
@@ -469,6 +692,12 @@ int main(int /*argc*/, char** /*argv*/)
         if (!small_font) handle_error("Failed to load small TTF font");
     }
 
+    // Directory index is kept on SD card; PLAYER_INDEX_DIR overrides where
+    library = new Media_Library();
+    const char* index_dir = getenv("PLAYER_INDEX_DIR");
+    if (library->init(index_dir ? index_dir : "/.config/gme_player/index", is_valid_music))
+        handle_error(library->init(NULL, is_valid_music));
+
     loop_mode = LOOP_ALL;
     player = new Music_Player();
     if (!player) handle_error("Out of memory Music_Player");
@@ -494,15 +723,28 @@ int main(int /*argc*/, char** /*argv*/)
             // CORREGIDO: NO llamar list_directory aquí para no resetear
 
             while (running && run_mode == MODE_SELECTION) {
-                draw_file_browser();
+                if (!screen_off && begin_frame(dirty & dirty_browser)) {
+                    draw_file_browser();
+                    end_frame();
+                    dirty = 0;
+                }
+
+                wait_event(idle_wait_ms);
+
+                // Show metadata scanned meanwhile
+                if (library->changes() != library_changes) {
+                    list_directory(current_path, false);
+                    dirty |= dirty_browser;
+                }
 
                 SDL_Event e;
                 while (SDL_PollEvent(&e)) {
+                    // Any input can change the listing or selection
+                    dirty |= dirty_browser;
                     if (screen_off) {
                         if (e.type == SDL_JOYBUTTONDOWN && e.jbutton.button == 11) {
                             hw_display_on();
                             screen_off = false;
-                            draw_file_browser();
                         }
                         continue;
                     }
@@ -589,6 +831,10 @@ int main(int /*argc*/, char** /*argv*/)
             start_track(1, selected_file_path.c_str());
             paused = false;
             track = 1;
+            dirty = dirty_all;
+
+            std::string drawn_header, drawn_status;
+            int drawn_scope = -1;
 
             while (running && run_mode == MODE_PLAYBACK) {
                 Uint32 now = SDL_GetTicks();
@@ -599,114 +845,130 @@ int main(int /*argc*/, char** /*argv*/)
                 }
 
                 if (!screen_off && scope) {
-
-                    // Clear entire screen
-                    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-                    SDL_RenderClear(renderer);
-
-                    // Draw scope only in the center area with top and bottom margins
-                    SDL_Rect scope_area = { 0, margin_top, scope_width, scope_draw_height };
-                    SDL_RenderSetViewport(renderer, &scope_area);
-                    scope->draw(scope_buf, scope_width, 2);
-                    SDL_RenderSetViewport(renderer, NULL);
-
-                    // Clear text areas top and bottom
-                    clear_text_areas(renderer);
-
-                    // Draw top text: title, track info and time
                     SDL_Color green = {0, 255, 0, 255};
+                    SDL_Color orange = {255, 165, 0, 255};
 
+                    // Find which regions changed since they were last drawn
                     char title[256];
                     snprintf(title, sizeof(title), "%s", player->track_info().game);
-                    render_text_big(title, 10, 20, green);
 
                     char trackinfo[256];
                     long secs = player->track_info().length / 1000;
                     snprintf(trackinfo, sizeof(trackinfo), "Track %d/%d: %s (%ld:%02ld)",
                              track, player->track_count(), player->track_info().song, secs / 60, secs % 60);
-                    render_text(trackinfo, 10, 65, green);
 
-                    render_status_monitor(scope_width);
+                    char status[64];
+                    snprintf(status, sizeof(status), "%d %.1f %d %.1f %d %d",
+                             loop_mode, tempo, echo_disabled, stereo_depth, bass_boost, paused);
 
-                    // Draw bottom right text: loop mode, tempo, pause status, controls info
-                    SDL_Color orange = {255, 165, 0, 255};
-                    
-                    int info_x = 10;
-                    int info_y = scope_height - margin_bottom + 5;
-                    
-                    int x = info_x;
-                    int y = info_y;
-                    int w = 0, h = 0;
-                    
-                    // Texto fijo "Loop: "
-                    render_text("Loop:", x, y, green);
-                    TTF_SizeText(font, "Loop:", &w, &h);
-                    x += w;
-                    
-                    const char* loop_val = "";
-                    switch (loop_mode) {
-                        case LOOP_OFF: loop_val = "OFF"; break;
-                        case LOOP_ONE: loop_val = "ONE"; break;
-                        case LOOP_ALL: loop_val = "ALL"; break;
+                    std::string header = std::string(title) + '\n' + trackinfo + '\n' + std::to_string(battery);
+                    if (header != drawn_header) {
+                        drawn_header = header;
+                        dirty |= dirty_header;
+                    }
+                    if (status != drawn_status) {
+                        drawn_status = status;
+                        dirty |= dirty_status;
                     }
-                    render_text(loop_val, x, y, orange);
-                    TTF_SizeText(font, loop_val, &w, &h);
-                    x += w;
-                    
-                    render_text(" Tempo:", x, y, green);
-                    TTF_SizeText(font, " Tempo:", &w, &h);
-                    x += w;
-                    
-                    char tempo_str[16];
-                    snprintf(tempo_str, sizeof(tempo_str), "%.1f", tempo);
-                    render_text(tempo_str, x, y, orange);
-                    TTF_SizeText(font, tempo_str, &w, &h);
-                    x += w;
-                    
-                    render_text(" Echo:", x, y, green);
-                    TTF_SizeText(font, " Echo:", &w, &h);
-                    x += w;
-                    
-                    const char* echo_str = echo_disabled ? "OFF" : "ON";
-                    render_text(echo_str, x, y, orange);
-                    TTF_SizeText(font, echo_str, &w, &h);
-                    x += w;
-                    
-                    render_text(" Stereo:", x, y, green);
-                    TTF_SizeText(font, " Stereo:", &w, &h);
-                    x += w;
-
-                    char stereo_str[16];
-                    snprintf(stereo_str, sizeof(stereo_str), "%.1f", stereo_depth);
-                    render_text(stereo_str, x, y, orange);
-                    TTF_SizeText(font, stereo_str, &w, &h);
-                    x += w;
-                    
-                    render_text(" ", x, y, green);
-                    TTF_SizeText(font, " ", &w, &h);
-                    x += w;
-                    
-                    if (paused) {
-                        const char* paused_str = "[PAUSED]";
-                        render_text(paused_str, x, y, orange);
-                        TTF_SizeText(font, paused_str, &w, &h);
-                        x += w;
+                    int scope_updates = player->scope_updates();
+                    if (scope_updates != drawn_scope) {
+                        drawn_scope = scope_updates;
+                        dirty |= dirty_scope;
                     }
-                    
-                    render_text_small("A:Str  B:Back  Y:Loop  ST:Pause  X:Echo  L:Accu  R:Res  SE:Exit", info_x, info_y + 40, green);
 
-                    // Present everything
-                    SDL_RenderPresent(renderer);
+                    unsigned regions = begin_frame(dirty);
+                    dirty = 0;
+
+                    // Track info hangs a few pixels into the scope band, so the
+                    // two are always drawn together
+                    if (regions & (dirty_header | dirty_scope)) {
+                        // Draw scope only in the center area with top and bottom margins
+                        SDL_Rect scope_area = { 0, margin_top, scope_width, scope_draw_height };
+                        SDL_RenderSetViewport(renderer, &scope_area);
+                        scope->draw(scope_buf, scope_width, 2);
+                        SDL_RenderSetViewport(renderer, NULL);
+
+                        // Draw top text: title, track info and battery
+                        SDL_Rect top_bar = { 0, 0, scope_width, margin_top };
+                        clear_rect(top_bar);
+                        render_text_big(title, 10, 20, green);
+                        render_text(trackinfo, 10, 65, green);
+                        render_status_monitor(scope_width);
+                    }
+
+                    if (regions & dirty_status) {
+                        // Draw bottom text: loop mode, tempo, pause status, controls info
+                        SDL_Rect bottom_bar = { 0, scope_height - margin_bottom, scope_width, margin_bottom };
+                        clear_rect(bottom_bar);
+
+                        int info_x = 10;
+                        int info_y = scope_height - margin_bottom + 5;
+
+                        int x = info_x;
+                        int y = info_y;
+
+                        // Texto fijo "Loop: "
+                        x += render_text("Loop:", x, y, green);
+
+                        const char* loop_val = "";
+                        switch (loop_mode) {
+                            case LOOP_OFF: loop_val = "OFF"; break;
+                            case LOOP_ONE: loop_val = "ONE"; break;
+                            case LOOP_ALL: loop_val = "ALL"; break;
+                        }
+                        x += render_text(loop_val, x, y, orange);
+
+                        x += render_text(" Tempo:", x, y, green);
+
+                        char tempo_str[16];
+                        snprintf(tempo_str, sizeof(tempo_str), "%.1f", tempo);
+                        x += render_text(tempo_str, x, y, orange);
+
+                        x += render_text(" Echo:", x, y, green);
+
+                        const char* echo_str = echo_disabled ? "OFF" : "ON";
+                        x += render_text(echo_str, x, y, orange);
+
+                        x += render_text(" Stereo:", x, y, green);
+
+                        char stereo_str[16];
+                        snprintf(stereo_str, sizeof(stereo_str), "%.1f", stereo_depth);
+                        x += render_text(stereo_str, x, y, orange);
+
+                        x += render_text(" Bass:", x, y, green);
+
+                        const char* bass_str = bass_boost ? "ON" : "OFF";
+                        x += render_text(bass_str, x, y, orange);
+
+                        x += render_text(" ", x, y, green);
+
+                        if (paused) {
+                            const char* paused_str = "[PAUSED]";
+                            x += render_text(paused_str, x, y, orange);
+                        }
+
+                        render_text_small("A:Str  B:Back  Y:Loop  ST:Pause  X:Echo  L:Accu  R:Res  M:Bass  SE:Exit", info_x, info_y + 40, green);
+                    }
+
+                    if (regions)
+                        end_frame();
                 }
 
                 // Playback logic and event handling ...
 
+                // Scope only moves while sound is playing, and track end is
+                // only checked here
+                wait_event(paused ? idle_wait_ms : screen_off ? poll_wait_ms : frame_wait_ms);
+
                 SDL_Event e;
                 while (SDL_PollEvent(&e)) {
+                    if (lost_screen_event(e))
+                        dirty = dirty_all;
                     if (screen_off) {
                         if (e.type == SDL_JOYBUTTONDOWN && e.jbutton.button == 11) {
                             hw_display_on();
                             screen_off = false;
+                            dirty = dirty_all;
                         }
                         
                         if (run_mode == MODE_PLAYBACK) {
@@ -790,7 +1052,7 @@ int main(int /*argc*/, char** /*argv*/)
                                     // CORREGIDO: NO resetear selected_index aquí
                                     list_directory(current_path, false); // false = no resetear selección
                                     selected_index = saved_index;
-                                    draw_file_browser();
+                                    dirty = dirty_all;
                                 }
                                 break;
                             case SDL_CONTROLLER_BUTTON_A:
@@ -879,11 +1141,16 @@ int main(int /*argc*/, char** /*argv*/)
                                 break;
                             case 2:
                                 loop_mode = static_cast<LoopMode>((loop_mode + 1) % 3);
+                                queue_next_track();
                                 break;
                             case 3:
                                 echo_disabled = !echo_disabled;
                                 player->set_echo_disable(echo_disabled);
                                 break;
+                            case 8:
+                                bass_boost = !bass_boost;
+                                player->set_bass_boost(bass_boost);
+                                break;
                             case 7:
                                 paused = !paused;
                                 player->pause(paused);
@@ -905,48 +1172,26 @@ int main(int /*argc*/, char** /*argv*/)
                     }
             }
 
+                // Queued track has carried on from previous one by itself
+                if (player->advance_queued()) {
+                    selected_file_path = queued_path;
+                    track = queued_track;
+                    update_title(selected_file_path.c_str());
+                    queue_next_track();
+                }
+
                 if (!paused && player->track_ended()) {
-                    if (loop_mode == LOOP_OFF) {
-                        if (track >= player->track_count()) {
-                            paused = true;
-                            player->pause(true);
-                        } else {
-                            ++track;
-                            start_track(track, selected_file_path.c_str());
-                        }
-                    }
-                    else if (loop_mode == LOOP_ONE) {
-                        start_track(track, selected_file_path.c_str());
-                    }
-                    else if (loop_mode == LOOP_ALL) {
-                        if (player->track_count() == 1) {
-                            int curr = -1;
-                            for (size_t i = 0; i < entries.size(); ++i) {
-                                std::string path = current_path + (current_path == "/" ? "" : "/") + entries[i].name;
-                                if (path == selected_file_path) {
-                                    curr = (int)i;
-                                    break;
-                                }
-                            }
-                            if (curr != -1) {
-                                int next = curr;
-                                do {
-                                    next++;
-                                    if (next >= (int)entries.size())
-                                        next = 0; // wrap-around
-                                } while (entries[next].is_dir || !is_valid_music(entries[next].name.c_str()) || next == curr);
-                    
-                                selected_file_path = current_path + (current_path == "/" ? "" : "/") + entries[next].name;
-                                handle_error(player->load_file(selected_file_path.c_str(), false));
-                                track = 1;
-                                start_track(track, selected_file_path.c_str());
-                            }
-                        } else {
-                            ++track;
-                            if (track > player->track_count())
-                                track = 1;
-                            start_track(track, selected_file_path.c_str());
+                    std::string next_path;
+                    int next_track;
+                    if (!next_after_current(next_path, next_track)) {
+                        paused = true;
+                        player->pause(true);
+                    } else {
+                        if (next_path != selected_file_path) {
+                            selected_file_path = next_path;
+                            handle_error(player->load_file(selected_file_path.c_str(), false));
                         }
+                        start_track(next_track, selected_file_path.c_str());
                     }
                 }
             }
@@ -957,8 +1202,11 @@ int main(int /*argc*/, char** /*argv*/)
     if (font) TTF_CloseFont(font);
     if (small_font) TTF_CloseFont(small_font);
     if (big_font) TTF_CloseFont(big_font);
+    clear_text_cache();
+    if (screen_texture) SDL_DestroyTexture(screen_texture);
     if (renderer) SDL_DestroyRenderer(renderer);
     delete player;
+    delete library;
     if (scope) {
         delete scope;
         scope = nullptr;
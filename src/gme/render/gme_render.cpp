@@ -0,0 +1,584 @@
+/* Offline batch renderer. Renders every track of game music files, directory
+trees of them, or files listed in M3U playlists to WAVE or raw files, using
+all CPU cores.
+
+Usage: gme_render [options] <file, directory or .m3u>...
+
+-o dir      Write output under dir (default: current directory)
+-r rate     Sample rate (default: 44100)
+-l seconds  Length of tracks whose length isn't known (default: 150)
+-f msec     Fade of tracks whose fade isn't known (default: 8000)
+-j jobs     Number of worker threads (default: number of CPUs)
+-w          Write raw 16-bit little-endian stereo instead of WAVE
+-n          Don't write anything, only render (for benchmarking)
+-q          Only print summary
+
+Each track is written as <file name>-<track>.wav (for example
+"song.nsf-01.wav"), in the same directory relative to the output directory as
+the file is relative to the directory given. Speed of each track is printed as
+a multiple of realtime. */
+
+#include "gme/gme.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+// Settings from command line
+static std::string out_dir = ".";
+static long sample_rate = 44100;
+static long default_length = 150 * 1000L;
+static long default_fade = 8000;
+static bool raw_output;
+static bool null_output;
+static bool quiet;
+
+// Work
+
+// Track to render. Track -1 means all tracks of file; whichever worker opens
+// it queues the others.
+struct job_t {
+	std::string path;
+	std::string m3u;        // playlist to apply to file, or empty
+	std::string m3u_data;   // its lines that apply to this file
+	std::string out_name;   // output path without track number and extension
+	int track;
+};
+
+// Each worker takes jobs from back of its own queue, and when that's empty
+// steals from front of another worker's queue, so files with many tracks get
+// spread over all workers.
+struct worker_t {
+	std::mutex mutex;
+	std::deque<job_t> jobs;
+
+	// Emulator for most recent file, kept while rendering its other tracks
+	Music_Emu* emu;
+	std::string emu_path;
+
+	// Totals for summary
+	int tracks;
+	double audio_secs;
+};
+
+static std::vector<worker_t*> workers;
+static std::atomic<int> jobs_left;    // queued or being rendered
+static std::atomic<int> failures;
+static std::mutex print_mutex;
+
+static void push_job( worker_t& w, job_t const& job )
+{
+	jobs_left++;
+	std::lock_guard<std::mutex> lock( w.mutex );
+	w.jobs.push_back( job );
+}
+
+static bool take_job( int self, job_t& out )
+{
+	for ( size_t i = 0; i < workers.size(); i++ )
+	{
+		worker_t& w = *workers [(self + i) % workers.size()];
+		std::lock_guard<std::mutex> lock( w.mutex );
+		if ( !w.jobs.empty() )
+		{
+			if ( i == 0 )
+			{
+				out = w.jobs.back();
+				w.jobs.pop_back();
+			}
+			else
+			{
+				out = w.jobs.front();
+				w.jobs.pop_front();
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+// Output
+
+static bool make_dirs( std::string const& path )
+{
+	for ( size_t i = 1; i <= path.size(); i++ )
+	{
+		if ( i == path.size() || path [i] == '/' )
+		{
+			if ( mkdir( path.substr( 0, i ).c_str(), 0755 ) && errno != EEXIST )
+				return false;
+		}
+	}
+	return true;
+}
+
+static void set_le16( unsigned char* p, unsigned n )
+{
+	p [0] = (unsigned char) n;
+	p [1] = (unsigned char) (n >> 8);
+}
+
+static void set_le32( unsigned char* p, unsigned long n )
+{
+	set_le16( p, n & 0xFFFF );
+	set_le16( p + 2, n >> 16 );
+}
+
+static void write_wave_header( FILE* out, unsigned long data_size )
+{
+	unsigned char h [0x2C] = {
+		'R','I','F','F', 0,0,0,0, 'W','A','V','E',
+		'f','m','t',' ', 16,0,0,0, 1,0, 2,0, 0,0,0,0, 0,0,0,0, 4,0, 16,0,
+		'd','a','t','a', 0,0,0,0
+	};
+	set_le32( h + 0x04, data_size + sizeof h - 8 );
+	set_le32( h + 0x18, sample_rate );
+	set_le32( h + 0x1C, sample_rate * 4 );
+	set_le32( h + 0x28, data_size );
+	fwrite( h, sizeof h, 1, out );
+}
+
+// Rendering
+
+// Open emulator for job in worker, reusing the one it already has if it's
+// for the same file
+static gme_err_t open_emu( worker_t& w, job_t const& job )
+{
+	std::string key = job.path + '\n' + job.m3u_data;
+	if ( w.emu && w.emu_path == key )
+		return 0;
+
+	gme_delete( w.emu );
+	w.emu = NULL;
+	w.emu_path.clear();
+
+	gme_err_t err = gme_open_file( job.path.c_str(), &w.emu, sample_rate );
+	if ( err )
+		return err;
+
+	// same sidecar playlist as player uses if none was given
+	if ( job.m3u.empty() )
+	{
+		std::string m3u = job.path.substr( 0, job.path.find_last_of( '.' ) ) + ".m3u";
+		gme_load_m3u( w.emu, m3u.c_str() );
+	}
+	else
+	{
+		gme_err_t m3u_err = gme_load_m3u_data( w.emu, job.m3u_data.data(), (long) job.m3u_data.size() );
+		if ( m3u_err )
+			fprintf( stderr, "%s: %s\n", job.m3u.c_str(), m3u_err );
+	}
+
+	w.emu_path = key;
+	return 0;
+}
+
+static gme_err_t render_track( worker_t& w, job_t const& job )
+{
+	Music_Emu* emu = w.emu;
+	gme_err_t err = gme_start_track( emu, job.track );
+	if ( err )
+		return err;
+
+	// Length and fade as player uses them
+	gme_info_t* info;
+	err = gme_track_info( emu, &info, job.track );
+	if ( err )
+		return err;
+	long length = info->length;
+	if ( length <= 0 )
+		length = info->intro_length + info->loop_length * 2;
+	if ( length <= 0 )
+		length = default_length;
+	long fade = (info->fade_length >= 0 ? info->fade_length : default_fade);
+	gme_free_info( info );
+	gme_set_fade_msecs( emu, length, fade );
+
+	char num [16];
+	snprintf( num, sizeof num, "-%02d", job.track + 1 );
+	std::string path = job.out_name + num + (raw_output ? ".raw" : ".wav");
+
+	FILE* out = NULL;
+	if ( !null_output )
+	{
+		out = fopen( path.c_str(), "wb" );
+		if ( !out )
+			return "Couldn't create output file";
+		if ( !raw_output )
+			write_wave_header( out, 0 );
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	const int buf_size = 4096;
+	short buf [buf_size];
+	unsigned char bytes [buf_size * 2];
+	unsigned long data_size = 0;
+	long end = (length + fade) * sample_rate / 1000 * 2;
+	long pos = 0;
+	while ( !err && pos < end && !gme_track_ended( emu ) )
+	{
+		int count = buf_size;
+		if ( count > end - pos )
+			count = (int) (end - pos);
+		err = gme_play( emu, count, buf );
+		pos += count;
+		if ( out )
+		{
+			for ( int i = 0; i < count; i++ )
+				set_le16( bytes + i * 2, (unsigned short) buf [i] );
+			if ( !fwrite( bytes, count * 2, 1, out ) )
+				err = "Couldn't write output file";
+			data_size += count * 2;
+		}
+	}
+
+	double secs = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+	double audio_secs = pos / 2.0 / sample_rate;
+
+	if ( out )
+	{
+		if ( !raw_output && !err && fseek( out, 0, SEEK_SET ) == 0 )
+			write_wave_header( out, data_size );
+		if ( fclose( out ) && !err )
+			err = "Couldn't write output file";
+		if ( err )
+			remove( path.c_str() );
+	}
+	if ( err )
+		return err;
+
+	w.tracks++;
+	w.audio_secs += audio_secs;
+	if ( !quiet )
+	{
+		std::lock_guard<std::mutex> lock( print_mutex );
+		printf( "%s #%d: %.1f s in %.2f s (%.1fx realtime)\n", job.path.c_str(),
+				job.track + 1, audio_secs, secs, secs > 0 ? audio_secs / secs : 0.0 );
+		fflush( stdout );
+	}
+	return 0;
+}
+
+static void run_job( int self, job_t& job )
+{
+	worker_t& w = *workers [self];
+	gme_err_t err = open_emu( w, job );
+
+	if ( !err && job.track < 0 )
+	{
+		// queue other tracks for this or other workers, and render first here
+		int count = gme_track_count( w.emu );
+		for ( int i = count - 1; i >= 1; i-- )
+		{
+			job_t t = job;
+			t.track = i;
+			push_job( w, t );
+		}
+		job.track = 0;
+	}
+
+	if ( !err )
+		err = render_track( w, job );
+
+	if ( err )
+	{
+		failures++;
+		std::lock_guard<std::mutex> lock( print_mutex );
+		fprintf( stderr, "%s #%d: %s\n", job.path.c_str(), job.track + 1, err );
+	}
+}
+
+static void worker_thread( int self )
+{
+	job_t job;
+	while ( jobs_left > 0 )
+	{
+		if ( !take_job( self, job ) )
+		{
+			// others are still splitting up files or rendering their last tracks
+			std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+			continue;
+		}
+		run_job( self, job );
+		jobs_left--;
+	}
+
+	gme_delete( workers [self]->emu );
+	workers [self]->emu = NULL;
+}
+
+// Finding files
+
+static bool ends_with( std::string const& s, const char* suffix )
+{
+	size_t n = strlen( suffix );
+	if ( s.size() < n )
+		return false;
+	std::string end = s.substr( s.size() - n );
+	std::transform( end.begin(), end.end(), end.begin(), ::tolower );
+	return end == suffix;
+}
+
+static std::string file_name( std::string const& path )
+{
+	size_t slash = path.find_last_of( '/' );
+	return (slash == std::string::npos ? path : path.substr( slash + 1 ));
+}
+
+static int next_worker;
+
+static void add_file( std::string const& path, std::string const& rel_dir,
+		std::string const& m3u = "", std::string const& m3u_data = "" )
+{
+	std::string dir = out_dir + (rel_dir.empty() ? "" : "/" + rel_dir);
+	if ( !null_output && !make_dirs( dir ) )
+	{
+		fprintf( stderr, "%s: Couldn't create directory\n", dir.c_str() );
+		failures++;
+		return;
+	}
+
+	job_t job;
+	job.path     = path;
+	job.m3u      = m3u;
+	job.m3u_data = m3u_data;
+	// extension is kept so files differing only in it don't collide
+	job.out_name = dir + "/" + file_name( path );
+	job.track    = -1;
+	push_job( *workers [next_worker++ % workers.size()], job );
+}
+
+static void add_dir( std::string const& dir, std::string const& rel_dir )
+{
+	DIR* d = opendir( dir.c_str() );
+	if ( !d )
+	{
+		fprintf( stderr, "%s: Couldn't open directory\n", dir.c_str() );
+		failures++;
+		return;
+	}
+
+	std::vector<std::string> names;
+	struct dirent* de;
+	while ( (de = readdir( d )) != NULL )
+		if ( de->d_name [0] != '.' )
+			names.push_back( de->d_name );
+	closedir( d );
+	std::sort( names.begin(), names.end() );
+
+	for ( size_t i = 0; i < names.size(); i++ )
+	{
+		std::string path = dir + "/" + names [i];
+		std::string rel = (rel_dir.empty() ? "" : rel_dir + "/") + names [i];
+		struct stat st;
+		if ( stat( path.c_str(), &st ) )
+			continue;
+		if ( S_ISDIR( st.st_mode ) )
+			add_dir( path, rel );
+		else if ( !ends_with( path, ".m3u" ) && gme_identify_extension( path.c_str() ) )
+			add_file( path, rel_dir );
+	}
+}
+
+// File name at start of playlist line, found the way M3u_Playlist does: it ends
+// at "::type" or at a comma followed by '$' or a digit, and '\' quotes the next
+// character. Sets *has_track if track fields follow it.
+static std::string playlist_file( char const* in, bool* has_track )
+{
+	std::string name;
+	*has_track = false;
+	while ( int c = *in++ )
+	{
+		if ( c == ',' ) // commas in filename
+		{
+			char const* p = in;
+			while ( *p == ' ' )
+				p++;
+			if ( *p == '$' || (unsigned) (*p - '0') <= 9 )
+			{
+				*has_track = true;
+				break;
+			}
+		}
+
+		if ( c == ':' && in [0] == ':' && in [1] && in [2] != ',' ) // ::type suffix
+		{
+			*has_track = true;
+			break;
+		}
+
+		if ( c == '\\' ) // \ prefix for special characters
+		{
+			c = *in;
+			if ( !c ) break;
+			in++;
+		}
+		name += (char) c;
+	}
+	return name;
+}
+
+// Add files listed in playlist. Lines with track fields ("file,track,..." or
+// "file::type,track,...") are rendered as the playlist defines their tracks.
+// Each file only gets its own track lines, plus the playlist's comment lines
+// for album info.
+static void add_m3u( std::string const& m3u )
+{
+	FILE* in = fopen( m3u.c_str(), "r" );
+	if ( !in )
+	{
+		fprintf( stderr, "%s: Couldn't open playlist\n", m3u.c_str() );
+		failures++;
+		return;
+	}
+
+	size_t slash = m3u.find_last_of( '/' );
+	std::string dir = (slash == std::string::npos ? "." : m3u.substr( 0, slash ));
+
+	std::string comments;
+	std::vector<std::string> paths;
+	std::vector<std::string> tracks; // track lines for each of paths
+	char line [1024];
+	while ( fgets( line, sizeof line, in ) )
+	{
+		line [strcspn( line, "\r\n" )] = 0;
+		if ( !line [0] )
+			continue;
+		if ( line [0] == '#' )
+		{
+			comments += line;
+			comments += '\n';
+			continue;
+		}
+
+		bool has_track;
+		std::string name = playlist_file( line, &has_track );
+		if ( name.empty() )
+			continue;
+		std::string path = (name [0] == '/' ? name : dir + "/" + name);
+		size_t i = std::find( paths.begin(), paths.end(), path ) - paths.begin();
+		if ( i == paths.size() )
+		{
+			paths.push_back( path );
+			tracks.push_back( "" );
+		}
+		if ( has_track )
+		{
+			tracks [i] += line;
+			tracks [i] += '\n';
+		}
+	}
+	fclose( in );
+
+	for ( size_t i = 0; i < paths.size(); i++ )
+	{
+		if ( tracks [i].empty() )
+			add_file( paths [i], "" );
+		else
+			add_file( paths [i], "", m3u, comments + tracks [i] );
+	}
+}
+
+static void usage()
+{
+	fprintf( stderr, "Usage: gme_render [-o dir] [-r rate] [-l seconds] [-f msec] "
+			"[-j jobs] [-w] [-n] [-q] <file, directory or .m3u>...\n" );
+	exit( EXIT_FAILURE );
+}
+
+int main( int argc, char** argv )
+{
+	int jobs = (int) std::thread::hardware_concurrency();
+	int i = 1;
+	for ( ; i < argc && argv [i][0] == '-' && argv [i][1]; i++ )
+	{
+		char opt = argv [i][1];
+		if ( strchr( "orlfj", opt ) )
+		{
+			if ( argv [i][2] || i + 1 >= argc )
+				usage();
+			const char* arg = argv [++i];
+			switch ( opt )
+			{
+				case 'o': out_dir = arg; break;
+				case 'r': sample_rate = atol( arg ); break;
+				case 'l': default_length = atol( arg ) * 1000L; break;
+				case 'f': default_fade = atol( arg ); break;
+				case 'j': jobs = atoi( arg ); break;
+			}
+		}
+		else if ( opt == 'w' ) raw_output = true;
+		else if ( opt == 'n' ) null_output = true;
+		else if ( opt == 'q' ) quiet = true;
+		else usage();
+	}
+	if ( i >= argc || sample_rate < 8000 || default_length <= 0 || default_fade < 0 )
+		usage();
+	if ( jobs < 1 )
+		jobs = 1;
+
+	for ( int n = 0; n < jobs; n++ )
+	{
+		worker_t* w = new worker_t;
+		w->emu        = NULL;
+		w->tracks     = 0;
+		w->audio_secs = 0;
+		workers.push_back( w );
+	}
+
+	for ( ; i < argc; i++ )
+	{
+		std::string path = argv [i];
+		while ( path.size() > 1 && path [path.size() - 1] == '/' )
+			path.erase( path.size() - 1 );
+
+		struct stat st;
+		if ( stat( path.c_str(), &st ) )
+		{
+			fprintf( stderr, "%s: %s\n", path.c_str(), strerror( errno ) );
+			failures++;
+		}
+		else if ( S_ISDIR( st.st_mode ) )
+			add_dir( path, "" );
+		else if ( ends_with( path, ".m3u" ) )
+			add_m3u( path );
+		else
+			add_file( path, "" );
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	for ( int n = 0; n < jobs; n++ )
+		threads.push_back( std::thread( worker_thread, n ) );
+	for ( int n = 0; n < jobs; n++ )
+		threads [n].join();
+	double secs = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+	int tracks = 0;
+	double audio_secs = 0;
+	for ( int n = 0; n < jobs; n++ )
+	{
+		tracks     += workers [n]->tracks;
+		audio_secs += workers [n]->audio_secs;
+		delete workers [n];
+	}
+
+	printf( "%d tracks, %.1f s of audio in %.2f s with %d jobs (%.1fx realtime)\n",
+			tracks, audio_secs, secs, jobs, secs > 0 ? audio_secs / secs : 0.0 );
+	if ( failures )
+		printf( "%d failed\n", (int) failures );
+
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,186 @@
+// Measures Fir_Resampler::read() throughput against the plain C++ loop it had
+// before SIMD was added, and checks that both give identical output. Run with an
+// optional number of seconds of sound to resample for each case.
+
+#include "Fir_Resampler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+
+typedef std::chrono::steady_clock bench_clock;
+typedef short sample_t;
+
+// Fir_Resampler with the original scalar read() as reference
+template<int width>
+class Scalar_Resampler : public Fir_Resampler<width> {
+public:
+	int read_scalar( sample_t* out, int32_t count );
+};
+
+template<int width>
+int Scalar_Resampler<width>::read_scalar( sample_t* out_begin, int32_t count )
+{
+	int const stereo = 2;
+	sample_t const* const impulses = Fir_Resampler_::impulses;
+	sample_t* out = out_begin;
+	sample_t const* in = this->buf.begin();
+	sample_t* end_pos = this->write_pos;
+	uint32_t skip = this->skip_bits >> this->imp_phase;
+	sample_t const* imp = impulses + this->imp_phase * width;
+	int remain = this->res - this->imp_phase;
+	int const step = this->step;
+
+	count >>= 1;
+	if ( end_pos - in >= width * stereo )
+	{
+		end_pos -= width * stereo;
+		do
+		{
+			if ( --count < 0 )
+				break;
+
+			int32_t l = 0;
+			int32_t r = 0;
+			sample_t const* i = in;
+			for ( int n = width / 2; n; --n )
+			{
+				int pt0 = imp [0];
+				l += pt0 * i [0];
+				r += pt0 * i [1];
+				int pt1 = imp [1];
+				imp += 2;
+				l += pt1 * i [2];
+				r += pt1 * i [3];
+				i += 4;
+			}
+
+			remain--;
+			in += (skip * stereo) & stereo;
+			skip >>= 1;
+			if ( !remain )
+			{
+				imp = impulses;
+				skip = this->skip_bits;
+				remain = this->res;
+			}
+
+			out [0] = (sample_t) (l >> 15);
+			out [1] = (sample_t) (r >> 15);
+			in += step;
+			out += 2;
+		}
+		while ( in <= end_pos );
+	}
+
+	this->imp_phase = this->res - remain;
+	int left = this->write_pos - in;
+	this->write_pos = &this->buf [left];
+	memmove( this->buf.begin(), in, left * sizeof *in );
+	return out - out_begin;
+}
+
+// Stereo input: a sweeping square wave plus noise, near full scale
+static void make_input( sample_t* out, int count )
+{
+	double phase = 0;
+	unsigned rand = 1;
+	for ( int i = 0; i < count; i += 2 )
+	{
+		phase += 0.01 + i * 1e-7;
+		rand = rand * 1664525 + 1013904223;
+		int noise = (int) (rand >> 20) - 0x800;
+		int sq = (sin( phase ) >= 0 ? 24000 : -24000);
+		out [i    ] = (sample_t) (sq + noise);
+		out [i + 1] = (sample_t) (-sq / 2 + noise * 4);
+	}
+}
+
+// Resamples input in blocks like emulators do. Returns output samples.
+template<int width>
+static long resample( Scalar_Resampler<width>& r, bool scalar, sample_t const* in,
+		long in_count, sample_t* out, long out_size )
+{
+	r.clear();
+	long out_count = 0;
+	while ( in_count > 0 )
+	{
+		int n = r.max_write();
+		if ( n > in_count )
+			n = (int) in_count;
+		memcpy( r.buffer(), in, n * sizeof *in );
+		r.write( n );
+		in += n;
+		in_count -= n;
+
+		int count = (int) (out_size - out_count);
+		if ( count > 4096 )
+			count = 4096;
+		out_count += (scalar ? r.read_scalar( out + out_count, count ) :
+				r.read( out + out_count, count ));
+	}
+	return out_count;
+}
+
+template<int width>
+static int bench( const char* name, double ratio, double seconds )
+{
+	static Scalar_Resampler<width> r;
+	if ( r.buffer_size( 4096 ) )
+		exit( EXIT_FAILURE );
+	r.time_ratio( ratio, 0.990, 1.0 );
+
+	long const in_count = (long) (seconds * 32000) * 2;
+	long const out_size = (long) (in_count / ratio) + 4096;
+	sample_t* in = (sample_t*) malloc( in_count * sizeof *in );
+	sample_t* out [2] = {
+		(sample_t*) malloc( out_size * sizeof (sample_t) ),
+		(sample_t*) malloc( out_size * sizeof (sample_t) )
+	};
+	if ( !in || !out [0] || !out [1] )
+		exit( EXIT_FAILURE );
+	make_input( in, in_count );
+
+	// best of several runs, alternating between the two
+	double rate [2] = { 0, 0 };
+	long count [2];
+	for ( int run = 0; run < 3; run++ )
+	{
+		for ( int scalar = 0; scalar < 2; scalar++ )
+		{
+			bench_clock::time_point start = bench_clock::now();
+			count [scalar] = resample( r, scalar != 0, in, in_count, out [scalar], out_size );
+			double sec = std::chrono::duration<double>( bench_clock::now() - start ).count();
+			double n = count [scalar] / 2 / (sec > 0 ? sec : 1e-9);
+			if ( rate [scalar] < n )
+				rate [scalar] = n;
+		}
+	}
+
+	int same = (count [0] == count [1] &&
+			!memcmp( out [0], out [1], count [0] * sizeof (sample_t) ));
+	printf( "%-6s ratio %.4f: scalar %6.2f M/s, read() %6.2f M/s (%.2fx), output %s\n",
+			name, ratio, rate [1] * 1e-6, rate [0] * 1e-6, rate [0] / rate [1],
+			same ? "identical" : "DIFFERENT" );
+
+	free( in );
+	free( out [0] );
+	free( out [1] );
+	return same;
+}
+
+int main( int argc, char** argv )
+{
+	double seconds = (argc > 1 ? atof( argv [1] ) : 300.0);
+	if ( seconds <= 0 )
+		return EXIT_FAILURE;
+
+	int ok = 1;
+	ok &= bench<24>( "Spc",  32000.0 / 44100, seconds ); // Spc_Emu
+	ok &= bench<24>( "Spc",  32000.0 / 48000, seconds );
+	ok &= bench<12>( "Dual", 53267.0 / 44100, seconds ); // Dual_Resampler, Genesis FM
+	ok &= bench<12>( "Dual", 0.9,             seconds );
+	ok &= bench<10>( "odd",  1.3,             seconds ); // width not a multiple of 4
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,208 @@
+// Measures Output_Filter against the float bass boost and fade that playgsf
+// used, and against the plain loop Music_Emu's fade had. Fade must give
+// identical output, bass boost is compared by how far it is from float. Run
+// with an optional number of seconds of sound to filter for each case.
+
+#include "Output_Filter.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+
+typedef std::chrono::steady_clock bench_clock;
+typedef short sample_t;
+
+long const sample_rate = 44100;
+int const block = 1152; // samples filtered at a time, like playgsf's writes
+
+// Stereo input: a sweeping square wave plus noise, near full scale
+static void make_input( sample_t* out, long count )
+{
+	double phase = 0;
+	unsigned rand = 1;
+	for ( long i = 0; i < count; i += 2 )
+	{
+		phase += 0.01 + (i % 100000) * 1e-7;
+		rand = rand * 1664525 + 1013904223;
+		int noise = (int) (rand >> 20) - 0x800;
+		int sq = (sin( phase ) >= 0 ? 24000 : -24000);
+		out [i    ] = (sample_t) (sq + noise);
+		out [i + 1] = (sample_t) (-sq / 2 + noise * 4);
+	}
+}
+
+// Fade level for block starting at sample i, falling to silence by the end
+static int fade_at( long i, long count )
+{
+	return (int) ((count - i) * Output_Filter::gain_unit / count);
+}
+
+// playgsf's float low-shelf, as reference
+
+struct Float_Shelf {
+	float b0, b1, b2, a1, a2;
+	float x1 [2], x2 [2], y1 [2], y2 [2];
+
+	Float_Shelf( float fs, float f0, float gainDB )
+	{
+		float A  = powf( 10.0f, gainDB / 40.0f );
+		float w0 = 2.0f * (float) M_PI * f0 / fs;
+		float alpha = sinf( w0 ) / 2.0f * sqrtf( (A + 1/A) * (1.0f/0.707f - 1.0f) + 2.0f );
+		float k = cosf( w0 );
+		float a0 =    (A+1) + (A-1)*k + 2.0f*sqrtf( A )*alpha;
+		b0 =    A*((A+1) - (A-1)*k + 2.0f*sqrtf( A )*alpha) / a0;
+		b1 =  2*A*((A-1) - (A+1)*k) / a0;
+		b2 =    A*((A+1) - (A-1)*k - 2.0f*sqrtf( A )*alpha) / a0;
+		a1 =  -2*((A-1) + (A+1)*k) / a0;
+		a2 =      ((A+1) + (A-1)*k - 2.0f*sqrtf( A )*alpha) / a0;
+		memset( x1, 0, sizeof x1 ); memset( x2, 0, sizeof x2 );
+		memset( y1, 0, sizeof y1 ); memset( y2, 0, sizeof y2 );
+	}
+
+	void run( sample_t* io, int count, float factor )
+	{
+		for ( int i = 0; i < count; i++ )
+			io [i] = (sample_t) (io [i] * factor);
+		for ( int i = 0; i < count; i++ )
+		{
+			int c = i & 1;
+			float in  = io [i];
+			float out = b0*in + b1*x1 [c] + b2*x2 [c] - a1*y1 [c] - a2*y2 [c];
+			x2 [c] = x1 [c]; x1 [c] = in; y2 [c] = y1 [c]; y1 [c] = out;
+			if ( out > 32767.0f ) out = 32767.0f;
+			if ( out < -32768.0f ) out = -32768.0f;
+			io [i] = (sample_t) out;
+		}
+	}
+};
+
+static double elapsed( bench_clock::time_point start )
+{
+	double sec = std::chrono::duration<double>( bench_clock::now() - start ).count();
+	return sec > 0 ? sec : 1e-9;
+}
+
+static void report( const char* name, double old_rate, double new_rate, const char* result )
+{
+	printf( "%-12s old %7.2f M/s, Output_Filter %7.2f M/s (%.2fx), %s\n",
+			name, old_rate * 1e-6, new_rate * 1e-6, new_rate / old_rate, result );
+}
+
+// Music_Emu's fade loop against Output_Filter::scale()
+static int bench_fade( sample_t const* in, long count, sample_t* out [2] )
+{
+	double rate [2] = { 0, 0 };
+	for ( int run = 0; run < 3; run++ )
+	{
+		for ( int old = 0; old < 2; old++ )
+		{
+			memcpy( out [old], in, count * sizeof *in );
+			bench_clock::time_point start = bench_clock::now();
+			for ( long i = 0; i < count; i += block )
+			{
+				int n = (int) (count - i < block ? count - i : block);
+				int gain = fade_at( i, count );
+				sample_t* io = out [old] + i;
+				if ( old )
+				{
+					for ( ; n; --n )
+					{
+						*io = sample_t ((*io * gain) >> 14);
+						++io;
+					}
+				}
+				else
+				{
+					Output_Filter::scale( io, n, gain );
+				}
+			}
+			double r = count / elapsed( start );
+			if ( rate [old] < r )
+				rate [old] = r;
+		}
+	}
+
+	int same = !memcmp( out [0], out [1], count * sizeof (sample_t) );
+	report( "fade", rate [1], rate [0], same ? "output identical" : "output DIFFERENT" );
+	return same;
+}
+
+// playgsf's float fade and bass boost against Output_Filter, with and without
+// limiter
+static int bench_bass( sample_t const* in, long count, sample_t* out [2], bool limiter )
+{
+	double rate [2] = { 0, 0 };
+	for ( int run = 0; run < 3; run++ )
+	{
+		for ( int old = 0; old < 2; old++ )
+		{
+			memcpy( out [old], in, count * sizeof *in );
+			Float_Shelf shelf( (float) sample_rate, 250.0f, 5.0f );
+			Output_Filter filter;
+			if ( filter.add_low_shelf( sample_rate, 250.0, 5.0, 0.707 ) )
+				exit( EXIT_FAILURE );
+			filter.enable_limiter( limiter );
+
+			bench_clock::time_point start = bench_clock::now();
+			for ( long i = 0; i < count; i += block )
+			{
+				int n = (int) (count - i < block ? count - i : block);
+				int fade = fade_at( i, count );
+				if ( old )
+				{
+					shelf.run( out [old] + i, n, (float) fade / Output_Filter::gain_unit );
+				}
+				else
+				{
+					filter.set_fade( fade );
+					filter.run( out [old] + i, n );
+				}
+			}
+			double r = count / elapsed( start );
+			if ( rate [old] < r )
+				rate [old] = r;
+		}
+	}
+
+	double signal = 0, noise = 0;
+	for ( long i = 0; i < count; i++ )
+	{
+		double d = out [0] [i] - out [1] [i];
+		signal += (double) out [1] [i] * out [1] [i];
+		noise  += d * d;
+	}
+	char result [64];
+	snprintf( result, sizeof result, "%.1f dB SNR against float",
+			noise > 0 ? 10 * log10( signal / noise ) : INFINITY );
+	report( limiter ? "bass+limiter" : "bass", rate [1], rate [0], result );
+	return 1;
+}
+
+int main( int argc, char** argv )
+{
+	double seconds = (argc > 1 ? atof( argv [1] ) : 300.0);
+	if ( seconds <= 0 )
+		return EXIT_FAILURE;
+
+	long const count = (long) (seconds * sample_rate) * 2;
+	sample_t* in = (sample_t*) malloc( count * sizeof *in );
+	sample_t* out [2] = {
+		(sample_t*) malloc( count * sizeof (sample_t) ),
+		(sample_t*) malloc( count * sizeof (sample_t) )
+	};
+	if ( !in || !out [0] || !out [1] )
+		return EXIT_FAILURE;
+	make_input( in, count );
+
+	int ok = 1;
+	ok &= bench_fade( in, count, out );
+	ok &= bench_bass( in, count, out, false );
+	ok &= bench_bass( in, count, out, true );
+
+	free( in );
+	free( out [0] );
+	free( out [1] );
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
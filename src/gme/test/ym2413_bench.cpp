@@ -0,0 +1,87 @@
+// Measures how many times faster than realtime Ym2413_Emu runs at the chip's
+// native rate, with all nine melody voices and with six voices plus rhythm
+// playing. Run with an optional number of seconds of sound to generate for each.
+
+#include "Ym2413_Emu.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+typedef std::chrono::steady_clock bench_clock;
+
+static double const clock_rate = 3579545;
+static double const sample_rate = clock_rate / 72;
+
+// Key on voices 0 to count - 1 with different instruments and notes
+static void key_on( Ym2413_Emu& opll, int count )
+{
+	for ( int i = 0; i < count; i++ )
+	{
+		int fnum = 172 + i * 12;
+		opll.write( 0x30 + i, (i + 1) << 4 ); // instrument, maximum volume
+		opll.write( 0x10 + i, fnum & 0xFF );
+		opll.write( 0x20 + i, 4 << 1 | fnum >> 8 ); // key off, so note restarts
+		opll.write( 0x20 + i, 0x10 | 4 << 1 | fnum >> 8 ); // key on, block 4
+	}
+}
+
+static double bench( bool rhythm, double seconds )
+{
+	static Ym2413_Emu opll;
+	if ( opll.set_rate( sample_rate, clock_rate ) )
+	{
+		printf( "Error: Out of memory\n" );
+		exit( EXIT_FAILURE );
+	}
+
+	key_on( opll, (rhythm ? 6 : 9) );
+	if ( rhythm )
+	{
+		opll.write( 0x16, 0x20 );
+		opll.write( 0x17, 0x50 );
+		opll.write( 0x18, 0xC0 );
+	}
+
+	// best of several runs
+	double best = 0;
+	for ( int run = 0; run < 3; run++ )
+	{
+		// retrigger notes or drums every 1/8 second, like music would
+		enum { frame = 6214 }; // about 1/8 second
+		static short buf [frame * 2];
+		long remain = (long) (seconds * sample_rate / 3);
+		bench_clock::time_point start = bench_clock::now();
+		for ( ; remain > 0; remain -= frame )
+		{
+			if ( rhythm )
+			{
+				opll.write( 0x0E, 0x20 );
+				opll.write( 0x0E, 0x3F );
+			}
+			else
+			{
+				key_on( opll, 9 );
+			}
+			memset( buf, 0, sizeof buf );
+			opll.run( frame, buf );
+		}
+		double sec = std::chrono::duration<double>( bench_clock::now() - start ).count();
+		double factor = seconds / 3 / (sec > 0 ? sec : 1e-9);
+		if ( best < factor )
+			best = factor;
+	}
+	return best;
+}
+
+int main( int argc, char** argv )
+{
+	double seconds = (argc > 1 ? atof( argv [1] ) : 120.0);
+	if ( seconds <= 0 )
+		return EXIT_FAILURE;
+
+	printf( "9 voices          %7.1fx realtime\n", bench( false, seconds ) );
+	printf( "6 voices + rhythm %7.1fx realtime\n", bench( true,  seconds ) );
+	return 0;
+}
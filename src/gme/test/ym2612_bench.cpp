@@ -0,0 +1,65 @@
+// Measures how many times faster than realtime each built-in YM2612 emulator
+// plays a VGM file, by default the bundled test.vgz. Run with optional path and
+// number of seconds of sound to generate for each emulator.
+
+#include "gme.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+typedef std::chrono::steady_clock bench_clock;
+
+static long const sample_rate = 44100;
+
+static void handle_error( const char* str )
+{
+	if ( str )
+	{
+		printf( "Error: %s\n", str );
+		exit( EXIT_FAILURE );
+	}
+}
+
+int main( int argc, char** argv )
+{
+	const char* path = (argc > 1 ? argv [1] : "../test.vgz");
+	double seconds = (argc > 2 ? atof( argv [2] ) : 120.0);
+	if ( seconds <= 0 )
+		return EXIT_FAILURE;
+
+	Music_Emu* emu;
+	handle_error( gme_open_file( path, &emu, sample_rate ) );
+	gme_ignore_silence( emu, 1 );
+
+	for ( int i = gme_ym2612_nuked; i <= gme_ym2612_gens; i++ )
+	{
+		const char* name = gme_ym2612_emu_name( i );
+		if ( !name )
+			continue;
+
+		handle_error( gme_set_ym2612_emu( emu, i ) );
+		handle_error( gme_start_track( emu, 0 ) );
+
+		// best of several runs
+		double best = 0;
+		for ( int run = 0; run < 3; run++ )
+		{
+			enum { buf_size = 2048 };
+			static short buf [buf_size];
+			long remain = (long) (seconds * sample_rate * 2 / 3);
+			handle_error( gme_seek( emu, 0 ) );
+			bench_clock::time_point start = bench_clock::now();
+			for ( ; remain > 0; remain -= buf_size )
+				handle_error( gme_play( emu, buf_size, buf ) );
+			double sec = std::chrono::duration<double>( bench_clock::now() - start ).count();
+			double factor = seconds / 3 / (sec > 0 ? sec : 1e-9);
+			if ( best < factor )
+				best = factor;
+		}
+		printf( "%-6s %7.1fx realtime\n", name, best );
+	}
+
+	gme_delete( emu );
+	return 0;
+}